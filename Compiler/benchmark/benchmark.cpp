@@ -0,0 +1,402 @@
+#include "generator.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#define NULL_DEVICE "NUL"
+#define DEFAULT_COMPILER "Compiler.exe"
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#define NULL_DEVICE "/dev/null"
+#define DEFAULT_COMPILER "./Compiler"
+#endif
+
+using namespace std;
+
+// Percent a measurement can get worse than its baseline before it is reported as a regression
+#define DEFAULT_TOLERANCE 10
+
+/* Scaling programs double in size SCALING_STEPS times from their dimension's smallest size (scalingSizes). The
+ * front end fails the scaling check if its time grows faster than size to the power SCALING_LIMIT along any of them. */
+#define SCALING_STEPS 5
+#define SCALING_LIMIT 1.3
+static const int scalingSizes[SCALING_DIMENSIONS] = { 4000, 1000, 50, 1000, 1000000 };
+
+// Compiler arguments of each measured mode
+#define MODE_COUNT 3
+static const char* modeNames[MODE_COUNT] = { "scan", "parse", "full" };
+static const char* modeArguments[MODE_COUNT] = { "--scan-only", "--parse-only", "" };
+
+/* Struct to hold one benchmark's measurement of one mode.
+ *    name / mode - the benchmark program and what the compiler did with it (modeNames)
+ *    lines / bytes / tokens - size of the program
+ *    seconds - fastest wall time of the runs, including starting the compiler
+ *    peakBytes - most memory the compiler process had resident in any of the runs
+ */
+struct benchmarkResult {
+	string name;
+	string mode;
+	long long lines = 0;
+	long long bytes = 0;
+	long long tokens = 0;
+	double seconds = 0;
+	long long peakBytes = 0;
+
+	double tokensPerSecond() { return (seconds > 0) ? tokens / seconds : 0; }
+	double linesPerSecond() { return (seconds > 0) ? lines / seconds : 0; }
+};
+
+/* Run the compiler with 'arguments', sending what it prints to 'output'. Gets the wall time it took and the most
+ * memory it had resident. Returns false if it couldn't be run or didn't exit normally. */
+static bool runCompiler(string compiler, vector<string> arguments, string output, double& seconds, long long& peakBytes) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+#ifdef _WIN32
+	SECURITY_ATTRIBUTES inherit = { sizeof(inherit), NULL, TRUE };
+	HANDLE file = CreateFileA(output.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &inherit, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	STARTUPINFOA startup = {};
+	startup.cb = sizeof(startup);
+	startup.dwFlags = STARTF_USESTDHANDLES;
+	startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+	startup.hStdOutput = file;
+	startup.hStdError = file;
+	string commandLine = "\"" + compiler + "\"";
+	for (size_t a = 0; a < arguments.size(); a++) commandLine += " \"" + arguments[a] + "\"";
+	PROCESS_INFORMATION process;
+	if (!CreateProcessA(NULL, &commandLine[0], NULL, NULL, TRUE, 0, NULL, NULL, &startup, &process)) {
+		CloseHandle(file);
+		return false;
+	}
+	WaitForSingleObject(process.hProcess, INFINITE);
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	PROCESS_MEMORY_COUNTERS counters;
+	peakBytes = GetProcessMemoryInfo(process.hProcess, &counters, sizeof(counters)) ? (long long)counters.PeakWorkingSetSize : 0;
+	DWORD status = 1;
+	GetExitCodeProcess(process.hProcess, &status);
+	CloseHandle(process.hThread);
+	CloseHandle(process.hProcess);
+	CloseHandle(file);
+	return status == 0;
+#else
+	vector<char*> argv;
+	argv.push_back(&compiler[0]);
+	for (size_t a = 0; a < arguments.size(); a++) argv.push_back(&arguments[a][0]);
+	argv.push_back(NULL);
+	pid_t pid = fork();
+	if (pid < 0) return false;
+	if (pid == 0) {
+		int fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd >= 0) {
+			dup2(fd, 1);
+			dup2(fd, 2);
+		}
+		execv(compiler.c_str(), &argv[0]);
+		_exit(127);
+	}
+	int status;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) != pid) return false;
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+#ifdef __APPLE__
+	peakBytes = usage.ru_maxrss;
+#else
+	peakBytes = (long long)usage.ru_maxrss * 1024;
+#endif
+	return WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+#endif
+}
+
+// The number after "key": in a line of JSON, or -1 if the line doesn't have the key
+static double jsonNumber(string text, string key) {
+	size_t at = text.find("\"" + key + "\":");
+	if (at == string::npos) return -1;
+	return atof(text.c_str() + at + key.size() + 3);
+}
+
+// The string after "key": in a line of JSON, or "" if the line doesn't have the key
+static string jsonString(string text, string key) {
+	size_t at = text.find("\"" + key + "\": \"");
+	if (at == string::npos) return "";
+	at += key.size() + 5;
+	return text.substr(at, text.find('"', at) - at);
+}
+
+// Write the results as JSON, one result to a line so the baseline can be read back a line at a time
+static void writeResults(ostream& out, vector<benchmarkResult>& results) {
+	out << "{\n  \"benchmarks\": [\n";
+	for (size_t r = 0; r < results.size(); r++) {
+		benchmarkResult& result = results[r];
+		out << "    { \"name\": \"" << result.name << "\", \"mode\": \"" << result.mode << "\", \"lines\": " << result.lines;
+		out << ", \"bytes\": " << result.bytes << ", \"tokens\": " << result.tokens << ", \"seconds\": " << fixed << setprecision(6) << result.seconds;
+		out << ", \"tokensPerSecond\": " << setprecision(0) << result.tokensPerSecond() << ", \"linesPerSecond\": " << result.linesPerSecond();
+		out << ", \"peakRSS\": " << result.peakBytes << " }" << ((r + 1 < results.size()) ? "," : "") << "\n";
+	}
+	out << "  ]\n}" << endl;
+}
+
+static bool readResults(string filename, vector<benchmarkResult>& results) {
+	ifstream in(filename);
+	if (!in) return false;
+	string text;
+	while (getline(in, text)) {
+		benchmarkResult result;
+		result.name = jsonString(text, "name");
+		if (result.name == "") continue;
+		result.mode = jsonString(text, "mode");
+		result.lines = (long long)jsonNumber(text, "lines");
+		result.tokens = (long long)jsonNumber(text, "tokens");
+		result.seconds = jsonNumber(text, "seconds");
+		result.peakBytes = (long long)jsonNumber(text, "peakRSS");
+		results.push_back(result);
+	}
+	return true;
+}
+
+/* Compare the results with a baseline. A result is a regression if its tokens per second fell, or its peak memory
+ * grew, by more than 'tolerance' percent. Returns the number of regressions. */
+static int compareResults(vector<benchmarkResult>& results, vector<benchmarkResult>& baseline, int tolerance) {
+	int regressions = 0;
+	cout << "\nCompared with the baseline:\n" << endl;
+	for (size_t r = 0; r < results.size(); r++) {
+		for (size_t b = 0; b < baseline.size(); b++) {
+			if ((results[r].name != baseline[b].name) || (results[r].mode != baseline[b].mode)) continue;
+			double speed = 100.0 * (results[r].tokensPerSecond() / baseline[b].tokensPerSecond() - 1);
+			double memory = 100.0 * ((double)results[r].peakBytes / baseline[b].peakBytes - 1);
+			bool regressed = (speed < -tolerance) || (memory > tolerance);
+			cout << "\t" << left << setw(10) << results[r].name << setw(8) << results[r].mode << right << fixed << setprecision(1);
+			cout << showpos << setw(9) << speed << "% tokens/s" << setw(9) << memory << "% peak RSS" << noshowpos;
+			cout << (regressed ? "   REGRESSION" : "") << endl;
+			if (regressed) regressions++;
+		}
+	}
+	cout << endl;
+	return regressions;
+}
+
+// Struct to hold one program of the suite
+struct benchmarkProgram {
+	string name;
+	generatorSettings settings;
+};
+
+static vector<benchmarkProgram> defaultSuite() {
+	vector<benchmarkProgram> suite(3);
+	suite[0].name = "small";
+	suite[0].settings.procedures = 100;
+	suite[0].settings.depth = 1;
+	suite[1].name = "medium";
+	suite[1].settings.procedures = 500;
+	suite[1].settings.globals = 64;
+	suite[1].settings.expressionLength = 8;
+	suite[1].settings.commentDensity = 20;
+	suite[2].name = "large";
+	suite[2].settings.procedures = 2000;
+	suite[2].settings.depth = 3;
+	suite[2].settings.globals = 256;
+	suite[2].settings.arraySize = 64;
+	suite[2].settings.expressionLength = 12;
+	suite[2].settings.commentDensity = 30;
+	return suite;
+}
+
+// Set a generator setting from a --name=N argument. Returns false if the argument isn't one.
+static bool generatorArgument(string arg, generatorSettings& settings) {
+	const char* names[] = { "--procedures=", "--depth=", "--globals=", "--array=", "--expression=", "--comments=", "--seed=" };
+	int* values[] = { &settings.procedures, &settings.depth, &settings.globals, &settings.arraySize, &settings.expressionLength, &settings.commentDensity, NULL };
+	for (int n = 0; n < 7; n++) {
+		string name = names[n];
+		if ((arg.compare(0, name.size(), name) != 0) || (arg.size() == name.size()) || !isdigit(arg[name.size()])) continue;
+		if (values[n]) *values[n] = atoi(arg.c_str() + name.size());
+		else settings.seed = (unsigned int)strtoul(arg.c_str() + name.size(), NULL, 10);
+		return true;
+	}
+	return false;
+}
+
+/* Time the compiler parsing the scaling programs of each dimension, doubling their size each step. The growth is the
+ * slope of a least squares fit of log time against log size, after taking off the time to compile the dimension's
+ * smallest program (starting the compiler). Returns the number of dimensions that grew faster than SCALING_LIMIT. */
+static int checkScaling(string compiler, int runs) {
+	int failures = 0;
+	string filename = "benchmark_scaling.src";
+	cout << "\t" << left << setw(12) << "Dimension" << right;
+	for (int step = 0; step < SCALING_STEPS; step++) cout << setw(10) << ("x" + to_string(1 << step));
+	cout << setw(10) << "Growth" << endl;
+	for (int d = 0; d < SCALING_DIMENSIONS; d++) {
+		vector<double> sizes, times;
+		double startup = 0;
+		for (int step = -1; step < SCALING_STEPS; step++) {
+			int size = (step < 0) ? 1 : (scalingSizes[d] << step);
+			ofstream out(filename);
+			generateScalingProgram(out, d, size);
+			out.close();
+			double best = 0, seconds;
+			long long peakBytes;
+			vector<string> arguments = { "--parse-only", filename };
+			for (int r = 0; r < runs; r++) {
+				// Programs with errors exit with 0 too, but one nested too deep is a fatal error
+				if (!runCompiler(compiler, arguments, NULL_DEVICE, seconds, peakBytes)) {
+					cout << "ERROR: " << compiler << " failed on the " << scalingNames[d] << " program of size " << size << endl;
+					return failures + 1;
+				}
+				if ((r == 0) || (seconds < best)) best = seconds;
+			}
+			if (step < 0) startup = best;
+			else {
+				sizes.push_back(log((double)size));
+				times.push_back(log(max(best - startup, 1e-6)));
+			}
+		}
+		remove(filename.c_str());
+
+		double meanSize = 0, meanTime = 0, covariance = 0, variance = 0;
+		for (size_t s = 0; s < sizes.size(); s++) {
+			meanSize += sizes[s] / sizes.size();
+			meanTime += times[s] / times.size();
+		}
+		for (size_t s = 0; s < sizes.size(); s++) {
+			covariance += (sizes[s] - meanSize) * (times[s] - meanTime);
+			variance += (sizes[s] - meanSize) * (sizes[s] - meanSize);
+		}
+		double growth = covariance / variance;
+		cout << "\t" << left << setw(12) << scalingNames[d] << right << fixed << setprecision(4);
+		for (size_t s = 0; s < times.size(); s++) cout << setw(10) << exp(times[s]);
+		cout << setw(8) << setprecision(2) << "n^" << growth << ((growth > SCALING_LIMIT) ? "   SUPER-LINEAR" : "") << endl;
+		if (growth > SCALING_LIMIT) failures++;
+	}
+	cout << endl;
+	return failures;
+}
+
+static void usage() {
+	cout << "Usage: benchmark [ --compiler=PATH | --runs=N | --save=FILE | --baseline=FILE | --tolerance=PERCENT ]" << endl;
+	cout << "       benchmark --scaling [ --compiler=PATH | --runs=N ]" << endl;
+	cout << "       benchmark --generate=FILE [ --procedures=N | --depth=N | --globals=N | --array=N | --expression=N | --comments=PERCENT | --seed=N ]" << endl;
+	cout << "\nThe first form generates the small, medium and large programs, and measures the compiler only scanning, only" << endl;
+	cout << "parsing, and fully compiling each one. --save writes the results as a JSON baseline, and --baseline compares them" << endl;
+	cout << "with one saved before, exiting with 1 if tokens/s or peak RSS got more than --tolerance percent (default 10) worse." << endl;
+	cout << "The second form parses programs that double in expression length, errors on one line, nesting depth, identifier" << endl;
+	cout << "length and comment length, and exits with 1 if the time grows faster than n^" << SCALING_LIMIT << " along any of them." << endl;
+	cout << "The third form only writes a generated program." << endl;
+}
+
+int main(int argc, char* argv[]) {
+	string compiler = DEFAULT_COMPILER;
+	string save = "", baselineFile = "", generate = "";
+	int runs = 3;
+	int tolerance = DEFAULT_TOLERANCE;
+	bool scaling = false;
+	generatorSettings settings;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg.compare(0, 11, "--compiler=") == 0) compiler = arg.substr(11);
+		else if ((arg.compare(0, 7, "--runs=") == 0) && (atoi(arg.c_str() + 7) > 0)) runs = atoi(arg.c_str() + 7);
+		else if (arg.compare(0, 7, "--save=") == 0) save = arg.substr(7);
+		else if (arg.compare(0, 11, "--baseline=") == 0) baselineFile = arg.substr(11);
+		else if ((arg.compare(0, 12, "--tolerance=") == 0) && isdigit(arg[12])) tolerance = atoi(arg.c_str() + 12);
+		else if (arg.compare(0, 11, "--generate=") == 0) generate = arg.substr(11);
+		else if (arg == "--scaling") scaling = true;
+		else if (!generatorArgument(arg, settings)) {
+			usage();
+			return 1;
+		}
+	}
+
+	if (generate != "") {
+		ofstream out(generate);
+		if (!out) {
+			cout << "ERROR: Could not write " << generate << endl;
+			return 1;
+		}
+		int lines = generateProgram(out, settings);
+		cout << "Wrote " << lines << " lines to " << generate << endl;
+		return 0;
+	}
+
+	if (scaling) return (checkScaling(compiler, runs) > 0) ? 1 : 0;
+
+	vector<benchmarkProgram> suite = defaultSuite();
+	vector<benchmarkResult> results;
+	cout << "\t" << left << setw(10) << "Program" << setw(8) << "Mode" << right << setw(10) << "Lines" << setw(12) << "Tokens";
+	cout << setw(12) << "Seconds" << setw(14) << "Tokens/s" << setw(12) << "Lines/s" << setw(14) << "Peak RSS" << endl;
+	for (size_t p = 0; p < suite.size(); p++) {
+		string filename = "benchmark_" + suite[p].name + ".src";
+		ofstream out(filename);
+		long long lines = generateProgram(out, suite[p].settings);
+		long long bytes = (long long)out.tellp();
+		out.close();
+
+		// The token count comes from a run with the time report, which isn't one of the measured runs
+		double seconds;
+		long long peakBytes;
+		string report = "benchmark_" + suite[p].name + ".json";
+		vector<string> countArguments = { "--scan-only", "--time-report=json", filename };
+		if (!runCompiler(compiler, countArguments, report, seconds, peakBytes)) {
+			cout << "ERROR: Could not run " << compiler << endl;
+			return 1;
+		}
+		ifstream in(report);
+		string text;
+		long long tokens = 0;
+		while (getline(in, text)) {
+			if (jsonNumber(text, "tokens") >= 0) tokens = (long long)jsonNumber(text, "tokens");
+		}
+		in.close();
+		remove(report.c_str());
+
+		for (int m = 0; m < MODE_COUNT; m++) {
+			benchmarkResult result;
+			result.name = suite[p].name;
+			result.mode = modeNames[m];
+			result.lines = lines;
+			result.bytes = bytes;
+			result.tokens = tokens;
+			vector<string> arguments;
+			if (string(modeArguments[m]) != "") arguments.push_back(modeArguments[m]);
+			arguments.push_back(filename);
+			for (int r = 0; r < runs; r++) {
+				if (!runCompiler(compiler, arguments, NULL_DEVICE, seconds, peakBytes)) {
+					cout << "ERROR: " << compiler << " failed on " << filename << endl;
+					return 1;
+				}
+				if ((r == 0) || (seconds < result.seconds)) result.seconds = seconds;
+				if (peakBytes > result.peakBytes) result.peakBytes = peakBytes;
+			}
+			cout << "\t" << left << setw(10) << result.name << setw(8) << result.mode << right << setw(10) << result.lines << setw(12) << result.tokens;
+			cout << setw(12) << fixed << setprecision(3) << result.seconds << setw(14) << setprecision(0) << result.tokensPerSecond();
+			cout << setw(12) << result.linesPerSecond() << setw(14) << result.peakBytes << endl;
+			results.push_back(result);
+		}
+		remove(filename.c_str());
+	}
+
+	if (save != "") {
+		ofstream out(save);
+		writeResults(out, results);
+		cout << "\nSaved the results to " << save << endl;
+	}
+	if (baselineFile != "") {
+		vector<benchmarkResult> baseline;
+		if (!readResults(baselineFile, baseline)) {
+			cout << "ERROR: Could not read the baseline " << baselineFile << endl;
+			return 1;
+		}
+		if (compareResults(results, baseline, tolerance) > 0) return 1;
+	}
+	return 0;
+}
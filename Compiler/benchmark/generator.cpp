@@ -0,0 +1,186 @@
+#include "generator.h"
+#include <string>
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+/* Writes one program. The random numbers come from a fixed linear congruential generator rather than <random>'s
+ * distributions, which aren't the same between standard libraries, so a seed gives the same program everywhere. */
+class programWriter
+{
+private:
+	ostream& out;
+	generatorSettings& settings;
+	unsigned int state;
+	int lines;
+
+	int random(int n) {
+		state = state * 1103515245u + 12345u;
+		return (int)((state >> 16) % (unsigned int)n);
+	}
+
+	void line(int indent, string text) {
+		out << string(indent, '\t') << text << "\n";
+		lines++;
+		if (random(100) < settings.commentDensity) {
+			out << string(indent, '\t') << "// generated comment " << lines << " about the line above\n";
+			lines++;
+		}
+	}
+
+	// An integer expression of the settings' length using the procedure's locals and the globals
+	string arithmetic() {
+		const char* ops[] = { " + ", " - ", " * ", " + " };
+		ostringstream expr;
+		for (int i = 0; i < settings.expressionLength; i++) {
+			if (i > 0) expr << ops[random(4)];
+			switch (random(5)) {
+			case 0: expr << "a"; break;
+			case 1: expr << "b"; break;
+			case 2: expr << "t"; break;
+			case 3: expr << "gi" << random(globalCount(0)); break;
+			default: expr << (random(100) + 1); break;
+			}
+		}
+		return expr.str();
+	}
+
+	// A condition like the ones in logicals.src
+	string condition() {
+		switch (random(4)) {
+		case 0: return "(t > " + to_string(random(1000)) + ")";
+		case 1: return "(gb" + to_string(random(globalCount(2))) + " & (a < b))";
+		case 2: return "(not flag | (t == b))";
+		default: return "(gs" + to_string(random(globalCount(3))) + " == \"A\")";
+		}
+	}
+
+	// Globals of each type are named gi, gf, gb and gs with a number, so each type has at least one
+	int globalCount(int type) {
+		int count = settings.globals / 4 + ((type < settings.globals % 4) ? 1 : 0);
+		return (count > 0) ? count : 1;
+	}
+
+	// Nested if / for statements down to 'depth', each assigning to the procedure's locals
+	void statements(int indent, int depth) {
+		line(indent, "t := " + arithmetic() + ";");
+		if (depth <= 0) return;
+		if (random(2) == 0) {
+			line(indent, "if " + condition() + " then");
+			statements(indent + 1, depth - 1);
+			line(indent, "else");
+			line(indent + 1, "flag := not flag;");
+			line(indent, "end if;");
+		}
+		else {
+			line(indent, "for (i := 0; i < " + to_string(settings.arraySize) + ")");
+			line(indent + 1, "v[i] := ga[i] + " + arithmetic() + ";");
+			statements(indent + 1, depth - 1);
+			line(indent + 1, "i := i + 1;");
+			line(indent, "end for;");
+		}
+	}
+
+	// A procedure with 'depth' more declared inside of it, each calling the next one in like multipleProcs.src
+	void procedure(int indent, string name, int depth, int index) {
+		line(indent, string((indent == 0) ? "global " : "") + "procedure " + name + " : integer (variable a : integer, variable b : integer)");
+		line(indent + 1, "variable i : integer;");
+		line(indent + 1, "variable t : integer;");
+		line(indent + 1, "variable flag : bool;");
+		line(indent + 1, "variable v : integer[" + to_string(settings.arraySize) + "];");
+		string inner = name + "_" + to_string(depth);
+		if (depth > 0) procedure(indent + 1, inner, depth - 1, index);
+		line(indent, "begin");
+		statements(indent + 1, settings.depth);
+		if (depth > 0) line(indent + 1, "t := t + " + inner + "(t, a);");
+
+		// Top level procedures are recursive like recursiveFib.src, and call a few of the ones before them
+		if (indent == 0) {
+			line(indent + 1, "if (a < 2) then");
+			line(indent + 2, "return a;");
+			line(indent + 1, "end if;");
+			line(indent + 1, "t := t + " + name + "(a - 1, b) + " + name + "(a - 2, b);");
+			for (int c = random(3); (c > 0) && (index > 0); c--) line(indent + 1, "t := t + P" + to_string(random(index)) + "(t, b - " + to_string(c) + ");");
+		}
+		line(indent + 1, "gi0 := gi0 + t;");
+		line(indent + 1, "return t;");
+		line(indent, "end procedure;");
+	}
+
+public:
+	programWriter(ostream& out_input, generatorSettings& settings_input) : out(out_input), settings(settings_input) {
+		state = settings.seed;
+		lines = 0;
+	}
+
+	int write() {
+		const char* types[] = { "integer", "float", "bool", "string" };
+		const char* prefixes[] = { "gi", "gf", "gb", "gs" };
+		line(0, "program Generated is");
+		line(0, "");
+		for (int type = 0; type < 4; type++) {
+			for (int g = 0; g < globalCount(type); g++) line(0, string("global variable ") + prefixes[type] + to_string(g) + " : " + types[type] + ";");
+		}
+		line(0, "global variable ga : integer[" + to_string(settings.arraySize) + "];");
+		line(0, "variable x : integer;");
+		line(0, "variable done : bool;");
+		line(0, "");
+		for (int p = 0; p < settings.procedures; p++) procedure(0, "P" + to_string(p), settings.depth, p);
+		line(0, "");
+		line(0, "begin");
+		line(0, "");
+		line(1, "gs0 := getString();");
+		line(1, "x := getInteger();");
+		if (settings.procedures > 0) line(1, "x := P" + to_string(settings.procedures - 1) + "(x, 2);");
+		line(1, "done := putInteger(x);");
+		line(0, "");
+		line(0, "end program.");
+		return lines;
+	}
+};
+
+int generateProgram(ostream& out, generatorSettings& settings) {
+	programWriter writer(out, settings);
+	return writer.write();
+}
+
+const char* scalingNames[SCALING_DIMENSIONS] = { "expression", "errors", "nesting", "identifier", "comment" };
+
+void generateScalingProgram(ostream& out, int dimension, int size) {
+	out << "program Scaling is\n\n";
+	out << "variable x : integer;\n";
+	string name = "y";
+	if (dimension == SCALING_IDENTIFIER) name = "y" + string(size - 1, 'a');
+	out << "variable " << name << " : integer;\n";
+	out << "variable b : bool;\n\nbegin\n\n";
+	switch (dimension) {
+	case SCALING_EXPRESSION:
+		out << "x := 1";
+		for (int i = 1; i < size; i++) out << ((i % 2) ? " + x * " : " - ") << (i % 97);
+		out << ";\n";
+		break;
+	case SCALING_ERRORS:
+		for (int i = 0; i < size; i++) out << "x := b + " << i << "; ";
+		out << "\n";
+		break;
+	case SCALING_NESTING:
+		for (int c = 0; c < SCALING_COPIES; c++) {
+			for (int i = 0; i < size; i++) out << string(i % 8, '\t') << "if (x > " << i << ") then\n";
+			out << "x := x + 1;\n";
+			for (int i = size - 1; i >= 0; i--) out << string(i % 8, '\t') << "end if;\n";
+		}
+		break;
+	case SCALING_IDENTIFIER:
+		for (int c = 0; c < SCALING_COPIES; c++) out << name << " := " << name << " + " << c << ";\n";
+		break;
+	case SCALING_COMMENT:
+		out << "/* ";
+		for (int i = 3; i < size; i += 16) out << ((i % 1024 == 3) ? "/* nested */ \n" : "comment text... ");
+		out << " */\n";
+		out << "x := 1;\n";
+		break;
+	}
+	out << "\nend program.\n";
+}
@@ -0,0 +1,52 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <string>
+#include <ostream>
+
+using namespace std;
+
+/* Struct to hold the shape of a generated program. Every program is valid and compiles without errors or warnings.
+ *    procedures - number of procedures declared in the program body, each calling some of the ones before it
+ *    depth - how deep procedures are declared inside each other, and if / for statements are nested, in each one
+ *    globals - number of global scalar variables, of every type
+ *    arraySize - size of the global and local arrays, and the number of times each loop goes around
+ *    expressionLength - number of operands in each arithmetic expression
+ *    commentDensity - percent of the lines followed by a comment line
+ *    seed - seed of the random choices, so the same settings always give the same program
+ */
+struct generatorSettings {
+	int procedures = 100;
+	int depth = 2;
+	int globals = 16;
+	int arraySize = 16;
+	int expressionLength = 6;
+	int commentDensity = 10;
+	unsigned int seed = 1;
+};
+
+/* Write a program made of the constructs in testPgms/correct: recursive procedures (recursiveFib.src), procedures
+ * declared inside each other calling the next one in (multipleProcs.src), and bool and string conditions
+ * (logicals.src), along with loops over arrays. Returns the number of lines written. */
+int generateProgram(ostream& out, generatorSettings& settings);
+
+// Dimensions a scaling program grows along
+#define SCALING_EXPRESSION 0
+#define SCALING_ERRORS 1
+#define SCALING_NESTING 2
+#define SCALING_IDENTIFIER 3
+#define SCALING_COMMENT 4
+#define SCALING_DIMENSIONS 5
+
+// Times the nested statements and the long identifier are repeated, so their cost is well above starting the compiler
+#define SCALING_COPIES 64
+
+extern const char* scalingNames[SCALING_DIMENSIONS];
+
+/* Write a program that is 'size' long along one dimension and small along the others, in the shape generated code
+ * is worst for: an expression of 'size' operands on one line, 'size' errors on one line, if statements nested 'size'
+ * deep (SCALING_COPIES times over), an identifier 'size' characters long (used SCALING_COPIES times), or a nested
+ * comment 'size' characters long. */
+void generateScalingProgram(ostream& out, int dimension, int size);
+
+#endif
@@ -0,0 +1,217 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "compileCache.h"
+#include "sha256.h"
+#include "options.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#include <sys/utime.h>
+#define getpid _getpid
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+#include "fileMap.h"
+
+using namespace std;
+
+// First line of every entry, so files that aren't complete entries are never replayed
+#define CACHE_ENTRY_HEADER "EECE5183-CACHE 1\n"
+
+// Constructor - creates the directory if it doesn't exist yet
+compileCache::compileCache(string directory_input, long long maxBytes_input) {
+	directory = directory_input;
+	maxBytes = maxBytes_input;
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0777);
+#endif
+}
+
+string compileCache::entryPath(string key) {
+	return directory + "/" + key + ".out";
+}
+
+static bool readFile(string filename, string& contents) {
+	ifstream file(filename.c_str(), ios::in | ios::binary);
+	if (!file) return false;
+	stringstream buffer;
+	buffer << file.rdbuf();
+	contents = buffer.str();
+	return true;
+}
+
+/* Part of every cache key, so entries made by a different build of the compiler are never used: the SHA-256 of the
+ * compiler's executable. A rebuild changes it even when it didn't recompile this file. It is hashed once per process
+ * (the compile server does it before forking). If the executable can't be read, the time this file was built is used,
+ * which misses rebuilds that didn't recompile it. */
+string compileCache::buildId() {
+	static const string id = []() {
+		string path;
+#ifdef _WIN32
+		char module[MAX_PATH];
+		DWORD length = GetModuleFileNameA(NULL, module, MAX_PATH);
+		if ((length > 0) && (length < MAX_PATH)) path = string(module, length);
+#else
+		path = "/proc/self/exe";
+#endif
+		fileMap executable(path.c_str());
+		if (!executable) return string(COMPILER_VERSION " (" __DATE__ " " __TIME__ ")");
+		sha256 hash;
+		hash.update(executable.begin(), executable.size());
+		return hash.hexDigest();
+	}();
+	return id;
+}
+
+/* The key of compiling 'filename' with 'options', as 64 hex digits. Options that don't change the output (the
+ * number of jobs and the cache settings) are left out. Returns false if the source, profile or an imported interface
+ * can't be read. */
+bool compileCache::key(string filename, compilerOptions& options, string& result) {
+	string source, profile;
+	if (!readFile(filename, source)) return false;
+	if ((options.profile != "") && !readFile(options.profile, profile)) return false;
+	vector<string> interfaces(options.imports.size());
+	for (size_t i = 0; i < options.imports.size(); i++) {
+		if (!readFile(options.imports[i], interfaces[i])) return false;
+	}
+
+	ostringstream settings;
+	settings << COMPILER_VERSION << "\n" << buildId() << "\ndebug " << options.debug << "\nstats " << options.stats << "\nir " << options.emitIR;
+	settings << "\noptimize " << options.optimize << "\ninline " << options.inlineBudget << "\nmemoize " << options.memoize;
+	settings << "\nregstats " << options.regStats << "\nframes " << options.frameReport << "\nprofile " << profile.size();
+	settings << "\nscan " << options.scanOnly << "\nparse " << options.parseOnly << "\nimports";
+	for (size_t i = 0; i < interfaces.size(); i++) settings << " " << interfaces[i].size();
+	settings << "\n";
+
+	sha256 hash;
+	hash.update(settings.str());
+	hash.update(profile);
+	for (size_t i = 0; i < interfaces.size(); i++) hash.update(interfaces[i]);
+	hash.update(source);
+	result = hash.hexDigest();
+	return true;
+}
+
+// Get the stored output for a key. A hit marks the entry as just used.
+bool compileCache::lookup(string key, string& output) {
+	string path = entryPath(key);
+	string contents;
+	string header = CACHE_ENTRY_HEADER;
+	if (!readFile(path, contents) || (contents.compare(0, header.size(), header) != 0)) return false;
+	output = contents.substr(header.size());
+#ifdef _WIN32
+	_utime(path.c_str(), NULL);
+#else
+	utime(path.c_str(), NULL);
+#endif
+	return true;
+}
+
+/* Add an entry. It is written to a temporary file first and then renamed, so a compiler running at the same time
+ * never sees a partial entry. When adding many entries at once, only the last one needs to trim the directory. */
+void compileCache::store(string key, string& output, bool trim) {
+	string path = entryPath(key);
+	string temporary = path + ".tmp" + to_string((long long)getpid());
+	{
+		ofstream file(temporary.c_str(), ios::out | ios::binary | ios::trunc);
+		if (!file) return;
+		file << CACHE_ENTRY_HEADER << output;
+		if (!file) {
+			file.close();
+			remove(temporary.c_str());
+			return;
+		}
+	}
+#ifdef _WIN32
+	remove(path.c_str());
+#endif
+	if (rename(temporary.c_str(), path.c_str()) != 0) remove(temporary.c_str());
+	if (trim) evict();
+}
+
+// Struct to hold a cache entry's file while the cache is being trimmed
+struct cacheFile {
+	string path;
+	long long bytes;
+	long long used;
+};
+
+// Delete the least recently used entries until the directory is under its size limit
+void compileCache::evict() {
+	vector<cacheFile> files;
+	long long total = 0;
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((directory + "/*.out").c_str(), &found);
+	if (search != INVALID_HANDLE_VALUE) {
+		do {
+			cacheFile file;
+			file.path = directory + "/" + found.cFileName;
+			file.bytes = ((long long)found.nFileSizeHigh << 32) | found.nFileSizeLow;
+			file.used = ((long long)found.ftLastWriteTime.dwHighDateTime << 32) | found.ftLastWriteTime.dwLowDateTime;
+			files.push_back(file);
+		} while (FindNextFileA(search, &found));
+		FindClose(search);
+	}
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (!dir) return;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		string name = entry->d_name;
+		if ((name.size() < 4) || (name.compare(name.size() - 4, 4, ".out") != 0)) continue;
+		cacheFile file;
+		file.path = directory + "/" + name;
+		struct stat info;
+		if (stat(file.path.c_str(), &info) != 0) continue;
+		file.bytes = (long long)info.st_size;
+		file.used = (long long)info.st_mtime;
+		files.push_back(file);
+	}
+	closedir(dir);
+#endif
+	for (size_t f = 0; f < files.size(); f++) total += files[f].bytes;
+	if (total <= maxBytes) return;
+
+	sort(files.begin(), files.end(), [](const cacheFile& a, const cacheFile& b) { return a.used < b.used; });
+	for (size_t f = 0; (f < files.size()) && (total > maxBytes); f++) {
+		if (remove(files[f].path.c_str()) == 0) total -= files[f].bytes;
+	}
+}
+
+// Constructor - output goes on to 'target'
+recordingBuffer::recordingBuffer(streambuf* target_input) {
+	target = target_input;
+}
+
+int recordingBuffer::overflow(int c) {
+	if (c == EOF) return 0;
+	recorded += (char)c;
+	return target->sputc((char)c);
+}
+
+streamsize recordingBuffer::xsputn(const char* data, streamsize count) {
+	recorded.append(data, (size_t)count);
+	return target->sputn(data, count);
+}
+
+int recordingBuffer::sync() {
+	return target->pubsync();
+}
+
+string& recordingBuffer::output() {
+	return recorded;
+}
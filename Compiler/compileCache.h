@@ -0,0 +1,55 @@
+#ifndef COMPILECACHE_H
+#define COMPILECACHE_H
+
+#include "options.h"
+#include <string>
+#include <streambuf>
+
+using namespace std;
+
+// Name and version of the compiler. Cache keys use compileCache::buildId() as well, which changes with every build.
+#define COMPILER_VERSION "EECE5183 compiler 1.0"
+
+/*
+ * Cache of compilation results, stored in a local directory. Each entry is the complete output of one
+ * compilation (diagnostics, statistics and IR), in a file named by the SHA-256 of everything that can change it:
+ * the source bytes, the compiler version, the options and the profile file's contents. A hit replays the output
+ * without scanning, parsing or optimizing anything. On a miss, the procedures that didn't change since an earlier
+ * compilation are taken from entries of their own (irIncremental.cpp), so only the edited ones are optimized again.
+ * Entries are touched when used, and the least recently used ones are deleted once the directory holds more than
+ * the size limit.
+ */
+class compileCache
+{
+private:
+	string directory;
+	long long maxBytes;
+	string entryPath(string key);
+	void evict();
+public:
+	compileCache(string directory_input, long long maxBytes_input);
+	static string buildId();
+	static bool key(string filename, compilerOptions& options, string& result);
+	bool lookup(string key, string& output);
+	void store(string key, string& output, bool trim = true);
+};
+
+/*
+ * Stream buffer that passes everything written to it on to another buffer and keeps a copy, so the output of a
+ * compilation is shown as it happens and can be stored in the cache afterwards.
+ */
+class recordingBuffer : public streambuf
+{
+private:
+	streambuf* target;
+	string recorded;
+protected:
+	int overflow(int c);
+	streamsize xsputn(const char* data, streamsize count);
+	int sync();
+public:
+	recordingBuffer(streambuf* target_input);
+	string& output();
+};
+
+#endif
@@ -3,43 +3,173 @@
 #include "token.h"
 #include "parser.h"
 #include "scopeMap.h"
+#include "options.h"
+#include "ir.h"
+#include "irPasses.h"
+#include "compileCache.h"
+#include "moduleInterface.h"
+#include "syntaxTree.h"
+#include "phaseReport.h"
+#include "compilerServer.h"
+#include "languageServer.h"
+#include "tokenStream.h"
 #include <iostream>
+#include <string>
+#include <map>
+#include <vector>
+#include <cstdlib>
 
 void invalidCommand() {
-	cout << "Invalid command line arguments. Example: [ --help | --h | --debug | --d ] filename" << endl;
+	cout << "Invalid command line arguments. Example: [ --help | --h | --debug | --d | --stats | --s | --ir | --i | --noopt | --n | --inline=N | --profile=FILE | --memoize | --m | --regstats | --r | --frames | --f | --jobs=N | --cache=DIR | --cachesize=MB | --time-report[=json] | --mem-report | --scan-only | --parse-only | --export=FILE | --import=FILE | --syntax=FILE | --server=SOCKET | --connect=SOCKET | --lsp | --relex-check=N ] filename" << endl;
 	return;
 }
 
-int main(int argc, char* argv[]) {
+int compilerMain(int argc, char* argv[]) {
     if (argc < 2) {
         std::cout << ("ERROR: No filename argument provided\n");
-        return 0;
+        return EXIT_FAILURE;
     }
 
-	bool debug = false;
-	string filename;
-	if ((argc == 2) || (argc == 3)) {
-		if ((string(argv[1]) == "--help") || (string(argv[1]) == "--h")) {
+	compilerOptions options;
+	string filename = "";
+	for (int i = 1; i < argc; i++) {
+		string arg = string(argv[i]);
+		if ((arg == "--help") || (arg == "--h")) {
 			std::cout << "\nThis is a compiler written for the University of Cincinnati class: EECE5183 Compiler Theory" << endl;
 			std::cout << "\nThe compiler is an LL(1) recursive descent compiler that uses C++ to scan, parse, and type check the program and LLVM to generate the compiler backend." << endl;
-			std::cout << "\nTo use this compiler, compile and then run from the command line using the arguments: [ --help | --h | --debug | --d ] filename." << endl;
-			std::cout << "\nThe compiler will scan and parse your file and generate code if parsing is successful. Otherwise relevant errors and warnings will be shown." << endl;
+			std::cout << "\nTo use this compiler, compile and then run from the command line using the arguments: [ --help | --h | --debug | --d | --stats | --s | --ir | --i | --noopt | --n | --inline=N | --profile=FILE | --memoize | --m | --regstats | --r | --frames | --f | --jobs=N | --cache=DIR | --cachesize=MB | --time-report[=json] | --mem-report | --scan-only | --parse-only | --export=FILE | --import=FILE | --syntax=FILE | --server=SOCKET | --connect=SOCKET | --lsp | --relex-check=N ] filename." << endl;
+			std::cout << "\nThe compiler will scan and parse your file and generate code if parsing is successful. Otherwise relevant errors and warnings will be shown, and the compiler exits with status 1." << endl;
 			std::cout << "\n--debug or --d argument will print out each token as it is scanned and print out each scope's symbol table after the scope is exited." << endl;
+			std::cout << "\n--stats or --s argument will print out counts of the tokens scanned, symbols added and looked up, and scopes created, of the constant expressions folded and constant variable values propagated, and of the changes made by the optimizer." << endl;
+			std::cout << "\n--ir or --i argument will print out the SSA intermediate representation of each procedure after optimization." << endl;
+			std::cout << "\n--noopt or --n argument will skip dead code elimination, value numbering, loop invariant code motion, vectorization of whole array expressions, bounds check elimination, inlining, and tail call optimization." << endl;
+			std::cout << "\n--inline=N argument sets the size in IR instructions of the largest procedure inlined at a call site (default 40, 0 turns inlining off)." << endl;
+			std::cout << "\n--profile=FILE argument reads call counts ('label count' per line) to skip inlining procedures that are never called and inline hot ones more." << endl;
+			std::cout << "\n--memoize or --m argument caches the results of recursive procedures that only depend on their scalar arguments (no globals, no I/O). The cache size can be set with a '//#memo N' comment before the procedure." << endl;
+			std::cout << "\n--regstats or --r argument will print out how many values the register allocator kept in registers (in and out of loops) and how many it spilled to the stack." << endl;
+			std::cout << "\n--frames or --f argument will print out the stack frame size in bytes of each procedure with every variable in its own slot, and after the frame layout shares slots and leaves out the variables kept in registers." << endl;
+			std::cout << "\n--jobs=N argument sets the number of threads procedures are optimized and compiled on (default 0, one per hardware thread). The output is the same for any number." << endl;
+			std::cout << "\n--cache=DIR argument keeps the output of each compilation in DIR, and replays it without compiling when the same source is compiled again with the same options. When the source changed, the procedures that didn't change (and don't call one that did) are taken from DIR instead of being optimized again." << endl;
+			std::cout << "\n--cachesize=MB argument sets the size the cache directory is kept under by deleting the least recently used entries (default " << CACHE_DEFAULT_MEGABYTES << ", at least 1)." << endl;
+			std::cout << "\n--time-report argument will print out the time spent scanning, parsing, in the symbol tables, optimizing, and generating code, with the counts from --stats. --time-report=json prints them as a JSON object. The compile cache isn't used, since its timings would be stale." << endl;
+			std::cout << "\n--mem-report argument will print out the number of heap allocations, bytes allocated and peak live bytes of each phase, and of the sites in the compiler that allocated the most. The compile cache isn't used either." << endl;
+			std::cout << "\n--scan-only argument only scans the source, and --parse-only scans and parses it without optimizing or generating code. These are for measuring the compiler's phases on their own." << endl;
+			std::cout << "\n--export=FILE argument writes the global procedures and variables of the program to the interface file FILE, so other programs can use them without parsing its source." << endl;
+			std::cout << "\n--import=FILE argument lets the program use the global procedures and variables in the interface file FILE written with --export. The file is mapped into memory and its symbols are looked up where they are. It can be given more than once, and the first interface with a name is the one used." << endl;
+			std::cout << "\n--syntax=FILE argument keeps the tokens and syntax tree (declarations, statements and calls) of the source in the file FILE, in a binary format other tools can read without the compiler. When the source hasn't changed since FILE was written, its tokens are read from FILE instead of scanned again (except with --debug, which shows them as they are scanned)." << endl;
+			std::cout << "\n--server=SOCKET argument keeps the compiler running as a server listening on the Unix domain socket SOCKET, which compiles the programs sent to it with --connect, several at once. The other arguments given with --server are added to each of those compilations, so --server=SOCKET --cache=DIR shares one compile cache between them." << endl;
+			std::cout << "\n--connect=SOCKET argument sends the other arguments to the server listening on SOCKET and shows the output of the compilation as it happens. If no server is listening, the program is compiled here instead." << endl;
+			std::cout << "\n--lsp argument runs a language server on stdin and stdout, which shows an editor the errors in the open programs as they are edited and finds where their symbols are declared and used." << endl;
+			std::cout << "\n--relex-check=N argument makes N edits to the file and checks that relexing the text after each one (as an editor keeping its tokens would) gives the same tokens as scanning it all again, and how much less it scans." << endl;
 			return 0;
 		}
-		else if ((string(argv[1]) == "--debug") || (string(argv[1]) == "--d")) {
-			debug = true;
-			filename = string(argv[2]);
+		else if ((arg == "--debug") || (arg == "--d")) {
+			options.debug = true;
+		}
+		else if ((arg == "--stats") || (arg == "--s")) {
+			options.stats = true;
+		}
+		else if ((arg == "--ir") || (arg == "--i")) {
+			options.emitIR = true;
+		}
+		else if ((arg == "--noopt") || (arg == "--n")) {
+			options.optimize = false;
+		}
+		else if ((arg == "--memoize") || (arg == "--m")) {
+			options.memoize = true;
+		}
+		else if ((arg == "--regstats") || (arg == "--r")) {
+			options.regStats = true;
+		}
+		else if ((arg == "--frames") || (arg == "--f")) {
+			options.frameReport = true;
+		}
+		else if ((arg.compare(0, 9, "--inline=") == 0) && (arg.size() > 9) && isdigit(arg[9])) {
+			options.inlineBudget = atoi(arg.c_str() + 9);
+		}
+		else if ((arg.compare(0, 7, "--jobs=") == 0) && (arg.size() > 7) && isdigit(arg[7])) {
+			options.jobs = atoi(arg.c_str() + 7);
+		}
+		else if ((arg.compare(0, 8, "--cache=") == 0) && (arg.size() > 8)) {
+			options.cacheDirectory = arg.substr(8);
+		}
+		// A size of 0 would delete every entry as soon as it is stored, so it is rejected like any other bad argument
+		else if ((arg.compare(0, 12, "--cachesize=") == 0) && (arg.size() > 12) && isdigit(arg[12]) && (atoi(arg.c_str() + 12) > 0)) {
+			options.cacheMegabytes = atoi(arg.c_str() + 12);
+		}
+		else if ((arg == "--time-report") || (arg == "--time-report=json")) {
+			options.timeReport = (arg == "--time-report") ? "table" : "json";
 		}
-		else if (argc == 2) {
-			debug = false;
-			filename = string(argv[1]);
+		else if (arg == "--mem-report") {
+			options.memoryReport = true;
+		}
+		else if (arg == "--scan-only") {
+			options.scanOnly = true;
+		}
+		else if (arg == "--parse-only") {
+			options.parseOnly = true;
+		}
+		else if ((arg.compare(0, 10, "--profile=") == 0) && (arg.size() > 10)) {
+			options.profile = arg.substr(10);
+		}
+		else if ((arg.compare(0, 9, "--export=") == 0) && (arg.size() > 9)) {
+			options.exportInterface = arg.substr(9);
+		}
+		else if ((arg.compare(0, 9, "--import=") == 0) && (arg.size() > 9)) {
+			options.imports.push_back(arg.substr(9));
+		}
+		else if ((arg.compare(0, 9, "--syntax=") == 0) && (arg.size() > 9)) {
+			options.syntaxFile = arg.substr(9);
+		}
+		else if ((filename == "") && (arg.compare(0, 2, "--") != 0)) {
+			filename = arg;
+		}
+		else {
+			invalidCommand();
+			return EXIT_FAILURE;
 		}
 	}
-	else {
+	if (filename == "") {
 		invalidCommand();
-		return 0;
+		return EXIT_FAILURE;
+	}
+
+	map<string, long long> profile;
+	if ((options.profile != "") && !readProfile(options.profile, profile)) {
+		std::cout << "ERROR: Could not open profile " << options.profile << endl;
+		return EXIT_FAILURE;
+	}
+
+	// The imported interfaces are mapped once and shared by every program in the file
+	vector<moduleInterface*> interfaces;
+	for (size_t i = 0; i < options.imports.size(); i++) {
+		interfaces.push_back(new moduleInterface(options.imports[i]));
+		if (!interfaces.back()->valid()) {
+			std::cout << "ERROR: Could not read interface " << options.imports[i] << endl;
+			for (size_t j = 0; j < interfaces.size(); j++) delete interfaces[j];
+			return EXIT_FAILURE;
+		}
+	}
+
+	phases.enabled = options.stats || (options.timeReport != "") || options.memoryReport;
+	phases.memory = options.memoryReport;
+
+	// A compilation that was done before with the same source and options just replays its output. One writing an interface or syntax file has to write it, so it is always compiled.
+	compileCache* cache = NULL;
+	string cacheKey;
+	bool cacheable = (options.timeReport == "") && !options.memoryReport && (options.exportInterface == "") && (options.syntaxFile == "");
+	if ((options.cacheDirectory != "") && cacheable && compileCache::key(filename, options, cacheKey)) {
+		cache = new compileCache(options.cacheDirectory, (long long)options.cacheMegabytes * 1024 * 1024);
+		string output;
+		if (cache->lookup(cacheKey, output)) {
+			cout << output;
+			delete cache;
+			return 0;
+		}
 	}
+	recordingBuffer recorder(cout.rdbuf());
+	streambuf* shown = cout.rdbuf();
+	if (cache) cout.rdbuf(&recorder);
 
     // Initializing the scanner
     Scanner* scanner = new Scanner;
@@ -50,18 +180,146 @@ int main(int argc, char* argv[]) {
     scanner->token = curr_token;
 
 	// Initializing symbol table
-	scopeMap* scopes = new scopeMap(debug);
+	scopeMap* scopes = new scopeMap(options.debug);
+	scopes->imports = interfaces;
+
+	// The tokens are read from a syntax file made from the same source instead of scanned. Otherwise a new one is made.
+	syntaxFile* syntax = NULL;
+	syntaxTree* tree = NULL;
+	string sourceHash;
+	uint64_t sourceBytes = 0;
+	if ((options.syntaxFile != "") && syntaxFile::hashSource(filename, sourceHash, sourceBytes)) {
+		syntax = new syntaxFile(options.syntaxFile);
+		if (!syntax->matches(sourceHash) || options.debug) {
+			delete syntax;
+			syntax = NULL;
+			tree = new syntaxTree();
+			scanner->tree = tree;
+		}
+	}
+
+	/* Exit status: EXIT_FAILURE if the source couldn't be read, a program in it had errors, or a file couldn't be
+	 * written. A fatal parse error exits with it from the parser. */
+	int status = EXIT_SUCCESS;
 
     // Initialize scanner, then begin parsing if there are no errors
-    if (scanner->startScanner(filename, debug)) {
+    if (!scanner->startScanner(filename, options.debug)) status = EXIT_FAILURE;
+    else {
+		if (syntax) scanner->startTokens(syntax);
 		do {
 			*curr_token = scanner->getToken();
-			Parser parser(curr_token, scanner, scopes);
+			if (options.scanOnly) continue;
+			irModule module;
+			Parser parser(curr_token, scanner, scopes, options, &module);
+			if (parser.HasErrors()) status = EXIT_FAILURE;
+			if ((options.exportInterface != "") && !parser.HasErrors() && !moduleInterface::write(options.exportInterface, parser.exported)) {
+				std::cout << "ERROR: Could not write interface " << options.exportInterface << endl;
+				status = EXIT_FAILURE;
+			}
+
+			// Optimize the IR built while parsing. It is incomplete if there were any errors.
+			if (!parser.HasErrors() && !options.parseOnly) {
+				// With a cache, only the procedures that changed since they were last compiled are compiled again
+				vector<cachedProcedure> procedures;
+				if (cache) procedures = findProcedures(module, options, profile, *cache);
+				vector<cachedProcedure>* cached = cache ? &procedures : NULL;
+
+				optimizerStats optStats;
+				if (options.optimize) {
+					TIME_PHASE(PHASE_OPTIMIZE);
+					optimizeModule(module, options, profile, optStats, cached);
+				}
+				allocationStats allocStats;
+				vector<frameLayoutStats> frames;
+				{
+					TIME_PHASE(PHASE_CODEGEN);
+					frames = generateModule(module, options, allocStats, cached);
+				}
+				if (cache) storeProcedures(procedures, options, *cache);
+				if (options.emitIR) printModule(cout, module);
+				if (options.stats) {
+					printPhaseCounts(cout);
+					cout << "Optimizer statistics:\n" << endl;
+					cout << "\tDead instructions removed: " << optStats.removedInstructions << endl;
+					cout << "\tUnreachable blocks removed: " << optStats.removedBlocks << endl;
+					cout << "\tConstant branches folded: " << optStats.foldedBranches << endl;
+					cout << "\tBlocks merged: " << optStats.mergedBlocks << endl;
+					cout << "\tRedundant values numbered: " << optStats.numberedValues << endl;
+					cout << "\tLoop invariants hoisted: " << optStats.hoistedInstructions << endl;
+					cout << "\tWhole array stores lowered: " << optStats.loweredArrayStores << endl;
+					cout << "\tVectorized loops: " << optStats.vectorLoops << endl;
+					cout << "\tBounds checks removed: " << optStats.removedChecks << endl;
+					cout << "\tBounds checks hoisted: " << optStats.hoistedChecks << endl;
+					cout << "\tCalls inlined: " << optStats.inlinedCalls << endl;
+					cout << "\tProcedures memoized: " << optStats.memoizedFunctions << endl;
+					cout << "\tTail recursive calls turned into loops: " << optStats.tailRecursiveCalls << endl;
+					cout << "\tTail calls: " << optStats.tailCalls << "\n" << endl;
+				}
+				if (options.regStats) {
+					cout << "Register allocation statistics:\n" << endl;
+					cout << "\tValues allocated: " << allocStats.values << endl;
+					cout << "\tValues in registers: " << allocStats.inRegisters << endl;
+					cout << "\tLoop values in registers: " << allocStats.loopValuesInRegisters << " of " << allocStats.loopValues << endl;
+					cout << "\tValues live across calls in callee saved registers: " << allocStats.callValuesInRegisters << " of " << allocStats.callValues << endl;
+					cout << "\tValues spilled: " << allocStats.spilled << endl;
+					cout << "\tSpill slots: " << allocStats.spillSlots << endl;
+					cout << "\tMost integer registers used: " << allocStats.integerRegisters << " of " << REG_INTEGER_COUNT << endl;
+					cout << "\tMost vector registers used: " << allocStats.floatRegisters << " of " << REG_FLOAT_COUNT << "\n" << endl;
+				}
+				if (options.frameReport) {
+					cout << "Frame sizes (bytes before -> after layout):\n" << endl;
+					int before = 0, after = 0;
+					for (size_t f = 0; f < module.functions.size(); f++) {
+						cout << "\t" << module.functions[f].label << ": " << frames[f].bytesBefore << " -> " << frames[f].bytesAfter;
+						cout << " (" << frames[f].sharedSlots << " shared slots)" << endl;
+						before += frames[f].bytesBefore;
+						after += frames[f].bytesAfter;
+					}
+					cout << "\tTotal: " << before << " -> " << after << "\n" << endl;
+				}
+			}
 			//std::cout << "{" << curr_token->type << ", " << curr_token->ascii << "}" << endl;
 		} while (curr_token->type != T_EOF);
+		if (tree && !tree->write(options.syntaxFile, sourceHash, sourceBytes)) {
+			std::cout << "ERROR: Could not write syntax file " << options.syntaxFile << endl;
+			status = EXIT_FAILURE;
+		}
+		if (options.timeReport != "") printPhaseReport(cout, options.timeReport == "json");
+		if (options.memoryReport) printMemoryReport(cout);
+
+		// Only successful compilations are stored, since a replay exits with EXIT_SUCCESS
+		if (cache) {
+			cout.flush();
+			cout.rdbuf(shown);
+			if (status == EXIT_SUCCESS) cache->store(cacheKey, recorder.output());
+		}
     }
+	cout.rdbuf(shown);
+	delete cache;
     delete scanner;
 	delete scopes;
+	delete tree;
+	delete syntax;
+	for (size_t i = 0; i < interfaces.size(); i++) delete interfaces[i];
+
+    return status;
+}
 
-    return 0;
-}
\ No newline at end of file
+int main(int argc, char* argv[]) {
+	if (argc >= 2) {
+		string arg = string(argv[1]);
+		if (arg == "--lsp") return runLanguageServer();
+		if ((arg.compare(0, 14, "--relex-check=") == 0) && (arg.size() > 14) && isdigit(arg[14]) && (argc == 3)) {
+			return runRelexCheck(argv[2], atoi(arg.c_str() + 14));
+		}
+		if (arg.compare(0, 9, "--server=") == 0) return runServer(arg.substr(9), argc - 2, argv + 2);
+		if (arg.compare(0, 10, "--connect=") == 0) {
+			int status = runClient(arg.substr(10), argc - 2, argv + 2);
+			if (status >= 0) return status;
+			// No server is listening, so compile here with the rest of the arguments
+			argv[1] = argv[0];
+			return compilerMain(argc - 1, argv + 1);
+		}
+	}
+	return compilerMain(argc, argv);
+}
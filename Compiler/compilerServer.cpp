@@ -0,0 +1,281 @@
+#include "compilerServer.h"
+#include "scanner.h"
+#include "parser.h"
+#include "compileCache.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#endif
+
+using namespace std;
+
+#define SERVER_PROTOCOL "EECE5183 1"
+
+#ifdef _WIN32
+
+int runServer(string socketPath, int argc, char* argv[]) {
+	cout << "ERROR: --server needs Unix domain sockets, which this build of the compiler doesn't support." << endl;
+	return 1;
+}
+
+int runClient(string socketPath, int argc, char* argv[]) {
+	return -1;
+}
+
+#else
+
+// Socket the server is listening on, removed when it is stopped
+static char listening[sizeof(((sockaddr_un*)0)->sun_path)];
+
+static void stopServer(int) {
+	unlink(listening);
+	_exit(0);
+}
+
+// Write all of the bytes, returning false if the other end has gone away
+static bool writeAll(int fd, const char* data, size_t length) {
+	while (length > 0) {
+		ssize_t written = write(fd, data, length);
+		if ((written < 0) && (errno == EINTR)) continue;
+		if (written <= 0) return false;
+		data += written;
+		length -= written;
+	}
+	return true;
+}
+
+// Read until the other end is closed
+static string readAll(int fd) {
+	string result;
+	char buffer[SERVER_CHUNK_BYTES];
+	while (true) {
+		ssize_t count = read(fd, buffer, sizeof(buffer));
+		if ((count < 0) && (errno == EINTR)) continue;
+		if (count <= 0) break;
+		result.append(buffer, count);
+	}
+	return result;
+}
+
+// Answer a request that can't be compiled with an error message and exit status 1, as a failed compile would
+static void refuseRequest(int connection, string message) {
+	string text = "ERROR: " + message + "\n";
+	string reply = "O " + to_string((long long)text.size()) + "\n" + text + "X 1\n";
+	writeAll(connection, reply.c_str(), reply.size());
+}
+
+// Fill in the address of the socket, returning false if the path is too long for one
+static bool socketAddress(string socketPath, sockaddr_un& address) {
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.empty() || (socketPath.size() >= sizeof(address.sun_path))) return false;
+	strcpy(address.sun_path, socketPath.c_str());
+	return true;
+}
+
+/* Compile one request, in a process of its own. The compilation runs in a child forked from this one, with its
+ * stdout and stderr going to a pipe that is copied to the client, so a crash still gets an exit status back. */
+static void serveConnection(int connection, vector<string>& defaults) {
+	signal(SIGCHLD, SIG_DFL);
+	signal(SIGPIPE, SIG_IGN);
+	istringstream request(readAll(connection));
+	string header, directory, line;
+	int count = -1;
+	getline(request, header);
+	getline(request, directory);
+	request >> count;
+	getline(request, line);
+
+	vector<string> args(1, "compiler");
+	args.insert(args.end(), defaults.begin(), defaults.end());
+	for (int i = 0; (i < count) && getline(request, line); i++) args.push_back(line);
+	if ((header != SERVER_PROTOCOL) || (count < 0) || ((int)args.size() != (int)defaults.size() + count + 1)) {
+		refuseRequest(connection, "The compile server didn't understand the request.");
+		return;
+	}
+
+	int output[2];
+	if (pipe(output) != 0) {
+		refuseRequest(connection, string("The compile server can't create a pipe: ") + strerror(errno));
+		return;
+	}
+	pid_t child = fork();
+	if (child < 0) {
+		refuseRequest(connection, string("The compile server can't start a compilation: ") + strerror(errno));
+		close(output[0]);
+		close(output[1]);
+		return;
+	}
+	if (child == 0) {
+		close(connection);
+		close(output[0]);
+		dup2(output[1], STDOUT_FILENO);
+		dup2(output[1], STDERR_FILENO);
+		close(output[1]);
+		if (chdir(directory.c_str()) != 0) {
+			cout << "ERROR: The compile server can't use the directory " << directory << endl;
+			exit(1);
+		}
+		vector<char*> argv;
+		for (size_t i = 0; i < args.size(); i++) argv.push_back(&args[i][0]);
+		argv.push_back(NULL);
+		exit(compilerMain((int)args.size(), &argv[0]));
+	}
+	close(output[1]);
+
+	char buffer[SERVER_CHUNK_BYTES];
+	while (true) {
+		ssize_t bytes = read(output[0], buffer, sizeof(buffer));
+		if ((bytes < 0) && (errno == EINTR)) continue;
+		if (bytes <= 0) break;
+		string frame = "O " + to_string((long long)bytes) + "\n";
+		if (!writeAll(connection, frame.c_str(), frame.size()) || !writeAll(connection, buffer, bytes)) {
+			// The client has gone away, so nobody wants the rest
+			kill(child, SIGKILL);
+			break;
+		}
+	}
+	close(output[0]);
+
+	int status = 0;
+	while ((waitpid(child, &status, 0) < 0) && (errno == EINTR));
+	int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+	string reply = "X " + to_string((long long)code) + "\n";
+	writeAll(connection, reply.c_str(), reply.size());
+}
+
+int runServer(string socketPath, int argc, char* argv[]) {
+	sockaddr_un address;
+	if (!socketAddress(socketPath, address)) {
+		cout << "ERROR: The socket path " << socketPath << " is empty or too long." << endl;
+		return 1;
+	}
+
+	// Paths given to the server are made absolute, since each request is compiled in the client's directory
+	vector<string> defaults;
+	char here[4096];
+	string cwd = (getcwd(here, sizeof(here)) != NULL) ? string(here) : string(".");
+	for (int i = 0; i < argc; i++) {
+		string arg = string(argv[i]);
+		size_t equals = arg.find('=');
+		bool path = (arg.compare(0, 8, "--cache=") == 0) || (arg.compare(0, 10, "--profile=") == 0);
+		path = path || (arg.compare(0, 9, "--import=") == 0) || (arg.compare(0, 9, "--export=") == 0) || (arg.compare(0, 9, "--syntax=") == 0);
+		if (path && (equals + 1 < arg.size()) && (arg[equals + 1] != '/')) arg = arg.substr(0, equals + 1) + cwd + "/" + arg.substr(equals + 1);
+		defaults.push_back(arg);
+	}
+
+	// Build the tables every compilation uses, so each request's process starts with them
+	Scanner::keywords();
+	Parser::RunTimeDeclarations();
+	compileCache::buildId();
+
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0) {
+		cout << "ERROR: Could not create a socket: " << strerror(errno) << endl;
+		return 1;
+	}
+	unlink(address.sun_path);
+	if ((bind(server, (sockaddr*)&address, sizeof(address)) != 0) || (listen(server, SERVER_BACKLOG) != 0)) {
+		cout << "ERROR: Could not listen on " << socketPath << ": " << strerror(errno) << endl;
+		close(server);
+		return 1;
+	}
+	strcpy(listening, address.sun_path);
+	signal(SIGINT, stopServer);
+	signal(SIGTERM, stopServer);
+	signal(SIGCHLD, SIG_IGN); // Finished request processes are reaped by the system
+	cout << "Compile server listening on " << socketPath << endl;
+
+	while (true) {
+		int connection = accept(server, NULL, NULL);
+		if (connection < 0) {
+			if (errno == EINTR) continue;
+			cout << "ERROR: Could not accept a connection: " << strerror(errno) << endl;
+			continue;
+		}
+		cout.flush();
+		pid_t session = fork();
+		if (session == 0) {
+			close(server);
+			signal(SIGINT, SIG_DFL);
+			signal(SIGTERM, SIG_DFL);
+			serveConnection(connection, defaults);
+			close(connection);
+			_exit(0);
+		}
+		if (session < 0) cout << "ERROR: Could not start a process for a request: " << strerror(errno) << endl;
+		close(connection);
+	}
+	return 0;
+}
+
+int runClient(string socketPath, int argc, char* argv[]) {
+	sockaddr_un address;
+	if (!socketAddress(socketPath, address)) return -1;
+	int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connection < 0) return -1;
+	if (connect(connection, (sockaddr*)&address, sizeof(address)) != 0) {
+		close(connection);
+		return -1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	char here[4096];
+	string request = string(SERVER_PROTOCOL) + "\n" + ((getcwd(here, sizeof(here)) != NULL) ? string(here) : string(".")) + "\n";
+	request += to_string((long long)argc) + "\n";
+	for (int i = 0; i < argc; i++) {
+		string arg = string(argv[i]);
+		if (arg.find('\n') != string::npos) {
+			cout << "ERROR: Arguments sent to the compile server can't contain a line break." << endl;
+			close(connection);
+			return 1;
+		}
+		request += arg + "\n";
+	}
+	if (!writeAll(connection, request.c_str(), request.size())) {
+		close(connection);
+		return -1;
+	}
+	shutdown(connection, SHUT_WR);
+
+	// Copy the output frames to stdout as they arrive, until the exit status
+	string pending;
+	char buffer[SERVER_CHUNK_BYTES];
+	while (true) {
+		size_t newline = pending.find('\n');
+		if (newline != string::npos) {
+			char kind = pending[0];
+			long long value = atoll(pending.c_str() + 2);
+			if (kind == 'X') {
+				close(connection);
+				return (int)value;
+			}
+			if ((kind == 'O') && (pending.size() >= newline + 1 + (size_t)value)) {
+				cout.write(pending.data() + newline + 1, value);
+				cout.flush();
+				pending.erase(0, newline + 1 + value);
+				continue;
+			}
+			if (kind != 'O') break;
+		}
+		ssize_t count = read(connection, buffer, sizeof(buffer));
+		if ((count < 0) && (errno == EINTR)) continue;
+		if (count <= 0) break;
+		pending.append(buffer, count);
+	}
+	close(connection);
+	cout << "ERROR: Lost the connection to the compile server." << endl;
+	return 1;
+}
+
+#endif
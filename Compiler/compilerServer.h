@@ -0,0 +1,31 @@
+#ifndef COMPILERSERVER_H
+#define COMPILERSERVER_H
+
+#include <string>
+
+using namespace std;
+
+// Connections waiting to be accepted before the server turns new ones away
+#define SERVER_BACKLOG 64
+
+// Size of the pieces a compilation's output is sent back to the client in
+#define SERVER_CHUNK_BYTES 4096
+
+/*
+ * Compile server, which keeps the compiler resident so a build compiling many programs doesn't pay for starting it
+ * and building its tables each time. runServer listens on a Unix domain socket, and builds the keyword table
+ * (Scanner::keywords) and the runtime procedure declarations (Parser::RunTimeDeclarations) once before accepting
+ * anything. Each connection is handled by a process forked from the server, so requests are compiled at the same
+ * time, start with those tables already built, and can't leave anything behind in the server. A compile cache given
+ * to the server (--cache=DIR) is shared by all of them.
+ *
+ * The request is text: a "EECE5183 1" line, the client's working directory, the number of arguments and one
+ * argument per line. The reply is the output of the compilation in "O <bytes>" frames as it is written, then an
+ * "X <status>" line with its exit status. runClient sends a request with its own arguments and copies the output
+ * to stdout. It returns -1 if no server is listening on the socket, so the caller can compile the program itself.
+ */
+int compilerMain(int argc, char* argv[]);
+int runServer(string socketPath, int argc, char* argv[]);
+int runClient(string socketPath, int argc, char* argv[]);
+
+#endif
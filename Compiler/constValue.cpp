@@ -0,0 +1,197 @@
+#include "constValue.h"
+#include "tokentypes.h"
+#include <string>
+
+using namespace std;
+
+// Constructor - values start out unknown
+constValue::constValue() {
+	known = false;
+	type = T_UNKNOWN;
+	intValue = 0;
+	floatValue = 0.0;
+	boolValue = false;
+	stringValue = "";
+}
+
+// Two values are equal only if both are known and hold the same typed value
+bool constValue::operator==(const constValue& other) const {
+	if (!known || !other.known || (type != other.type)) return false;
+	switch (type) {
+	case TYPE_INTEGER: return intValue == other.intValue;
+	case TYPE_FLOAT: return floatValue == other.floatValue;
+	case TYPE_BOOL: return boolValue == other.boolValue;
+	case TYPE_STRING: return stringValue == other.stringValue;
+	default: return false;
+	}
+}
+
+bool constValue::operator!=(const constValue& other) const {
+	return !(*this == other);
+}
+
+constValue constInteger(int value) {
+	constValue c;
+	c.known = true;
+	c.type = TYPE_INTEGER;
+	c.intValue = value;
+	return c;
+}
+
+constValue constFloat(double value) {
+	constValue c;
+	c.known = true;
+	c.type = TYPE_FLOAT;
+	c.floatValue = value;
+	return c;
+}
+
+constValue constBool(bool value) {
+	constValue c;
+	c.known = true;
+	c.type = TYPE_BOOL;
+	c.boolValue = value;
+	return c;
+}
+
+constValue constString(string value) {
+	constValue c;
+	c.known = true;
+	c.type = TYPE_STRING;
+	c.stringValue = value;
+	return c;
+}
+
+// Numeric value of an integer, float, or bool (bools compare as integers '0' and '1')
+static double asDouble(const constValue& value) {
+	if (value.type == TYPE_FLOAT) return value.floatValue;
+	else if (value.type == TYPE_BOOL) return value.boolValue ? 1.0 : 0.0;
+	else return (double)value.intValue;
+}
+
+static int asInteger(const constValue& value) {
+	if (value.type == TYPE_BOOL) return value.boolValue ? 1 : 0;
+	else return value.intValue;
+}
+
+static bool isNumeric(const constValue& value) {
+	return (value.type == TYPE_INTEGER) || (value.type == TYPE_FLOAT);
+}
+
+bool foldBinary(string op, const constValue& left, const constValue& right, constValue& result, bool& divideByZero) {
+	divideByZero = false;
+	if (!left.known || !right.known) return false;
+
+	// Arithmetic operators. Integer results wrap around the same as they will at runtime.
+	if ((op == "+") || (op == "-") || (op == "*") || (op == "/")) {
+		if (!isNumeric(left) || !isNumeric(right)) return false;
+		if ((left.type == TYPE_INTEGER) && (right.type == TYPE_INTEGER)) {
+			unsigned int l = (unsigned int)left.intValue;
+			unsigned int r = (unsigned int)right.intValue;
+			if (op == "+") result = constInteger((int)(l + r));
+			else if (op == "-") result = constInteger((int)(l - r));
+			else if (op == "*") result = constInteger((int)(l * r));
+			else {
+				if (right.intValue == 0) {
+					divideByZero = true;
+					return false;
+				}
+				// INT_MIN / -1 overflows, leave it for the runtime to handle
+				if ((right.intValue == -1) && (left.intValue == (int)0x80000000)) return false;
+				result = constInteger(left.intValue / right.intValue);
+			}
+		}
+		else {
+			double l = asDouble(left);
+			double r = asDouble(right);
+			if (op == "+") result = constFloat(l + r);
+			else if (op == "-") result = constFloat(l - r);
+			else if (op == "*") result = constFloat(l * r);
+			else {
+				if (r == 0.0) {
+					divideByZero = true;
+					return false;
+				}
+				result = constFloat(l / r);
+			}
+		}
+		return true;
+	}
+
+	// Bitwise operators for integers, boolean operators for bools
+	if ((op == "&") || (op == "|")) {
+		if ((left.type == TYPE_INTEGER) && (right.type == TYPE_INTEGER)) {
+			if (op == "&") result = constInteger(left.intValue & right.intValue);
+			else result = constInteger(left.intValue | right.intValue);
+			return true;
+		}
+		else if ((left.type == TYPE_BOOL) && (right.type == TYPE_BOOL)) {
+			if (op == "&") result = constBool(left.boolValue && right.boolValue);
+			else result = constBool(left.boolValue || right.boolValue);
+			return true;
+		}
+		else return false;
+	}
+
+	// Relational operators. Strings may only be tested for equality.
+	if ((left.type == TYPE_STRING) || (right.type == TYPE_STRING)) {
+		if ((left.type != TYPE_STRING) || (right.type != TYPE_STRING)) return false;
+		if (op == "==") result = constBool(left.stringValue == right.stringValue);
+		else if (op == "!=") result = constBool(left.stringValue != right.stringValue);
+		else return false;
+		return true;
+	}
+	if ((left.type == TYPE_FLOAT) || (right.type == TYPE_FLOAT)) {
+		double l = asDouble(left);
+		double r = asDouble(right);
+		if (op == "<") result = constBool(l < r);
+		else if (op == "<=") result = constBool(l <= r);
+		else if (op == ">") result = constBool(l > r);
+		else if (op == ">=") result = constBool(l >= r);
+		else if (op == "==") result = constBool(l == r);
+		else if (op == "!=") result = constBool(l != r);
+		else return false;
+		return true;
+	}
+	int l = asInteger(left);
+	int r = asInteger(right);
+	if (op == "<") result = constBool(l < r);
+	else if (op == "<=") result = constBool(l <= r);
+	else if (op == ">") result = constBool(l > r);
+	else if (op == ">=") result = constBool(l >= r);
+	else if (op == "==") result = constBool(l == r);
+	else if (op == "!=") result = constBool(l != r);
+	else return false;
+	return true;
+}
+
+bool foldNegate(const constValue& operand, constValue& result) {
+	if (!operand.known) return false;
+	if (operand.type == TYPE_INTEGER) result = constInteger((int)(0u - (unsigned int)operand.intValue));
+	else if (operand.type == TYPE_FLOAT) result = constFloat(-operand.floatValue);
+	else return false;
+	return true;
+}
+
+bool foldNot(const constValue& operand, constValue& result) {
+	if (!operand.known) return false;
+	if (operand.type == TYPE_INTEGER) result = constInteger(~operand.intValue);
+	else if (operand.type == TYPE_BOOL) result = constBool(!operand.boolValue);
+	else return false;
+	return true;
+}
+
+/* Integers and floats can be assigned to each other, but only integer to float is converted here.
+ * Float to integer conversion is left to the runtime so the compiler never guesses at its rounding. */
+bool convertConst(const constValue& value, int type, constValue& result) {
+	if (!value.known) return false;
+	if (value.type == type) {
+		result = value;
+		return true;
+	}
+	if ((type == TYPE_FLOAT) && (value.type == TYPE_INTEGER)) {
+		result = constFloat((double)value.intValue);
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,44 @@
+#ifndef CONSTVALUE_H
+#define CONSTVALUE_H
+
+#include <string>
+#include "tokentypes.h"
+
+using namespace std;
+
+/* Struct to hold the compile time value of an expression, if it has one.
+ *    known - true if the expression's value is known at compile time
+ *    type - TYPE_INTEGER | TYPE_FLOAT | TYPE_BOOL | TYPE_STRING
+ *    intValue / floatValue / boolValue / stringValue - the value for the matching type
+ */
+struct constValue {
+	bool known;
+	int type;
+	int intValue;
+	double floatValue;
+	bool boolValue;
+	string stringValue;
+
+	constValue();
+	bool operator==(const constValue& other) const;
+	bool operator!=(const constValue& other) const;
+};
+
+// Constructors for known values of each type
+constValue constInteger(int value);
+constValue constFloat(double value);
+constValue constBool(bool value);
+constValue constString(string value);
+
+/* Folding functions. Each returns true and sets result if the operation could be evaluated at compile time.
+ * Operand types follow the parser's type checking rules, integers and floats may be mixed in arithmetic.
+ * divideByZero is set when a constant division by zero is found, which is never folded.
+ */
+bool foldBinary(string op, const constValue& left, const constValue& right, constValue& result, bool& divideByZero);
+bool foldNegate(const constValue& operand, constValue& result);
+bool foldNot(const constValue& operand, constValue& result);
+
+// Convert a known value to the type of the destination it is assigned to. Returns false if this can't be done at compile time.
+bool convertConst(const constValue& value, int type, constValue& result);
+
+#endif
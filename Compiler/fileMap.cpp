@@ -0,0 +1,100 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "fileMap.h"
+#include <cstddef>
+
+using namespace std;
+
+fileMap::fileMap(const char* filename) noexcept {
+	first = nullptr;
+	last = nullptr;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return;
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(file, &size) || (size.QuadPart == 0)) {
+		CloseHandle(file);
+		return;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping) return;
+
+	// The view keeps the mapping open after its handle is closed
+	first = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	CloseHandle(mapping);
+	if (first) last = first + size.QuadPart;
+#else
+	int file = open(filename, O_RDONLY);
+	if (file < 0) return;
+	struct stat status;
+	if ((fstat(file, &status) != 0) || (status.st_size == 0)) {
+		close(file);
+		return;
+	}
+	void* view = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+
+	// The mapping stays valid after the file is closed
+	close(file);
+	if (view == MAP_FAILED) return;
+	first = static_cast<const char*>(view);
+	last = first + status.st_size;
+#endif
+}
+
+// Take over the mapping of &other, which is left mapping nothing
+fileMap::fileMap(fileMap&& other) noexcept {
+	first = other.first;
+	last = other.last;
+	other.first = nullptr;
+	other.last = nullptr;
+}
+
+fileMap& fileMap::operator=(fileMap&& other) noexcept {
+	if (this == &other) return *this;
+	unmap();
+	first = other.first;
+	last = other.last;
+	other.first = nullptr;
+	other.last = nullptr;
+	return *this;
+}
+
+fileMap::~fileMap() noexcept {
+	unmap();
+}
+
+void fileMap::unmap() noexcept {
+	if (!first) return;
+#ifdef _WIN32
+	UnmapViewOfFile(first);
+#else
+	munmap(const_cast<char*>(first), last - first);
+#endif
+	first = nullptr;
+	last = nullptr;
+}
+
+// Whether the file was mapped
+fileMap::operator bool() const noexcept {
+	return first != nullptr;
+}
+
+const char* fileMap::begin() const noexcept {
+	return first;
+}
+
+const char* fileMap::end() const noexcept {
+	return last;
+}
+
+size_t fileMap::size() const noexcept {
+	return last - first;
+}
@@ -0,0 +1,32 @@
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <cstddef>
+
+using namespace std;
+
+/*
+ * A file mapped read only into memory. The OS reads the contents in as they are touched, and shares the pages with
+ * every other process mapping the same file. An empty file, or one that can't be opened, maps to nothing. A map can
+ * be moved but not copied, so the file is unmapped exactly once.
+ */
+class fileMap
+{
+private:
+	const char* first;
+	const char* last;
+	void unmap() noexcept;
+public:
+	explicit fileMap(const char* filename) noexcept;
+	fileMap(const fileMap&) = delete;
+	fileMap& operator=(const fileMap&) = delete;
+	fileMap(fileMap&& other) noexcept;
+	fileMap& operator=(fileMap&& other) noexcept;
+	~fileMap() noexcept;
+	explicit operator bool() const noexcept;
+	const char* begin() const noexcept;
+	const char* end() const noexcept;
+	size_t size() const noexcept;
+};
+
+#endif
@@ -0,0 +1,337 @@
+#include "ir.h"
+#include "tokentypes.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <ostream>
+
+using namespace std;
+
+// Branches and returns end a basic block
+bool isTerminator(int op) {
+	return (op == IR_BR) || (op == IR_CONDBR) || (op == IR_RET);
+}
+
+// Instructions that must be kept even if their value is never used
+bool hasSideEffects(int op) {
+	switch (op) {
+	case IR_STORE: case IR_STORE_ELEM: case IR_CALL: case IR_BR: case IR_CONDBR: case IR_RET: case IR_CHECK:
+	case IR_MEMO_FIND: case IR_MEMO_PUT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Floats, strings (16 bytes, see runtime.h rtString) and vectors are kept in the vector registers
+bool inVectorRegister(irInstruction& inst) {
+	return (inst.type == TYPE_FLOAT) || (inst.type == TYPE_STRING) || (inst.lanes > 1);
+}
+
+bool isBinaryOp(int op) {
+	return ((op >= IR_ADD) && (op <= IR_OR)) || ((op >= IR_LT) && (op <= IR_NE));
+}
+
+string opName(int op) {
+	switch (op) {
+	case IR_NOP: return "nop";
+	case IR_CONST: return "const";
+	case IR_UNDEF: return "undef";
+	case IR_PARAM: return "param";
+	case IR_PHI: return "phi";
+	case IR_CONVERT: return "convert";
+	case IR_SPLAT: return "splat";
+	case IR_ADD: return "add";
+	case IR_SUB: return "sub";
+	case IR_MUL: return "mul";
+	case IR_DIV: return "div";
+	case IR_AND: return "and";
+	case IR_OR: return "or";
+	case IR_NOT: return "not";
+	case IR_NEG: return "neg";
+	case IR_LT: return "lt";
+	case IR_LE: return "le";
+	case IR_GT: return "gt";
+	case IR_GE: return "ge";
+	case IR_EQ: return "eq";
+	case IR_NE: return "ne";
+	case IR_LOAD: return "load";
+	case IR_STORE: return "store";
+	case IR_LOAD_ELEM: return "loadelem";
+	case IR_STORE_ELEM: return "storeelem";
+	case IR_ADDR: return "addr";
+	case IR_CALL: return "call";
+	case IR_BR: return "br";
+	case IR_CONDBR: return "condbr";
+	case IR_RET: return "ret";
+	case IR_CHECK: return "check";
+	case IR_MEMO_FIND: return "memofind";
+	case IR_MEMO_GET: return "memoget";
+	case IR_MEMO_PUT: return "memoput";
+	default: return "unknown";
+	}
+}
+
+// Rebuild every block's predecessor and successor lists from the block terminators
+void computeCFG(irFunction& function) {
+	size_t b;
+	for (b = 0; b < function.blocks.size(); b++) {
+		function.blocks[b].preds.clear();
+		function.blocks[b].succs.clear();
+	}
+	for (b = 0; b < function.blocks.size(); b++) {
+		irBlock& block = function.blocks[b];
+		if (block.removed || block.instructions.empty()) continue;
+		irInstruction& last = function.instructions[block.instructions.back()];
+		if (last.op == IR_BR) {
+			block.succs.push_back(last.target);
+		}
+		else if (last.op == IR_CONDBR) {
+			block.succs.push_back(last.target);
+			if (last.falseTarget != last.target) block.succs.push_back(last.falseTarget);
+		}
+		for (size_t s = 0; s < block.succs.size(); s++) {
+			function.blocks[block.succs[s]].preds.push_back((int)b);
+		}
+	}
+}
+
+/* Blocks reachable from the entry block in reverse postorder. With loopBodiesFirst the successors of each block are
+ * visited last to first, so a loop's body comes right after its header (a branch's target) and before the code
+ * after the loop. That order is used as the linear layout for live ranges. */
+vector<int> reversePostOrder(irFunction& function, bool loopBodiesFirst) {
+	vector<int> order;
+	if (function.blocks.empty()) return order;
+	vector<bool> visited(function.blocks.size(), false);
+	vector< pair<int, size_t> > stack;
+	stack.push_back(make_pair(0, (size_t)0));
+	visited[0] = true;
+	while (!stack.empty()) {
+		int b = stack.back().first;
+		size_t next = stack.back().second;
+		if (next < function.blocks[b].succs.size()) {
+			stack.back().second++;
+			int s = function.blocks[b].succs[loopBodiesFirst ? function.blocks[b].succs.size() - 1 - next : next];
+			if (!visited[s]) {
+				visited[s] = true;
+				stack.push_back(make_pair(s, (size_t)0));
+			}
+		}
+		else {
+			order.push_back(b);
+			stack.pop_back();
+		}
+	}
+	reverse(order.begin(), order.end());
+	return order;
+}
+
+/* Compute immediate dominators with the iterative algorithm from Cooper, Harvey and Kennedy.
+ * computeCFG() must be called first. */
+void computeDominators(irFunction& function) {
+	vector<int> order = reversePostOrder(function);
+	vector<int> position(function.blocks.size(), -1);
+	size_t i;
+	for (i = 0; i < order.size(); i++) position[order[i]] = (int)i;
+
+	vector<int> idom(function.blocks.size(), -1);
+	if (order.empty()) return;
+	idom[0] = 0;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (i = 1; i < order.size(); i++) {
+			int b = order[i];
+			int newIdom = -1;
+			vector<int>& preds = function.blocks[b].preds;
+			for (size_t p = 0; p < preds.size(); p++) {
+				int pred = preds[p];
+				if (idom[pred] == -1) continue;
+				if (newIdom == -1) {
+					newIdom = pred;
+					continue;
+				}
+				// Walk both blocks up the dominator tree until they meet
+				int a = pred;
+				int c = newIdom;
+				while (a != c) {
+					while (position[a] > position[c]) a = idom[a];
+					while (position[c] > position[a]) c = idom[c];
+				}
+				newIdom = a;
+			}
+			if (idom[b] != newIdom) {
+				idom[b] = newIdom;
+				changed = true;
+			}
+		}
+	}
+	for (i = 0; i < function.blocks.size(); i++) {
+		function.blocks[i].idom = (i == 0) ? -1 : idom[i];
+	}
+}
+
+// True if block a dominates block b. computeDominators() must be called first.
+bool dominates(irFunction& function, int a, int b) {
+	while (b != -1) {
+		if (a == b) return true;
+		b = function.blocks[b].idom;
+	}
+	return false;
+}
+
+/* Find the natural loops of a function, innermost (smallest) first. Back edges to the same header share one loop.
+ * computeCFG() and computeDominators() must be called first. */
+vector<irLoop> findLoops(irFunction& function) {
+	vector<irLoop> loops;
+	vector<int> order = reversePostOrder(function);
+	for (size_t h = 0; h < order.size(); h++) {
+		int header = order[h];
+		irLoop loop;
+		loop.header = header;
+		loop.inLoop.assign(function.blocks.size(), false);
+		loop.inLoop[header] = true;
+		loop.blocks.push_back(header);
+
+		// Walk backwards from each back edge's source until the header is reached
+		vector<int> work;
+		vector<int>& preds = function.blocks[header].preds;
+		for (size_t p = 0; p < preds.size(); p++) {
+			if (dominates(function, header, preds[p])) work.push_back(preds[p]);
+		}
+		if (work.empty()) continue;
+		while (!work.empty()) {
+			int b = work.back();
+			work.pop_back();
+			if (loop.inLoop[b] || ((b != 0) && (function.blocks[b].idom == -1))) continue;
+			loop.inLoop[b] = true;
+			loop.blocks.push_back(b);
+			for (size_t p = 0; p < function.blocks[b].preds.size(); p++) work.push_back(function.blocks[b].preds[p]);
+		}
+
+		// The preheader must be the only way into the loop and lead only to the header
+		int outside = -1;
+		int outsideCount = 0;
+		for (size_t p = 0; p < preds.size(); p++) {
+			if (!loop.inLoop[preds[p]]) {
+				outside = preds[p];
+				outsideCount++;
+			}
+		}
+		if ((outsideCount == 1) && (function.blocks[outside].succs.size() == 1)) loop.preheader = outside;
+		loops.push_back(loop);
+	}
+
+	// Insertion sort by size keeps loops with the same size in program order
+	for (size_t i = 1; i < loops.size(); i++) {
+		for (size_t j = i; (j > 0) && (loops[j].blocks.size() < loops[j - 1].blocks.size()); j--) {
+			swap(loops[j], loops[j - 1]);
+		}
+	}
+	return loops;
+}
+
+// Make every instruction that used value 'from' use value 'to' instead
+void replaceAllUses(irFunction& function, int from, int to) {
+	for (size_t i = 0; i < function.instructions.size(); i++) {
+		irInstruction& inst = function.instructions[i];
+		if (inst.op == IR_NOP) continue;
+		for (size_t o = 0; o < inst.operands.size(); o++) {
+			if (inst.operands[o] == from) inst.operands[o] = to;
+		}
+	}
+}
+
+// Take an instruction out of its block. Its index is never reused.
+void removeInstruction(irFunction& function, int id) {
+	irInstruction& inst = function.instructions[id];
+	if (inst.block >= 0) {
+		vector<int>& list = function.blocks[inst.block].instructions;
+		list.erase(remove(list.begin(), list.end(), id), list.end());
+	}
+	inst.op = IR_NOP;
+	inst.block = -1;
+	inst.operands.clear();
+	inst.phiBlocks.clear();
+}
+
+static string typeName(int type) {
+	switch (type) {
+	case TYPE_INTEGER: return "integer";
+	case TYPE_FLOAT: return "float";
+	case TYPE_BOOL: return "bool";
+	case TYPE_STRING: return "string";
+	default: return "unknown";
+	}
+}
+
+static string constText(constValue& value) {
+	switch (value.type) {
+	case TYPE_INTEGER: return to_string(value.intValue);
+	case TYPE_FLOAT: return to_string(value.floatValue);
+	case TYPE_BOOL: return value.boolValue ? "true" : "false";
+	case TYPE_STRING: return "\"" + value.stringValue + "\"";
+	default: return "?";
+	}
+}
+
+void printFunction(ostream& out, irFunction& function) {
+	out << "function " << function.label << " : " << (function.returnType ? typeName(function.returnType) : "void");
+	out << " (frame " << function.frameSize;
+	if (function.frameBytes > 0) out << ", " << function.frameBytes << " bytes";
+	out << ")" << endl;
+	for (size_t b = 0; b < function.blocks.size(); b++) {
+		irBlock& block = function.blocks[b];
+		if (block.removed) continue;
+		out << "  b" << b << ":";
+		if (!block.preds.empty()) {
+			out << "\t\t; preds";
+			for (size_t p = 0; p < block.preds.size(); p++) out << " b" << block.preds[p];
+		}
+		out << endl;
+		for (size_t i = 0; i < block.instructions.size(); i++) {
+			int id = block.instructions[i];
+			irInstruction& inst = function.instructions[id];
+			out << "    ";
+			if (inst.type != 0) out << "%" << id << " = ";
+			if (inst.tail) out << "tail ";
+			out << opName(inst.op);
+			if (inst.type != 0) {
+				if (inst.lanes > 1) out << " <" << inst.lanes << " x " << typeName(inst.type) << ">";
+				else out << " " << typeName(inst.type);
+				if (inst.size > 0) out << "[" << inst.size << "]";
+			}
+			else if (inst.lanes > 1) out << " <" << inst.lanes << ">";
+			if (inst.op == IR_CONST) out << " " << constText(inst.constant);
+			if ((inst.op == IR_CONST) && (inst.type == TYPE_STRING) && (inst.constant.intValue >= 0)) out << " $" << inst.constant.intValue;
+			if (inst.op == IR_CALL) out << " " << inst.callee;
+			bool memo = (inst.op >= IR_MEMO_FIND) && (inst.op <= IR_MEMO_PUT);
+			if (memo) out << " " << inst.callee << "{" << inst.constant.intValue << "}";
+			if (inst.variable >= 0) out << " " << function.variables[inst.variable].name;
+			for (size_t o = 0; o < inst.operands.size(); o++) {
+				out << ((o == 0) && (inst.variable < 0) && (inst.op != IR_CALL) && !memo ? " " : ", ");
+				out << "%" << inst.operands[o];
+				if (inst.op == IR_PHI) out << " [b" << inst.phiBlocks[o] << "]";
+			}
+			if (inst.op == IR_BR) out << " b" << inst.target;
+			if (inst.op == IR_CONDBR) out << ", b" << inst.target << ", b" << inst.falseTarget;
+			if (inst.op == IR_CHECK) out << " < " << inst.size;
+			if ((id < (int)function.registers.size()) && (function.registers[id] >= 0)) {
+				out << "\t\t; " << (inVectorRegister(inst) ? "f" : "r") << function.registers[id];
+			}
+			else if ((id < (int)function.spillSlot.size()) && (function.spillSlot[id] >= 0)) {
+				out << "\t\t; spill " << function.spillSlot[id];
+			}
+			out << endl;
+		}
+	}
+	out << endl;
+}
+
+void printModule(ostream& out, irModule& module) {
+	for (size_t s = 0; s < module.strings.size(); s++) out << "$" << s << " = \"" << module.strings[s] << "\"" << endl;
+	if (!module.strings.empty()) out << endl;
+	for (size_t f = 0; f < module.functions.size(); f++) {
+		printFunction(out, module.functions[f]);
+	}
+}
@@ -0,0 +1,197 @@
+#ifndef IR_H
+#define IR_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include "tokentypes.h"
+#include "constValue.h"
+
+using namespace std;
+
+// Instructions that produce values
+#define IR_NOP 0
+#define IR_CONST 1
+#define IR_UNDEF 2
+#define IR_PARAM 3
+#define IR_PHI 4
+#define IR_CONVERT 5
+#define IR_SPLAT 6
+
+/* Arithmetic, bitwise / boolean, and relational operators. Operands are converted to a common type first.
+ * Strings are equal when their runtime.h rtString values are, which is a 16 byte compare. */
+#define IR_ADD 10
+#define IR_SUB 11
+#define IR_MUL 12
+#define IR_DIV 13
+#define IR_AND 14
+#define IR_OR 15
+#define IR_NOT 16
+#define IR_NEG 17
+#define IR_LT 18
+#define IR_LE 19
+#define IR_GT 20
+#define IR_GE 21
+#define IR_EQ 22
+#define IR_NE 23
+
+// Memory access for variables that are not in SSA form (globals and arrays)
+#define IR_LOAD 30
+#define IR_STORE 31
+#define IR_LOAD_ELEM 32
+#define IR_STORE_ELEM 33
+
+/* Address of an array variable, passed as the argument of a by-reference parameter. The callee reads (and for out /
+ * inout parameters writes) the variable through it, so a call using one may change the variable. */
+#define IR_ADDR 34
+
+// Width of the vector registers whole array operations are lowered to. 256 targets AVX2, 128 targets SSE.
+#define IR_VECTOR_BITS 256
+
+// Calls and control flow
+#define IR_CALL 40
+#define IR_BR 41
+#define IR_CONDBR 42
+#define IR_RET 43
+
+// Trap (runtime.h boundsError) unless 0 <= operand 0 < size. Emitted before every indexed array access.
+#define IR_CHECK 44
+
+/* Memo table of a pure procedure, named by callee and with the number of entries in constant. The operands are the arguments the
+ * table is keyed on. IR_MEMO_FIND is true if they have an entry, IR_MEMO_GET is its value, and IR_MEMO_PUT adds
+ * the value in its last operand, replacing an older entry if the table is full (runtime.h memoTable). */
+#define IR_MEMO_FIND 45
+#define IR_MEMO_GET 46
+#define IR_MEMO_PUT 47
+
+/* Struct to hold one IR instruction. Instructions are referred to by their index in irFunction::instructions,
+ * and an instruction that produces a value is the SSA value itself.
+ *    op - IR_* opcode, IR_NOP once the instruction has been removed
+ *    type - type of the value produced (TYPE_INTEGER, etc.) or 0 if no value is produced
+ *    size - number of elements for whole array values, 0 for scalars. For IR_CHECK the array size.
+ *    lanes - number of vector lanes, 1 for scalar instructions. IR_LOAD_ELEM and IR_STORE_ELEM with more than one
+ *            lane access that many consecutive elements starting at the index. IR_SPLAT copies a scalar to every lane.
+ *    block - index of the block the instruction is in, -1 once removed
+ *    operands - instruction indices of the values used
+ *    phiBlocks - predecessor block each IR_PHI operand comes from
+ *    constant - value of an IR_CONST, and the number of memo table entries (an integer) for IR_MEMO_*. A string
+ *               constant too long to be stored inline has its irModule::strings index in intValue, -1 otherwise.
+ *    variable - index into irFunction::variables for IR_PARAM, memory access, IR_ADDR and IR_CHECK
+ *    callee - call label of the procedure for IR_CALL, and of the memoized procedure for IR_MEMO_*
+ *    tail - IR_CALL whose value is returned right away, so the callee can take over the caller's frame
+ *    target / falseTarget - successor blocks of IR_BR and IR_CONDBR
+ */
+struct irInstruction {
+	int op = IR_NOP;
+	int type = 0;
+	int size = 0;
+	int lanes = 1;
+	int block = -1;
+	vector<int> operands;
+	vector<int> phiBlocks;
+	constValue constant;
+	int variable = -1;
+	string callee;
+	bool tail = false;
+	int target = -1;
+	int falseTarget = -1;
+};
+
+/* Struct to hold a basic block. The last instruction is always a terminator once the function is finished.
+ *    preds / succs - predecessor and successor block indices
+ *    idom - immediate dominator, -1 for the entry block and unreachable blocks
+ *    removed - true once the block has been found unreachable and deleted
+ */
+struct irBlock {
+	vector<int> instructions;
+	vector<int> preds;
+	vector<int> succs;
+	int idom = -1;
+	bool removed = false;
+};
+
+/* Struct to hold a variable used by a function.
+ *    ssa - true for scalar locals and parameters, which never appear in loads or stores
+ *    global - true for program level globals, which any procedure call may change
+ *    param - parameter position, -1 for other variables
+ *    reference - array parameter passed by reference. It is the caller's array, which may also be a global or another
+ *                reference parameter, so any call or store to one of those may change it.
+ *    frameOffset - byte offset in the frame once layoutFrame() has run, -1 if the variable isn't in the frame
+ */
+struct irVariable {
+	string name;
+	int type = 0;
+	int size = 0;
+	bool ssa = false;
+	bool global = false;
+	int param = -1;
+	bool reference = false;
+	int FPoffset = 0;
+	int frameOffset = -1;
+};
+
+/* A procedure (or the program body) as a control flow graph of basic blocks in SSA form. Block 0 is the entry.
+ *    memoSize - memo table entries requested with a //#memo pragma, 0 to never memoize, -1 if there was no pragma
+ *    registers - register of each value once allocateRegisters() has run, -1 if it is spilled or doesn't need one.
+ *                Floats and vectors use the vector registers (f0, f1, ...), other values the integer ones (r0, ...).
+ *    spillSlot / spillSlots - stack slot (after the frame) of each spilled value, -1 if it isn't spilled, and the
+ *                number of slots used
+ *    frameBytes / spillOffset - size of the frame and byte offset of each spill slot once layoutFrame() has run
+ */
+struct irFunction {
+	string name;
+	string label;
+	int returnType = 0;
+	int frameSize = 0;
+	int memoSize = -1;
+	vector<irVariable> variables;
+	vector<int> registers;
+	vector<int> spillSlot;
+	int spillSlots = 0;
+	int frameBytes = 0;
+	vector<int> spillOffset;
+	vector<irInstruction> instructions;
+	vector<irBlock> blocks;
+};
+
+/* Struct to hold a natural loop found from a back edge to its header.
+ *    preheader - the only block outside the loop that branches to the header, -1 if there isn't exactly one
+ *    inLoop - true for each block index in the loop
+ */
+struct irLoop {
+	int header = -1;
+	int preheader = -1;
+	vector<int> blocks;
+	vector<bool> inLoop;
+};
+
+/* All of the functions in a compilation unit, in the order their bodies were finished.
+ *    strings - string literals too long to be stored inline, each distinct one once. They are placed in read-only
+ *              data, and generated code refers to them there instead of copying them (runtime.h stringLiterals).
+ */
+struct irModule {
+	vector<irFunction> functions;
+	vector<string> strings;
+};
+
+// Instruction properties
+bool isTerminator(int op);
+bool hasSideEffects(int op);
+bool isBinaryOp(int op);
+string opName(int op);
+bool inVectorRegister(irInstruction& inst);
+
+// CFG and dominator maintenance
+void computeCFG(irFunction& function);
+void computeDominators(irFunction& function);
+bool dominates(irFunction& function, int a, int b);
+vector<int> reversePostOrder(irFunction& function, bool loopBodiesFirst = false);
+vector<irLoop> findLoops(irFunction& function);
+void replaceAllUses(irFunction& function, int from, int to);
+void removeInstruction(irFunction& function, int id);
+
+// Text dump of the IR
+void printFunction(ostream& out, irFunction& function);
+void printModule(ostream& out, irModule& module);
+
+#endif
@@ -0,0 +1,200 @@
+#include "irPasses.h"
+#include "ir.h"
+#include "options.h"
+#include "phaseReport.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+/*
+ * Runs a task for each function of a module on a number of threads. Functions are started in index order, and a
+ * task may wait for a lower numbered function to finish. Those were all started first, so a wait never depends on
+ * a task that hasn't started, and the tasks can't deadlock.
+ */
+class functionScheduler
+{
+private:
+	mutex lock;
+	condition_variable finished;
+	vector<bool> done;
+	size_t next;
+	function<void(size_t)> task;
+	void work();
+public:
+	functionScheduler(size_t count);
+	void run(int jobs, function<void(size_t)> task_input);
+	void waitFor(size_t f);
+};
+
+// Constructor - none of 'count' functions have been started
+functionScheduler::functionScheduler(size_t count) {
+	done.assign(count, false);
+	next = 0;
+}
+
+// Take the next function until all of them have been started
+void functionScheduler::work() {
+	while (true) {
+		size_t f;
+		{
+			lock_guard<mutex> guard(lock);
+			if (next == done.size()) return;
+			f = next++;
+		}
+		task(f);
+		lock_guard<mutex> guard(lock);
+		done[f] = true;
+		finished.notify_all();
+	}
+}
+
+// Run the task for every function. 0 jobs means one per hardware thread. The calling thread is one of the jobs.
+void functionScheduler::run(int jobs, function<void(size_t)> task_input) {
+	task = task_input;
+	if (jobs <= 0) jobs = (int)thread::hardware_concurrency();
+	size_t threads = min((size_t)max(jobs, 1), done.size());
+	vector<thread> workers;
+	for (size_t t = 1; t < threads; t++) workers.push_back(thread(&functionScheduler::work, this));
+	work();
+	for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+}
+
+void functionScheduler::waitFor(size_t f) {
+	unique_lock<mutex> guard(lock);
+	while (!done[f]) finished.wait(guard);
+}
+
+void addStats(optimizerStats& total, optimizerStats& stats) {
+	total.removedInstructions += stats.removedInstructions;
+	total.removedBlocks += stats.removedBlocks;
+	total.foldedBranches += stats.foldedBranches;
+	total.mergedBlocks += stats.mergedBlocks;
+	total.numberedValues += stats.numberedValues;
+	total.hoistedInstructions += stats.hoistedInstructions;
+	total.loweredArrayStores += stats.loweredArrayStores;
+	total.vectorLoops += stats.vectorLoops;
+	total.removedChecks += stats.removedChecks;
+	total.hoistedChecks += stats.hoistedChecks;
+	total.inlinedCalls += stats.inlinedCalls;
+	total.memoizedFunctions += stats.memoizedFunctions;
+	total.tailRecursiveCalls += stats.tailRecursiveCalls;
+	total.tailCalls += stats.tailCalls;
+}
+
+void addStats(allocationStats& total, allocationStats& stats) {
+	total.values += stats.values;
+	total.inRegisters += stats.inRegisters;
+	total.spilled += stats.spilled;
+	total.loopValues += stats.loopValues;
+	total.loopValuesInRegisters += stats.loopValuesInRegisters;
+	total.callValues += stats.callValues;
+	total.callValuesInRegisters += stats.callValuesInRegisters;
+	total.spillSlots += stats.spillSlots;
+	total.integerRegisters = max(total.integerRegisters, stats.integerRegisters);
+	total.floatRegisters = max(total.floatRegisters, stats.floatRegisters);
+}
+
+void optimizeModule(irModule& module, compilerOptions& options, map<string, long long>& profile, optimizerStats& stats,
+	vector<cachedProcedure>* cached) {
+	size_t count = module.functions.size();
+	vector<optimizerStats> functionStats(count);
+	size_t f, i;
+
+	// Cheap and needed by the call graph, so cached functions have their tail recursion turned into loops again too
+	functionScheduler tails(count);
+	tails.run(options.jobs, [&](size_t f) { eliminateTailRecursion(module.functions[f], functionStats[f]); });
+	for (f = 0; f < count; f++) {
+		addStats(stats, functionStats[f]);
+		functionStats[f] = optimizerStats();
+	}
+	set<string> recursive = findRecursive(module);
+
+	// Procedures called by one finished before them are inlined unoptimized, so keep a copy of their body
+	map<string, size_t> index;
+	for (f = 0; f < count; f++) index[module.functions[f].label] = f;
+	map<size_t, irFunction> originals;
+	for (f = 0; f < count; f++) {
+		vector<irInstruction>& list = module.functions[f].instructions;
+		for (i = 0; i < list.size(); i++) {
+			if ((list[i].op != IR_CALL) || (list[i].block < 0)) continue;
+			map<string, size_t>::iterator it = index.find(list[i].callee);
+			if ((it != index.end()) && (it->second > f) && !originals.count(it->second)) originals[it->second] = module.functions[it->second];
+		}
+	}
+
+	functionScheduler optimizer(count);
+	optimizer.run(options.jobs, [&](size_t f) {
+		irFunction& function = module.functions[f];
+		if (cached && (*cached)[f].found) {
+			function = (*cached)[f].optimized;
+			functionStats[f] = (*cached)[f].optimizeStats;
+			return;
+		}
+		map<string, irFunction*> callees;
+		for (size_t i = 0; i < function.instructions.size(); i++) {
+			irInstruction& inst = function.instructions[i];
+			if ((inst.op != IR_CALL) || (inst.block < 0) || callees.count(inst.callee)) continue;
+			map<string, size_t>::iterator it = index.find(inst.callee);
+			if ((it == index.end()) || (it->second == f)) continue;
+			if (it->second > f) callees[inst.callee] = &originals.find(it->second)->second;
+			else {
+				optimizer.waitFor(it->second);
+				callees[inst.callee] = &module.functions[it->second];
+			}
+		}
+		{
+			ALLOCATION_SITE("inlineCalls");
+			inlineCalls(callees, function, options, profile, recursive, functionStats[f]);
+		}
+		ALLOCATION_SITE("optimizeFunction");
+		optimizeFunction(function, functionStats[f]);
+		if (cached) {
+			(*cached)[f].optimized = function;
+			(*cached)[f].optimizeStats = functionStats[f];
+		}
+	});
+	for (f = 0; f < count; f++) addStats(stats, functionStats[f]);
+
+	if (options.memoize) memoizeFunctions(module, stats);
+	for (f = 0; f < count; f++) functionStats[f] = optimizerStats();
+	functionScheduler tailCalls(count);
+	tailCalls.run(options.jobs, [&](size_t f) { markTailCalls(module.functions[f], functionStats[f]); });
+	for (f = 0; f < count; f++) addStats(stats, functionStats[f]);
+}
+
+vector<frameLayoutStats> generateModule(irModule& module, compilerOptions& options, allocationStats& stats,
+	vector<cachedProcedure>* cached) {
+	size_t count = module.functions.size();
+	vector<allocationStats> functionStats(count);
+	vector<frameLayoutStats> frames(count);
+	functionScheduler generator(count);
+	generator.run(options.jobs, [&](size_t f) {
+		if (cached && (*cached)[f].found) {
+			module.functions[f] = (*cached)[f].generated;
+			functionStats[f] = (*cached)[f].allocStats;
+			frames[f] = (*cached)[f].frame;
+			return;
+		}
+		{
+			ALLOCATION_SITE("allocateRegisters");
+			allocateRegisters(module.functions[f], functionStats[f]);
+		}
+		ALLOCATION_SITE("layoutFrame");
+		frames[f] = layoutFrame(module.functions[f]);
+		if (cached) {
+			(*cached)[f].generated = module.functions[f];
+			(*cached)[f].allocStats = functionStats[f];
+			(*cached)[f].frame = frames[f];
+		}
+	});
+	for (size_t f = 0; f < count; f++) addStats(stats, functionStats[f]);
+	return frames;
+}
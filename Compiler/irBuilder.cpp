@@ -0,0 +1,535 @@
+#include "irBuilder.h"
+#include "ir.h"
+#include "constValue.h"
+#include "tokentypes.h"
+#include "runtime/runtime.h"
+#include "phaseReport.h"
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+irBuilder::irBuilder(irModule* module_input) {
+	module = module_input;
+}
+
+irBuilder::~irBuilder() {
+	module = nullptr;
+}
+
+irFunction& irBuilder::current() {
+	return functions.back().function;
+}
+
+bool irBuilder::inFunction() {
+	return !functions.empty();
+}
+
+// Size of the memo table for the innermost function if it is memoized, 0 to never memoize it
+void irBuilder::setMemoSize(int entries) {
+	if (inFunction()) current().memoSize = entries;
+}
+
+/* Start the IR for a procedure (or the program body) and create its entry block.
+ * Nested procedures are labeled with the path of procedures they are declared in, so labels are unique. */
+string irBuilder::beginFunction(string name, int returnType) {
+	string label = name;
+	if (functions.size() > 1) label = current().label + "." + name;
+
+	functions.push_back(functionState());
+	functionState& state = functions.back();
+	state.function.name = name;
+	state.function.label = label;
+	state.function.returnType = returnType;
+	state.paramCount = 0;
+	state.currentBlock = newBlock();
+	sealBlock(state.currentBlock);
+	return label;
+}
+
+// Finish the innermost function, adding a return if the body doesn't end with one, and add it to the module
+void irBuilder::endFunction(int frameSize) {
+	if (!terminated(currentBlock())) ret(-1);
+	for (size_t b = 0; b < current().blocks.size(); b++) {
+		if (!functions.back().sealed[b]) sealBlock((int)b);
+	}
+	current().frameSize = frameSize;
+	computeCFG(current());
+	module->functions.push_back(current());
+	functions.pop_back();
+}
+
+// Add a variable declared in the current procedure. Scalars that no other procedure can see are kept in SSA form.
+int irBuilder::declareVariable(string name, int type, int size, bool global, int FPoffset) {
+	if (!inFunction()) return -1;
+	irVariable var;
+	var.name = name;
+	var.type = type;
+	var.size = size;
+	var.global = global;
+	var.ssa = (size == 0) && (!global);
+	var.FPoffset = FPoffset;
+	current().variables.push_back(var);
+	int index = (int)current().variables.size() - 1;
+	functions.back().localVariables[name] = index;
+	return index;
+}
+
+/* Add a parameter of the current procedure. Scalar parameters become IR_PARAM values in the entry block.
+ * Array parameters passed by reference are the caller's array, found through the address in the frame. */
+int irBuilder::declareParameter(string name, int type, int size, int FPoffset, bool reference) {
+	int index = declareVariable(name, type, size, false, FPoffset);
+	if (index < 0) return -1;
+	current().variables[index].param = functions.back().paramCount++;
+	current().variables[index].reference = reference && (size > 0);
+	if (current().variables[index].ssa) {
+		irInstruction inst;
+		inst.op = IR_PARAM;
+		inst.type = type;
+		inst.variable = index;
+		inst.block = 0;
+		current().instructions.push_back(inst);
+		int id = (int)current().instructions.size() - 1;
+		current().blocks[0].instructions.push_back(id);
+		functions.back().currentDef[0][index] = id;
+	}
+	return index;
+}
+
+// Find a variable by the name and scope the symbol table found it in. Globals are added the first time they are used.
+int irBuilder::findVariable(string name, bool global, int type, int size) {
+	if (!inFunction()) return -1;
+	functionState& state = functions.back();
+	map<string, int>& table = global ? state.globalVariables : state.localVariables;
+	map<string, int>::iterator it = table.find(name);
+	if (it != table.end()) return it->second;
+	if (!global) return -1;
+
+	irVariable var;
+	var.name = name;
+	var.type = type;
+	var.size = size;
+	var.global = true;
+	current().variables.push_back(var);
+	int index = (int)current().variables.size() - 1;
+	state.globalVariables[name] = index;
+	return index;
+}
+
+bool irBuilder::isSSA(int variable) {
+	return (variable >= 0) && current().variables[variable].ssa;
+}
+
+int irBuilder::typeOf(int value) {
+	if (value < 0) return T_UNKNOWN;
+	return current().instructions[value].type;
+}
+
+int irBuilder::sizeOf(int value) {
+	if (value < 0) return 0;
+	return current().instructions[value].size;
+}
+
+bool irBuilder::terminated(int block) {
+	vector<int>& list = current().blocks[block].instructions;
+	return (!list.empty()) && isTerminator(current().instructions[list.back()].op);
+}
+
+// Append an instruction to the current block. Code following a return is put in a new unreachable block.
+int irBuilder::addInstruction(irInstruction& inst) {
+	ALLOCATION_SITE("irBuilder::addInstruction");
+	if (terminated(currentBlock())) {
+		int dead = newBlock();
+		sealBlock(dead);
+		setBlock(dead);
+	}
+	inst.block = currentBlock();
+	current().instructions.push_back(inst);
+	int id = (int)current().instructions.size() - 1;
+	current().blocks[inst.block].instructions.push_back(id);
+	return id;
+}
+
+void irBuilder::addEdge(int from, int to) {
+	current().blocks[from].succs.push_back(to);
+	current().blocks[to].preds.push_back(from);
+}
+
+int irBuilder::newBlock() {
+	ALLOCATION_SITE("irBuilder::newBlock");
+	functionState& state = functions.back();
+	state.function.blocks.push_back(irBlock());
+	state.sealed.push_back(false);
+	state.currentDef.push_back(map<int, int>());
+	state.incompletePhis.push_back(map<int, int>());
+	return (int)state.function.blocks.size() - 1;
+}
+
+void irBuilder::setBlock(int block) {
+	functions.back().currentBlock = block;
+}
+
+int irBuilder::currentBlock() {
+	return functions.back().currentBlock;
+}
+
+// All predecessors of the block are known, so finish the phis created while it was open
+void irBuilder::sealBlock(int block) {
+	functionState& state = functions.back();
+	if (state.sealed[block]) return;
+	map<int, int> incomplete = state.incompletePhis[block];
+	state.incompletePhis[block].clear();
+	state.sealed[block] = true;
+	map<int, int>::iterator it;
+	for (it = incomplete.begin(); it != incomplete.end(); ++it) {
+		addPhiOperands(it->first, it->second);
+	}
+}
+
+void irBuilder::writeVariable(int variable, int value) {
+	if ((variable < 0) || (value < 0)) return;
+	if (!isSSA(variable)) {
+		store(variable, value);
+		return;
+	}
+	value = convert(value, current().variables[variable].type);
+	functions.back().currentDef[currentBlock()][variable] = value;
+}
+
+int irBuilder::readVariable(int variable) {
+	if (variable < 0) return -1;
+	if (!isSSA(variable)) return load(variable);
+	return readVariableAt(variable, currentBlock());
+}
+
+int irBuilder::readVariableAt(int variable, int block) {
+	map<int, int>& defs = functions.back().currentDef[block];
+	map<int, int>::iterator it = defs.find(variable);
+	if (it != defs.end()) return it->second;
+	return readVariableRecursive(variable, block);
+}
+
+int irBuilder::readVariableRecursive(int variable, int block) {
+	functionState& state = functions.back();
+	int value;
+	if (!state.sealed[block]) {
+		// Not all predecessors are known yet, the phi's operands are added when the block is sealed
+		value = newPhi(variable, block);
+		state.incompletePhis[block][variable] = value;
+	}
+	else if (current().blocks[block].preds.size() == 1) {
+		value = readVariableAt(variable, current().blocks[block].preds[0]);
+	}
+	else if (current().blocks[block].preds.empty()) {
+		// Read before any assignment
+		value = undef(current().variables[variable].type);
+	}
+	else {
+		// Break cycles by defining the variable with an operandless phi first
+		value = newPhi(variable, block);
+		state.currentDef[block][variable] = value;
+		value = addPhiOperands(variable, value);
+	}
+	state.currentDef[block][variable] = value;
+	return value;
+}
+
+// Create a phi at the start of a block
+int irBuilder::newPhi(int variable, int block) {
+	irInstruction inst;
+	inst.op = IR_PHI;
+	inst.type = current().variables[variable].type;
+	inst.block = block;
+	current().instructions.push_back(inst);
+	int id = (int)current().instructions.size() - 1;
+	vector<int>& list = current().blocks[block].instructions;
+	list.insert(list.begin(), id);
+	return id;
+}
+
+int irBuilder::addPhiOperands(int variable, int phi) {
+	int block = current().instructions[phi].block;
+	vector<int> preds = current().blocks[block].preds;
+	for (size_t p = 0; p < preds.size(); p++) {
+		int value = readVariableAt(variable, preds[p]);
+		current().instructions[phi].operands.push_back(value);
+		current().instructions[phi].phiBlocks.push_back(preds[p]);
+	}
+	return tryRemoveTrivialPhi(phi);
+}
+
+// A phi whose operands are all the same value (or itself) is replaced by that value
+int irBuilder::tryRemoveTrivialPhi(int phi) {
+	int same = -1;
+	vector<int> operands = current().instructions[phi].operands;
+	for (size_t o = 0; o < operands.size(); o++) {
+		if ((operands[o] == same) || (operands[o] == phi)) continue;
+		if (same != -1) return phi;
+		same = operands[o];
+	}
+	if (same == -1) same = undef(current().instructions[phi].type);
+
+	// Remember the other phis that used this one, they may become trivial too
+	vector<int> users;
+	for (size_t i = 0; i < current().instructions.size(); i++) {
+		irInstruction& inst = current().instructions[i];
+		if ((inst.op != IR_PHI) || ((int)i == phi)) continue;
+		for (size_t o = 0; o < inst.operands.size(); o++) {
+			if (inst.operands[o] == phi) {
+				users.push_back((int)i);
+				break;
+			}
+		}
+	}
+
+	replaceAllUses(current(), phi, same);
+	functionState& state = functions.back();
+	for (size_t b = 0; b < state.currentDef.size(); b++) {
+		map<int, int>::iterator it;
+		for (it = state.currentDef[b].begin(); it != state.currentDef[b].end(); ++it) {
+			if (it->second == phi) it->second = same;
+		}
+	}
+	removeInstruction(current(), phi);
+
+	for (size_t u = 0; u < users.size(); u++) {
+		if (current().instructions[users[u]].op == IR_PHI) tryRemoveTrivialPhi(users[u]);
+	}
+	return same;
+}
+
+/* Long string literals are added to the module's read-only strings the first time they are used, so every use of
+ * the same text refers to the same bytes */
+int irBuilder::constant(constValue value) {
+	if (!inFunction() || !value.known) return -1;
+	irInstruction inst;
+	inst.op = IR_CONST;
+	inst.type = value.type;
+	inst.constant = value;
+	if (value.type == TYPE_STRING) {
+		inst.constant.intValue = -1;
+		if (value.stringValue.size() > RT_STRING_INLINE) {
+			map<string, int>::iterator it = strings.find(value.stringValue);
+			if (it == strings.end()) {
+				it = strings.insert(make_pair(value.stringValue, (int)module->strings.size())).first;
+				module->strings.push_back(value.stringValue);
+			}
+			inst.constant.intValue = it->second;
+		}
+	}
+	return addInstruction(inst);
+}
+
+// Undefined values are placed at the start of the entry block so they dominate every use
+int irBuilder::undef(int type) {
+	irInstruction inst;
+	inst.op = IR_UNDEF;
+	inst.type = type;
+	inst.block = 0;
+	current().instructions.push_back(inst);
+	int id = (int)current().instructions.size() - 1;
+	vector<int>& list = current().blocks[0].instructions;
+	list.insert(list.begin(), id);
+	return id;
+}
+
+int irBuilder::convert(int value, int type) {
+	if ((value < 0) || (type == T_UNKNOWN) || (type == 0) || (typeOf(value) == type)) return value;
+	irInstruction& source = current().instructions[value];
+	constValue converted;
+	if ((source.op == IR_CONST) && convertConst(source.constant, type, converted)) return constant(converted);
+
+	irInstruction inst;
+	inst.op = IR_CONVERT;
+	inst.type = type;
+	inst.size = sizeOf(value);
+	inst.operands.push_back(value);
+	return addInstruction(inst);
+}
+
+// Emit a binary operator, converting the operands to the type the operator is evaluated in
+int irBuilder::binary(string op, int left, int right) {
+	if (!inFunction() || (left < 0) || (right < 0)) return -1;
+	int leftType = typeOf(left);
+	int rightType = typeOf(right);
+	bool anyFloat = (leftType == TYPE_FLOAT) || (rightType == TYPE_FLOAT);
+	bool bothBool = (leftType == TYPE_BOOL) && (rightType == TYPE_BOOL);
+
+	irInstruction inst;
+	int operandType;
+	if (op == "+") inst.op = IR_ADD;
+	else if (op == "-") inst.op = IR_SUB;
+	else if (op == "*") inst.op = IR_MUL;
+	else if (op == "/") inst.op = IR_DIV;
+	else if (op == "&") inst.op = IR_AND;
+	else if (op == "|") inst.op = IR_OR;
+	else if (op == "<") inst.op = IR_LT;
+	else if (op == "<=") inst.op = IR_LE;
+	else if (op == ">") inst.op = IR_GT;
+	else if (op == ">=") inst.op = IR_GE;
+	else if (op == "==") inst.op = IR_EQ;
+	else if (op == "!=") inst.op = IR_NE;
+	else return -1;
+
+	if ((inst.op >= IR_ADD) && (inst.op <= IR_DIV)) {
+		operandType = anyFloat ? TYPE_FLOAT : TYPE_INTEGER;
+		inst.type = operandType;
+	}
+	else if ((inst.op == IR_AND) || (inst.op == IR_OR)) {
+		operandType = bothBool ? TYPE_BOOL : TYPE_INTEGER;
+		inst.type = operandType;
+	}
+	else {
+		if ((leftType == TYPE_STRING) || (rightType == TYPE_STRING)) operandType = TYPE_STRING;
+		else if (anyFloat) operandType = TYPE_FLOAT;
+		else if (bothBool) operandType = TYPE_BOOL;
+		else operandType = TYPE_INTEGER;
+		inst.type = TYPE_BOOL;
+	}
+	inst.size = (sizeOf(left) > sizeOf(right)) ? sizeOf(left) : sizeOf(right);
+	inst.operands.push_back(convert(left, operandType));
+	inst.operands.push_back(convert(right, operandType));
+	return addInstruction(inst);
+}
+
+int irBuilder::notOp(int value) {
+	if (!inFunction() || (value < 0)) return -1;
+	irInstruction inst;
+	inst.op = IR_NOT;
+	inst.type = typeOf(value);
+	inst.size = sizeOf(value);
+	inst.operands.push_back(value);
+	return addInstruction(inst);
+}
+
+int irBuilder::negate(int value) {
+	if (!inFunction() || (value < 0)) return -1;
+	irInstruction inst;
+	inst.op = IR_NEG;
+	inst.type = typeOf(value);
+	inst.size = sizeOf(value);
+	inst.operands.push_back(value);
+	return addInstruction(inst);
+}
+
+// Load a scalar or a whole array from memory
+int irBuilder::load(int variable) {
+	if (!inFunction() || (variable < 0)) return -1;
+	if (isSSA(variable)) return readVariable(variable);
+	irInstruction inst;
+	inst.op = IR_LOAD;
+	inst.type = current().variables[variable].type;
+	inst.size = current().variables[variable].size;
+	inst.variable = variable;
+	return addInstruction(inst);
+}
+
+void irBuilder::store(int variable, int value) {
+	if (!inFunction() || (variable < 0) || (value < 0)) return;
+	if (isSSA(variable)) {
+		writeVariable(variable, value);
+		return;
+	}
+	irInstruction inst;
+	inst.op = IR_STORE;
+	inst.variable = variable;
+	inst.operands.push_back(convert(value, current().variables[variable].type));
+	addInstruction(inst);
+}
+
+// Convert an array index to an integer and check it against the array's size
+int irBuilder::boundsCheck(int variable, int index) {
+	index = convert(index, TYPE_INTEGER);
+	irInstruction inst;
+	inst.op = IR_CHECK;
+	inst.size = current().variables[variable].size;
+	inst.variable = variable;
+	inst.operands.push_back(index);
+	addInstruction(inst);
+	return index;
+}
+
+int irBuilder::loadElement(int variable, int index) {
+	if (!inFunction() || (variable < 0) || (index < 0)) return -1;
+	index = boundsCheck(variable, index);
+	irInstruction inst;
+	inst.op = IR_LOAD_ELEM;
+	inst.type = current().variables[variable].type;
+	inst.variable = variable;
+	inst.operands.push_back(index);
+	return addInstruction(inst);
+}
+
+void irBuilder::storeElement(int variable, int index, int value) {
+	if (!inFunction() || (variable < 0) || (index < 0) || (value < 0)) return;
+	index = boundsCheck(variable, index);
+	value = convert(value, current().variables[variable].type);
+	irInstruction inst;
+	inst.op = IR_STORE_ELEM;
+	inst.variable = variable;
+	inst.operands.push_back(index);
+	inst.operands.push_back(value);
+	addInstruction(inst);
+}
+
+// Name of the variable a whole array value was loaded from, "" if the value is an expression
+string irBuilder::arrayName(int value) {
+	if (!inFunction() || (value < 0)) return "";
+	irInstruction& inst = current().instructions[value];
+	if ((inst.op != IR_LOAD) || (inst.size == 0)) return "";
+	return current().variables[inst.variable].name;
+}
+
+/* Pass an array by reference instead of copying it. The argument's load of the whole array becomes its address;
+ * any other array value is left as it is, and is passed as the address of a temporary copy. */
+int irBuilder::address(int value) {
+	if (arrayName(value) == "") return value;
+	current().instructions[value].op = IR_ADDR;
+	return value;
+}
+
+int irBuilder::call(string label, vector<int>& args, int returnType) {
+	if (!inFunction()) return -1;
+	irInstruction inst;
+	inst.op = IR_CALL;
+	inst.type = returnType;
+	inst.callee = label;
+	for (size_t a = 0; a < args.size(); a++) {
+		inst.operands.push_back((args[a] < 0) ? undef(T_UNKNOWN) : args[a]);
+	}
+	return addInstruction(inst);
+}
+
+// Branches out of a block that already ended (code after a return) are dropped
+void irBuilder::branch(int target) {
+	if (!inFunction() || terminated(currentBlock())) return;
+	irInstruction inst;
+	inst.op = IR_BR;
+	inst.target = target;
+	addEdge(currentBlock(), target);
+	addInstruction(inst);
+}
+
+void irBuilder::condBranch(int condition, int trueTarget, int falseTarget) {
+	if (!inFunction() || terminated(currentBlock())) return;
+	if (condition < 0) condition = undef(TYPE_BOOL);
+	irInstruction inst;
+	inst.op = IR_CONDBR;
+	inst.target = trueTarget;
+	inst.falseTarget = falseTarget;
+	inst.operands.push_back(convert(condition, TYPE_BOOL));
+	addEdge(currentBlock(), trueTarget);
+	if (falseTarget != trueTarget) addEdge(currentBlock(), falseTarget);
+	addInstruction(inst);
+}
+
+void irBuilder::ret(int value) {
+	if (!inFunction() || terminated(currentBlock())) return;
+	irInstruction inst;
+	inst.op = IR_RET;
+	if ((value >= 0) && (current().returnType != 0)) {
+		inst.operands.push_back(convert(value, current().returnType));
+	}
+	addInstruction(inst);
+}
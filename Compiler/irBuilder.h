@@ -0,0 +1,97 @@
+#ifndef IRBUILDER_H
+#define IRBUILDER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "ir.h"
+#include "constValue.h"
+
+using namespace std;
+
+/*
+ * Interface used by the parser to build the IR of each procedure as it is parsed.
+ * Scalar locals are put into SSA form on the fly using the algorithm from Braun et al.,
+ * "Simple and Efficient Construction of Static Single Assignment Form": each block records the value last
+ * written to each variable, and phis are created on demand when a variable is read in a block that doesn't define it.
+ * Blocks are sealed once all of their predecessors are known.
+ *
+ * Value arguments and return values are instruction indices in the function being built, -1 means no value
+ * (used after parse errors, in which case the IR is never used).
+ */
+class irBuilder
+{
+private:
+	// State of a function whose body is being parsed. Procedure declarations nest, so the innermost is at the back.
+	struct functionState {
+		irFunction function;
+		int currentBlock;
+		vector<bool> sealed;
+		vector< map<int, int> > currentDef;
+		vector< map<int, int> > incompletePhis;
+		map<string, int> localVariables;
+		map<string, int> globalVariables;
+		int paramCount;
+	};
+	irModule* module;
+	vector<functionState> functions;
+	map<string, int> strings;
+
+	irFunction& current();
+	int addInstruction(irInstruction& inst);
+	int typeOf(int value);
+	int sizeOf(int value);
+	bool terminated(int block);
+	int boundsCheck(int variable, int index);
+	int newPhi(int variable, int block);
+	int readVariableAt(int variable, int block);
+	int readVariableRecursive(int variable, int block);
+	int addPhiOperands(int variable, int phi);
+	int tryRemoveTrivialPhi(int phi);
+	void addEdge(int from, int to);
+public:
+	irBuilder(irModule* module_input);
+	~irBuilder();
+
+	// Functions. beginFunction returns the unique call label of the procedure.
+	string beginFunction(string name, int returnType);
+	void endFunction(int frameSize);
+	bool inFunction();
+	void setMemoSize(int entries);
+
+	// Variables
+	int declareVariable(string name, int type, int size, bool global, int FPoffset);
+	int declareParameter(string name, int type, int size, int FPoffset, bool reference);
+	int findVariable(string name, bool global, int type, int size);
+	bool isSSA(int variable);
+	int readVariable(int variable);
+	void writeVariable(int variable, int value);
+
+	// Blocks
+	int newBlock();
+	void setBlock(int block);
+	void sealBlock(int block);
+	int currentBlock();
+
+	// Values
+	int constant(constValue value);
+	int undef(int type);
+	int convert(int value, int type);
+	int binary(string op, int left, int right);
+	int notOp(int value);
+	int negate(int value);
+	int load(int variable);
+	void store(int variable, int value);
+	int loadElement(int variable, int index);
+	void storeElement(int variable, int index, int value);
+	string arrayName(int value);
+	int address(int value);
+	int call(string label, vector<int>& args, int returnType);
+
+	// Terminators
+	void branch(int target);
+	void condBranch(int condition, int trueTarget, int falseTarget);
+	void ret(int value);
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include "irPasses.h"
+#include "ir.h"
+#include "tokentypes.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+/* Something that needs space in the frame: a variable kept in memory or a register allocator spill slot.
+ *    start / end - first and last position (in reverse postorder) the contents are needed at
+ *    variable / spill - index of the variable or spill slot, -1 for the other kind
+ */
+struct frameObject {
+	int bytes;
+	int align;
+	int start;
+	int end;
+	int variable;
+	int spill;
+};
+
+// A range of the frame and the objects sharing it, none of whose lifetimes overlap
+struct frameSlot {
+	int offset;
+	int bytes;
+	vector<int> objects;
+};
+
+// Size of one value of a type: integers are 32 bit, floats are doubles, strings are runtime.h rtString values
+static int typeBytes(int type) {
+	switch (type) {
+	case TYPE_INTEGER: return 4;
+	case TYPE_FLOAT: return 8;
+	case TYPE_BOOL: return 1;
+	case TYPE_STRING: return 16;
+	default: return 4;
+	}
+}
+
+/* Size and alignment of a variable. Arrays that hold at least one vector are aligned for the vector loops whole
+ * array operations are lowered to, and everything else to the size of its type. An array passed by reference only
+ * needs room for its address. */
+static void variableBytes(irVariable& var, int& bytes, int& align) {
+	if (var.reference) {
+		bytes = align = 8;
+		return;
+	}
+	align = typeBytes(var.type);
+	bytes = align;
+	if (var.size > 0) {
+		bytes = align * var.size;
+		if (bytes >= IR_VECTOR_BITS / 8) align = IR_VECTOR_BITS / 8;
+	}
+}
+
+static int alignUp(int value, int align) {
+	return (value + align - 1) / align * align;
+}
+
+/* The frame as scope::addSymbol() lays it out: every local and parameter in declaration order, each in its own slot,
+ * with the sizes and alignment of their types. */
+static int declaredFrameBytes(irFunction& function, int header) {
+	vector< pair<int, int> > order;
+	for (size_t v = 0; v < function.variables.size(); v++) {
+		if (!function.variables[v].global) order.push_back(make_pair(function.variables[v].FPoffset, (int)v));
+	}
+	sort(order.begin(), order.end());
+	int bytes = header;
+	for (size_t i = 0; i < order.size(); i++) {
+		int size, align;
+		variableBytes(function.variables[order[i].second], size, align);
+		bytes = alignUp(bytes, align) + size;
+	}
+	return alignUp(bytes, FRAME_ALIGN);
+}
+
+/* Lay out the frame of a function after register allocation. Only variables kept in memory (arrays, array
+ * parameters and scalar parameters, which the caller stores) and spill slots get space. Objects are placed
+ * largest alignment first so little space is lost to padding, and an object shares the slot of earlier ones whose
+ * lifetimes it doesn't overlap. A variable's lifetime covers all of its accesses and every loop containing one,
+ * since its contents are needed on the next iteration. Scalar parameters are only needed on entry. */
+frameLayoutStats layoutFrame(irFunction& function) {
+	frameLayoutStats stats;
+	int header = (function.label == "main") ? 0 : FRAME_HEADER_BYTES;
+	stats.bytesBefore = declaredFrameBytes(function, header);
+	size_t b, i, o;
+
+	computeCFG(function);
+	computeDominators(function);
+	vector<int> order = reversePostOrder(function, true);
+	vector<int> blockStart(function.blocks.size(), 0);
+	vector<int> blockEnd(function.blocks.size(), 0);
+	vector<int> position(function.instructions.size(), -1);
+	int pos = 0;
+	for (b = 0; b < order.size(); b++) {
+		vector<int>& list = function.blocks[order[b]].instructions;
+		blockStart[order[b]] = pos;
+		for (i = 0; i < list.size(); i++) position[list[i]] = pos++;
+		blockEnd[order[b]] = pos;
+	}
+
+	// Frame objects for the variables in memory, which start out live only at the entry
+	vector<frameObject> objects;
+	vector<int> objectOf(function.variables.size(), -1);
+	for (size_t v = 0; v < function.variables.size(); v++) {
+		irVariable& var = function.variables[v];
+		var.frameOffset = -1;
+		if (var.global || (var.ssa && (var.param < 0))) continue;
+		frameObject object;
+		variableBytes(var, object.bytes, object.align);
+		object.start = 0;
+		object.end = 0;
+		object.variable = (int)v;
+		object.spill = -1;
+		objectOf[v] = (int)objects.size();
+		objects.push_back(object);
+	}
+
+	// Local arrays are live from their first access to their last, and parameters from the entry to their last (or
+	// to their IR_PARAM for scalars)
+	vector<bool> accessed(objects.size(), false);
+	for (i = 0; i < function.instructions.size(); i++) {
+		irInstruction& inst = function.instructions[i];
+		if ((inst.variable < 0) || (position[i] < 0)) continue;
+		int object = objectOf[inst.variable];
+		if (object < 0) continue;
+		bool param = function.variables[inst.variable].param >= 0;
+		if (!accessed[object] && !param) objects[object].start = position[i];
+		accessed[object] = true;
+		objects[object].start = min(objects[object].start, position[i]);
+		objects[object].end = max(objects[object].end, position[i]);
+	}
+	vector<irLoop> loops = findLoops(function);
+	for (size_t l = 0; l < loops.size(); l++) {
+		int loopStart = pos;
+		int loopEnd = 0;
+		for (b = 0; b < loops[l].blocks.size(); b++) {
+			loopStart = min(loopStart, blockStart[loops[l].blocks[b]]);
+			loopEnd = max(loopEnd, blockEnd[loops[l].blocks[b]]);
+		}
+		for (size_t v = 0; v < objects.size(); v++) {
+			if (!accessed[v] || (objects[v].end < loopStart) || (objects[v].start > loopEnd)) continue;
+			objects[v].start = min(objects[v].start, loopStart);
+			objects[v].end = max(objects[v].end, loopEnd);
+		}
+	}
+
+	/* Spill slots were already shared by the register allocator, so each one is live for the whole function.
+	 * A slot is as big as the largest value spilled to it. */
+	function.spillOffset.assign(function.spillSlots, -1);
+	for (int s = 0; s < function.spillSlots; s++) {
+		frameObject object;
+		object.bytes = 1;
+		for (i = 0; i < function.spillSlot.size(); i++) {
+			if (function.spillSlot[i] != s) continue;
+			irInstruction& inst = function.instructions[i];
+			int valueBytes = (inst.lanes > 1) ? IR_VECTOR_BITS / 8 : typeBytes(inst.type);
+			object.bytes = max(object.bytes, valueBytes);
+		}
+		object.align = object.bytes;
+		object.start = 0;
+		object.end = pos;
+		object.variable = -1;
+		object.spill = s;
+		objects.push_back(object);
+	}
+
+	// Largest alignment first, then largest size, keeping declaration order otherwise. Unused locals are left out.
+	vector<int> placement;
+	for (o = 0; o < objects.size(); o++) {
+		int v = objects[o].variable;
+		if ((v >= 0) && !accessed[o] && (function.variables[v].param < 0)) continue;
+		placement.push_back((int)o);
+	}
+	for (o = 1; o < placement.size(); o++) {
+		for (size_t j = o; j > 0; j--) {
+			frameObject& a = objects[placement[j - 1]];
+			frameObject& c = objects[placement[j]];
+			if ((a.align > c.align) || ((a.align == c.align) && (a.bytes >= c.bytes))) break;
+			swap(placement[j - 1], placement[j]);
+		}
+	}
+
+	vector<frameSlot> slots;
+	int bytes = header;
+	for (o = 0; o < placement.size(); o++) {
+		frameObject& object = objects[placement[o]];
+		int found = -1;
+		for (size_t s = 0; (s < slots.size()) && (found < 0); s++) {
+			frameSlot& slot = slots[s];
+			if ((slot.bytes < object.bytes) || (slot.offset % object.align != 0)) continue;
+			bool overlaps = false;
+			for (size_t k = 0; k < slot.objects.size(); k++) {
+				frameObject& other = objects[slot.objects[k]];
+				if ((other.start <= object.end) && (object.start <= other.end)) overlaps = true;
+			}
+			if (!overlaps) found = (int)s;
+		}
+		if (found >= 0) stats.sharedSlots++;
+		else {
+			frameSlot slot;
+			slot.offset = alignUp(bytes, object.align);
+			slot.bytes = object.bytes;
+			bytes = slot.offset + slot.bytes;
+			slots.push_back(slot);
+			found = (int)slots.size() - 1;
+		}
+		slots[found].objects.push_back(placement[o]);
+		if (object.variable >= 0) function.variables[object.variable].frameOffset = slots[found].offset;
+		else function.spillOffset[object.spill] = slots[found].offset;
+	}
+
+	function.frameBytes = alignUp(bytes, FRAME_ALIGN);
+	stats.bytesAfter = function.frameBytes;
+	return stats;
+}
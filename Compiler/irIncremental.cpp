@@ -0,0 +1,397 @@
+#include "irPasses.h"
+#include "ir.h"
+#include "options.h"
+#include "compileCache.h"
+#include "sha256.h"
+#include "tokentypes.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+// Part of every procedure's key, changed whenever the format of its entry changes
+#define PROCEDURE_ENTRY_VERSION "procedure 1"
+
+/* Writer of the binary form functions are hashed and stored in. Numbers are zigzag encoded in 7 bit groups, low
+ * group first with the high bit set on all but the last, so the small numbers most of IR is made of take a byte.
+ * Strings are their length and then their bytes. A long string constant is written with its text but not its
+ * irModule::strings index, which depends on the strings of the procedures before it. */
+class irWriter
+{
+private:
+	string& out;
+public:
+	irWriter(string& out_input) : out(out_input) {}
+	void number(long long value);
+	void text(const string& value);
+	void list(const vector<int>& values);
+	void function(irFunction& function);
+};
+
+void irWriter::number(long long value) {
+	unsigned long long bits = ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+	while (bits >= 0x80) {
+		out += (char)((bits & 0x7F) | 0x80);
+		bits >>= 7;
+	}
+	out += (char)bits;
+}
+
+void irWriter::text(const string& value) {
+	number((long long)value.size());
+	out += value;
+}
+
+void irWriter::list(const vector<int>& values) {
+	number((long long)values.size());
+	for (size_t i = 0; i < values.size(); i++) number(values[i]);
+}
+
+void irWriter::function(irFunction& function) {
+	size_t i;
+	text(function.name);
+	text(function.label);
+	number(function.returnType);
+	number(function.frameSize);
+	number(function.memoSize);
+	number((long long)function.variables.size());
+	for (i = 0; i < function.variables.size(); i++) {
+		irVariable& var = function.variables[i];
+		text(var.name);
+		number(var.type);
+		number(var.size);
+		number(var.ssa);
+		number(var.global);
+		number(var.param);
+		number(var.reference);
+		number(var.FPoffset);
+		number(var.frameOffset);
+	}
+	list(function.registers);
+	list(function.spillSlot);
+	number(function.spillSlots);
+	number(function.frameBytes);
+	list(function.spillOffset);
+	number((long long)function.instructions.size());
+	for (i = 0; i < function.instructions.size(); i++) {
+		irInstruction& inst = function.instructions[i];
+		number(inst.op);
+		number(inst.type);
+		number(inst.size);
+		number(inst.lanes);
+		number(inst.block);
+		list(inst.operands);
+		list(inst.phiBlocks);
+		long long bits;
+		memcpy(&bits, &inst.constant.floatValue, sizeof(bits));
+		number(inst.constant.known);
+		number(inst.constant.type);
+		number((inst.constant.type == TYPE_STRING) ? (inst.constant.intValue >= 0) : inst.constant.intValue);
+		number(bits);
+		number(inst.constant.boolValue);
+		text(inst.constant.stringValue);
+		number(inst.variable);
+		text(inst.callee);
+		number(inst.tail);
+		number(inst.target);
+		number(inst.falseTarget);
+	}
+	number((long long)function.blocks.size());
+	for (i = 0; i < function.blocks.size(); i++) {
+		irBlock& block = function.blocks[i];
+		list(block.instructions);
+		list(block.preds);
+		list(block.succs);
+		number(block.idom);
+		number(block.removed);
+	}
+}
+
+/* Reader of what irWriter wrote. Long string constants get the index of their text in the module being compiled.
+ * 'ok' is cleared if the entry is cut short, uses a string the module doesn't have, or refers to an instruction,
+ * block, variable or spill slot the function doesn't have, so a damaged entry is a miss rather than a crash. */
+class irReader
+{
+private:
+	const char* next;
+	const char* end;
+	map<string, int>& strings;
+	bool indices(irFunction& function);
+public:
+	bool ok;
+	irReader(const string& in, map<string, int>& strings_input);
+	long long number();
+	string text();
+	vector<int> list();
+	void function(irFunction& function);
+};
+
+irReader::irReader(const string& in, map<string, int>& strings_input) : strings(strings_input) {
+	next = in.data();
+	end = in.data() + in.size();
+	ok = true;
+}
+
+long long irReader::number() {
+	unsigned long long bits = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (next == end) {
+			ok = false;
+			return 0;
+		}
+		unsigned char byte = (unsigned char)*next++;
+		bits |= (unsigned long long)(byte & 0x7F) << shift;
+		if (byte < 0x80) break;
+	}
+	return (long long)(bits >> 1) ^ -(long long)(bits & 1);
+}
+
+string irReader::text() {
+	long long length = number();
+	if (!ok || (length < 0) || (length > end - next)) {
+		ok = false;
+		return "";
+	}
+	string value(next, (size_t)length);
+	next += length;
+	return value;
+}
+
+vector<int> irReader::list() {
+	long long count = number();
+	vector<int> values;
+	if ((count < 0) || (count > end - next)) ok = false;
+	if (ok) values.reserve((size_t)count);
+	for (long long i = 0; ok && (i < count); i++) values.push_back((int)number());
+	return values;
+}
+
+void irReader::function(irFunction& function) {
+	long long count, i;
+	function.name = text();
+	function.label = text();
+	function.returnType = (int)number();
+	function.frameSize = (int)number();
+	function.memoSize = (int)number();
+	count = number();
+	for (i = 0; ok && (i < count); i++) {
+		irVariable var;
+		var.name = text();
+		var.type = (int)number();
+		var.size = (int)number();
+		var.ssa = number() != 0;
+		var.global = number() != 0;
+		var.param = (int)number();
+		var.reference = number() != 0;
+		var.FPoffset = (int)number();
+		var.frameOffset = (int)number();
+		function.variables.push_back(var);
+	}
+	function.registers = list();
+	function.spillSlot = list();
+	function.spillSlots = (int)number();
+	function.frameBytes = (int)number();
+	function.spillOffset = list();
+	count = number();
+	for (i = 0; ok && (i < count); i++) {
+		irInstruction inst;
+		inst.op = (int)number();
+		inst.type = (int)number();
+		inst.size = (int)number();
+		inst.lanes = (int)number();
+		inst.block = (int)number();
+		inst.operands = list();
+		inst.phiBlocks = list();
+		inst.constant.known = number() != 0;
+		inst.constant.type = (int)number();
+		inst.constant.intValue = (int)number();
+		long long bits = number();
+		memcpy(&inst.constant.floatValue, &bits, sizeof(bits));
+		inst.constant.boolValue = number() != 0;
+		inst.constant.stringValue = text();
+		if (inst.constant.type == TYPE_STRING) {
+			map<string, int>::iterator it = strings.find(inst.constant.stringValue);
+			if (inst.constant.intValue == 0) inst.constant.intValue = -1;
+			else if (it != strings.end()) inst.constant.intValue = it->second;
+			else ok = false;
+		}
+		inst.variable = (int)number();
+		inst.callee = text();
+		inst.tail = number() != 0;
+		inst.target = (int)number();
+		inst.falseTarget = (int)number();
+		function.instructions.push_back(inst);
+	}
+	count = number();
+	for (i = 0; ok && (i < count); i++) {
+		irBlock block;
+		block.instructions = list();
+		block.preds = list();
+		block.succs = list();
+		block.idom = (int)number();
+		block.removed = number() != 0;
+		function.blocks.push_back(block);
+	}
+	if (ok && !indices(function)) ok = false;
+}
+
+// Whether 'value' is an index into a vector of 'count' elements, or -1 where 'none' allows it
+static bool inRange(int value, size_t count, bool none = false) {
+	return (none && (value == -1)) || ((value >= 0) && ((size_t)value < count));
+}
+
+static bool allInRange(const vector<int>& values, size_t count, bool none = false) {
+	for (size_t i = 0; i < values.size(); i++) {
+		if (!inRange(values[i], count, none)) return false;
+	}
+	return true;
+}
+
+// Whether every index the function holds is in range of what it refers to, as the passes and backend assume
+bool irReader::indices(irFunction& function) {
+	size_t instructions = function.instructions.size();
+	size_t blocks = function.blocks.size();
+	size_t variables = function.variables.size();
+	if ((function.spillSlots < 0) || (function.frameBytes < 0)) return false;
+	size_t slots = (size_t)function.spillSlots;
+	for (size_t i = 0; i < instructions; i++) {
+		irInstruction& inst = function.instructions[i];
+		if (!inRange(inst.block, blocks, true) || !allInRange(inst.operands, instructions)) return false;
+		if (!allInRange(inst.phiBlocks, blocks) || !inRange(inst.variable, variables, true)) return false;
+		if (!inRange(inst.target, blocks, true) || !inRange(inst.falseTarget, blocks, true)) return false;
+	}
+	for (size_t b = 0; b < blocks; b++) {
+		irBlock& block = function.blocks[b];
+		if (!allInRange(block.instructions, instructions) || !allInRange(block.preds, blocks)) return false;
+		if (!allInRange(block.succs, blocks) || !inRange(block.idom, blocks, true)) return false;
+	}
+
+	// Registers and spill slots are per instruction once allocateRegisters() has run, and offsets per slot once
+	// layoutFrame() has
+	if (!function.registers.empty() && (function.registers.size() != instructions)) return false;
+	if (!allInRange(function.registers, max(REG_INTEGER_COUNT, REG_FLOAT_COUNT), true)) return false;
+	if (!function.spillSlot.empty() && (function.spillSlot.size() != instructions)) return false;
+	if (!allInRange(function.spillSlot, slots, true)) return false;
+	if (!function.spillOffset.empty() && (function.spillOffset.size() != slots)) return false;
+	return true;
+}
+
+// The counters stored with a procedure, in the order they are stored
+static vector<int*> procedureCounts(cachedProcedure& procedure) {
+	optimizerStats& opt = procedure.optimizeStats;
+	allocationStats& alloc = procedure.allocStats;
+	int* counts[] = { &opt.removedInstructions, &opt.removedBlocks, &opt.foldedBranches, &opt.mergedBlocks,
+		&opt.numberedValues, &opt.hoistedInstructions, &opt.loweredArrayStores, &opt.vectorLoops, &opt.removedChecks,
+		&opt.hoistedChecks, &opt.inlinedCalls, &opt.memoizedFunctions, &opt.tailRecursiveCalls, &opt.tailCalls,
+		&alloc.values, &alloc.inRegisters, &alloc.spilled, &alloc.loopValues, &alloc.loopValuesInRegisters,
+		&alloc.callValues, &alloc.callValuesInRegisters, &alloc.spillSlots, &alloc.integerRegisters, &alloc.floatRegisters,
+		&procedure.frame.bytesBefore, &procedure.frame.bytesAfter, &procedure.frame.sharedSlots };
+	return vector<int*>(counts, counts + sizeof(counts) / sizeof(counts[0]));
+}
+
+/* The key of each function. It hashes the options the optimizer uses, the profile, and the IR as parsed of the
+ * function and of every function it can reach through calls, in module order with the function itself marked.
+ * That order decides which callees are inlined optimized and which unoptimized, so it is part of the key too. */
+static vector<string> procedureKeys(irModule& module, compilerOptions& options, map<string, long long>& profile) {
+	size_t count = module.functions.size();
+	size_t f, i;
+	map<string, size_t> index;
+	vector<string> hashes(count);
+	for (f = 0; f < count; f++) {
+		index[module.functions[f].label] = f;
+		string text;
+		irWriter writer(text);
+		writer.function(module.functions[f]);
+		sha256 hash;
+		hash.update(text);
+		hashes[f] = hash.hexDigest();
+	}
+	vector<vector<size_t>> calls(count);
+	for (f = 0; f < count; f++) {
+		irFunction& function = module.functions[f];
+		for (i = 0; i < function.instructions.size(); i++) {
+			irInstruction& inst = function.instructions[i];
+			if ((inst.op != IR_CALL) || (inst.block < 0)) continue;
+			map<string, size_t>::iterator it = index.find(inst.callee);
+			if (it != index.end()) calls[f].push_back(it->second);
+		}
+	}
+
+	ostringstream settings;
+	settings << COMPILER_VERSION << "\n" << compileCache::buildId() << "\n" << PROCEDURE_ENTRY_VERSION << "\noptimize " << options.optimize;
+	settings << "\ninline " << options.inlineBudget << "\nmemoize " << options.memoize << "\n";
+	for (map<string, long long>::iterator it = profile.begin(); it != profile.end(); it++) {
+		settings << it->first.size() << ":" << it->first << " " << it->second << "\n";
+	}
+
+	vector<string> keys(count);
+	for (f = 0; f < count; f++) {
+		vector<bool> reached(count, false);
+		vector<size_t> work(1, f);
+		reached[f] = true;
+		while (!work.empty()) {
+			vector<size_t>& callees = calls[work.back()];
+			work.pop_back();
+			for (i = 0; i < callees.size(); i++) {
+				if (reached[callees[i]]) continue;
+				reached[callees[i]] = true;
+				work.push_back(callees[i]);
+			}
+		}
+		sha256 hash;
+		hash.update(settings.str());
+		for (size_t g = 0; g < count; g++) {
+			if (!reached[g]) continue;
+			hash.update((g == f) ? "*" : "-");
+			hash.update(hashes[g]);
+		}
+		keys[f] = hash.hexDigest();
+	}
+	return keys;
+}
+
+vector<cachedProcedure> findProcedures(irModule& module, compilerOptions& options, map<string, long long>& profile, compileCache& cache) {
+	vector<string> keys = procedureKeys(module, options, profile);
+	vector<cachedProcedure> procedures(module.functions.size());
+	map<string, int> strings;
+	for (size_t s = 0; s < module.strings.size(); s++) strings[module.strings[s]] = (int)s;
+
+	for (size_t f = 0; f < procedures.size(); f++) {
+		cachedProcedure& procedure = procedures[f];
+		procedure.key = keys[f];
+		string entry;
+		if (!cache.lookup(procedure.key, entry)) continue;
+
+		irReader reader(entry, strings);
+		if (options.optimize) reader.function(procedure.optimized);
+		reader.function(procedure.generated);
+		vector<int*> counts = procedureCounts(procedure);
+		for (size_t c = 0; c < counts.size(); c++) *counts[c] = (int)reader.number();
+		procedure.found = reader.ok && (procedure.generated.label == module.functions[f].label);
+		if (procedure.found) continue;
+		procedures[f] = cachedProcedure();
+		procedures[f].key = keys[f];
+	}
+	return procedures;
+}
+
+void storeProcedures(vector<cachedProcedure>& procedures, compilerOptions& options, compileCache& cache) {
+	vector<size_t> compiled;
+	for (size_t f = 0; f < procedures.size(); f++) {
+		if (!procedures[f].found) compiled.push_back(f);
+	}
+	for (size_t c = 0; c < compiled.size(); c++) {
+		cachedProcedure& procedure = procedures[compiled[c]];
+		string entry;
+		irWriter writer(entry);
+		if (options.optimize) writer.function(procedure.optimized);
+		writer.function(procedure.generated);
+		vector<int*> counts = procedureCounts(procedure);
+		for (size_t i = 0; i < counts.size(); i++) writer.number(*counts[i]);
+		cache.store(procedure.key, entry, c + 1 == compiled.size());
+	}
+}
@@ -0,0 +1,280 @@
+#include "irPasses.h"
+#include "ir.h"
+#include "options.h"
+#include "tokentypes.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <algorithm>
+
+using namespace std;
+
+// Calls to procedures with at least this many calls in the profile get four times the size budget
+#define INLINE_HOT_CALLS 1000
+
+/* Read a call profile. Each line holds a procedure's call label and the number of times it was called.
+ * Returns false if the file can't be opened. */
+bool readProfile(string filename, map<string, long long>& counts) {
+	ifstream file(filename);
+	if (!file.is_open()) return false;
+	string label;
+	long long count;
+	while (file >> label >> count) counts[label] += count;
+	return true;
+}
+
+// Number of instructions in a function, not counting parameters and undefined values
+static int functionSize(irFunction& function) {
+	int size = 0;
+	for (size_t b = 0; b < function.blocks.size(); b++) {
+		if (function.blocks[b].removed) continue;
+		vector<int>& list = function.blocks[b].instructions;
+		for (size_t i = 0; i < list.size(); i++) {
+			int op = function.instructions[list[i]].op;
+			if ((op != IR_PARAM) && (op != IR_UNDEF)) size++;
+		}
+	}
+	return size;
+}
+
+// Labels of the procedures that can call themselves, directly or through other procedures
+set<string> findRecursive(irModule& module) {
+	map<string, set<string> > calls;
+	size_t f, i;
+	for (f = 0; f < module.functions.size(); f++) {
+		irFunction& function = module.functions[f];
+		for (i = 0; i < function.instructions.size(); i++) {
+			if (function.instructions[i].op == IR_CALL) calls[function.label].insert(function.instructions[i].callee);
+		}
+	}
+
+	set<string> recursive;
+	for (f = 0; f < module.functions.size(); f++) {
+		string start = module.functions[f].label;
+		set<string> seen;
+		vector<string> work(calls[start].begin(), calls[start].end());
+		while (!work.empty()) {
+			string label = work.back();
+			work.pop_back();
+			if (label == start) {
+				recursive.insert(start);
+				break;
+			}
+			if (!seen.insert(label).second) continue;
+			work.insert(work.end(), calls[label].begin(), calls[label].end());
+		}
+	}
+	return recursive;
+}
+
+/* Copy the body of 'callee' into 'caller' in place of the call instruction 'call'.
+ * The call's block is split: the code before the call branches to the copied entry block, every copied return
+ * branches to a new block holding the code after the call, and the returned values meet in a phi there. */
+static void inlineCall(irFunction& caller, irFunction& callee, int call) {
+	irInstruction callInst = caller.instructions[call];
+	int block = callInst.block;
+	vector<int>& list = caller.blocks[block].instructions;
+	size_t position = find(list.begin(), list.end(), call) - list.begin();
+	vector<int> before(list.begin(), list.begin() + position);
+	vector<int> after(list.begin() + position + 1, list.end());
+	size_t i, b, o;
+
+	/* Callee variables become caller variables. Globals are shared, and so are arrays passed by reference, which are
+	 * the variable whose address was passed. Locals get a slot after the caller's frame. */
+	int frameStart = caller.frameSize;
+	vector<int> variableMap(callee.variables.size(), -1);
+	for (size_t v = 0; v < callee.variables.size(); v++) {
+		irVariable var = callee.variables[v];
+		if (var.reference && (var.param < (int)callInst.operands.size())) {
+			irInstruction& arg = caller.instructions[callInst.operands[var.param]];
+			if (arg.op == IR_ADDR) {
+				variableMap[v] = arg.variable;
+				continue;
+			}
+		}
+		if (var.global) {
+			for (size_t c = 0; c < caller.variables.size(); c++) {
+				if (caller.variables[c].global && (caller.variables[c].name == var.name)) variableMap[v] = (int)c;
+			}
+			if (variableMap[v] != -1) continue;
+		}
+		else {
+			var.name = callee.label + "." + var.name;
+			var.FPoffset = frameStart + var.FPoffset - 2;
+			var.param = -1;
+			var.reference = false;
+		}
+		caller.variables.push_back(var);
+		variableMap[v] = (int)caller.variables.size() - 1;
+	}
+	if (callee.frameSize > 2) caller.frameSize += callee.frameSize - 2;
+
+	// New blocks for the callee's blocks, followed by the block for the code after the call
+	vector<int> blockMap(callee.blocks.size(), -1);
+	for (b = 0; b < callee.blocks.size(); b++) {
+		if (callee.blocks[b].removed) continue;
+		blockMap[b] = (int)caller.blocks.size();
+		caller.blocks.push_back(irBlock());
+	}
+	int exit = (int)caller.blocks.size();
+	caller.blocks.push_back(irBlock());
+
+	// Phis in the old successors now come from the exit block
+	for (i = 0; i < caller.instructions.size(); i++) {
+		irInstruction& inst = caller.instructions[i];
+		if (inst.op != IR_PHI) continue;
+		for (o = 0; o < inst.phiBlocks.size(); o++) {
+			if (inst.phiBlocks[o] == block) inst.phiBlocks[o] = exit;
+		}
+	}
+
+	/* Give every callee instruction a caller index first, so operands can be mapped in one pass.
+	 * Scalar parameters are the call's arguments. Array parameters are copied into their new local variable, unless
+	 * they were passed by reference. */
+	vector<int> valueMap(callee.instructions.size(), -1);
+	for (b = 0; b < callee.blocks.size(); b++) {
+		if (callee.blocks[b].removed) continue;
+		vector<int>& calleeList = callee.blocks[b].instructions;
+		for (i = 0; i < calleeList.size(); i++) {
+			irInstruction& inst = callee.instructions[calleeList[i]];
+			if (inst.op == IR_PARAM) {
+				int param = callee.variables[inst.variable].param;
+				if (param < (int)callInst.operands.size()) valueMap[calleeList[i]] = callInst.operands[param];
+				continue;
+			}
+			caller.instructions.push_back(inst);
+			valueMap[calleeList[i]] = (int)caller.instructions.size() - 1;
+		}
+	}
+	for (size_t v = 0; v < callee.variables.size(); v++) {
+		irVariable& var = callee.variables[v];
+		if ((var.param < 0) || var.ssa || (var.param >= (int)callInst.operands.size())) continue;
+		if (caller.instructions[callInst.operands[var.param]].op == IR_ADDR) continue;
+		irInstruction copy;
+		copy.op = IR_STORE;
+		copy.variable = variableMap[v];
+		copy.block = block;
+		copy.operands.push_back(callInst.operands[var.param]);
+		caller.instructions.push_back(copy);
+		before.push_back((int)caller.instructions.size() - 1);
+	}
+
+	// Map operands, blocks and variables, and turn returns into branches to the exit block
+	vector<int> returnValues;
+	vector<int> returnBlocks;
+	for (b = 0; b < callee.blocks.size(); b++) {
+		if (callee.blocks[b].removed) continue;
+		vector<int>& calleeList = callee.blocks[b].instructions;
+		vector<int>& newList = caller.blocks[blockMap[b]].instructions;
+		for (i = 0; i < calleeList.size(); i++) {
+			if (callee.instructions[calleeList[i]].op == IR_PARAM) continue;
+			int id = valueMap[calleeList[i]];
+			irInstruction& inst = caller.instructions[id];
+			inst.block = blockMap[b];
+			for (o = 0; o < inst.operands.size(); o++) inst.operands[o] = valueMap[inst.operands[o]];
+			for (o = 0; o < inst.phiBlocks.size(); o++) inst.phiBlocks[o] = blockMap[inst.phiBlocks[o]];
+			if (inst.variable >= 0) inst.variable = variableMap[inst.variable];
+			if (inst.target >= 0) inst.target = blockMap[inst.target];
+			if (inst.falseTarget >= 0) inst.falseTarget = blockMap[inst.falseTarget];
+			if (inst.op == IR_RET) {
+				returnValues.push_back(inst.operands.empty() ? -1 : inst.operands[0]);
+				returnBlocks.push_back(blockMap[b]);
+				inst.op = IR_BR;
+				inst.operands.clear();
+				inst.target = exit;
+			}
+			newList.push_back(id);
+		}
+	}
+
+	// The value of the call is the value returned, or undefined if a return had no value
+	int result = -1;
+	if ((callInst.type != 0) && !returnBlocks.empty()) {
+		if ((returnBlocks.size() == 1) && (returnValues[0] >= 0)) result = returnValues[0];
+		else {
+			irInstruction phi;
+			phi.op = IR_PHI;
+			phi.type = callInst.type;
+			phi.block = exit;
+			for (o = 0; o < returnBlocks.size(); o++) {
+				if (returnValues[o] >= 0) phi.operands.push_back(returnValues[o]);
+				else {
+					irInstruction undefined;
+					undefined.op = IR_UNDEF;
+					undefined.type = callInst.type;
+					undefined.block = 0;
+					caller.instructions.push_back(undefined);
+					int id = (int)caller.instructions.size() - 1;
+					caller.blocks[0].instructions.insert(caller.blocks[0].instructions.begin(), id);
+					if (block == 0) before.insert(before.begin(), id);
+					phi.operands.push_back(id);
+				}
+				phi.phiBlocks.push_back(returnBlocks[o]);
+			}
+			caller.instructions.push_back(phi);
+			result = (int)caller.instructions.size() - 1;
+			after.insert(after.begin(), result);
+		}
+	}
+
+	irInstruction enter;
+	enter.op = IR_BR;
+	enter.target = blockMap[0];
+	enter.block = block;
+	caller.instructions.push_back(enter);
+	before.push_back((int)caller.instructions.size() - 1);
+
+	for (i = 0; i < after.size(); i++) caller.instructions[after[i]].block = exit;
+	caller.blocks[block].instructions = before;
+	caller.blocks[exit].instructions = after;
+	if (result >= 0) replaceAllUses(caller, call, result);
+	caller.instructions[call].op = IR_NOP;
+	caller.instructions[call].block = -1;
+	caller.instructions[call].operands.clear();
+	computeCFG(caller);
+}
+
+/* Inline calls to small procedures that aren't recursive. A procedure is inlined if its size is within the budget.
+ * Calls in loops get twice the budget. With a profile, procedures that were never called aren't inlined and
+ * procedures called at least INLINE_HOT_CALLS times get four times the budget.
+ * 'callees' holds the body to inline for each procedure the caller calls, by call label. */
+void inlineCalls(map<string, irFunction*>& callees, irFunction& caller, compilerOptions& options,
+	map<string, long long>& profile, set<string>& recursive, optimizerStats& stats) {
+	if (options.inlineBudget <= 0) return;
+
+	computeCFG(caller);
+	computeDominators(caller);
+	vector<irLoop> loops = findLoops(caller);
+	vector<bool> inLoop(caller.blocks.size(), false);
+	for (size_t l = 0; l < loops.size(); l++) {
+		for (size_t b = 0; b < loops[l].blocks.size(); b++) inLoop[loops[l].blocks[b]] = true;
+	}
+
+	// Find the call sites first, since inlining adds instructions and blocks
+	vector<int> calls;
+	vector<int> budgets;
+	for (size_t i = 0; i < caller.instructions.size(); i++) {
+		irInstruction& inst = caller.instructions[i];
+		if ((inst.op != IR_CALL) || (inst.block < 0)) continue;
+		map<string, irFunction*>::iterator it = callees.find(inst.callee);
+		if ((it == callees.end()) || (inst.callee == caller.label) || recursive.count(inst.callee)) continue;
+
+		int budget = options.inlineBudget;
+		if (inLoop[inst.block]) budget *= 2;
+		if (!profile.empty()) {
+			map<string, long long>::iterator count = profile.find(inst.callee);
+			if ((count == profile.end()) || (count->second == 0)) continue;
+			if (count->second >= INLINE_HOT_CALLS) budget *= 4;
+		}
+		if (functionSize(*it->second) > budget) continue;
+		calls.push_back((int)i);
+	}
+
+	for (size_t c = 0; c < calls.size(); c++) {
+		irInstruction& inst = caller.instructions[calls[c]];
+		inlineCall(caller, *callees[inst.callee], calls[c]);
+		stats.inlinedCalls++;
+	}
+}
@@ -0,0 +1,188 @@
+#include "irPasses.h"
+#include "ir.h"
+#include "tokentypes.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+
+using namespace std;
+
+/* Memo tables sized by the heuristic start with MEMO_BASE_ENTRIES and grow four times for each parameter after the
+ * first, since the number of argument combinations grows with each one. No table is bigger than MEMO_MAX_ENTRIES. */
+#define MEMO_BASE_ENTRIES 1024
+#define MEMO_MAX_ENTRIES 65536
+
+// Types that fit in one word of a memo table key or value
+static bool memoType(int type) {
+	return (type == TYPE_INTEGER) || (type == TYPE_FLOAT) || (type == TYPE_BOOL);
+}
+
+/* Labels of the procedures whose result only depends on their arguments: every parameter is a scalar, no global is
+ * read or written, and every call is to another pure procedure (runtime GET* / PUT* calls are I/O).
+ * Procedures are assumed pure until a call to one that isn't is found, so mutually recursive procedures can be pure. */
+set<string> findPure(irModule& module) {
+	set<string> pure;
+	size_t f, i;
+	for (f = 0; f < module.functions.size(); f++) {
+		irFunction& function = module.functions[f];
+		bool isPure = (function.label != "main") && memoType(function.returnType);
+		for (size_t v = 0; isPure && (v < function.variables.size()); v++) {
+			irVariable& var = function.variables[v];
+			if ((var.param >= 0) && (!var.ssa || !memoType(var.type))) isPure = false;
+		}
+		for (i = 0; isPure && (i < function.instructions.size()); i++) {
+			irInstruction& inst = function.instructions[i];
+			if ((inst.block < 0) || (inst.variable < 0) || (inst.op == IR_CHECK)) continue;
+			if (function.variables[inst.variable].global) isPure = false;
+		}
+		if (isPure) pure.insert(function.label);
+	}
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (f = 0; f < module.functions.size(); f++) {
+			irFunction& function = module.functions[f];
+			if (!pure.count(function.label)) continue;
+			for (i = 0; i < function.instructions.size(); i++) {
+				irInstruction& inst = function.instructions[i];
+				if ((inst.op != IR_CALL) || (inst.block < 0) || pure.count(inst.callee)) continue;
+				pure.erase(function.label);
+				changed = true;
+				break;
+			}
+		}
+	}
+	return pure;
+}
+
+/* Give a pure function a memo table. The entry block looks its arguments up in the table and returns the value found,
+ * otherwise it continues to the original body (moved to a new block), which adds its result before each return.
+ * Parameters removed as dead aren't part of the key, since the result doesn't depend on them.
+ * Returns false if the entry block is the target of a branch, so there is nowhere to put the lookup. */
+static bool memoizeFunction(irFunction& function, int entries) {
+	computeCFG(function);
+	if (!function.blocks[0].preds.empty()) return false;
+	size_t b, i;
+
+	// The parameters stay in the entry block, in parameter order, and everything else moves to the body block
+	vector<int> params;
+	vector<int> entry;
+	vector<int> body;
+	vector<int>& list = function.blocks[0].instructions;
+	for (i = 0; i < list.size(); i++) {
+		int op = function.instructions[list[i]].op;
+		if (op == IR_PARAM) params.push_back(list[i]);
+		else if (op == IR_UNDEF) entry.push_back(list[i]);
+		else body.push_back(list[i]);
+	}
+	for (i = 1; i < params.size(); i++) {
+		for (size_t j = i; j > 0; j--) {
+			int a = function.variables[function.instructions[params[j - 1]].variable].param;
+			int c = function.variables[function.instructions[params[j]].variable].param;
+			if (a <= c) break;
+			swap(params[j - 1], params[j]);
+		}
+	}
+	entry.insert(entry.begin(), params.begin(), params.end());
+
+	// Each original return adds its value to the table first
+	for (b = 0; b < function.blocks.size(); b++) {
+		if (function.blocks[b].removed) continue;
+		vector<int>& blockList = function.blocks[b].instructions;
+		if (blockList.empty()) continue;
+		irInstruction last = function.instructions[blockList.back()];
+		if ((last.op != IR_RET) || last.operands.empty()) continue;
+		irInstruction put;
+		put.op = IR_MEMO_PUT;
+		put.block = (int)b;
+		put.callee = function.label;
+		put.constant.type = TYPE_INTEGER;
+		put.constant.intValue = entries;
+		put.operands = params;
+		put.operands.push_back(last.operands[0]);
+		function.instructions.push_back(put);
+		if (b == 0) body.insert(body.end() - 1, (int)function.instructions.size() - 1);
+		else blockList.insert(blockList.end() - 1, (int)function.instructions.size() - 1);
+	}
+
+	int bodyBlock = (int)function.blocks.size();
+	int hitBlock = bodyBlock + 1;
+	function.blocks.push_back(irBlock());
+	function.blocks.push_back(irBlock());
+	for (i = 0; i < body.size(); i++) function.instructions[body[i]].block = bodyBlock;
+	function.blocks[bodyBlock].instructions = body;
+
+	// Phis in the entry block's old successors now come from the body block
+	for (i = 0; i < function.instructions.size(); i++) {
+		irInstruction& inst = function.instructions[i];
+		if ((inst.op != IR_PHI) || (inst.block < 0)) continue;
+		for (size_t o = 0; o < inst.phiBlocks.size(); o++) {
+			if (inst.phiBlocks[o] == 0) inst.phiBlocks[o] = bodyBlock;
+		}
+	}
+
+	irInstruction lookup;
+	lookup.callee = function.label;
+	lookup.constant.type = TYPE_INTEGER;
+	lookup.constant.intValue = entries;
+	lookup.operands = params;
+
+	irInstruction find = lookup;
+	find.op = IR_MEMO_FIND;
+	find.type = TYPE_BOOL;
+	find.block = 0;
+	function.instructions.push_back(find);
+	int found = (int)function.instructions.size() - 1;
+	entry.push_back(found);
+
+	irInstruction branch;
+	branch.op = IR_CONDBR;
+	branch.block = 0;
+	branch.operands.push_back(found);
+	branch.target = hitBlock;
+	branch.falseTarget = bodyBlock;
+	function.instructions.push_back(branch);
+	entry.push_back((int)function.instructions.size() - 1);
+	function.blocks[0].instructions = entry;
+
+	irInstruction get = lookup;
+	get.op = IR_MEMO_GET;
+	get.type = function.returnType;
+	get.block = hitBlock;
+	function.instructions.push_back(get);
+	int value = (int)function.instructions.size() - 1;
+	irInstruction ret;
+	ret.op = IR_RET;
+	ret.block = hitBlock;
+	ret.operands.push_back(value);
+	function.instructions.push_back(ret);
+	function.blocks[hitBlock].instructions.push_back(value);
+	function.blocks[hitBlock].instructions.push_back((int)function.instructions.size() - 1);
+
+	computeCFG(function);
+	return true;
+}
+
+/* Memoize the pure procedures that are recursive, whose repeated calls with the same arguments the table saves.
+ * The table size comes from the procedure's //#memo pragma, or the heuristic above if it doesn't have one. */
+void memoizeFunctions(irModule& module, optimizerStats& stats) {
+	set<string> recursive = findRecursive(module);
+	set<string> pure = findPure(module);
+	for (size_t f = 0; f < module.functions.size(); f++) {
+		irFunction& function = module.functions[f];
+		if (!recursive.count(function.label) || !pure.count(function.label) || (function.memoSize == 0)) continue;
+
+		int entries = function.memoSize;
+		if (entries < 0) {
+			entries = MEMO_BASE_ENTRIES;
+			for (size_t v = 0; v < function.variables.size(); v++) {
+				if ((function.variables[v].param > 0) && (entries < MEMO_MAX_ENTRIES)) entries *= 4;
+			}
+		}
+		entries = min(entries, MEMO_MAX_ENTRIES);
+		if (memoizeFunction(function, entries)) stats.memoizedFunctions++;
+	}
+}
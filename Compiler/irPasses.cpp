@@ -0,0 +1,857 @@
+#include "irPasses.h"
+#include "ir.h"
+#include "tokentypes.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+// Replace a phi that has one distinct operand by that operand. Returns true if it was removed.
+static bool removeTrivialPhi(irFunction& function, int phi) {
+	irInstruction& inst = function.instructions[phi];
+	int same = -1;
+	for (size_t o = 0; o < inst.operands.size(); o++) {
+		if ((inst.operands[o] == same) || (inst.operands[o] == phi)) continue;
+		if (same != -1) return false;
+		same = inst.operands[o];
+	}
+	if (same == -1) return false;
+	replaceAllUses(function, phi, same);
+	removeInstruction(function, phi);
+	return true;
+}
+
+/* Turn branches on constant conditions into unconditional branches, delete blocks that can't be reached
+ * from the entry block, then delete every instruction whose value is never used by an instruction with side effects. */
+void eliminateDeadCode(irFunction& function, optimizerStats& stats) {
+	size_t i;
+	bool changedCFG = false;
+	for (size_t b = 0; b < function.blocks.size(); b++) {
+		irBlock& block = function.blocks[b];
+		if (block.removed || block.instructions.empty()) continue;
+		irInstruction& last = function.instructions[block.instructions.back()];
+		if ((last.op != IR_CONDBR) || (function.instructions[last.operands[0]].op != IR_CONST)) continue;
+		if (!function.instructions[last.operands[0]].constant.boolValue) last.target = last.falseTarget;
+		last.op = IR_BR;
+		last.falseTarget = -1;
+		last.operands.clear();
+		changedCFG = true;
+		stats.foldedBranches++;
+	}
+
+	computeCFG(function);
+	vector<int> order = reversePostOrder(function);
+	vector<bool> reachable(function.blocks.size(), false);
+	for (i = 0; i < order.size(); i++) reachable[order[i]] = true;
+
+	for (size_t b = 0; b < function.blocks.size(); b++) {
+		irBlock& block = function.blocks[b];
+		if (reachable[b] || block.removed) continue;
+		vector<int> list = block.instructions;
+		for (i = 0; i < list.size(); i++) removeInstruction(function, list[i]);
+		block.removed = true;
+		changedCFG = true;
+		stats.removedBlocks++;
+	}
+
+	// Phis lose the operands that came from blocks that are no longer predecessors
+	if (changedCFG) {
+		computeCFG(function);
+		for (i = 0; i < function.instructions.size(); i++) {
+			irInstruction& inst = function.instructions[i];
+			if (inst.op != IR_PHI) continue;
+			vector<int>& preds = function.blocks[inst.block].preds;
+			for (size_t o = inst.operands.size(); o > 0; o--) {
+				if (find(preds.begin(), preds.end(), inst.phiBlocks[o - 1]) == preds.end()) {
+					inst.operands.erase(inst.operands.begin() + (o - 1));
+					inst.phiBlocks.erase(inst.phiBlocks.begin() + (o - 1));
+				}
+			}
+		}
+		for (i = 0; i < function.instructions.size(); i++) {
+			if (function.instructions[i].op == IR_PHI) removeTrivialPhi(function, (int)i);
+		}
+	}
+
+	// Mark everything needed by an instruction with side effects
+	vector<bool> live(function.instructions.size(), false);
+	vector<int> work;
+	for (i = 0; i < function.instructions.size(); i++) {
+		irInstruction& inst = function.instructions[i];
+		if ((inst.block >= 0) && hasSideEffects(inst.op)) {
+			live[i] = true;
+			work.push_back((int)i);
+		}
+	}
+	while (!work.empty()) {
+		int id = work.back();
+		work.pop_back();
+		vector<int>& operands = function.instructions[id].operands;
+		for (size_t o = 0; o < operands.size(); o++) {
+			if ((operands[o] >= 0) && !live[operands[o]]) {
+				live[operands[o]] = true;
+				work.push_back(operands[o]);
+			}
+		}
+	}
+
+	// Sweep
+	for (i = 0; i < function.instructions.size(); i++) {
+		irInstruction& inst = function.instructions[i];
+		if ((inst.block >= 0) && !live[i]) {
+			removeInstruction(function, (int)i);
+			stats.removedInstructions++;
+		}
+	}
+}
+
+/* Merge each block that ends with a branch into its successor when it is the successor's only predecessor.
+ * Inlining and if statements without an else leave chains of such blocks behind. */
+void mergeBlocks(irFunction& function, optimizerStats& stats) {
+	computeCFG(function);
+	for (size_t b = 0; b < function.blocks.size(); b++) {
+		irBlock& block = function.blocks[b];
+		while (!block.removed && !block.instructions.empty()) {
+			irInstruction& last = function.instructions[block.instructions.back()];
+			if (last.op != IR_BR) break;
+			int next = last.target;
+			if ((next == (int)b) || (next == 0) || (function.blocks[next].preds.size() != 1)) break;
+
+			// Phis in the merged block have one operand
+			vector<int> moved = function.blocks[next].instructions;
+			removeInstruction(function, block.instructions.back());
+			for (size_t i = 0; i < moved.size(); i++) {
+				irInstruction& inst = function.instructions[moved[i]];
+				if (inst.op == IR_PHI) {
+					int value = inst.operands[0];
+					removeInstruction(function, moved[i]);
+					replaceAllUses(function, moved[i], value);
+					continue;
+				}
+				inst.block = (int)b;
+				block.instructions.push_back(moved[i]);
+			}
+			for (size_t i = 0; i < function.instructions.size(); i++) {
+				irInstruction& inst = function.instructions[i];
+				if (inst.op != IR_PHI) continue;
+				for (size_t o = 0; o < inst.phiBlocks.size(); o++) {
+					if (inst.phiBlocks[o] == next) inst.phiBlocks[o] = (int)b;
+				}
+			}
+			function.blocks[next].instructions.clear();
+			function.blocks[next].removed = true;
+			computeCFG(function);
+			stats.mergedBlocks++;
+		}
+	}
+}
+
+// Operators whose operands can be swapped without changing the value
+static bool isCommutative(int op) {
+	switch (op) {
+	case IR_ADD: case IR_MUL: case IR_AND: case IR_OR: case IR_EQ: case IR_NE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Follow the chain of values that replaced a value
+static int resolveValue(vector<int>& replacement, int value) {
+	while ((value >= 0) && (replacement[value] != -1)) value = replacement[value];
+	return value;
+}
+
+/* Build the key that identifies the value an instruction computes, or "" if it can't be numbered.
+ * Loads are keyed with the block and the number of stores / calls seen in it so far, so a load is only
+ * merged with an earlier load in the same block when memory can't have changed in between. */
+static string valueKey(irInstruction& inst, int memoryBlock, int memoryGeneration) {
+	string key;
+	switch (inst.op) {
+	case IR_CONST: case IR_CONVERT: case IR_NOT: case IR_NEG: case IR_PHI: case IR_SPLAT:
+		break;
+	case IR_LOAD: case IR_LOAD_ELEM:
+		key = "m" + to_string(memoryBlock) + "." + to_string(memoryGeneration) + ":";
+		break;
+	default:
+		if (!isBinaryOp(inst.op)) return "";
+	}
+	key += to_string(inst.op) + ":" + to_string(inst.type) + ":" + to_string(inst.size) + "x" + to_string(inst.lanes) + ":" + to_string(inst.variable);
+	if (inst.op == IR_CONST) {
+		switch (inst.constant.type) {
+		case TYPE_INTEGER: key += ":" + to_string(inst.constant.intValue); break;
+		case TYPE_FLOAT: key += ":" + to_string(inst.constant.floatValue); break;
+		case TYPE_BOOL: key += inst.constant.boolValue ? ":t" : ":f"; break;
+		default: key += ":\"" + inst.constant.stringValue; break;
+		}
+		return key;
+	}
+	vector<int> operands = inst.operands;
+	if (isCommutative(inst.op) && (operands.size() == 2) && (operands[0] > operands[1])) swap(operands[0], operands[1]);
+	for (size_t o = 0; o < operands.size(); o++) {
+		key += ":" + to_string(operands[o]);
+		if (inst.op == IR_PHI) key += "@" + to_string(inst.phiBlocks[o]);
+	}
+	if (inst.op == IR_PHI) key += ":b" + to_string(inst.block);
+	return key;
+}
+
+/* Global value numbering over the dominator tree. Each value is looked up in a table of the values
+ * computed in the blocks that dominate it, and replaced if an equal value is found. */
+void numberValues(irFunction& function, optimizerStats& stats) {
+	computeCFG(function);
+	computeDominators(function);
+	vector<int> order = reversePostOrder(function);
+	if (order.empty()) return;
+
+	vector< vector<int> > children(function.blocks.size());
+	size_t i;
+	for (i = 1; i < order.size(); i++) children[function.blocks[order[i]].idom].push_back(order[i]);
+
+	vector<int> replacement(function.instructions.size(), -1);
+	map<string, int> table;
+
+	// Depth first walk of the dominator tree. Each stack entry remembers the keys its block added to the table.
+	vector< pair<int, vector<string> > > stack;
+	vector<size_t> nextChild;
+	stack.push_back(make_pair(0, vector<string>()));
+	nextChild.push_back(0);
+	bool entered = false;
+	while (!stack.empty()) {
+		int b = stack.back().first;
+		if (!entered) {
+			int generation = 0;
+			vector<int> list = function.blocks[b].instructions;
+			for (i = 0; i < list.size(); i++) {
+				irInstruction& inst = function.instructions[list[i]];
+				for (size_t o = 0; o < inst.operands.size(); o++) inst.operands[o] = resolveValue(replacement, inst.operands[o]);
+				if ((inst.op == IR_STORE) || (inst.op == IR_STORE_ELEM) || (inst.op == IR_CALL)) generation++;
+
+				string key = valueKey(inst, b, generation);
+				if (key == "") continue;
+				map<string, int>::iterator it = table.find(key);
+				if (it != table.end()) {
+					replacement[list[i]] = it->second;
+					removeInstruction(function, list[i]);
+					stats.numberedValues++;
+				}
+				else {
+					table[key] = list[i];
+					stack.back().second.push_back(key);
+				}
+			}
+		}
+		if (nextChild.back() < children[b].size()) {
+			int child = children[b][nextChild.back()++];
+			stack.push_back(make_pair(child, vector<string>()));
+			nextChild.push_back(0);
+			entered = false;
+		}
+		else {
+			vector<string>& keys = stack.back().second;
+			for (i = 0; i < keys.size(); i++) table.erase(keys[i]);
+			stack.pop_back();
+			nextChild.pop_back();
+			entered = true;
+		}
+	}
+
+	// Phi operands coming around back edges were visited before the values they refer to were replaced
+	for (i = 0; i < function.instructions.size(); i++) {
+		irInstruction& inst = function.instructions[i];
+		for (size_t o = 0; o < inst.operands.size(); o++) inst.operands[o] = resolveValue(replacement, inst.operands[o]);
+	}
+}
+
+// Globals and reference parameters may be the same memory, and calls may change either
+static bool sharedMemory(irVariable& var) {
+	return var.global || var.reference;
+}
+
+// True if evaluating the instruction before the loop is safe and gives the same value as every iteration
+static bool isInvariant(irFunction& function, irLoop& loop, irInstruction& inst, vector<bool>& storedInLoop, bool callInLoop) {
+	switch (inst.op) {
+	case IR_CONST: case IR_CONVERT: case IR_NOT: case IR_NEG: case IR_SPLAT:
+		break;
+	case IR_LOAD:
+		if (storedInLoop[inst.variable] || (callInLoop && sharedMemory(function.variables[inst.variable]))) return false;
+		break;
+	case IR_LOAD_ELEM: {
+		if (storedInLoop[inst.variable] || (callInLoop && sharedMemory(function.variables[inst.variable]))) return false;
+		// The loop may run zero times, so only loads known to be in bounds are moved ahead of it
+		irInstruction& index = function.instructions[inst.operands[0]];
+		if ((index.op != IR_CONST) || (index.constant.intValue < 0) || (index.constant.intValue >= function.variables[inst.variable].size)) return false;
+		break;
+	}
+	case IR_DIV: {
+		// Integer division by zero traps, so only divisions by a non-zero constant are moved
+		irInstruction& divisor = function.instructions[inst.operands[1]];
+		if (inst.type == TYPE_INTEGER) {
+			if ((divisor.op != IR_CONST) || (divisor.constant.intValue == 0)) return false;
+		}
+		break;
+	}
+	default:
+		if (!isBinaryOp(inst.op)) return false;
+	}
+	for (size_t o = 0; o < inst.operands.size(); o++) {
+		int def = function.instructions[inst.operands[o]].block;
+		if ((def >= 0) && loop.inLoop[def]) return false;
+	}
+	return true;
+}
+
+/* Loop invariant code motion. Instructions in a loop whose operands are all defined outside of it
+ * are moved to the end of the loop's preheader. Inner loops are done first so their invariants can
+ * move out of the enclosing loops as well. */
+void hoistLoopInvariants(irFunction& function, optimizerStats& stats) {
+	computeCFG(function);
+	computeDominators(function);
+	vector<irLoop> loops = findLoops(function);
+	vector<int> order = reversePostOrder(function);
+
+	for (size_t l = 0; l < loops.size(); l++) {
+		irLoop& loop = loops[l];
+		if (loop.preheader < 0) continue;
+
+		/* Find what memory the loop can change. A store to shared memory may change all of it, and a call may change
+		 * the variables whose address it is passed. */
+		vector<bool> storedInLoop(function.variables.size(), false);
+		bool callInLoop = false;
+		bool sharedStore = false;
+		size_t b, i;
+		for (b = 0; b < loop.blocks.size(); b++) {
+			vector<int>& list = function.blocks[loop.blocks[b]].instructions;
+			for (i = 0; i < list.size(); i++) {
+				irInstruction& inst = function.instructions[list[i]];
+				if ((inst.op == IR_STORE) || (inst.op == IR_STORE_ELEM)) {
+					storedInLoop[inst.variable] = true;
+					if (sharedMemory(function.variables[inst.variable])) sharedStore = true;
+				}
+				if (inst.op == IR_CALL) {
+					callInLoop = true;
+					for (size_t o = 0; o < inst.operands.size(); o++) {
+						irInstruction& arg = function.instructions[inst.operands[o]];
+						if (arg.op == IR_ADDR) storedInLoop[arg.variable] = true;
+					}
+				}
+			}
+		}
+		for (size_t v = 0; sharedStore && (v < function.variables.size()); v++) {
+			if (sharedMemory(function.variables[v])) storedInLoop[v] = true;
+		}
+
+		// Visit the loop's blocks in program order until nothing else can be moved
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (b = 0; b < order.size(); b++) {
+				if (!loop.inLoop[order[b]]) continue;
+				vector<int> list = function.blocks[order[b]].instructions;
+				for (i = 0; i < list.size(); i++) {
+					irInstruction& inst = function.instructions[list[i]];
+					if (!isInvariant(function, loop, inst, storedInLoop, callInLoop)) continue;
+
+					vector<int>& from = function.blocks[inst.block].instructions;
+					from.erase(remove(from.begin(), from.end(), list[i]), from.end());
+					vector<int>& to = function.blocks[loop.preheader].instructions;
+					to.insert(to.end() - 1, list[i]);
+					inst.block = loop.preheader;
+					stats.hoistedInstructions++;
+					changed = true;
+				}
+			}
+		}
+	}
+}
+
+// Number of elements of a type that fit in one vector register, or 0 if the type isn't vectorized
+static int vectorLanes(int type) {
+	switch (type) {
+	case TYPE_INTEGER: case TYPE_BOOL: return IR_VECTOR_BITS / 32;
+	case TYPE_FLOAT: return IR_VECTOR_BITS / 64;
+	default: return 0;
+	}
+}
+
+/* True if the whole array value can be computed one element at a time where it is stored.
+ * Every array load in the expression has to be in the store's block with no store or call after it,
+ * so reading the elements inside the loop gives the same values. */
+static bool canLowerArray(irFunction& function, int value, int size, int storeBlock, int storePosition) {
+	irInstruction& inst = function.instructions[value];
+	if (inst.size == 0) return true;
+	if ((inst.size != size) || (vectorLanes(inst.type) == 0)) return false;
+	switch (inst.op) {
+	case IR_LOAD: {
+		if (inst.block != storeBlock) return false;
+		vector<int>& list = function.blocks[storeBlock].instructions;
+		size_t p = find(list.begin(), list.end(), value) - list.begin();
+		for (p++; (int)p < storePosition; p++) {
+			int op = function.instructions[list[p]].op;
+			if ((op == IR_STORE) || (op == IR_STORE_ELEM) || (op == IR_CALL)) return false;
+		}
+		return true;
+	}
+	case IR_CONVERT: case IR_NOT: case IR_NEG:
+		break;
+	default:
+		if (!isBinaryOp(inst.op)) return false;
+	}
+	for (size_t o = 0; o < inst.operands.size(); o++) {
+		if (!canLowerArray(function, inst.operands[o], size, storeBlock, storePosition)) return false;
+	}
+	return true;
+}
+
+// Lanes used for a whole array expression. Every array value in it must fit in the same number of lanes.
+static int expressionLanes(irFunction& function, int value) {
+	irInstruction& inst = function.instructions[value];
+	if (inst.size == 0) return IR_VECTOR_BITS;
+	int lanes = vectorLanes(inst.type);
+	for (size_t o = 0; o < inst.operands.size(); o++) lanes = min(lanes, expressionLanes(function, inst.operands[o]));
+	return lanes;
+}
+
+// Add an instruction to the end of a list of new instructions for a block
+static int emit(irFunction& function, irInstruction& inst, int block, vector<int>& list) {
+	inst.block = block;
+	function.instructions.push_back(inst);
+	int id = (int)function.instructions.size() - 1;
+	list.push_back(id);
+	return id;
+}
+
+/* Emit the instructions computing 'lanes' elements of a whole array value starting at 'index'.
+ * Scalars are used as they are for one lane, and copied to every lane with IR_SPLAT (placed in 'setup') otherwise.
+ * 'done' maps the array values already emitted, so values used more than once are only computed once. */
+static int lowerElements(irFunction& function, int value, int lanes, int index, int block, vector<int>& list,
+	int setupBlock, vector<int>& setup, map<int, int>& done) {
+	map<int, int>::iterator it = done.find(value);
+	if (it != done.end()) return it->second;
+
+	irInstruction source = function.instructions[value];
+	irInstruction inst;
+	inst.type = source.type;
+	inst.lanes = lanes;
+	int id;
+	if (source.size == 0) {
+		if (lanes == 1) return value;
+		inst.op = IR_SPLAT;
+		inst.operands.push_back(value);
+		id = emit(function, inst, setupBlock, setup);
+	}
+	else if (source.op == IR_LOAD) {
+		inst.op = IR_LOAD_ELEM;
+		inst.variable = source.variable;
+		inst.operands.push_back(index);
+		id = emit(function, inst, block, list);
+	}
+	else {
+		inst.op = source.op;
+		for (size_t o = 0; o < source.operands.size(); o++) {
+			inst.operands.push_back(lowerElements(function, source.operands[o], lanes, index, block, list, setupBlock, setup, done));
+		}
+		id = emit(function, inst, block, list);
+	}
+	done[value] = id;
+	return id;
+}
+
+static int emitConstant(irFunction& function, int value, int block, vector<int>& list) {
+	irInstruction inst;
+	inst.op = IR_CONST;
+	inst.type = TYPE_INTEGER;
+	inst.constant = constInteger(value);
+	return emit(function, inst, block, list);
+}
+
+/* Replace the whole array store at 'position' in 'block' by a fused loop that computes and stores one
+ * vector of elements per iteration, followed by scalar code for the elements left over.
+ * No temporary arrays are needed since every element only depends on the same element of its operands.
+ * Returns true if a loop was created, in which case the rest of the block was moved to the loop's exit block. */
+static bool lowerArrayStore(irFunction& function, int block, int position) {
+	int storeId = function.blocks[block].instructions[position];
+	irInstruction store = function.instructions[storeId];
+	irVariable& var = function.variables[store.variable];
+	int lanes = min(vectorLanes(var.type), expressionLanes(function, store.operands[0]));
+	int vectorEnd = var.size - (var.size % lanes);
+
+	vector<int> before(function.blocks[block].instructions.begin(), function.blocks[block].instructions.begin() + position);
+	vector<int> after(function.blocks[block].instructions.begin() + position + 1, function.blocks[block].instructions.end());
+	function.instructions[storeId].op = IR_NOP;
+	function.instructions[storeId].block = -1;
+	function.instructions[storeId].operands.clear();
+
+	int tailBlock = block;
+	vector<int> tail;
+	if (vectorEnd > 0) {
+		/* block:  ...  br header
+		 * header: i = phi [0, block], [next, body]  condbr i < vectorEnd, body, exit
+		 * body:   vector loads, operators, and store at i  next = i + lanes  br header
+		 * exit:   scalar tail, then the rest of the original block */
+		int header = (int)function.blocks.size();
+		int body = header + 1;
+		int exit = header + 2;
+		function.blocks.resize(function.blocks.size() + 3);
+
+		// Phis in the old successors now come from the exit block
+		for (size_t i = 0; i < function.instructions.size(); i++) {
+			irInstruction& inst = function.instructions[i];
+			if (inst.op != IR_PHI) continue;
+			for (size_t o = 0; o < inst.phiBlocks.size(); o++) {
+				if (inst.phiBlocks[o] == block) inst.phiBlocks[o] = exit;
+			}
+		}
+		for (size_t i = 0; i < after.size(); i++) function.instructions[after[i]].block = exit;
+
+		int zero = emitConstant(function, 0, block, before);
+		vector<int> headerList, bodyList;
+		irInstruction phi;
+		phi.op = IR_PHI;
+		phi.type = TYPE_INTEGER;
+		int index = emit(function, phi, header, headerList);
+		int limit = emitConstant(function, vectorEnd, header, headerList);
+		irInstruction compare;
+		compare.op = IR_LT;
+		compare.type = TYPE_BOOL;
+		compare.operands.push_back(index);
+		compare.operands.push_back(limit);
+		int condition = emit(function, compare, header, headerList);
+		irInstruction branch;
+		branch.op = IR_CONDBR;
+		branch.target = body;
+		branch.falseTarget = exit;
+		branch.operands.push_back(condition);
+		emit(function, branch, header, headerList);
+
+		map<int, int> done;
+		irInstruction vectorStore;
+		vectorStore.op = IR_STORE_ELEM;
+		vectorStore.variable = store.variable;
+		vectorStore.lanes = lanes;
+		vectorStore.operands.push_back(index);
+		vectorStore.operands.push_back(lowerElements(function, store.operands[0], lanes, index, body, bodyList, block, before, done));
+		emit(function, vectorStore, body, bodyList);
+		int step = emitConstant(function, lanes, body, bodyList);
+		irInstruction add;
+		add.op = IR_ADD;
+		add.type = TYPE_INTEGER;
+		add.operands.push_back(index);
+		add.operands.push_back(step);
+		int next = emit(function, add, body, bodyList);
+		irInstruction back;
+		back.op = IR_BR;
+		back.target = header;
+		emit(function, back, body, bodyList);
+
+		function.instructions[index].operands.push_back(zero);
+		function.instructions[index].phiBlocks.push_back(block);
+		function.instructions[index].operands.push_back(next);
+		function.instructions[index].phiBlocks.push_back(body);
+
+		irInstruction enter;
+		enter.op = IR_BR;
+		enter.target = header;
+		emit(function, enter, block, before);
+
+		function.blocks[block].instructions = before;
+		function.blocks[header].instructions = headerList;
+		function.blocks[body].instructions = bodyList;
+		tailBlock = exit;
+	}
+
+	// Elements that don't fill a whole vector
+	for (int e = vectorEnd; e < var.size; e++) {
+		map<int, int> done;
+		int index = emitConstant(function, e, tailBlock, tail);
+		irInstruction element;
+		element.op = IR_STORE_ELEM;
+		element.variable = store.variable;
+		element.operands.push_back(index);
+		element.operands.push_back(lowerElements(function, store.operands[0], 1, index, tailBlock, tail, tailBlock, tail, done));
+		emit(function, element, tailBlock, tail);
+	}
+
+	vector<int>& list = function.blocks[tailBlock].instructions;
+	if (tailBlock == block) {
+		list = before;
+		list.insert(list.end(), tail.begin(), tail.end());
+	}
+	else list = tail;
+	list.insert(list.end(), after.begin(), after.end());
+	return vectorEnd > 0;
+}
+
+/* Lower stores of whole array expressions (like a := b + c * 2) to vectorized loops.
+ * Stores that can't be done one element at a time are left as whole array operations. */
+void lowerArrayOperations(irFunction& function, optimizerStats& stats) {
+	size_t blockCount = function.blocks.size();
+	for (size_t b = 0; b < blockCount; b++) {
+		if (function.blocks[b].removed) continue;
+		// Lowering moves the rest of the block to a new block, which is visited later
+		int current = (int)b;
+		bool lowered = true;
+		while (lowered) {
+			lowered = false;
+			vector<int>& list = function.blocks[current].instructions;
+			for (size_t p = 0; p < list.size(); p++) {
+				irInstruction& inst = function.instructions[list[p]];
+				if (inst.op != IR_STORE) continue;
+				irVariable& var = function.variables[inst.variable];
+				if ((var.size == 0) || (vectorLanes(var.type) == 0)) continue;
+				if (!canLowerArray(function, inst.operands[0], var.size, current, (int)p)) continue;
+
+				stats.loweredArrayStores++;
+				if (lowerArrayStore(function, current, (int)p)) {
+					stats.vectorLoops++;
+					current = (int)function.blocks.size() - 1;
+				}
+				lowered = true;
+				break;
+			}
+		}
+	}
+	computeCFG(function);
+}
+
+// Closed range of values an integer can have. LLONG_MIN / LLONG_MAX mean there is no bound on that side.
+struct valueRange {
+	long long low = LLONG_MIN;
+	long long high = LLONG_MAX;
+};
+
+static long long addBound(long long bound, long long amount) {
+	if ((bound == LLONG_MIN) || (bound == LLONG_MAX)) return bound;
+	return bound + amount;
+}
+
+static valueRange intersect(valueRange a, valueRange b) {
+	a.low = max(a.low, b.low);
+	a.high = min(a.high, b.high);
+	return a;
+}
+
+// Constant integer operand of an instruction, if the operand is a constant
+static bool constantOperand(irFunction& function, int value, long long& constant) {
+	irInstruction& inst = function.instructions[value];
+	if ((inst.op != IR_CONST) || (inst.constant.type != TYPE_INTEGER)) return false;
+	constant = inst.constant.intValue;
+	return true;
+}
+
+/* Range analysis used to remove bounds checks. Ranges of values are computed from their definitions,
+ * then narrowed at each block by the loop and if conditions that must have been true to reach it. */
+class rangeAnalysis
+{
+private:
+	irFunction& function;
+	map<int, valueRange> ranges;
+	set<int> visiting;
+public:
+	rangeAnalysis(irFunction& function_input) : function(function_input) {}
+
+	// Range of a value anywhere it is used
+	valueRange rangeOf(int value) {
+		map<int, valueRange>::iterator it = ranges.find(value);
+		if (it != ranges.end()) return it->second;
+		valueRange range;
+		if (visiting.count(value)) return range;
+		visiting.insert(value);
+
+		irInstruction& inst = function.instructions[value];
+		long long constant;
+		switch (inst.op) {
+		case IR_CONST:
+			if (inst.type == TYPE_INTEGER) range.low = range.high = inst.constant.intValue;
+			else if (inst.type == TYPE_BOOL) range.low = range.high = inst.constant.boolValue ? 1 : 0;
+			break;
+		case IR_CONVERT:
+			if (function.instructions[inst.operands[0]].type == TYPE_BOOL) {
+				range.low = 0;
+				range.high = 1;
+			}
+			break;
+		case IR_ADD: case IR_SUB:
+			if (constantOperand(function, inst.operands[1], constant)) {
+				if (inst.op == IR_SUB) constant = -constant;
+				range = rangeOf(inst.operands[0]);
+				range.low = addBound(range.low, constant);
+				range.high = addBound(range.high, constant);
+			}
+			else if ((inst.op == IR_ADD) && constantOperand(function, inst.operands[0], constant)) {
+				range = rangeOf(inst.operands[1]);
+				range.low = addBound(range.low, constant);
+				range.high = addBound(range.high, constant);
+			}
+			break;
+		case IR_PHI:
+			range = phiRange(value);
+			break;
+		default:
+			break;
+		}
+
+		visiting.erase(value);
+		ranges[value] = range;
+		return range;
+	}
+
+	/* A phi that only ever steps by a constant from its own value (a for loop's induction variable) is bounded
+	 * on one side by its starting values. Other phis have the union of their operands' ranges.
+	 * The step is taken in the loop body, after the loop condition has bounded the other side, so it can't overflow
+	 * as long as the condition compares against an array size. */
+	valueRange phiRange(int phi) {
+		irInstruction& inst = function.instructions[phi];
+		valueRange start;
+		bool haveStart = false;
+		bool increasing = true;
+		bool decreasing = true;
+		bool stepping = false;
+		for (size_t o = 0; o < inst.operands.size(); o++) {
+			irInstruction& operand = function.instructions[inst.operands[o]];
+			long long step;
+			if (((operand.op == IR_ADD) || (operand.op == IR_SUB)) && (operand.operands[0] == phi) &&
+				constantOperand(function, operand.operands[1], step)) {
+				if (operand.op == IR_SUB) step = -step;
+				if (step < 0) increasing = false;
+				if (step > 0) decreasing = false;
+				stepping = true;
+				continue;
+			}
+			valueRange range = rangeOf(inst.operands[o]);
+			if (!haveStart) start = range;
+			else {
+				start.low = min(start.low, range.low);
+				start.high = max(start.high, range.high);
+			}
+			haveStart = true;
+		}
+		if (!haveStart) return valueRange();
+		if (stepping && increasing) start.high = LLONG_MAX;
+		else if (stepping && decreasing) start.low = LLONG_MIN;
+		else if (stepping) return valueRange();
+		return start;
+	}
+
+	// Narrow the range of a value by one condition known to be true (or false if 'holds' is false)
+	valueRange applyCondition(int value, int condition, bool holds, valueRange range) {
+		irInstruction& cond = function.instructions[condition];
+		if ((cond.op < IR_LT) || (cond.op > IR_GE)) return range;
+		int op = cond.op;
+		int left = cond.operands[0];
+		int right = cond.operands[1];
+		// Rewrite as 'value op other'
+		if (right == value) {
+			swap(left, right);
+			if (op == IR_LT) op = IR_GT;
+			else if (op == IR_LE) op = IR_GE;
+			else if (op == IR_GT) op = IR_LT;
+			else op = IR_LE;
+		}
+		if (left != value) return range;
+		if (!holds) {
+			if (op == IR_LT) op = IR_GE;
+			else if (op == IR_LE) op = IR_GT;
+			else if (op == IR_GT) op = IR_LE;
+			else op = IR_LT;
+		}
+		valueRange other = rangeOf(right);
+		if ((op == IR_LT) && (other.high != LLONG_MAX)) range.high = min(range.high, other.high - 1);
+		else if ((op == IR_LE) && (other.high != LLONG_MAX)) range.high = min(range.high, other.high);
+		else if ((op == IR_GT) && (other.low != LLONG_MIN)) range.low = max(range.low, other.low + 1);
+		else if ((op == IR_GE) && (other.low != LLONG_MIN)) range.low = max(range.low, other.low);
+		return range;
+	}
+
+	/* Range of a value where it is used in a block. Each branch on the path down the dominator tree whose
+	 * successor can only be entered from that branch tells which way its condition went. */
+	valueRange rangeAt(int value, int block) {
+		irInstruction& inst = function.instructions[value];
+		long long constant;
+		if (((inst.op == IR_ADD) || (inst.op == IR_SUB)) && constantOperand(function, inst.operands[1], constant)) {
+			if (inst.op == IR_SUB) constant = -constant;
+			valueRange range = rangeAt(inst.operands[0], block);
+			range.low = addBound(range.low, constant);
+			range.high = addBound(range.high, constant);
+			return intersect(range, rangeOf(value));
+		}
+
+		valueRange range = rangeOf(value);
+		for (int child = block; function.blocks[child].idom != -1; child = function.blocks[child].idom) {
+			int parent = function.blocks[child].idom;
+			if ((function.blocks[child].preds.size() != 1) || (function.blocks[child].preds[0] != parent)) continue;
+			irInstruction& branch = function.instructions[function.blocks[parent].instructions.back()];
+			if ((branch.op != IR_CONDBR) || (branch.target == branch.falseTarget)) continue;
+			range = applyCondition(value, branch.operands[0], branch.target == child, range);
+		}
+		return range;
+	}
+};
+
+/* Remove the bounds checks that range analysis proves can't fail, and the checks repeated by an earlier
+ * check that dominates them. Checks of loop invariant indices at the start of a loop header are moved into
+ * the preheader, since the header always runs right after it. */
+void eliminateBoundsChecks(irFunction& function, optimizerStats& stats) {
+	computeCFG(function);
+	computeDominators(function);
+	rangeAnalysis analysis(function);
+	vector<int> order = reversePostOrder(function);
+
+	// Earlier checks of each index value as (block, size) pairs
+	map<int, vector< pair<int, int> > > checked;
+	for (size_t b = 0; b < order.size(); b++) {
+		vector<int> list = function.blocks[order[b]].instructions;
+		for (size_t i = 0; i < list.size(); i++) {
+			irInstruction& inst = function.instructions[list[i]];
+			if (inst.op != IR_CHECK) continue;
+			int index = inst.operands[0];
+
+			valueRange range = analysis.rangeAt(index, order[b]);
+			bool redundant = (range.low >= 0) && (range.high < inst.size);
+			vector< pair<int, int> >& earlier = checked[index];
+			for (size_t e = 0; (e < earlier.size()) && !redundant; e++) {
+				if ((earlier[e].second <= inst.size) && dominates(function, earlier[e].first, order[b])) redundant = true;
+			}
+			if (redundant) {
+				removeInstruction(function, list[i]);
+				stats.removedChecks++;
+			}
+			else earlier.push_back(make_pair(order[b], inst.size));
+		}
+	}
+
+	vector<irLoop> loops = findLoops(function);
+	for (size_t l = 0; l < loops.size(); l++) {
+		irLoop& loop = loops[l];
+		if (loop.preheader < 0) continue;
+		vector<int> list = function.blocks[loop.header].instructions;
+		for (size_t i = 0; i < list.size(); i++) {
+			irInstruction& inst = function.instructions[list[i]];
+			if ((inst.op != IR_CHECK) || loop.inLoop[function.instructions[inst.operands[0]].block]) {
+				if (hasSideEffects(inst.op)) break;
+				continue;
+			}
+			vector<int>& from = function.blocks[loop.header].instructions;
+			from.erase(remove(from.begin(), from.end(), list[i]), from.end());
+			vector<int>& to = function.blocks[loop.preheader].instructions;
+			to.insert(to.end() - 1, list[i]);
+			inst.block = loop.preheader;
+			stats.hoistedChecks++;
+		}
+	}
+}
+
+void optimizeFunction(irFunction& function, optimizerStats& stats) {
+	eliminateDeadCode(function, stats);
+	numberValues(function, stats);
+	lowerArrayOperations(function, stats);
+	hoistLoopInvariants(function, stats);
+	eliminateBoundsChecks(function, stats);
+	numberValues(function, stats);
+	eliminateDeadCode(function, stats);
+	mergeBlocks(function, stats);
+}
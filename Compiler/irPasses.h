@@ -0,0 +1,165 @@
+#ifndef IRPASSES_H
+#define IRPASSES_H
+
+#include "ir.h"
+#include "options.h"
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+/* Counters for the changes made by the optimization passes, shown with the --stats flag.
+ *    removedInstructions / removedBlocks - dead code and unreachable blocks deleted
+ *    foldedBranches - conditional branches on a constant turned into unconditional branches
+ *    mergedBlocks - blocks joined with their only predecessor
+ *    numberedValues - redundant values replaced by an equal value that dominates them
+ *    hoistedInstructions - loop invariant instructions moved into a loop's preheader
+ *    loweredArrayStores - whole array stores computed one element (or vector of elements) at a time
+ *    vectorLoops - vectorized loops created for whole array stores
+ *    removedChecks / hoistedChecks - array bounds checks proven unnecessary, or moved out of a loop
+ *    inlinedCalls - call sites replaced by a copy of the called procedure
+ *    memoizedFunctions - pure recursive procedures given a memo table
+ *    tailRecursiveCalls - calls a procedure makes to itself in tail position, turned into a loop
+ *    tailCalls - other calls in tail position, marked to reuse the caller's frame
+ */
+struct optimizerStats {
+	int removedInstructions = 0;
+	int removedBlocks = 0;
+	int foldedBranches = 0;
+	int mergedBlocks = 0;
+	int numberedValues = 0;
+	int hoistedInstructions = 0;
+	int loweredArrayStores = 0;
+	int vectorLoops = 0;
+	int removedChecks = 0;
+	int hoistedChecks = 0;
+	int inlinedCalls = 0;
+	int memoizedFunctions = 0;
+	int tailRecursiveCalls = 0;
+	int tailCalls = 0;
+};
+
+// Backend independent optimizations on the SSA IR. Each pass leaves the CFG (preds / succs) up to date.
+void eliminateDeadCode(irFunction& function, optimizerStats& stats);
+void mergeBlocks(irFunction& function, optimizerStats& stats);
+void numberValues(irFunction& function, optimizerStats& stats);
+void hoistLoopInvariants(irFunction& function, optimizerStats& stats);
+void lowerArrayOperations(irFunction& function, optimizerStats& stats);
+void eliminateBoundsChecks(irFunction& function, optimizerStats& stats);
+
+// Inlining, done across functions (irInline.cpp)
+bool readProfile(string filename, map<string, long long>& counts);
+set<string> findRecursive(irModule& module);
+void inlineCalls(map<string, irFunction*>& callees, irFunction& caller, compilerOptions& options,
+	map<string, long long>& profile, set<string>& recursive, optimizerStats& stats);
+
+// Memoization of pure recursive procedures (irMemo.cpp)
+set<string> findPure(irModule& module);
+void memoizeFunctions(irModule& module, optimizerStats& stats);
+
+// Tail calls (irTail.cpp)
+void eliminateTailRecursion(irFunction& function, optimizerStats& stats);
+void markTailCalls(irFunction& function, optimizerStats& stats);
+
+/* Registers available to the allocator: the x86-64 integer registers less the stack pointer, frame pointer and a
+ * scratch register for reloading spilled values, and the vector registers less one scratch register. */
+#define REG_INTEGER_COUNT 13
+#define REG_FLOAT_COUNT 15
+
+/* Registers a call leaves alone (System V: rbx and r12 to r15), numbered first. A value live across a call can only
+ * be kept in one of them. Every vector register is clobbered by a call. */
+#define REG_INTEGER_CALLEE_SAVED 5
+#define REG_FLOAT_CALLEE_SAVED 0
+
+/* Counters for register allocation, shown with the --regstats flag.
+ *    values - values that needed a register (constants are immediates and whole arrays stay in memory)
+ *    inRegisters / spilled - values given a register, or a stack slot because there were too few registers
+ *    loopValues / loopValuesInRegisters - values used in a loop, and how many of them got a register
+ *    callValues / callValuesInRegisters - values live across a call, and how many of them got a callee saved register
+ *    spillSlots - stack slots used for spilled values, over all functions
+ *    integerRegisters / floatRegisters - most registers of each kind used by one function
+ */
+struct allocationStats {
+	int values = 0;
+	int inRegisters = 0;
+	int spilled = 0;
+	int loopValues = 0;
+	int loopValuesInRegisters = 0;
+	int callValues = 0;
+	int callValuesInRegisters = 0;
+	int spillSlots = 0;
+	int integerRegisters = 0;
+	int floatRegisters = 0;
+};
+
+// Liveness analysis and linear scan register allocation, done last (irRegAlloc.cpp)
+void allocateRegisters(irFunction& function, allocationStats& stats);
+
+// Frames start with the saved FP and return address, and their size keeps the stack pointer 16 byte aligned
+#define FRAME_HEADER_BYTES 16
+#define FRAME_ALIGN 16
+
+/* Size of one function's frame, shown with the --frames flag.
+ *    bytesBefore - with every local and parameter in its own slot in declaration order, as scope::addSymbol() does
+ *    bytesAfter - with the layout from layoutFrame()
+ *    sharedSlots - variables and spill slots put in a slot already used by something with a disjoint lifetime
+ */
+struct frameLayoutStats {
+	int bytesBefore = 0;
+	int bytesAfter = 0;
+	int sharedSlots = 0;
+};
+
+// Stack frame layout, done after register allocation (irFrame.cpp)
+frameLayoutStats layoutFrame(irFunction& function);
+
+// Statistics of functions done on different threads are added up in function order
+void addStats(optimizerStats& total, optimizerStats& stats);
+void addStats(allocationStats& total, allocationStats& stats);
+
+/* A procedure compiled before, found in the compile cache by its fingerprint (irIncremental.cpp).
+ *    key - the fingerprint: a hash of the procedure's IR as parsed, and of every procedure it can reach through its
+ *          calls, since those are what inlining, memoization and tail call marking look at
+ *    found - true if the cache had an entry for the key, which optimizeModule() and generateModule() use in place
+ *            of optimizing and generating the procedure again
+ *    optimized / generated - the function after it was optimized, which procedures after it inline, and after
+ *                            register allocation and frame layout
+ *    optimizeStats / allocStats / frame - what optimizing and generating it counted
+ */
+struct cachedProcedure {
+	string key;
+	bool found = false;
+	irFunction optimized;
+	irFunction generated;
+	optimizerStats optimizeStats;
+	allocationStats allocStats;
+	frameLayoutStats frame;
+};
+
+/* Incremental recompilation at procedure granularity. findProcedures() fingerprints each function of a module that
+ * was just parsed and looks it up in the cache. storeProcedures() adds the ones that had to be compiled. */
+class compileCache;
+vector<cachedProcedure> findProcedures(irModule& module, compilerOptions& options, map<string, long long>& profile, compileCache& cache);
+void storeProcedures(vector<cachedProcedure>& procedures, compilerOptions& options, compileCache& cache);
+
+/* Run the optimization pipeline on every function (irBackend.cpp). Functions are done on options.jobs threads,
+ * but each one inlines the same callee bodies it would if they were done one at a time in the order they were
+ * finished: the optimized body of procedures finished before it, and the unoptimized body of the others. So the
+ * result doesn't depend on the number of threads.
+ * Tail recursion is turned into loops first, so those procedures are no longer recursive and can be inlined.
+ * With the --memoize option, pure recursive procedures are memoized once they are all optimized.
+ * Functions found in 'cached' are taken from it instead of being inlined into and optimized again, and the others
+ * are copied into it once optimized. */
+void optimizeFunction(irFunction& function, optimizerStats& stats);
+void optimizeModule(irModule& module, compilerOptions& options, map<string, long long>& profile, optimizerStats& stats,
+	vector<cachedProcedure>* cached = NULL);
+
+/* Register allocation and frame layout of every function, the per function part of code generation, done on
+ * options.jobs threads. Returns the frame layout statistics in function order. Like optimizeModule(), functions
+ * found in 'cached' are taken from it and the others are copied into it. */
+vector<frameLayoutStats> generateModule(irModule& module, compilerOptions& options, allocationStats& stats,
+	vector<cachedProcedure>* cached = NULL);
+
+#endif
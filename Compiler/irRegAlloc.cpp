@@ -0,0 +1,347 @@
+#include "irPasses.h"
+#include "ir.h"
+#include "tokentypes.h"
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+/* Live range of one value over the blocks laid out by reversePostOrder(function, true). Each instruction takes two
+ * positions, and each block runs from the position of its first instruction to one past its last.
+ *    ranges - sorted, disjoint [from, to] positions the value is live at. The gaps are lifetime holes, like the body
+ *             of a loop for a phi only used after the loop, where the register can hold something else.
+ *    cost - uses and definition weighted by loop depth. The value with the lowest cost is spilled first.
+ *    inLoop - true if the value is used or defined inside a loop
+ *    acrossCall - true if the value is live across a call, which clobbers the caller saved registers
+ */
+struct liveInterval {
+	int value;
+	vector< pair<int, int> > ranges;
+	bool floatClass;
+	double cost;
+	bool inLoop;
+	bool acrossCall;
+	int start() const { return ranges.front().first; }
+	int end() const { return ranges.back().second; }
+};
+
+// Values that live in a register. Constants are used as immediates, and whole arrays stay in memory.
+static bool needsLocation(irInstruction& inst) {
+	if ((inst.block < 0) || (inst.type == 0) || (inst.size > 0)) return false;
+	return (inst.op != IR_CONST) && (inst.op != IR_UNDEF);
+}
+
+/* Find the live range of each value. Liveness is found per block with the usual backwards dataflow, where a phi's
+ * operands are live out of the predecessor they come from rather than live into the phi's block. */
+static vector<liveInterval> buildIntervals(irFunction& function, vector<int>& order) {
+	size_t b, i, o;
+	vector<int> blockStart(function.blocks.size(), 0);
+	vector<int> blockEnd(function.blocks.size(), 0);
+	vector<int> position(function.instructions.size(), -1);
+	int pos = 0;
+	for (b = 0; b < order.size(); b++) {
+		vector<int>& list = function.blocks[order[b]].instructions;
+		blockStart[order[b]] = pos;
+		for (i = 0; i < list.size(); i++) {
+			position[list[i]] = pos;
+			pos += 2;
+		}
+		blockEnd[order[b]] = pos - 1;
+	}
+
+	// Values that are never used (like the result of most PUT* calls) don't need a location either
+	vector<bool> located(function.instructions.size(), false);
+	for (i = 0; i < function.instructions.size(); i++) {
+		irInstruction& inst = function.instructions[i];
+		if (inst.block < 0) continue;
+		for (o = 0; o < inst.operands.size(); o++) located[inst.operands[o]] = true;
+	}
+	for (i = 0; i < function.instructions.size(); i++) {
+		located[i] = located[i] && needsLocation(function.instructions[i]);
+	}
+
+	// Iterate to a fixed point, going backwards through the blocks so most values settle in one pass
+	vector< set<int> > liveIn(function.blocks.size());
+	vector< set<int> > liveOut(function.blocks.size());
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t r = order.size(); r-- > 0;) {
+			int block = order[r];
+			set<int> live;
+			vector<int>& succs = function.blocks[block].succs;
+			for (size_t s = 0; s < succs.size(); s++) {
+				live.insert(liveIn[succs[s]].begin(), liveIn[succs[s]].end());
+				vector<int>& list = function.blocks[succs[s]].instructions;
+				for (i = 0; i < list.size(); i++) {
+					irInstruction& phi = function.instructions[list[i]];
+					if (phi.op != IR_PHI) continue;
+					for (o = 0; o < phi.operands.size(); o++) {
+						if ((phi.phiBlocks[o] == block) && located[phi.operands[o]]) live.insert(phi.operands[o]);
+					}
+				}
+			}
+			liveOut[block] = live;
+			vector<int>& list = function.blocks[block].instructions;
+			for (i = list.size(); i-- > 0;) {
+				irInstruction& inst = function.instructions[list[i]];
+				live.erase(list[i]);
+				if (inst.op == IR_PHI) continue;
+				for (o = 0; o < inst.operands.size(); o++) {
+					if (located[inst.operands[o]]) live.insert(inst.operands[o]);
+				}
+			}
+			if (live != liveIn[block]) {
+				liveIn[block] = live;
+				changed = true;
+			}
+		}
+	}
+
+	// Loop depth of each block weights the cost of spilling the values used there
+	computeDominators(function);
+	vector<irLoop> loops = findLoops(function);
+	vector<int> depth(function.blocks.size(), 0);
+	for (size_t l = 0; l < loops.size(); l++) {
+		for (b = 0; b < loops[l].blocks.size(); b++) depth[loops[l].blocks[b]]++;
+	}
+
+	vector<int> intervalOf(function.instructions.size(), -1);
+	vector<liveInterval> intervals;
+	for (i = 0; i < function.instructions.size(); i++) {
+		if (!located[i] || (position[i] < 0)) continue;
+		liveInterval interval;
+		interval.value = (int)i;
+		interval.floatClass = inVectorRegister(function.instructions[i]);
+		interval.cost = 0;
+		interval.inLoop = false;
+		interval.acrossCall = false;
+		intervalOf[i] = (int)intervals.size();
+		intervals.push_back(interval);
+	}
+
+	/* In each block a value is live from the block start (if it is live in) or its definition, to the block end (if
+	 * it is live out) or its last use. Phi operands are used at the end of the block they come from. */
+	for (b = 0; b < order.size(); b++) {
+		int block = order[b];
+		double weight = 1;
+		for (int d = 0; d < min(depth[block], 3); d++) weight *= 10;
+		map<int, pair<int, int> > blockRanges;
+		set<int>::iterator it;
+		for (it = liveIn[block].begin(); it != liveIn[block].end(); it++) {
+			blockRanges[*it] = make_pair(blockStart[block], blockStart[block]);
+		}
+		for (it = liveOut[block].begin(); it != liveOut[block].end(); it++) {
+			if (!blockRanges.count(*it)) blockRanges[*it] = make_pair(blockStart[block], blockEnd[block]);
+			blockRanges[*it].second = blockEnd[block];
+		}
+		vector<int>& list = function.blocks[block].instructions;
+		for (i = 0; i < list.size(); i++) {
+			irInstruction& inst = function.instructions[list[i]];
+			if (intervalOf[list[i]] >= 0) {
+				intervals[intervalOf[list[i]]].cost += weight;
+				if (depth[block] > 0) intervals[intervalOf[list[i]]].inLoop = true;
+				if (liveOut[block].count(list[i])) blockRanges[list[i]].first = position[list[i]];
+				else blockRanges[list[i]] = make_pair(position[list[i]], position[list[i]]);
+			}
+			for (o = 0; o < inst.operands.size(); o++) {
+				int use = intervalOf[inst.operands[o]];
+				if (use < 0) continue;
+				intervals[use].cost += weight;
+				if (depth[block] > 0) intervals[use].inLoop = true;
+				if (inst.op == IR_PHI) continue;
+				pair<int, int>& range = blockRanges[inst.operands[o]];
+				range.second = max(range.second, position[list[i]]);
+			}
+		}
+		map<int, pair<int, int> >::iterator r;
+		for (r = blockRanges.begin(); r != blockRanges.end(); r++) {
+			if (intervalOf[r->first] >= 0) intervals[intervalOf[r->first]].ranges.push_back(r->second);
+		}
+	}
+
+	/* Calls (and the memo table lookups, which call into the runtime) clobber the caller saved registers. A value is
+	 * live across one if it is live at the call without being its result, and still live after it. */
+	vector<int> calls;
+	for (i = 0; i < function.instructions.size(); i++) {
+		int op = function.instructions[i].op;
+		bool call = (op == IR_CALL) || (op == IR_MEMO_FIND) || (op == IR_MEMO_GET) || (op == IR_MEMO_PUT);
+		if (call && (position[i] >= 0)) calls.push_back(position[i]);
+	}
+
+	// Sort each value's ranges and join the ones from consecutive blocks
+	for (i = 0; i < intervals.size(); i++) {
+		vector< pair<int, int> >& ranges = intervals[i].ranges;
+		sort(ranges.begin(), ranges.end());
+		vector< pair<int, int> > joined;
+		for (size_t k = 0; k < ranges.size(); k++) {
+			if (!joined.empty() && (ranges[k].first <= joined.back().second + 1)) {
+				joined.back().second = max(joined.back().second, ranges[k].second);
+			}
+			else joined.push_back(ranges[k]);
+		}
+		ranges = joined;
+		for (size_t c = 0; (c < calls.size()) && !intervals[i].acrossCall; c++) {
+			if (calls[c] == position[intervals[i].value]) continue;
+			for (size_t k = 0; k < ranges.size(); k++) {
+				if ((ranges[k].first <= calls[c]) && (calls[c] < ranges[k].second)) intervals[i].acrossCall = true;
+			}
+		}
+		int length = 0;
+		for (size_t k = 0; k < ranges.size(); k++) length += ranges[k].second - ranges[k].first + 1;
+		intervals[i].cost /= length;
+	}
+	return intervals;
+}
+
+static bool startsBefore(const liveInterval& a, const liveInterval& b) {
+	return (a.start() < b.start()) || ((a.start() == b.start()) && (a.value < b.value));
+}
+
+// True if the value is live at a position (not in one of its holes)
+static bool covers(liveInterval& interval, int pos) {
+	for (size_t r = 0; r < interval.ranges.size(); r++) {
+		if ((interval.ranges[r].first <= pos) && (pos <= interval.ranges[r].second)) return true;
+	}
+	return false;
+}
+
+// True if two values are live at the same position anywhere
+static bool intersects(liveInterval& a, liveInterval& b) {
+	size_t i = 0, j = 0;
+	while ((i < a.ranges.size()) && (j < b.ranges.size())) {
+		if (a.ranges[i].second < b.ranges[j].first) i++;
+		else if (b.ranges[j].second < a.ranges[i].first) j++;
+		else return true;
+	}
+	return false;
+}
+
+/* Linear scan register allocation (Poletto and Sarkar, with the lifetime holes of Traub et al.) over the live
+ * intervals in order of their start. Active values hold their register at the current position, and inactive ones
+ * hold it again after a hole. A register is free for a value if no active value holds it and no inactive value that
+ * holds it is live at the same time. When no register is free, the cheapest of the new value and the active values
+ * whose register would be free is spilled, so values used in loops keep their registers. Spilled values share a
+ * stack slot when their intervals don't overlap.
+ * A value live across a call can only have a callee saved register, and is spilled when none of those is free (so
+ * always for vector values). Other values take the caller saved registers first, to leave the callee saved ones for
+ * the values that need them. */
+void allocateRegisters(irFunction& function, allocationStats& stats) {
+	function.registers.assign(function.instructions.size(), -1);
+	function.spillSlot.assign(function.instructions.size(), -1);
+	function.spillSlots = 0;
+	computeCFG(function);
+	vector<int> order = reversePostOrder(function, true);
+	vector<liveInterval> intervals = buildIntervals(function, order);
+	sort(intervals.begin(), intervals.end(), startsBefore);
+
+	int registerCount[2] = { REG_INTEGER_COUNT, REG_FLOAT_COUNT };
+	int calleeSaved[2] = { REG_INTEGER_CALLEE_SAVED, REG_FLOAT_CALLEE_SAVED };
+	vector<bool> usedRegisters[2] = { vector<bool>(REG_INTEGER_COUNT, false), vector<bool>(REG_FLOAT_COUNT, false) };
+	vector<int> active;
+	vector<int> inactive;
+	vector<int> slotEnd; // end of the last interval given each spill slot
+	size_t i, a;
+
+	for (i = 0; i < intervals.size(); i++) {
+		liveInterval& current = intervals[i];
+		int pos = current.start();
+
+		for (a = active.size(); a-- > 0;) {
+			liveInterval& old = intervals[active[a]];
+			if (old.end() < pos) active.erase(active.begin() + a);
+			else if (!covers(old, pos)) {
+				inactive.push_back(active[a]);
+				active.erase(active.begin() + a);
+			}
+		}
+		for (a = inactive.size(); a-- > 0;) {
+			liveInterval& old = intervals[inactive[a]];
+			if (old.end() < pos) inactive.erase(inactive.begin() + a);
+			else if (covers(old, pos)) {
+				active.push_back(inactive[a]);
+				inactive.erase(inactive.begin() + a);
+			}
+		}
+
+		// Registers held by an active value, or by an inactive value that will need it while this one is live
+		vector<bool> taken(registerCount[current.floatClass], false);
+		vector<bool> blocked(registerCount[current.floatClass], false);
+		for (a = 0; a < active.size(); a++) {
+			liveInterval& other = intervals[active[a]];
+			if (other.floatClass == current.floatClass) taken[function.registers[other.value]] = true;
+		}
+		for (a = 0; a < inactive.size(); a++) {
+			liveInterval& other = intervals[inactive[a]];
+			if ((other.floatClass == current.floatClass) && intersects(other, current)) {
+				blocked[function.registers[other.value]] = true;
+			}
+		}
+
+		// Registers the value can have, in the order they are tried
+		int count = registerCount[current.floatClass];
+		int saved = calleeSaved[current.floatClass];
+		int allowed = current.acrossCall ? saved : count;
+		int reg = -1;
+		for (int n = 0; (n < allowed) && (reg < 0); n++) {
+			int r = current.acrossCall ? n : (n + saved) % count;
+			if (!taken[r] && !blocked[r]) reg = r;
+		}
+		int victim = -1; // interval that goes to memory instead
+		if (reg < 0) {
+			victim = (int)i;
+			for (a = 0; a < active.size(); a++) {
+				liveInterval& other = intervals[active[a]];
+				if ((other.floatClass != current.floatClass) || blocked[function.registers[other.value]]) continue;
+				if (function.registers[other.value] >= allowed) continue;
+				liveInterval& cheapest = intervals[victim];
+				if ((other.cost < cheapest.cost) || ((other.cost == cheapest.cost) && (other.end() > cheapest.end()))) {
+					victim = active[a];
+				}
+			}
+			if (victim != (int)i) {
+				reg = function.registers[intervals[victim].value];
+				function.registers[intervals[victim].value] = -1;
+				active.erase(find(active.begin(), active.end(), victim));
+			}
+		}
+
+		if (reg >= 0) {
+			function.registers[current.value] = reg;
+			active.push_back((int)i);
+			usedRegisters[current.floatClass][reg] = true;
+		}
+		if (victim >= 0) {
+			// A spilled value is in its slot for its whole interval, which can start before the current one
+			liveInterval& spill = intervals[victim];
+			int slot = 0;
+			while ((slot < (int)slotEnd.size()) && (slotEnd[slot] >= spill.start())) slot++;
+			if (slot == (int)slotEnd.size()) slotEnd.push_back(spill.end());
+			else slotEnd[slot] = spill.end();
+			function.spillSlot[spill.value] = slot;
+		}
+	}
+
+	for (i = 0; i < intervals.size(); i++) {
+		bool inRegister = function.registers[intervals[i].value] >= 0;
+		stats.values++;
+		if (inRegister) stats.inRegisters++;
+		else stats.spilled++;
+		if (intervals[i].inLoop) {
+			stats.loopValues++;
+			if (inRegister) stats.loopValuesInRegisters++;
+		}
+		if (intervals[i].acrossCall) {
+			stats.callValues++;
+			if (inRegister) stats.callValuesInRegisters++;
+		}
+	}
+	function.spillSlots = (int)slotEnd.size();
+	stats.spillSlots += function.spillSlots;
+	stats.integerRegisters = max(stats.integerRegisters, (int)count(usedRegisters[0].begin(), usedRegisters[0].end(), true));
+	stats.floatRegisters = max(stats.floatRegisters, (int)count(usedRegisters[1].begin(), usedRegisters[1].end(), true));
+}
+
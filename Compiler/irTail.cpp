@@ -0,0 +1,181 @@
+#include "irPasses.h"
+#include "ir.h"
+#include "tokentypes.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Number of times each value is used as an operand
+static vector<int> countUses(irFunction& function) {
+	vector<int> uses(function.instructions.size(), 0);
+	for (size_t i = 0; i < function.instructions.size(); i++) {
+		irInstruction& inst = function.instructions[i];
+		if (inst.block < 0) continue;
+		for (size_t o = 0; o < inst.operands.size(); o++) uses[inst.operands[o]]++;
+	}
+	return uses;
+}
+
+/* The call just before the return ending a block, if the return gives back the call's value (or nothing) and
+ * nothing else uses the value. Returns -1 if the block doesn't end with a tail call. */
+static int tailCall(irFunction& function, int block, vector<int>& uses) {
+	vector<int>& list = function.blocks[block].instructions;
+	if (list.size() < 2) return -1;
+	irInstruction& ret = function.instructions[list.back()];
+	int call = list[list.size() - 2];
+	irInstruction& inst = function.instructions[call];
+	if ((ret.op != IR_RET) || (inst.op != IR_CALL)) return -1;
+	if (ret.operands.empty()) return (uses[call] == 0) ? call : -1;
+	return ((ret.operands[0] == call) && (uses[call] == 1)) ? call : -1;
+}
+
+// True if each array the call passes by reference is the one the procedure was passed, so the loop can keep using it
+static bool sameReferences(irFunction& function, irInstruction& call) {
+	for (size_t v = 0; v < function.variables.size(); v++) {
+		irVariable& var = function.variables[v];
+		if (!var.reference || (var.param >= (int)call.operands.size())) continue;
+		irInstruction& arg = function.instructions[call.operands[var.param]];
+		if ((arg.op != IR_ADDR) || (arg.variable != (int)v)) return false;
+	}
+	return true;
+}
+
+/* Turn calls a procedure makes to itself in tail position into a loop. The entry block's code moves to a new loop
+ * header with a phi for each scalar parameter, and each tail call becomes a branch back to the header passing its
+ * arguments to the phis. Array parameters are stored to directly, since they live in the frame being reused. Calls
+ * passing a different array by reference are left alone. */
+void eliminateTailRecursion(irFunction& function, optimizerStats& stats) {
+	computeCFG(function);
+	vector<int> uses = countUses(function);
+	vector<int> calls;
+	size_t b, i;
+	for (b = 0; b < function.blocks.size(); b++) {
+		if (function.blocks[b].removed) continue;
+		int call = tailCall(function, (int)b, uses);
+		if ((call < 0) || (function.instructions[call].callee != function.label)) continue;
+		if (sameReferences(function, function.instructions[call])) calls.push_back(call);
+	}
+	if (calls.empty() || !function.blocks[0].preds.empty()) return;
+
+	// Parameters (and undefined values) stay in the entry block, which now just branches to the header
+	int header = (int)function.blocks.size();
+	function.blocks.push_back(irBlock());
+	vector<int> entry;
+	vector<int>& list = function.blocks[0].instructions;
+	vector<int> params(function.variables.size(), -1);
+	for (i = 0; i < list.size(); i++) {
+		irInstruction& inst = function.instructions[list[i]];
+		if (inst.op == IR_PARAM) params[inst.variable] = list[i];
+		if ((inst.op == IR_PARAM) || (inst.op == IR_UNDEF)) entry.push_back(list[i]);
+		else {
+			inst.block = header;
+			function.blocks[header].instructions.push_back(list[i]);
+		}
+	}
+	for (i = 0; i < function.instructions.size(); i++) {
+		irInstruction& inst = function.instructions[i];
+		if ((inst.op != IR_PHI) || (inst.block < 0)) continue;
+		for (size_t o = 0; o < inst.phiBlocks.size(); o++) {
+			if (inst.phiBlocks[o] == 0) inst.phiBlocks[o] = header;
+		}
+	}
+	irInstruction enter;
+	enter.op = IR_BR;
+	enter.target = header;
+	enter.block = 0;
+	function.instructions.push_back(enter);
+	entry.push_back((int)function.instructions.size() - 1);
+	function.blocks[0].instructions = entry;
+
+	// Every use of a scalar parameter now uses its phi in the header
+	vector<int> phis(function.variables.size(), -1);
+	vector<int> headerPhis;
+	for (size_t v = 0; v < function.variables.size(); v++) {
+		if (params[v] < 0) continue;
+		irInstruction phi;
+		phi.op = IR_PHI;
+		phi.type = function.instructions[params[v]].type;
+		phi.block = header;
+		function.instructions.push_back(phi);
+		phis[v] = (int)function.instructions.size() - 1;
+		replaceAllUses(function, params[v], phis[v]);
+		function.instructions[phis[v]].operands.push_back(params[v]);
+		function.instructions[phis[v]].phiBlocks.push_back(0);
+		headerPhis.push_back(phis[v]);
+	}
+	vector<int>& headerList = function.blocks[header].instructions;
+	headerList.insert(headerList.begin(), headerPhis.begin(), headerPhis.end());
+
+	for (size_t c = 0; c < calls.size(); c++) {
+		irInstruction call = function.instructions[calls[c]];
+		int block = call.block;
+		vector<int>& blockList = function.blocks[block].instructions;
+		int ret = blockList.back();
+		blockList.resize(blockList.size() - 2);
+
+		for (size_t v = 0; v < function.variables.size(); v++) {
+			irVariable& var = function.variables[v];
+			if ((var.param < 0) || (var.param >= (int)call.operands.size())) continue;
+			int arg = call.operands[var.param];
+			if (phis[v] >= 0) {
+				// Arguments are converted to the parameter's type like they would be on entry
+				int argType = function.instructions[arg].type;
+				if ((argType != var.type) && (argType != T_UNKNOWN)) {
+					irInstruction convert;
+					convert.op = IR_CONVERT;
+					convert.type = var.type;
+					convert.block = block;
+					convert.operands.push_back(arg);
+					function.instructions.push_back(convert);
+					arg = (int)function.instructions.size() - 1;
+					blockList.push_back(arg);
+				}
+				function.instructions[phis[v]].operands.push_back(arg);
+				function.instructions[phis[v]].phiBlocks.push_back(block);
+			}
+			else if (!var.ssa && !var.reference) {
+				irInstruction store;
+				store.op = IR_STORE;
+				store.variable = (int)v;
+				store.block = block;
+				store.operands.push_back(arg);
+				function.instructions.push_back(store);
+				blockList.push_back((int)function.instructions.size() - 1);
+			}
+		}
+
+		removeInstruction(function, calls[c]);
+		irInstruction& branch = function.instructions[ret];
+		branch.op = IR_BR;
+		branch.operands.clear();
+		branch.target = header;
+		blockList.push_back(ret);
+		stats.tailRecursiveCalls++;
+	}
+	computeCFG(function);
+}
+
+/* Mark the remaining calls in tail position, to other procedures or to this one through them, so the backend can
+ * jump to the callee in place of the caller's frame. Calls passing an array aren't marked, since the array is
+ * copied from (or passed by reference to) the frame the callee would overwrite. Globals and arrays the caller was
+ * itself passed by reference live outside of its frame, so those can still be passed by reference. */
+void markTailCalls(irFunction& function, optimizerStats& stats) {
+	vector<int> uses = countUses(function);
+	for (size_t b = 0; b < function.blocks.size(); b++) {
+		if (function.blocks[b].removed) continue;
+		int call = tailCall(function, (int)b, uses);
+		if (call < 0) continue;
+		irInstruction& inst = function.instructions[call];
+		bool arrays = false;
+		for (size_t o = 0; o < inst.operands.size(); o++) {
+			irInstruction& arg = function.instructions[inst.operands[o]];
+			if (arg.size == 0) continue;
+			irVariable* var = (arg.op == IR_ADDR) ? &function.variables[arg.variable] : NULL;
+			if (!var || !(var->global || var->reference)) arrays = true;
+		}
+		if (arrays || inst.tail) continue;
+		inst.tail = true;
+		stats.tailCalls++;
+	}
+}
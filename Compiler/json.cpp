@@ -0,0 +1,320 @@
+#include "json.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+// Deepest nesting of arrays and objects accepted, so a hostile message can't overflow the stack
+#define JSON_MAX_DEPTH 256
+
+jsonValue::jsonValue() {
+	type = JSON_NULL;
+	boolValue = false;
+	numberValue = 0;
+}
+
+jsonValue::jsonValue(bool value) : jsonValue() {
+	type = JSON_BOOL;
+	boolValue = value;
+}
+
+jsonValue::jsonValue(int value) : jsonValue() {
+	type = JSON_NUMBER;
+	numberValue = value;
+}
+
+jsonValue::jsonValue(double value) : jsonValue() {
+	type = JSON_NUMBER;
+	numberValue = value;
+}
+
+jsonValue::jsonValue(const char* value) : jsonValue() {
+	type = JSON_STRING;
+	stringValue = value;
+}
+
+jsonValue::jsonValue(string value) : jsonValue() {
+	type = JSON_STRING;
+	stringValue = value;
+}
+
+jsonValue jsonValue::array() {
+	jsonValue value;
+	value.type = JSON_ARRAY;
+	return value;
+}
+
+jsonValue jsonValue::object() {
+	jsonValue value;
+	value.type = JSON_OBJECT;
+	return value;
+}
+
+// Shared null value returned for missing members and elements
+static const jsonValue missing;
+
+const jsonValue& jsonValue::operator[](const string& name) const {
+	map<string, jsonValue>::const_iterator it = members.find(name);
+	return (it == members.end()) ? missing : it->second;
+}
+
+const jsonValue& jsonValue::operator[](size_t index) const {
+	return (index < items.size()) ? items[index] : missing;
+}
+
+// Set a member, making this an object. Returns this value so calls can be chained.
+jsonValue& jsonValue::set(const string& name, jsonValue value) {
+	type = JSON_OBJECT;
+	members[name] = value;
+	return *this;
+}
+
+// Append an element, making this an array
+jsonValue& jsonValue::add(jsonValue value) {
+	type = JSON_ARRAY;
+	items.push_back(value);
+	return *this;
+}
+
+bool jsonValue::has(const string& name) const {
+	return members.count(name) > 0;
+}
+
+int jsonValue::asInt() const {
+	return (type == JSON_NUMBER) ? (int)numberValue : 0;
+}
+
+static void writeString(ostringstream& out, const string& value) {
+	out << '"';
+	for (size_t i = 0; i < value.size(); i++) {
+		unsigned char ch = (unsigned char)value[i];
+		switch (ch) {
+		case '"': out << "\\\""; break;
+		case '\\': out << "\\\\"; break;
+		case '\n': out << "\\n"; break;
+		case '\r': out << "\\r"; break;
+		case '\t': out << "\\t"; break;
+		default:
+			if (ch < 0x20) {
+				char escape[8];
+				snprintf(escape, sizeof(escape), "\\u%04x", ch);
+				out << escape;
+			}
+			else out << value[i];
+		}
+	}
+	out << '"';
+}
+
+static void writeValue(ostringstream& out, const jsonValue& value) {
+	switch (value.type) {
+	case JSON_BOOL: out << (value.boolValue ? "true" : "false"); break;
+	case JSON_NUMBER:
+		if (value.numberValue == (double)(long long)value.numberValue) out << (long long)value.numberValue;
+		else out << value.numberValue;
+		break;
+	case JSON_STRING: writeString(out, value.stringValue); break;
+	case JSON_ARRAY:
+		out << '[';
+		for (size_t i = 0; i < value.items.size(); i++) {
+			if (i > 0) out << ',';
+			writeValue(out, value.items[i]);
+		}
+		out << ']';
+		break;
+	case JSON_OBJECT: {
+		out << '{';
+		bool first = true;
+		for (map<string, jsonValue>::const_iterator it = value.members.begin(); it != value.members.end(); it++) {
+			if (!first) out << ',';
+			first = false;
+			writeString(out, it->first);
+			out << ':';
+			writeValue(out, it->second);
+		}
+		out << '}';
+		break;
+	}
+	default: out << "null"; break;
+	}
+}
+
+// The value as JSON text, with no whitespace
+string jsonValue::text() const {
+	ostringstream out;
+	writeValue(out, *this);
+	return out.str();
+}
+
+// Recursive descent parser of JSON text. 'next' is the index of the next character to read.
+class jsonParser
+{
+private:
+	const string& text;
+	size_t next;
+	void skipSpace();
+	bool literal(const char* word);
+	bool parseString(string& result);
+	void appendUtf8(string& result, unsigned int code);
+public:
+	jsonParser(const string& text_input) : text(text_input), next(0) {}
+	bool value(jsonValue& result, int depth);
+	bool finished();
+};
+
+void jsonParser::skipSpace() {
+	while ((next < text.size()) && ((text[next] == ' ') || (text[next] == '\t') || (text[next] == '\n') || (text[next] == '\r'))) next++;
+}
+
+bool jsonParser::finished() {
+	skipSpace();
+	return next == text.size();
+}
+
+bool jsonParser::literal(const char* word) {
+	size_t length = string(word).size();
+	if (text.compare(next, length, word) != 0) return false;
+	next += length;
+	return true;
+}
+
+void jsonParser::appendUtf8(string& result, unsigned int code) {
+	if (code < 0x80) result += (char)code;
+	else if (code < 0x800) {
+		result += (char)(0xC0 | (code >> 6));
+		result += (char)(0x80 | (code & 0x3F));
+	}
+	else if (code < 0x10000) {
+		result += (char)(0xE0 | (code >> 12));
+		result += (char)(0x80 | ((code >> 6) & 0x3F));
+		result += (char)(0x80 | (code & 0x3F));
+	}
+	else {
+		result += (char)(0xF0 | (code >> 18));
+		result += (char)(0x80 | ((code >> 12) & 0x3F));
+		result += (char)(0x80 | ((code >> 6) & 0x3F));
+		result += (char)(0x80 | (code & 0x3F));
+	}
+}
+
+bool jsonParser::parseString(string& result) {
+	if ((next >= text.size()) || (text[next] != '"')) return false;
+	next++;
+	while (next < text.size()) {
+		char ch = text[next++];
+		if (ch == '"') return true;
+		if (ch != '\\') {
+			result += ch;
+			continue;
+		}
+		if (next >= text.size()) return false;
+		ch = text[next++];
+		switch (ch) {
+		case '"': case '\\': case '/': result += ch; break;
+		case 'b': result += '\b'; break;
+		case 'f': result += '\f'; break;
+		case 'n': result += '\n'; break;
+		case 'r': result += '\r'; break;
+		case 't': result += '\t'; break;
+		case 'u': {
+			if (next + 4 > text.size()) return false;
+			unsigned int code = (unsigned int)strtoul(text.substr(next, 4).c_str(), NULL, 16);
+			next += 4;
+			// A surrogate pair is one character
+			if ((code >= 0xD800) && (code < 0xDC00) && (text.compare(next, 2, "\\u") == 0) && (next + 6 <= text.size())) {
+				unsigned int low = (unsigned int)strtoul(text.substr(next + 2, 4).c_str(), NULL, 16);
+				if ((low >= 0xDC00) && (low < 0xE000)) {
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					next += 6;
+				}
+			}
+			appendUtf8(result, code);
+			break;
+		}
+		default: return false;
+		}
+	}
+	return false;
+}
+
+bool jsonParser::value(jsonValue& result, int depth) {
+	if (depth > JSON_MAX_DEPTH) return false;
+	skipSpace();
+	if (next >= text.size()) return false;
+	char ch = text[next];
+	if (ch == '{') {
+		next++;
+		result = jsonValue::object();
+		skipSpace();
+		if ((next < text.size()) && (text[next] == '}')) {
+			next++;
+			return true;
+		}
+		while (true) {
+			skipSpace();
+			string name;
+			if (!parseString(name)) return false;
+			skipSpace();
+			if ((next >= text.size()) || (text[next++] != ':')) return false;
+			jsonValue member;
+			if (!value(member, depth + 1)) return false;
+			result.members[name] = member;
+			skipSpace();
+			if (next >= text.size()) return false;
+			ch = text[next++];
+			if (ch == '}') return true;
+			if (ch != ',') return false;
+		}
+	}
+	if (ch == '[') {
+		next++;
+		result = jsonValue::array();
+		skipSpace();
+		if ((next < text.size()) && (text[next] == ']')) {
+			next++;
+			return true;
+		}
+		while (true) {
+			jsonValue item;
+			if (!value(item, depth + 1)) return false;
+			result.items.push_back(item);
+			skipSpace();
+			if (next >= text.size()) return false;
+			ch = text[next++];
+			if (ch == ']') return true;
+			if (ch != ',') return false;
+		}
+	}
+	if (ch == '"') {
+		result = jsonValue("");
+		return parseString(result.stringValue);
+	}
+	if (literal("true")) {
+		result = jsonValue(true);
+		return true;
+	}
+	if (literal("false")) {
+		result = jsonValue(false);
+		return true;
+	}
+	if (literal("null")) {
+		result = jsonValue();
+		return true;
+	}
+	const char* start = text.c_str() + next;
+	char* end;
+	double number = strtod(start, &end);
+	if (end == start) return false;
+	next += end - start;
+	result = jsonValue(number);
+	return true;
+}
+
+bool jsonValue::parse(const string& text, jsonValue& result) {
+	jsonParser parser(text);
+	return parser.value(result, 0) && parser.finished();
+}
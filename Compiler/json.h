@@ -0,0 +1,56 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+#define JSON_NULL 0
+#define JSON_BOOL 1
+#define JSON_NUMBER 2
+#define JSON_STRING 3
+#define JSON_ARRAY 4
+#define JSON_OBJECT 5
+
+/*
+ * A JSON value, for the messages of the language server (languageServer.cpp).
+ *    type - JSON_* kind of value
+ *    boolValue / numberValue / stringValue - the value of a bool, number or string
+ *    items - elements of an array
+ *    members - members of an object, by name
+ * Looking up a member or element that isn't there gives a null value, so a path into a message can be followed
+ * without checking each step. parse() returns false if the text isn't one complete value.
+ */
+class jsonValue
+{
+public:
+	int type;
+	bool boolValue;
+	double numberValue;
+	string stringValue;
+	vector<jsonValue> items;
+	map<string, jsonValue> members;
+
+	jsonValue();
+	jsonValue(bool value);
+	jsonValue(int value);
+	jsonValue(double value);
+	jsonValue(const char* value);
+	jsonValue(string value);
+	static jsonValue array();
+	static jsonValue object();
+
+	const jsonValue& operator[](const string& name) const;
+	const jsonValue& operator[](size_t index) const;
+	jsonValue& set(const string& name, jsonValue value);
+	jsonValue& add(jsonValue value);
+	bool has(const string& name) const;
+	int asInt() const;
+	string text() const;
+
+	static bool parse(const string& text, jsonValue& result);
+};
+
+#endif
@@ -0,0 +1,599 @@
+#include "languageServer.h"
+#include "json.h"
+#include "symbolIndex.h"
+#include "scanner.h"
+#include "tokenStream.h"
+#include "parser.h"
+#include "scopeMap.h"
+#include "options.h"
+#include "compileCache.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+using namespace std;
+
+// JSON-RPC error for a request the server doesn't handle
+#define LSP_METHOD_NOT_FOUND -32601
+
+// LSP diagnostic severities and symbol kinds used
+#define LSP_SEVERITY_ERROR 1
+#define LSP_SEVERITY_WARNING 2
+#define LSP_SYMBOL_FUNCTION 12
+#define LSP_SYMBOL_VARIABLE 13
+
+/* Struct to hold an identifier found in the text of a line.
+ *    name - in upper case, like the scanner makes it
+ *    spelling - as it is written
+ *    column - where it starts on the line, in characters of the position encoding (see encodedLength)
+ *    occurrence - appearances of the name earlier on the line, which is how the index tells them apart
+ */
+struct lspIdentifier {
+	string name;
+	string spelling;
+	int column;
+	int occurrence;
+};
+
+/* Struct to hold what an analysis of a document found.
+ *    version - the version of the document analyzed
+ *    index - its declarations and the uses of them
+ *    lines - identifiers on each line of the text analyzed, to turn index positions into columns and back
+ *    diagnostics - errors and warnings, as they are published
+ */
+struct lspAnalysis {
+	int version = 0;
+	symbolIndex index;
+	vector<vector<lspIdentifier>> lines;
+	jsonValue diagnostics = jsonValue::array();
+};
+
+/* Struct to hold an open document.
+ *    text - the text with every edit the client has sent applied
+ *    tokens - its tokens, relexed around each edit (tokenStream) so analyses parse them without scanning everything
+ *    version - the client's version of the text
+ *    waiting - edited since the worker last took its text
+ *    changed - when it was last edited
+ *    firstChange - when it was first edited after the worker last took its text, which starts the latency budget
+ *    analysis - the last analysis that was current when it finished. Requests use it while a newer one is made.
+ */
+struct lspDocument {
+	string text;
+	unique_ptr<tokenStream> tokens;
+	int version = 0;
+	bool waiting = false;
+	chrono::steady_clock::time_point changed;
+	chrono::steady_clock::time_point firstChange;
+	shared_ptr<lspAnalysis> analysis;
+};
+
+// Stream buffer that drops what is written. The parser's printed errors would corrupt the protocol on stdout.
+class discardBuffer : public streambuf
+{
+protected:
+	int overflow(int c) { return (c == EOF) ? 0 : c; }
+	streamsize xsputn(const char*, streamsize count) { return count; }
+};
+
+class languageServer
+{
+private:
+	mutex lock;
+	mutex outputLock;
+	condition_variable wake;
+	map<string, lspDocument> documents;
+	bool running;
+	bool shuttingDown;
+	bool utf8Positions;
+	void send(const jsonValue& message);
+	void respond(const jsonValue& id, jsonValue result);
+	void notify(string method, jsonValue params);
+	void log(string message);
+	void publish(string uri, int version, jsonValue diagnostics);
+	void edited(lspDocument& document);
+	shared_ptr<lspAnalysis> analysisOf(const jsonValue& params);
+	jsonValue location(string uri, lspAnalysis& analysis, symbolPosition& position);
+	jsonValue symbols(string uri, lspAnalysis& analysis, string query);
+	jsonValue definition(const jsonValue& params);
+	jsonValue references(const jsonValue& params);
+	jsonValue workspaceSymbols(const jsonValue& params);
+	void analyzeDocuments();
+public:
+	languageServer();
+	int run();
+};
+
+// Read the next message's content, returning false at the end of input
+static bool readMessage(string& content) {
+	long length = -1;
+	string header;
+	int ch;
+	while ((ch = getchar()) != EOF) {
+		if (ch == '\r') continue;
+		if (ch != '\n') {
+			header += (char)ch;
+			continue;
+		}
+		if (header == "") {
+			if (length < 0) continue;
+			content.assign((size_t)length, '\0');
+			return (length == 0) || (fread(&content[0], 1, (size_t)length, stdin) == (size_t)length);
+		}
+		if ((header.size() > 15) && (header.compare(0, 15, "Content-Length:") == 0)) length = strtol(header.c_str() + 15, NULL, 10);
+		header = "";
+	}
+	return false;
+}
+
+/* Characters of text[from, to) in the position encoding agreed on with the client: bytes for UTF-8, otherwise UTF-16
+ * code units, the LSP default. A UTF-8 character takes one code unit, or two (a surrogate pair) if it takes 4 bytes. */
+static int encodedLength(const string& text, size_t from, size_t to, bool utf8) {
+	if (utf8) return (int)(to - from);
+	int units = 0;
+	for (size_t i = from; i < to; i++) {
+		unsigned char byte = (unsigned char)text[i];
+		if ((byte & 0xC0) == 0x80) continue;
+		units += (byte >= 0xF0) ? 2 : 1;
+	}
+	return units;
+}
+
+// The offset in the text of an LSP position (zero based line and column), clamped to the line
+static size_t offsetOf(const string& text, int line, int column, bool utf8) {
+	size_t offset = 0;
+	for (int l = 0; (l < line) && (offset < text.size()); offset++) {
+		if (text[offset] == '\n') l++;
+	}
+	for (int units = 0; (units < column) && (offset < text.size()) && (text[offset] != '\n');) {
+		// A UTF-16 column counts whole characters, so their continuation bytes are skipped with them
+		size_t next = offset + 1;
+		while (!utf8 && (next < text.size()) && (((unsigned char)text[next] & 0xC0) == 0x80)) next++;
+		units += encodedLength(text, offset, next, utf8);
+		offset = next;
+	}
+	return offset;
+}
+
+/* Apply one of the changes in a didChange notification to a document's text and tokens. A change without a range
+ * replaces all of the text, which is scanned again. */
+static void applyChange(lspDocument& document, const jsonValue& change, bool utf8) {
+	const jsonValue& range = change["range"];
+	if (range.type != JSON_OBJECT) {
+		document.text = change["text"].stringValue;
+		document.tokens.reset(new tokenStream(document.text));
+		return;
+	}
+	size_t start = offsetOf(document.text, range["start"]["line"].asInt(), range["start"]["character"].asInt(), utf8);
+	size_t end = offsetOf(document.text, range["end"]["line"].asInt(), range["end"]["character"].asInt(), utf8);
+	if (end < start) end = start;
+	textEdit edit;
+	edit.offset = start;
+	edit.length = end - start;
+	edit.text = change["text"].stringValue;
+	document.text.replace(edit.offset, edit.length, edit.text);
+	document.tokens->edit(edit);
+}
+
+/* The identifiers on each line of the text, found the way the scanner finds them: comments (nested ones too) and
+ * strings are skipped, and words that are keywords aren't identifiers. */
+static vector<vector<lspIdentifier>> findIdentifiers(const string& text, bool utf8) {
+	const map<string, int>& keywords = Scanner::keywords();
+	vector<vector<lspIdentifier>> lines(1);
+	map<string, int> onLine;
+	size_t lineStart = 0;
+	int depth = 0;
+	size_t i = 0;
+	while (i < text.size()) {
+		char ch = text[i];
+		if (ch == '\n') {
+			lines.push_back(vector<lspIdentifier>());
+			onLine.clear();
+			lineStart = ++i;
+			continue;
+		}
+		if (depth > 0) {
+			if ((ch == '*') && (i + 1 < text.size()) && (text[i + 1] == '/')) {
+				depth--;
+				i += 2;
+			}
+			else if ((ch == '/') && (i + 1 < text.size()) && (text[i + 1] == '*')) {
+				depth++;
+				i += 2;
+			}
+			else i++;
+			continue;
+		}
+		if ((ch == '/') && (i + 1 < text.size()) && (text[i + 1] == '/')) {
+			while ((i < text.size()) && (text[i] != '\n')) i++;
+			continue;
+		}
+		if ((ch == '/') && (i + 1 < text.size()) && (text[i + 1] == '*')) {
+			depth = 1;
+			i += 2;
+			continue;
+		}
+		if (ch == '"') {
+			for (i++; (i < text.size()) && (text[i] != '"'); i++) {
+				if (text[i] != '\n') continue;
+				lines.push_back(vector<lspIdentifier>());
+				onLine.clear();
+				lineStart = i + 1;
+			}
+			i++;
+			continue;
+		}
+		if (isdigit((unsigned char)ch)) {
+			while ((i < text.size()) && (isdigit((unsigned char)text[i]) || (text[i] == '.'))) i++;
+			continue;
+		}
+		if (!isalpha((unsigned char)ch)) {
+			i++;
+			continue;
+		}
+		lspIdentifier identifier;
+		identifier.column = encodedLength(text, lineStart, i, utf8);
+		size_t start = i;
+		while ((i < text.size()) && (isalnum((unsigned char)text[i]) || (text[i] == '_'))) {
+			identifier.name += (char)toupper((unsigned char)text[i]);
+			i++;
+		}
+		if (keywords.count(identifier.name) > 0) continue;
+		identifier.spelling = text.substr(start, i - start);
+		identifier.occurrence = onLine[identifier.name]++;
+		lines.back().push_back(identifier);
+	}
+	return lines;
+}
+
+// Parse the tokens of the text, collecting its declarations, uses and diagnostics
+static shared_ptr<lspAnalysis> analyze(const string& text, const vector<Token>& tokens, int version, bool utf8) {
+	shared_ptr<lspAnalysis> analysis = make_shared<lspAnalysis>();
+	analysis->version = version;
+	analysis->lines = findIdentifiers(text, utf8);
+
+	compilerOptions options;
+	options.parseOnly = true;
+	options.exitOnFatal = false;
+	Scanner scanner;
+	Token token;
+	scanner.token = &token;
+	scopeMap scopes(false);
+	scopes.index = &analysis->index;
+	scanner.startTokens(&tokens, text.size());
+	token = scanner.getToken();
+	irModule module;
+	Parser parser(&token, &scanner, &scopes, options, &module);
+
+	for (size_t d = 0; d < parser.diagnostics.size(); d++) {
+		parserDiagnostic& diagnostic = parser.diagnostics[d];
+		int line = (diagnostic.line > 0) ? diagnostic.line - 1 : 0;
+		size_t start = offsetOf(text, line, 0, utf8);
+		size_t end = text.find('\n', start);
+		if (end == string::npos) end = text.size();
+		if ((end > start) && (text[end - 1] == '\r')) end--;
+		jsonValue range = jsonValue::object();
+		range.set("start", jsonValue::object().set("line", line).set("character", 0));
+		range.set("end", jsonValue::object().set("line", line).set("character", encodedLength(text, start, end, utf8)));
+		jsonValue item = jsonValue::object();
+		item.set("range", range);
+		item.set("severity", (diagnostic.kind == "Warning") ? LSP_SEVERITY_WARNING : LSP_SEVERITY_ERROR);
+		item.set("source", "EECE5183");
+		item.set("code", diagnostic.kind);
+		item.set("message", diagnostic.message);
+		analysis->diagnostics.add(item);
+	}
+	return analysis;
+}
+
+languageServer::languageServer() {
+	running = true;
+	shuttingDown = false;
+	utf8Positions = false;
+}
+
+void languageServer::send(const jsonValue& message) {
+	string content = message.text();
+	lock_guard<mutex> guard(outputLock);
+	fprintf(stdout, "Content-Length: %u\r\n\r\n", (unsigned)content.size());
+	fwrite(content.data(), 1, content.size(), stdout);
+	fflush(stdout);
+}
+
+void languageServer::respond(const jsonValue& id, jsonValue result) {
+	send(jsonValue::object().set("jsonrpc", "2.0").set("id", id).set("result", result));
+}
+
+void languageServer::notify(string method, jsonValue params) {
+	send(jsonValue::object().set("jsonrpc", "2.0").set("method", method).set("params", params));
+}
+
+void languageServer::log(string message) {
+	notify("window/logMessage", jsonValue::object().set("type", 4).set("message", message));
+}
+
+void languageServer::publish(string uri, int version, jsonValue diagnostics) {
+	jsonValue params = jsonValue::object().set("uri", uri).set("diagnostics", diagnostics);
+	if (version >= 0) params.set("version", version);
+	notify("textDocument/publishDiagnostics", params);
+}
+
+// A document was opened or edited. Any analysis already running of it is of an older version now.
+void languageServer::edited(lspDocument& document) {
+	document.changed = chrono::steady_clock::now();
+	if (!document.waiting) document.firstChange = document.changed;
+	document.waiting = true;
+	wake.notify_all();
+}
+
+/* When the worker takes a waiting document: once it has settled after its last edit, or, if it keeps being edited,
+ * early enough that an analysis taking LSP_SETTLE_MS still finishes within the budget of its oldest edit. */
+static chrono::steady_clock::time_point analysisDue(const lspDocument& document) {
+	chrono::steady_clock::time_point settled = document.changed + chrono::milliseconds(LSP_SETTLE_MS);
+	chrono::steady_clock::time_point latest = document.firstChange + chrono::milliseconds(LSP_LATENCY_BUDGET_MS - LSP_SETTLE_MS);
+	return (settled < latest) ? settled : latest;
+}
+
+/* The worker thread. It analyzes the document that is due first, without holding the lock while parsing. An analysis
+ * of a version edited again while it ran is still published, since it is newer than the diagnostics the client has,
+ * and the edits it missed are analyzed next. */
+void languageServer::analyzeDocuments() {
+	unique_lock<mutex> guard(lock);
+	while (running) {
+		map<string, lspDocument>::iterator next = documents.end();
+		for (map<string, lspDocument>::iterator it = documents.begin(); it != documents.end(); it++) {
+			if (it->second.waiting && ((next == documents.end()) || (analysisDue(it->second) < analysisDue(next->second)))) next = it;
+		}
+		if (next == documents.end()) {
+			wake.wait(guard);
+			continue;
+		}
+		chrono::steady_clock::time_point due = analysisDue(next->second);
+		if (chrono::steady_clock::now() < due) {
+			wake.wait_until(guard, due);
+			continue;
+		}
+		string uri = next->first;
+		string text = next->second.text;
+		vector<Token> tokens = next->second.tokens->tokens();
+		int version = next->second.version;
+		chrono::steady_clock::time_point firstChange = next->second.firstChange;
+		bool utf8 = utf8Positions;
+		next->second.waiting = false;
+
+		guard.unlock();
+		shared_ptr<lspAnalysis> analysis = analyze(text, tokens, version, utf8);
+		guard.lock();
+
+		// The document may have been closed, or analyzed again by a newer version's analysis
+		map<string, lspDocument>::iterator it = documents.find(uri);
+		if (it == documents.end()) continue;
+		if (it->second.analysis && (it->second.analysis->version >= version)) continue;
+		it->second.analysis = analysis;
+		publish(uri, version, analysis->diagnostics);
+		long long latency = (long long)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - firstChange).count();
+		if (latency > LSP_LATENCY_BUDGET_MS) {
+			log("Diagnostics of " + uri + " took " + to_string(latency) + " ms after the edit, over the budget of " + to_string(LSP_LATENCY_BUDGET_MS) + " ms");
+		}
+	}
+}
+
+// The last analysis of the document a request is about, or null if it hasn't been analyzed
+shared_ptr<lspAnalysis> languageServer::analysisOf(const jsonValue& params) {
+	lock_guard<mutex> guard(lock);
+	map<string, lspDocument>::iterator it = documents.find(params["textDocument"]["uri"].stringValue);
+	if (it == documents.end()) return shared_ptr<lspAnalysis>();
+	return it->second.analysis;
+}
+
+// The location of an appearance of a name in the index, or null if it isn't in the text (the runtime procedures)
+jsonValue languageServer::location(string uri, lspAnalysis& analysis, symbolPosition& position) {
+	int line = position.line - 1;
+	if ((line < 0) || (line >= (int)analysis.lines.size())) return jsonValue();
+	vector<lspIdentifier>& identifiers = analysis.lines[line];
+	for (size_t i = 0; i < identifiers.size(); i++) {
+		if ((identifiers[i].name != position.name) || (identifiers[i].occurrence != position.occurrence)) continue;
+		jsonValue range = jsonValue::object();
+		range.set("start", jsonValue::object().set("line", line).set("character", identifiers[i].column));
+		range.set("end", jsonValue::object().set("line", line).set("character", identifiers[i].column + (int)identifiers[i].name.size()));
+		return jsonValue::object().set("uri", uri).set("range", range);
+	}
+	return jsonValue();
+}
+
+// The declaration an identifier at a request's position is or refers to, -1 if there isn't one
+static int declarationAt(lspAnalysis& analysis, const jsonValue& params) {
+	int line = params["position"]["line"].asInt();
+	int column = params["position"]["character"].asInt();
+	if ((line < 0) || (line >= (int)analysis.lines.size())) return -1;
+	vector<lspIdentifier>& identifiers = analysis.lines[line];
+	for (size_t i = 0; i < identifiers.size(); i++) {
+		lspIdentifier& identifier = identifiers[i];
+		if ((column < identifier.column) || (column > identifier.column + (int)identifier.name.size())) continue;
+		return analysis.index.find(identifier.name, line + 1, identifier.occurrence);
+	}
+	return -1;
+}
+
+jsonValue languageServer::definition(const jsonValue& params) {
+	shared_ptr<lspAnalysis> analysis = analysisOf(params);
+	if (!analysis) return jsonValue();
+	int declaration = declarationAt(*analysis, params);
+	if (declaration < 0) return jsonValue();
+	return location(params["textDocument"]["uri"].stringValue, *analysis, analysis->index.declarations[declaration].position);
+}
+
+jsonValue languageServer::references(const jsonValue& params) {
+	jsonValue result = jsonValue::array();
+	shared_ptr<lspAnalysis> analysis = analysisOf(params);
+	if (!analysis) return result;
+	int declaration = declarationAt(*analysis, params);
+	if (declaration < 0) return result;
+	string uri = params["textDocument"]["uri"].stringValue;
+	if (params["context"]["includeDeclaration"].boolValue) {
+		jsonValue found = location(uri, *analysis, analysis->index.declarations[declaration].position);
+		if (found.type != JSON_NULL) result.add(found);
+	}
+	vector<symbolPosition>& references = analysis->index.references;
+	for (size_t r = 0; r < references.size(); r++) {
+		if (references[r].declaration != declaration) continue;
+		jsonValue found = location(uri, *analysis, references[r]);
+		if (found.type != JSON_NULL) result.add(found);
+	}
+	return result;
+}
+
+// The declarations in a document whose names contain the query (all of them for an empty one)
+jsonValue languageServer::symbols(string uri, lspAnalysis& analysis, string query) {
+	jsonValue result = jsonValue::array();
+	for (size_t q = 0; q < query.size(); q++) query[q] = (char)toupper((unsigned char)query[q]);
+	vector<symbolDeclaration>& declarations = analysis.index.declarations;
+	for (size_t d = 0; d < declarations.size(); d++) {
+		symbolDeclaration& declaration = declarations[d];
+		if (declaration.position.name.find(query) == string::npos) continue;
+		jsonValue found = location(uri, analysis, declaration.position);
+		if (found.type == JSON_NULL) continue;
+		// Shown as it is written where it is declared
+		string name = declaration.position.name;
+		vector<lspIdentifier>& identifiers = analysis.lines[declaration.position.line - 1];
+		for (size_t i = 0; i < identifiers.size(); i++) {
+			if ((identifiers[i].name == name) && (identifiers[i].occurrence == declaration.position.occurrence)) name = identifiers[i].spelling;
+		}
+		jsonValue symbol = jsonValue::object();
+		symbol.set("name", name);
+		symbol.set("kind", (declaration.symbol.type == TYPE_PROCEDURE) ? LSP_SYMBOL_FUNCTION : LSP_SYMBOL_VARIABLE);
+		symbol.set("location", found);
+		if (declaration.container != "") symbol.set("containerName", declaration.container);
+		result.add(symbol);
+	}
+	return result;
+}
+
+jsonValue languageServer::workspaceSymbols(const jsonValue& params) {
+	vector<pair<string, shared_ptr<lspAnalysis>>> analyses;
+	{
+		lock_guard<mutex> guard(lock);
+		for (map<string, lspDocument>::iterator it = documents.begin(); it != documents.end(); it++) {
+			if (it->second.analysis) analyses.push_back(make_pair(it->first, it->second.analysis));
+		}
+	}
+	jsonValue result = jsonValue::array();
+	for (size_t a = 0; a < analyses.size(); a++) {
+		jsonValue found = symbols(analyses[a].first, *analyses[a].second, params["query"].stringValue);
+		for (size_t s = 0; s < found.items.size(); s++) result.add(found.items[s]);
+	}
+	return result;
+}
+
+int languageServer::run() {
+	thread worker(&languageServer::analyzeDocuments, this);
+	int status = 1;
+	string content;
+	while (readMessage(content)) {
+		jsonValue message;
+		if (!jsonValue::parse(content, message)) continue;
+		string method = message["method"].stringValue;
+		const jsonValue& params = message["params"];
+		bool request = message.has("id");
+		const jsonValue& id = message["id"];
+
+		if (method == "initialize") {
+			// Positions are in bytes if the client can take them, which saves converting them
+			const jsonValue& encodings = params["capabilities"]["general"]["positionEncodings"];
+			{
+				lock_guard<mutex> guard(lock);
+				for (size_t e = 0; e < encodings.items.size(); e++) {
+					if (encodings.items[e].stringValue == "utf-8") utf8Positions = true;
+				}
+			}
+			jsonValue sync = jsonValue::object().set("openClose", true).set("change", 2);
+			jsonValue capabilities = jsonValue::object();
+			capabilities.set("positionEncoding", utf8Positions ? "utf-8" : "utf-16");
+			capabilities.set("textDocumentSync", sync);
+			capabilities.set("definitionProvider", true);
+			capabilities.set("referencesProvider", true);
+			capabilities.set("documentSymbolProvider", true);
+			capabilities.set("workspaceSymbolProvider", true);
+			jsonValue info = jsonValue::object().set("name", "EECE5183").set("version", COMPILER_VERSION);
+			respond(id, jsonValue::object().set("capabilities", capabilities).set("serverInfo", info));
+		}
+		else if (method == "shutdown") {
+			shuttingDown = true;
+			respond(id, jsonValue());
+		}
+		else if (method == "exit") {
+			status = shuttingDown ? 0 : 1;
+			break;
+		}
+		else if (method == "textDocument/didOpen") {
+			lock_guard<mutex> guard(lock);
+			const jsonValue& item = params["textDocument"];
+			lspDocument& document = documents[item["uri"].stringValue];
+			document.text = item["text"].stringValue;
+			document.tokens.reset(new tokenStream(document.text));
+			document.version = item["version"].asInt();
+			edited(document);
+		}
+		else if (method == "textDocument/didChange") {
+			lock_guard<mutex> guard(lock);
+			string uri = params["textDocument"]["uri"].stringValue;
+			map<string, lspDocument>::iterator it = documents.find(uri);
+			if (it == documents.end()) continue;
+			const jsonValue& changes = params["contentChanges"];
+			for (size_t c = 0; c < changes.items.size(); c++) applyChange(it->second, changes.items[c], utf8Positions);
+			it->second.version = params["textDocument"]["version"].asInt();
+			edited(it->second);
+		}
+		else if (method == "textDocument/didClose") {
+			string uri = params["textDocument"]["uri"].stringValue;
+			{
+				lock_guard<mutex> guard(lock);
+				documents.erase(uri);
+			}
+			publish(uri, -1, jsonValue::array());
+		}
+		else if (method == "textDocument/definition") respond(id, definition(params));
+		else if (method == "textDocument/references") respond(id, references(params));
+		else if (method == "textDocument/documentSymbol") {
+			shared_ptr<lspAnalysis> analysis = analysisOf(params);
+			respond(id, analysis ? symbols(params["textDocument"]["uri"].stringValue, *analysis, "") : jsonValue::array());
+		}
+		else if (method == "workspace/symbol") respond(id, workspaceSymbols(params));
+		else if (request && (method != "")) {
+			jsonValue error = jsonValue::object().set("code", LSP_METHOD_NOT_FOUND).set("message", "Unhandled method " + method);
+			send(jsonValue::object().set("jsonrpc", "2.0").set("id", id).set("error", error));
+		}
+	}
+	{
+		lock_guard<mutex> guard(lock);
+		running = false;
+	}
+	wake.notify_all();
+	worker.join();
+	return status;
+}
+
+int runLanguageServer() {
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	discardBuffer discarded;
+	streambuf* shown = cout.rdbuf(&discarded);
+	languageServer server;
+	int status = server.run();
+	cout.rdbuf(shown);
+	return status;
+}
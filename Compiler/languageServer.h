@@ -0,0 +1,25 @@
+#ifndef LANGUAGESERVER_H
+#define LANGUAGESERVER_H
+
+// Time a document has to go without an edit before it is analyzed again, so typing doesn't start an analysis per key
+#define LSP_SETTLE_MS 150
+
+/* Diagnostics are published within this long of an edit, even while the document keeps being edited: an analysis is
+ * started early enough to have LSP_SETTLE_MS left to run in. Publishing later than that is logged to the client. */
+#define LSP_LATENCY_BUDGET_MS 300
+
+/*
+ * Language server (Language Server Protocol over stdin and stdout), so an editor shows errors as the program is
+ * written instead of after running the compiler on it. Open documents are kept in memory with the client's edits
+ * applied, to the text and to its tokens, which each edit relexes only around itself (tokenStream). A worker thread
+ * analyzes a document once it has settled after an edit, or once the latency budget of its oldest edit is running
+ * out: it parses the tokens with a symbolIndex attached to the scopeMap, and publishes the parser's errors and
+ * warnings as diagnostics. An analysis of a version that was edited again while it ran is published all the same,
+ * and the newer version is analyzed after it. Positions are in UTF-8 bytes if the client supports them, otherwise in
+ * UTF-16 code units as the protocol defaults to. Go to definition, find references and the document and workspace
+ * symbols come from the index of the last analysis of each document, which covers every declaration and use in all
+ * of its scopes.
+ */
+int runLanguageServer();
+
+#endif
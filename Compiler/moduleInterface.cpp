@@ -0,0 +1,147 @@
+#include "moduleInterface.h"
+#include "scopeInfo.h"
+#include "fileMap.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// Map the interface file and check its header and that the arrays it describes fit in it
+moduleInterface::moduleInterface(string filename) : file(filename.c_str()) {
+	header = nullptr;
+	symbols = nullptr;
+	arguments = nullptr;
+	strings = nullptr;
+	if (!file || (file.size() < sizeof(interfaceHeader))) return;
+
+	const interfaceHeader* candidate = reinterpret_cast<const interfaceHeader*>(file.begin());
+	if ((memcmp(candidate->magic, INTERFACE_MAGIC, sizeof(candidate->magic)) != 0) || (candidate->version != INTERFACE_VERSION)) return;
+	size_t bytes = sizeof(interfaceHeader) + (size_t)candidate->symbolCount * sizeof(interfaceSymbol);
+	bytes += (size_t)candidate->argumentCount * sizeof(interfaceArgument) + candidate->stringBytes;
+	if (bytes != file.size()) return;
+
+	header = candidate;
+	symbols = reinterpret_cast<const interfaceSymbol*>(file.begin() + sizeof(interfaceHeader));
+	arguments = reinterpret_cast<const interfaceArgument*>(symbols + header->symbolCount);
+	strings = reinterpret_cast<const char*>(arguments + header->argumentCount);
+}
+
+// A string in the table. An offset past its end (a damaged file) reads as "".
+const char* moduleInterface::text(uint32_t offset) {
+	if ((offset >= header->stringBytes) || (memchr(strings + offset, '\0', header->stringBytes - offset) == nullptr)) return "";
+	return strings + offset;
+}
+
+// Whether the file was mapped and is an interface written by this version
+bool moduleInterface::valid() {
+	return header != nullptr;
+}
+
+size_t moduleInterface::size() {
+	return header ? header->symbolCount : 0;
+}
+
+// The record of an exported symbol, nullptr if the module doesn't export it
+const interfaceSymbol* moduleInterface::find(string name) {
+	if (!header) return nullptr;
+	size_t low = 0, high = header->symbolCount;
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		int order = strcmp(text(symbols[middle].name), name.c_str());
+		if (order == 0) return &symbols[middle];
+		if (order < 0) low = middle + 1;
+		else high = middle;
+	}
+	return nullptr;
+}
+
+// Put an exported symbol's table entry into &value. Returns false if the module doesn't export it.
+bool moduleInterface::lookup(string name, scopeInfo& value) {
+	const interfaceSymbol* symbol = find(name);
+	if (!symbol) return false;
+	value = scopeInfo();
+	value.type = symbol->type;
+	value.size = symbol->size;
+	value.returnType = symbol->returnType;
+	value.callLabel = text(symbol->callLabel);
+	if ((symbol->firstArgument > header->argumentCount) || (symbol->argumentCount > header->argumentCount - symbol->firstArgument)) return true;
+	for (uint32_t i = 0; i < symbol->argumentCount; i++) {
+		const interfaceArgument& argument = arguments[symbol->firstArgument + i];
+		scopeInfo parameter;
+		parameter.type = argument.type;
+		parameter.size = argument.size;
+		parameter.parameterType = argument.parameterType;
+		value.arguments.push_back(parameter);
+	}
+	return true;
+}
+
+/* Write the interface of a module exporting the symbols. It is written to a temporary file first and then renamed,
+ * so a program importing it while it is written never maps a partial one. */
+bool moduleInterface::write(string filename, const vector<pair<string, scopeInfo>>& exported) {
+	vector<pair<string, scopeInfo>> sorted = exported;
+	sort(sorted.begin(), sorted.end(), [](const pair<string, scopeInfo>& a, const pair<string, scopeInfo>& b) {
+		return a.first < b.first;
+	});
+
+	vector<interfaceSymbol> symbolRecords;
+	vector<interfaceArgument> argumentRecords;
+	string table;
+	for (size_t i = 0; i < sorted.size(); i++) {
+		const scopeInfo& value = sorted[i].second;
+		interfaceSymbol symbol;
+		symbol.name = (uint32_t)table.size();
+		table += sorted[i].first;
+		table += '\0';
+		symbol.callLabel = (uint32_t)table.size();
+		table += value.callLabel;
+		table += '\0';
+		symbol.type = value.type;
+		symbol.size = value.size;
+		symbol.returnType = value.returnType;
+		symbol.firstArgument = (uint32_t)argumentRecords.size();
+		symbol.argumentCount = (uint32_t)value.arguments.size();
+		for (size_t a = 0; a < value.arguments.size(); a++) {
+			interfaceArgument argument;
+			argument.type = value.arguments[a].type;
+			argument.size = value.arguments[a].size;
+			argument.parameterType = value.arguments[a].parameterType;
+			argumentRecords.push_back(argument);
+		}
+		symbolRecords.push_back(symbol);
+	}
+
+	interfaceHeader header;
+	memcpy(header.magic, INTERFACE_MAGIC, sizeof(header.magic));
+	header.version = INTERFACE_VERSION;
+	header.symbolCount = (uint32_t)symbolRecords.size();
+	header.argumentCount = (uint32_t)argumentRecords.size();
+	header.stringBytes = (uint32_t)table.size();
+
+	string temporary = filename + ".tmp";
+	{
+		ofstream out(temporary.c_str(), ios::out | ios::binary | ios::trunc);
+		if (!out) return false;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!symbolRecords.empty()) out.write(reinterpret_cast<const char*>(&symbolRecords[0]), symbolRecords.size() * sizeof(interfaceSymbol));
+		if (!argumentRecords.empty()) out.write(reinterpret_cast<const char*>(&argumentRecords[0]), argumentRecords.size() * sizeof(interfaceArgument));
+		out.write(table.data(), table.size());
+		if (!out) {
+			out.close();
+			remove(temporary.c_str());
+			return false;
+		}
+	}
+#ifdef _WIN32
+	remove(filename.c_str());
+#endif
+	if (rename(temporary.c_str(), filename.c_str()) != 0) {
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
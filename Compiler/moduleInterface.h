@@ -0,0 +1,81 @@
+#ifndef MODULEINTERFACE_H
+#define MODULEINTERFACE_H
+
+#include "scopeInfo.h"
+#include "fileMap.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// First bytes of every interface file
+#define INTERFACE_MAGIC "EECEMODI"
+
+// Changes whenever the layout of the records changes, so an interface written by another version isn't read as this one
+#define INTERFACE_VERSION 1
+
+/* Struct at the start of an interface file. The symbols, their arguments and the string table follow it in that order.
+ *    magic - INTERFACE_MAGIC, without its terminating NUL
+ *    version - INTERFACE_VERSION of the compiler that wrote it
+ *    symbolCount / argumentCount - records in the symbol and argument arrays
+ *    stringBytes - size of the string table, which holds NUL terminated names and labels
+ */
+struct interfaceHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t symbolCount;
+	uint32_t argumentCount;
+	uint32_t stringBytes;
+};
+
+/* Struct to hold an exported symbol, sorted by name in the file so it can be looked up in place.
+ *    name / callLabel - offsets of the symbol's name and of a procedure's call label in the string table
+ *    type / size / returnType - as in scopeInfo
+ *    firstArgument / argumentCount - a procedure's parameters in the argument array
+ */
+struct interfaceSymbol {
+	uint32_t name;
+	uint32_t callLabel;
+	int32_t type;
+	int32_t size;
+	int32_t returnType;
+	uint32_t firstArgument;
+	uint32_t argumentCount;
+};
+
+/* Struct to hold a parameter of an exported procedure.
+ *    type / size / parameterType - as in scopeInfo
+ */
+struct interfaceArgument {
+	int32_t type;
+	int32_t size;
+	int32_t parameterType;
+};
+
+/*
+ * Interface of a separately compiled module: the global procedures and variables of its program scope, written with
+ * --export and read by the programs that --import it instead of parsing its source again. The file is a header and
+ * arrays of fixed size records, so it is mapped into memory and read where it is, without building anything per
+ * symbol. A lookup is a binary search over the mapped symbols, and only the symbols a program uses are turned into
+ * scopeInfo. Every record has 4 byte fields in the byte order of the machine that wrote it.
+ */
+class moduleInterface
+{
+private:
+	fileMap file;
+	const interfaceHeader* header;
+	const interfaceSymbol* symbols;
+	const interfaceArgument* arguments;
+	const char* strings;
+	const char* text(uint32_t offset);
+public:
+	moduleInterface(string filename);
+	bool valid();
+	size_t size();
+	const interfaceSymbol* find(string name);
+	bool lookup(string name, scopeInfo& value);
+	static bool write(string filename, const vector<pair<string, scopeInfo>>& exported);
+};
+
+#endif
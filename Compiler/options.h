@@ -0,0 +1,59 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Size the compile cache directory is kept under, unless --cachesize sets another one
+#define CACHE_DEFAULT_MEGABYTES 256
+
+/* Struct to hold the command line options that change how a program is compiled.
+ *    debug - print each token as it is scanned and each scope's symbol table when it is exited
+ *    stats - print counts of the optimizations done
+ *    emitIR - print the IR of each procedure after optimization
+ *    optimize - run the IR optimization passes
+ *    inlineBudget - largest procedure (in IR instructions) inlined at a call site, 0 turns inlining off
+ *    profile - file of call counts used to guide inlining, "" if there is none
+ *    memoize - give pure recursive procedures a memo table of the results for the arguments they were called with
+ *    regStats - print counts of the values the register allocator kept in registers and spilled
+ *    frameReport - print the frame size of each procedure before and after frame layout
+ *    jobs - threads procedures are optimized and compiled on, 0 for one per hardware thread
+ *    cacheDirectory - directory of the compile cache, "" to not use one
+ *    cacheMegabytes - size the compile cache directory is kept under, at least 1
+ *    timeReport - print the time spent in each phase of the compiler, "table" or "json", "" to not print it
+ *    memoryReport - print the heap allocations made in each phase of the compiler and at its busiest sites
+ *    scanOnly - only scan the source, for measuring the scanner (benchmark/benchmark.cpp)
+ *    parseOnly - scan and parse the source, but don't optimize it or generate code
+ *    exitOnFatal - end the process on a fatal parse error, otherwise parsing just stops there (languageServer.cpp)
+ *    imports - interface files of the modules whose global symbols the program can use (moduleInterface.h)
+ *    exportInterface - file to write the interface of the program's own global symbols to, "" to not write one
+ *    syntaxFile - file of the source's tokens and syntax tree, read instead of scanning a source that hasn't changed and
+ *                 written otherwise, "" to not use one (syntaxTree.h)
+ * Options that change the output must be part of the compile cache key (compileCache::key).
+ */
+struct compilerOptions {
+	bool debug = false;
+	bool stats = false;
+	bool emitIR = false;
+	bool optimize = true;
+	int inlineBudget = 40;
+	string profile = "";
+	bool memoize = false;
+	bool regStats = false;
+	bool frameReport = false;
+	int jobs = 0;
+	string cacheDirectory = "";
+	int cacheMegabytes = CACHE_DEFAULT_MEGABYTES;
+	string timeReport = "";
+	bool memoryReport = false;
+	bool scanOnly = false;
+	bool parseOnly = false;
+	bool exitOnFatal = true;
+	vector<string> imports;
+	string exportInterface = "";
+	string syntaxFile = "";
+};
+
+#endif
@@ -4,12 +4,49 @@
 #include "tokentypes.h"
 #include "scopeInfo.h"
 #include "token.h"
+#include "phaseReport.h"
+#include "syntaxTree.h"
 #include <string>
 #include <iostream>
 #include <queue>
+#include <cstdlib>
+#include <cctype>
 
 using namespace std;
 
+// Counts one more level of nesting while a declaration, statement or expression is being parsed
+class nestingLevel
+{
+private:
+	int& nesting;
+public:
+	nestingLevel(int& nesting_input) : nesting(nesting_input) {
+		nesting++;
+	}
+	~nestingLevel() {
+		nesting--;
+	}
+};
+
+/* Keeps a node of the syntax tree open while the construct it is for is parsed, if a tree is being built. The node
+ * is dropped if its kind is never set, when the construct wasn't there after all. */
+class treeNode
+{
+private:
+	syntaxTree* tree;
+	size_t node;
+public:
+	int kind = 0;
+	int type = 0;
+	int size = 0;
+	treeNode(syntaxTree* tree_input, bool fromIdentifier = false) : tree(tree_input) {
+		node = tree ? tree->begin(fromIdentifier) : 0;
+	}
+	~treeNode() {
+		if (tree) tree->end(node, kind, type, size);
+	}
+};
+
 /* Constructor for the parser
  * Grabs the linked list of tokens from the scanner
  * Starts parsing using the Program() grammar
@@ -19,20 +56,33 @@ using namespace std;
  * 	zero or more { }*
  * 	or one or more { }+
  */
-Parser::Parser(Token* tokenPtr, Scanner* scannerPtr, scopeMap* prgScopes) {
+Parser::Parser(Token* tokenPtr, Scanner* scannerPtr, scopeMap* prgScopes, compilerOptions options_input, irModule* module) {
 	// Set default values needed to begin parsing and attach other compiler classes to their pointers
 	token = tokenPtr;
 	scopes = prgScopes;
 	scanner = scannerPtr;
 	textLine = "";
 	currentLine = 0;
+	nesting = 0;
 	hasWarning = false;
 	hasError = false;
 	hasLineError = false;
-	outArg = false;
+	callCount = 0;
+	options = options_input;
+	builder = new irBuilder(module);
+	exprValue = -1;
+	memoPragma = -1;
+	foldedNodes = 0;
+	propagatedUses = 0;
+	constantConditions = 0;
 
-	// Start program parsing
-	Program();
+	// Start program parsing. A fatal error ends it here when the process keeps running (options.exitOnFatal).
+	try {
+		Program();
+	}
+	catch (parserStopped&) {
+		return;
+	}
 
 	// Ensure the end of the file is reached
 	if (token->type != T_EOF) {
@@ -52,11 +102,15 @@ Parser::Parser(Token* tokenPtr, Scanner* scannerPtr, scopeMap* prgScopes) {
 		cout << "\nParser completed with no errors or warnings.\n\tCode has been generated.\n" << endl;
 	}
 
+	if (options.stats) DisplayStats();
 }
 
 // Destructor
 Parser::~Parser() {
+	delete builder;
+
 	// Set all pointers to nullptr
+	builder = nullptr;
 	token = nullptr;
 	scanner = nullptr;
 	scopes = nullptr;
@@ -64,30 +118,33 @@ Parser::~Parser() {
 
 // Report fatal error and stop parsing.
 void Parser::ReportFatalError(string message) {
-	error_queue.push("Fatal Error: line - " + to_string(currentLine) + "\n\t" + message + "\n\tFound: " + textLine + " " + token->ascii);
+	COUNT_PHASE(diagnostics, 1);
+	ALLOCATION_SITE("Parser diagnostics");
+	error_queue.push("Fatal Error: line - " + to_string(currentLine) + "\n\t" + message + "\n\tFound: " + ErrorContext() + " " + token->ascii);
+	diagnostics.push_back({ currentLine, "Fatal Error", message });
 	hasError = true;
 	DisplayErrorQueue();
+	if (!options.exitOnFatal) throw parserStopped();
 	exit(EXIT_FAILURE);
 }
 
 // Report error, line number, and descriptive message. Get tokens until the next line or a ';' is found.
 void Parser::ReportLineError(string message, bool skipSemicolon = true) {
+	COUNT_PHASE(diagnostics, 1);
+	ALLOCATION_SITE("Parser diagnostics");
 	hasError = true;
 	hasLineError = true;
 
 	// Use a '^' under the error text line to indicate where the error was encountered
-	int error_location = textLine.size();
-	string error_callout = "";
-	while (error_location > 0) {
-		error_location--;
-		error_callout.append(" ");
-	}
-	error_callout.append("^");
+	string context = ErrorContext();
+	string error_callout = string(context.size(), ' ') + "^";
 
-	// Get the rest of the line of tokens ( looks for newline or a semicolon )
+	// Get the rest of the line of tokens ( looks for newline or a semicolon ). Only the start of it is shown.
+	string rest = "";
 	bool getNext = true;
 	while (getNext) {
-		textLine.append(" " + token->ascii);
+		if (rest.size() < ERROR_CONTEXT_CHARS) rest.append(" " + token->ascii);
+		else if (rest.compare(rest.size() - 4, 4, " ...") != 0) rest.append(" ...");
 		// attempt to resync for structure keywords
 		if (skipSemicolon) {
 			if (token->type == T_SEMICOLON) {
@@ -96,7 +153,7 @@ void Parser::ReportLineError(string message, bool skipSemicolon = true) {
 			}
 		}
 		switch (token->type) {
-		case T_SEMICOLON: case T_BEGIN: case T_END: case T_PROCEDURE: case T_THEN: case T_ELSE: case T_FOR:
+		case T_SEMICOLON: case T_BEGIN: case T_END: case T_PROCEDURE: case T_THEN: case T_ELSE: case T_FOR: case T_EOF:
 			getNext = false;
 			break;
 		default:
@@ -105,7 +162,8 @@ void Parser::ReportLineError(string message, bool skipSemicolon = true) {
 		if (token->line != currentLine) getNext = false;
 		if (getNext) *token = scanner->getToken();
 	}
-	error_queue.push("Line Error: line - " + to_string(currentLine) + "\n\t" + message + "\n\tFound: " + textLine + "\n\t       " + error_callout);
+	error_queue.push("Line Error: line - " + to_string(currentLine) + "\n\t" + message + "\n\tFound: " + context + rest + "\n\t       " + error_callout);
+	diagnostics.push_back({ currentLine, "Line Error", message });
 	textLine = "";
 	currentLine = token->line;
 	return;
@@ -113,18 +171,31 @@ void Parser::ReportLineError(string message, bool skipSemicolon = true) {
 
 // Report error line number and descriptive message
 void Parser::ReportError(string message) {
-	error_queue.push("Error: line - " + to_string(currentLine) + "\n\t" + message + "\n\tFound: " + textLine + " " + token->ascii);
+	COUNT_PHASE(diagnostics, 1);
+	ALLOCATION_SITE("Parser diagnostics");
+	error_queue.push("Error: line - " + to_string(currentLine) + "\n\t" + message + "\n\tFound: " + ErrorContext() + " " + token->ascii);
+	diagnostics.push_back({ currentLine, "Error", message });
 	hasError = true;
 	return;
 }
 
 // Report warning and descriptive message
 void Parser::ReportWarning(string message) {
-	error_queue.push("Warning: line - " + to_string(currentLine) + "\n\t" + message + "\n\tFound: " + textLine + " " + token->ascii);
+	COUNT_PHASE(diagnostics, 1);
+	ALLOCATION_SITE("Parser diagnostics");
+	error_queue.push("Warning: line - " + to_string(currentLine) + "\n\t" + message + "\n\tFound: " + ErrorContext() + " " + token->ascii);
+	diagnostics.push_back({ currentLine, "Warning", message });
 	hasWarning = true;
 	return;
 }
 
+/* The line's text up to the current token for an error message. Only the last ERROR_CONTEXT_CHARS characters of a long
+ * line are shown, so a line with many errors (like generated code all on one line) doesn't copy the whole line into each. */
+string Parser::ErrorContext() {
+	if (textLine.size() <= ERROR_CONTEXT_CHARS) return textLine;
+	return " ..." + textLine.substr(textLine.size() - ERROR_CONTEXT_CHARS);
+}
+
 // Display all of the stored warnings/errors after parsing is complete or a fatal error occurs
 void Parser::DisplayErrorQueue() {
 	if (!error_queue.empty())
@@ -138,12 +209,46 @@ void Parser::DisplayErrorQueue() {
 	return;
 }
 
-// Check if current token is the correct type, if so get next
-bool Parser::CheckToken(int type) {
-	// Skip over any comment tokens
+// True if any errors were found, in which case the IR is incomplete and must not be used
+bool Parser::HasErrors() {
+	return hasError;
+}
+
+// Display the optimization counters gathered while parsing
+void Parser::DisplayStats() {
+	cout << "Statistics:\n" << endl;
+	cout << "\tFolded constant expressions: " << foldedNodes << endl;
+	cout << "\tPropagated constant uses: " << propagatedUses << endl;
+	cout << "\tConstant conditions: " << constantConditions << "\n" << endl;
+	return;
+}
+
+// Skip over any comment tokens
+void Parser::SkipComments() {
 	while (token->type == T_COMMENT) {
+		ReadPragma(token->ascii);
 		*token = scanner->getToken();
 	}
+}
+
+/* Pragmas are single line comments starting with '#'. The only pragma is
+ *		//#memo <number>
+ * which sets the number of entries in the memo table of the next procedure (0 means it is never memoized).
+ * See the --memoize option. */
+void Parser::ReadPragma(string comment) {
+	if (comment.compare(0, 7, "//#memo") != 0) return;
+	size_t start = comment.find_first_not_of(" \t", 7);
+	if ((start == string::npos) || (start == 7) || !isdigit((unsigned char)comment[start])) {
+		ReportWarning("Ignoring bad pragma. Expected '//#memo <number>'.");
+		return;
+	}
+	memoPragma = atoi(comment.c_str() + start);
+}
+
+// Check if current token is the correct type, if so get next
+bool Parser::CheckToken(int type) {
+	ALLOCATION_SITE("Parser::CheckToken");
+	SkipComments();
 
 	if (token->line != currentLine) {
 		currentLine = token->line;
@@ -166,37 +271,54 @@ bool Parser::CheckToken(int type) {
 	else return false;
 }
 
-void Parser::DeclareRunTime() {
-	// Procedure to be added to the symbol tables
-	scopeInfo procVal;
-	procVal.size = 0;
-	procVal.type = TYPE_PROCEDURE;
-	procVal.parameterType = TYPE_PARAM_NULL;
-
-	// input / output parameter of the runtime procedure
-	scopeInfo inputVal;
-	inputVal.arguments.clear();
-
-	string IDs[8] = { "GETBOOL", "GETINTEGER", "GETFLOAT", "GETSTRING", "PUTBOOL", "PUTINTEGER", "PUTFLOAT", "PUTSTRING" };
-	int parameterTypes[8] = { TYPE_PARAM_OUT, TYPE_PARAM_OUT, TYPE_PARAM_OUT, TYPE_PARAM_OUT, TYPE_PARAM_IN, TYPE_PARAM_IN, TYPE_PARAM_IN, TYPE_PARAM_IN };
-	int Types[8] = { TYPE_BOOL, TYPE_INTEGER, TYPE_FLOAT, TYPE_STRING, TYPE_BOOL, TYPE_INTEGER, TYPE_FLOAT, TYPE_STRING };
-
-	for (int i = 0; i < 8; i++) {
-		// Clear parameter list
-		procVal.arguments.clear();
-
+/* The runtime procedures from runtime.h, as the symbols they are declared as.
+ * GET* procedures take no arguments and return the value read, PUT* procedures take the value to write and return true.
+ * The list is built the first time it is used and shared by every parser, so a process compiling many programs
+ * (compilerServer.cpp) only builds it once.
+ */
+const vector<pair<string, scopeInfo>>& Parser::RunTimeDeclarations() {
+	static const vector<pair<string, scopeInfo>> declarations = []() {
+		vector<pair<string, scopeInfo>> list;
+		// Procedure to be added to the symbol tables
+		scopeInfo procVal;
+		procVal.size = 0;
+		procVal.type = TYPE_PROCEDURE;
+		procVal.parameterType = TYPE_PARAM_NULL;
+
+		// input parameter of the PUT* procedures
+		scopeInfo inputVal;
+		inputVal.arguments.clear();
+		inputVal.parameterType = TYPE_PARAM_IN;
 		inputVal.size = 0;
 
-		// Get new parameter values
-		inputVal.type = Types[i];
-		inputVal.parameterType = parameterTypes[i];
+		string IDs[8] = { "GETBOOL", "GETINTEGER", "GETFLOAT", "GETSTRING", "PUTBOOL", "PUTINTEGER", "PUTFLOAT", "PUTSTRING" };
+		string labels[8] = { "getBool", "getInteger", "getFloat", "getString", "putBool", "putInteger", "putFloat", "putString" };
+		int Types[8] = { TYPE_BOOL, TYPE_INTEGER, TYPE_FLOAT, TYPE_STRING, TYPE_BOOL, TYPE_INTEGER, TYPE_FLOAT, TYPE_STRING };
 
-		// Start new parameter list
-		procVal.arguments.push_back(inputVal);
+		for (int i = 0; i < 8; i++) {
+			// Clear parameter list
+			procVal.arguments.clear();
+
+			if (i < 4) procVal.returnType = Types[i];
+			else {
+				procVal.returnType = TYPE_BOOL;
+				inputVal.type = Types[i];
+				procVal.arguments.push_back(inputVal);
+			}
+			procVal.callLabel = labels[i];
+			list.push_back(make_pair(IDs[i], procVal));
+		}
+		return list;
+	}();
+	return declarations;
+}
 
-		// Add procedure as a global symbol to the outermost scope
-		string symbolID = IDs[i];
-		procVal.callLabel = IDs[i];
+// Declare the runtime procedures as global symbols in the outermost scope
+void Parser::DeclareRunTime() {
+	const vector<pair<string, scopeInfo>>& declarations = RunTimeDeclarations();
+	for (size_t i = 0; i < declarations.size(); i++) {
+		string symbolID = declarations[i].first;
+		scopeInfo procVal = declarations[i].second;
 		scopes->addSymbol(symbolID, procVal, true);
 	}
 	return;
@@ -204,11 +326,25 @@ void Parser::DeclareRunTime() {
 
 // <program> ::= <program_header> <program_body>
 void Parser::Program() {
+	TIME_PHASE(PHASE_PROGRAM);
+	treeNode node(scanner->tree);
+	node.kind = NODE_PROGRAM;
 	scopes->newScope(); // Create a new scope for the program
+	constTable.push_back(map<string, constValue>());
 	DeclareRunTime(); // Set up runtime functions as global in the outermost scope
+	builder->beginFunction("main", 0);
 	if (!ProgramHeader()) ReportError("Expected program header.");
 	if (!ProgramBody()) ReportError("Expected program body.");
+	builder->endFunction(scopes->getFrameSize());
 	if (!CheckToken(T_PERIOD)) ReportWarning("Expected '.' at end of program.");
+
+	// The program's interface is its own global symbols, not the runtime's or those it imported
+	if (options.exportInterface != "") {
+		const vector<pair<string, scopeInfo>>& runtime = RunTimeDeclarations();
+		map<string, scopeInfo> globals = scopes->getGlobals();
+		for (size_t i = 0; i < runtime.size(); i++) globals.erase(runtime[i].first);
+		exported.assign(globals.begin(), globals.end());
+	}
 	if (CheckToken(T_EOF)) scopes->exitScope(); // Exit program scope once program ends
 
 	else ReportError("Found some tokens remaining in file when end of program was expected.");
@@ -292,6 +428,10 @@ bool Parser::ProgramBody() {
  *      |[ global ] <type_declaration>
  */
 bool Parser::Declaration(bool& procDec) {
+	TIME_PHASE(PHASE_DECLARATION);
+	nestingLevel level(nesting);
+	if (nesting > MAX_NESTING) ReportFatalError("Declarations are nested more than " + to_string(MAX_NESTING) + " deep.");
+	treeNode node(scanner->tree);
 	bool global;
 	string id;
 	scopeInfo newSymbol;
@@ -308,17 +448,31 @@ bool Parser::Declaration(bool& procDec) {
 
 	// Determine if a procedure or variable declaration exists
 	if (ProcedureDeclaration(id, newSymbol, global)) {
+		node.kind = NODE_PROCEDURE;
+		node.type = newSymbol.returnType;
 		scopes->exitScope();
+		constTable.pop_back();
 		scopes->addSymbol(id, newSymbol, global);
 		procDec = true;
 		return true;
 	}
 	else if (VariableDeclaration(id, newSymbol)) {
+		node.kind = NODE_VARIABLE;
+		node.type = newSymbol.type;
+		node.size = newSymbol.size;
 		// Add symbol to current scope. VariableDeclaration will pass the symbol's type and size members.
-		scopes->addSymbol(id, newSymbol, global);
+		if (scopes->addSymbol(id, newSymbol, global)) {
+			// Look the symbol back up to get the frame offset it was given
+			scopeInfo stored;
+			bool storedGlobal;
+			scopes->checkSymbol(id, stored, storedGlobal);
+			builder->declareVariable(id, newSymbol.type, newSymbol.size, global, stored.FPoffset);
+		}
 		return true;
 	}
 	else if (TypeDeclaration(id, newSymbol)) {
+		node.kind = NODE_TYPE;
+		node.type = newSymbol.type;
 		// Add symbol to current scope. TypeDeclaration will pass the symbol's type and size members.
 		scopes->addSymbol(id, newSymbol, global);
 		return true;
@@ -419,7 +573,10 @@ bool Parser::TypeMark(int& type) {
 bool Parser::ProcedureDeclaration(string& id, scopeInfo& procDeclaration, bool global) {
 	//Get Procedure Header
 	if (ProcedureHeader(id, procDeclaration, global)) {
-		if (ProcedureBody()) return true;
+		if (ProcedureBody()) {
+			builder->endFunction(scopes->getFrameSize());
+			return true;
+		}
 		else {
 			ReportFatalError("Expected procedure body after procedure header.");
 			return true;
@@ -433,10 +590,12 @@ bool Parser::ProcedureHeader(string& id, scopeInfo& procDeclaration, bool global
 	if (CheckToken(T_PROCEDURE)) {
 		//Create new scope in nested symbol tables for the procedure
 		scopes->newScope();
+		constTable.push_back(map<string, constValue>());
 
 		// Set the symbol table entry's type and size to the correct values for a procedure
 		procDeclaration.type = TYPE_PROCEDURE;
 		procDeclaration.size = 0;
+		procDeclaration.returnType = T_UNKNOWN;
 
 		// Get procedure identifier and set value to be added to the symbol table
 		if (Identifier(id)) {
@@ -450,6 +609,11 @@ bool Parser::ProcedureHeader(string& id, scopeInfo& procDeclaration, bool global
 				ReportLineError("Bad line. Expected colon after procedure name.");
 			}
 
+			// Start the procedure's IR before its parameters are declared
+			procDeclaration.callLabel = builder->beginFunction(id, procDeclaration.returnType);
+			if (memoPragma >= 0) builder->setMemoSize(memoPragma);
+			memoPragma = -1;
+
 			// Get parameter list for the procedure, if it has parameters
 			if (CheckToken(T_LPAREN)) {
 				ParameterList(procDeclaration);
@@ -537,6 +701,7 @@ bool Parser::ProcedureBody() {
 bool Parser::ProcedureCall(string id) {
 	// Argument list whose type and size values will be compared against those declared in the procedure's parameter list
 	vector<scopeInfo> argList;
+	vector<int> argValues;
 	scopeInfo procedureCall;
 	bool isGlobal;
 	int offset = 2;
@@ -544,17 +709,25 @@ bool Parser::ProcedureCall(string id) {
 
 	// Ensure an id was found in the assignment statement check called right before ProcedureCall, otherwise return false
 	if (id == "") return false;
+	treeNode node(scanner->tree, true);
+	node.kind = NODE_CALL;
 
 	// Get procedure's declared information from scope table
 	found = scopes->checkSymbol(id, procedureCall, isGlobal);
 
 	// Get argument list used in the procedure call
 	if (CheckToken(T_LPAREN)) {
-		ArgumentList(argList, procedureCall, offset);
+		ArgumentList(argList, procedureCall, offset, argValues);
 		if (!CheckToken(T_RPAREN)) ReportLineError("Expected ')' closing procedure call.");
 	}
 	else ReportError("Expected '(' in procedure call.");
 
+	// The called procedure may change any global variable
+	callCount++;
+	KillGlobalConsts();
+	if (found) exprValue = builder->call(procedureCall.callLabel, argValues, procedureCall.returnType);
+	else exprValue = -1;
+
 	// Compare called argument list against the procedure parameter list
 	if (found) {
 		bool match = true;
@@ -587,9 +760,10 @@ bool Parser::ProcedureCall(string id) {
  *	 <expression> , <argument_list>
  *	|<expression>
  */
-bool Parser::ArgumentList(vector<scopeInfo>& list, scopeInfo procValue, int& offset) {
+bool Parser::ArgumentList(vector<scopeInfo>& list, scopeInfo procValue, int& offset, vector<int>& values) {
 	// Create vector<scopeInfo> where all argument list information will be stored and later returned by the function
 	list.clear();
+	values.clear();
 
 	/* argEntry variable will contain argument information about expression type and size.
 	 * All arguments will have an empty arguments vector and have their parameterType = TYPE_PARAM_NULL
@@ -600,36 +774,48 @@ bool Parser::ArgumentList(vector<scopeInfo>& list, scopeInfo procValue, int& off
 
 	// For each comma-separated expression, store the type and size values, in the order encountered, in the 'list' vector
 	vector<scopeInfo>::iterator it = procValue.arguments.begin();
-	if (it != procValue.arguments.end()) {
-		if (it->parameterType == TYPE_PARAM_OUT) outArg = true;
-	}
 
 	if (Expression(argEntry.type, argEntry.size)) {
 		// GEN: add arguments from register to correct frame
 
 		offset = 2;
-		++it;
 
 		list.push_back(argEntry);
+		values.push_back((it != procValue.arguments.end()) ? PassArgument(*it, exprValue) : exprValue);
+		if (it != procValue.arguments.end()) ++it;
 		while (CheckToken(T_COMMA)) {
-			if (it != procValue.arguments.end()) {
-				if (it->parameterType == TYPE_PARAM_OUT) {
-					outArg = true;
-				}
-				else outArg = false;
-			}
 			if (Expression(argEntry.type, argEntry.size)) {
 				list.push_back(argEntry);
+				values.push_back((it != procValue.arguments.end()) ? PassArgument(*it, exprValue) : exprValue);
 				// Add arguments from register to correct frame
-				++it;
+				if (it != procValue.arguments.end()) ++it;
 			}
 			else ReportError("Expected another argument after ',' in argument list of procedure call.");
 		}
 	}
-	outArg = false;
 	return true;
 }
 
+/* Value passed for an argument of parameter 'param'. Arrays passed by reference are passed as the address of the
+ * argument's variable. An 'out' or 'inout' array must be a variable the procedure is allowed to change, but an 'in'
+ * array can be any array expression, which is passed as the address of a temporary. */
+int Parser::PassArgument(scopeInfo& param, int value) {
+	if ((param.size == 0) || (param.parameterType == TYPE_PARAM_NULL)) return value;
+	if (param.parameterType == TYPE_PARAM_IN) return builder->address(value);
+
+	string name = builder->arrayName(value);
+	scopeInfo argument;
+	bool isGlobal;
+	if ((name == "") || !scopes->checkSymbol(name, argument, isGlobal)) {
+		if (value >= 0) ReportError("Argument of an 'out' or 'inout' parameter must be an array variable.");
+		return value;
+	}
+	if ((argument.size > 0) && (argument.parameterType == TYPE_PARAM_IN)) {
+		ReportError("Can't pass 'in' parameter " + name + " as an 'out' or 'inout' argument, it is read only.");
+	}
+	return builder->address(value);
+}
+
 
 /*	<parameter_list> ::=
  *		 <parameter> , <parameter_list>
@@ -644,14 +830,36 @@ bool Parser::ParameterList(scopeInfo& procEntry) {
 	return true;
 }
 
-// <parameter> ::= <variable_declaration>
+/* <parameter> ::= <variable_declaration> { in | out | inout }
+ * Parameters without a mode are passed by value. Array parameters with a mode are passed by reference, read only for
+ * 'in' and read-write for 'out' and 'inout', so the caller's array is never copied. Scalars can only be 'in'.
+ */
 bool Parser::Parameter(scopeInfo& procEntry) {
 	scopeInfo paramEntry;
 	string id;
+	treeNode node(scanner->tree);
 	// Get parameter declaration
 	if (VariableDeclaration(id, paramEntry)) {
+		node.kind = NODE_PARAMETER;
+		node.type = paramEntry.type;
+		node.size = paramEntry.size;
+		paramEntry.parameterType = TYPE_PARAM_NULL;
+		if (CheckToken(T_IN)) paramEntry.parameterType = TYPE_PARAM_IN;
+		else if (CheckToken(T_OUT)) paramEntry.parameterType = TYPE_PARAM_OUT;
+		else if (CheckToken(T_INOUT)) paramEntry.parameterType = TYPE_PARAM_INOUT;
+		if ((paramEntry.size == 0) && ((paramEntry.parameterType == TYPE_PARAM_OUT) || (paramEntry.parameterType == TYPE_PARAM_INOUT))) {
+			ReportError("Parameter " + id + " can't be 'out' or 'inout', only array parameters are passed by reference.");
+			paramEntry.parameterType = TYPE_PARAM_NULL;
+		}
+		bool reference = (paramEntry.size > 0) && (paramEntry.parameterType != TYPE_PARAM_NULL);
+
 		// Add parameter to current scope
-		scopes->addSymbol(id, paramEntry, false);
+		if (scopes->addSymbol(id, paramEntry, false)) {
+			scopeInfo stored;
+			bool storedGlobal;
+			scopes->checkSymbol(id, stored, storedGlobal);
+			builder->declareParameter(id, paramEntry.type, paramEntry.size, stored.FPoffset, reference);
+		}
 
 		// Add to current procedure declaration's parameter list
 		procEntry.arguments.push_back(paramEntry);
@@ -668,25 +876,30 @@ bool Parser::Parameter(scopeInfo& procEntry) {
  *		|<return_statement>
  */
 bool Parser::Statement() {
+	TIME_PHASE(PHASE_STATEMENT);
+	nestingLevel level(nesting);
+	if (nesting > MAX_NESTING) ReportFatalError("Statements are nested more than " + to_string(MAX_NESTING) + " deep.");
 	string id = "";
-	if (IfStatement()) return true;
-	else if (LoopStatement()) return true;
-	else if (ReturnStatement()) return true;
-	else if (Assignment(id)) return true;
-	else return false;
+	treeNode node(scanner->tree);
+	if (IfStatement()) node.kind = NODE_IF;
+	else if (LoopStatement()) node.kind = NODE_LOOP;
+	else if (ReturnStatement()) node.kind = NODE_RETURN;
+	else if (Assignment(id)) node.kind = NODE_ASSIGNMENT;
+	return node.kind != 0;
 }
 
 // <assignment_statement> ::= <destination> := <expression>
 bool Parser::Assignment(string& id) {
-	int type, size, dType, dSize;
+	int type = T_UNKNOWN, size = 0, dType, dSize;
 	bool found;
 	scopeInfo destinationValue;
 	bool isGlobal;
 	bool indirect;
 	int indirect_type;
+	int indexValue = -1;
 
 	// Determine destination if this is a valid assignment statement
-	if (!Destination(id, dType, dSize, destinationValue, found, isGlobal, indirect, indirect_type)) {
+	if (!Destination(id, dType, dSize, destinationValue, found, isGlobal, indirect, indirect_type, indexValue)) {
 		return false;
 	}
 
@@ -701,6 +914,18 @@ bool Parser::Assignment(string& id) {
 			if ((type != dType) && ((!isNumber(dType)) || (!isNumber(type)))) {
 				ReportError("Bad assignment, type of expression must match destination.");
 			}
+
+			// Remember the value of scalar variables assigned a constant, forget it otherwise
+			if ((!indirect) && (dSize == 0)) {
+				constValue value;
+				if (!convertConst(exprConst, dType, value)) value = constValue();
+				SetConst(ConstKey(id, isGlobal), value);
+			}
+
+			// Write the value to the destination variable or array element
+			int variable = VariableOf(id, destinationValue, isGlobal);
+			if (indirect) builder->storeElement(variable, indexValue, exprValue);
+			else builder->store(variable, exprValue);
 		}
 		return true;
 	}
@@ -714,7 +939,7 @@ bool Parser::Assignment(string& id) {
  * Returns the destination's identifier (will be used in procedure call if assignment fails).
  * Returns destination's type and size for comparison with what is being assigned to the destination.
  */
-bool Parser::Destination(string& id, int& dType, int& dSize, scopeInfo& destinationValue, bool& found, bool& isGlobal, bool& indirect, int& indirect_type) {
+bool Parser::Destination(string& id, int& dType, int& dSize, scopeInfo& destinationValue, bool& found, bool& isGlobal, bool& indirect, int& indirect_type, int& indexValue) {
 	// Variable to hold destination symbol's information from the nested scope tables
 	int type, size;
 
@@ -732,6 +957,9 @@ bool Parser::Destination(string& id, int& dType, int& dSize, scopeInfo& destinat
 		else {
 			dType = destinationValue.type;
 			dSize = destinationValue.size;
+			if ((dSize > 0) && (destinationValue.parameterType == TYPE_PARAM_IN)) {
+				ReportError("Destination: " + id + " is an 'in' parameter passed by reference and can't be assigned to");
+			}
 		}
 
 		// Reads in array size if the identifier is an array.
@@ -740,6 +968,7 @@ bool Parser::Destination(string& id, int& dType, int& dSize, scopeInfo& destinat
 			if (Expression(type, size)) {
 				// Make sure array index is a single numeric value
 				indirect_type = type;
+				indexValue = exprValue;
 				if (size != 0 || ((type != TYPE_FLOAT) && (type != TYPE_INTEGER) && (type != TYPE_BOOL))) {
 					ReportError("Destination array's index must be a scalar numeric value");
 				}
@@ -797,6 +1026,21 @@ bool Parser::IfStatement() {
 	else if (!CheckToken(T_RPAREN)) {
 		ReportLineError("Expected ')' after condition in if statement.");
 	}
+	else if (exprConst.known) constantConditions++;
+
+	// Branch to the 'then' or 'else' block. An if statement without 'else' uses an empty 'else' block.
+	int thenBlock = builder->newBlock();
+	int elseBlock = builder->newBlock();
+	int endBlock = builder->newBlock();
+	builder->condBranch(exprValue, thenBlock, elseBlock);
+	builder->sealBlock(thenBlock);
+	builder->sealBlock(elseBlock);
+	builder->setBlock(thenBlock);
+
+	/* Each branch starts with the constants known before the if statement.
+	 * Only constants with the same value at the end of both branches are known after it. */
+	map<string, constValue> thenConsts;
+	map<string, constValue> beforeIf = constTable.back();
 
 	/* Get statements to be evaluated if the statement's expression evaluates to true.
 	 * There must be at least one statement following 'then'. */
@@ -816,6 +1060,10 @@ bool Parser::IfStatement() {
 			if (CheckToken(T_ELSE)) {
 				flag = false;
 				resyncEnabled = true;
+				thenConsts = constTable.back();
+				constTable.back() = beforeIf;
+				builder->branch(endBlock);
+				builder->setBlock(elseBlock);
 				while (true) {
 					while (Statement()) {
 						flag = true;
@@ -832,6 +1080,10 @@ bool Parser::IfStatement() {
 						if (!CheckToken(T_IF)) {
 							ReportFatalError("missing 'if' in the 'end if' closure of conditional statement");
 						}
+						MergeConsts(thenConsts);
+						builder->branch(endBlock);
+						builder->sealBlock(endBlock);
+						builder->setBlock(endBlock);
 						return true;
 					}
 					else if (resyncEnabled) {
@@ -849,6 +1101,12 @@ bool Parser::IfStatement() {
 				if (!CheckToken(T_IF)) {
 					ReportFatalError("Missing 'if' in the 'end if' closure of the if statement.");
 				}
+				MergeConsts(beforeIf);
+				builder->branch(endBlock);
+				builder->setBlock(elseBlock);
+				builder->branch(endBlock);
+				builder->sealBlock(endBlock);
+				builder->setBlock(endBlock);
 				return true;
 			}
 			else if (resyncEnabled) {
@@ -880,18 +1138,42 @@ bool Parser::LoopStatement() {
 
 	if (!Assignment(id)) ReportError("Expected an assignment at start of for loop statement.");
 
+	// The loop header is sealed once the branch back from the end of the body is added
+	int headerBlock = builder->newBlock();
+	int bodyBlock = builder->newBlock();
+	int exitBlock = builder->newBlock();
+	builder->branch(headerBlock);
+	builder->setBlock(headerBlock);
+
+	/* The condition and body run again after any statement in the body, so no constants are known inside the loop.
+	 * The constants known before the loop are restored after it, except for variables assigned in the loop. */
+	map<string, constValue> beforeLoop = constTable.back();
+	int callsBeforeLoop = callCount;
+	constTable.back().clear();
+	assignedConsts.push_back(set<string>());
+
 	if (!CheckToken(T_SEMICOLON)) ReportError("Expected ';' separating assignment statement and expression in for loop statement.");
 
 	if (!Expression(type, size)) ReportError("Expected a valid expression following assignment in for loop statement.");
+	else if ((type == TYPE_BOOL) && exprConst.known) constantConditions++;
 
 	if (!CheckToken(T_RPAREN)) ReportError("Expected ')' after assignment and expression in for loop statement.");
 
+	builder->condBranch(exprValue, bodyBlock, exitBlock);
+	builder->sealBlock(bodyBlock);
+	builder->setBlock(bodyBlock);
+
 	while (true) {
 		while (Statement()) {
 			if (!CheckToken(T_SEMICOLON)) ReportLineError("Expected ';' after statement in for loop.", true);
 		}
 		if (CheckToken(T_END)) {
 			if (!CheckToken(T_FOR)) ReportError("Missing 'for' in the 'end for' closure of the for loop statement.");
+			EndLoopConsts(beforeLoop, callsBeforeLoop);
+			builder->branch(headerBlock);
+			builder->sealBlock(headerBlock);
+			builder->sealBlock(exitBlock);
+			builder->setBlock(exitBlock);
 			return true;
 		}
 		else if (resyncEnabled) {
@@ -909,10 +1191,9 @@ bool Parser::LoopStatement() {
 bool Parser::ReturnStatement() {
 	int tempType, tempSize;
 	if (CheckToken(T_RETURN)) {
-		if (Expression(tempType, tempSize))
-		{
-			return true;
-		}
+		if (Expression(tempType, tempSize)) builder->ret(exprValue);
+		else builder->ret(-1);
+		return true;
 	}
 	else return false;
 }
@@ -921,8 +1202,12 @@ bool Parser::ReturnStatement() {
  *		[ not ] <arithOp>
  */
 bool Parser::Expression(int& type, int& size) {
+	TIME_PHASE(PHASE_EXPRESSION);
+	nestingLevel level(nesting);
+	if (nesting > MAX_NESTING) ReportFatalError("Expressions are nested more than " + to_string(MAX_NESTING) + " deep.");
 	// Flag used to determine if an expression is required following a 'NOT' token
 	bool notOp;
+	exprValue = -1;
 	if (CheckToken(T_NOT)) {
 		notOp = true;
 	}
@@ -935,6 +1220,18 @@ bool Parser::Expression(int& type, int& size) {
 		if ((notOp) && (type != TYPE_BOOL) && (type != TYPE_INTEGER)) {
 			ReportError("'NOT' operator is defined only for type Bool and Integer.");
 		}
+		if (notOp) {
+			constValue folded;
+			if (foldNot(exprConst, folded)) {
+				exprConst = folded;
+				foldedNodes++;
+				exprValue = builder->constant(exprConst);
+			}
+			else {
+				exprConst = constValue();
+				exprValue = builder->notOp(exprValue);
+			}
+		}
 		ExpressionPrime(type, size, true, true);
 		return true;
 	}
@@ -954,13 +1251,34 @@ bool Parser::Expression(int& type, int& size) {
  */
 bool Parser::ExpressionPrime(int& inputType, int& inputSize, bool catchTypeError, bool catchSizeError) {
 	int arithOpType, arithOpSize;
+	bool found = false;
 
-	// Get the operator to pass to the codegenerator evaluation stack
-	string op = token->ascii;
-
-	if (CheckToken(T_BITWISE)) {
-		CheckToken(T_NOT); // 'NOT' is always optional and will be good for both integer-bitwise and boolean-boolean expressions.
+	// Each further '&' or '|' <arithOp> is parsed by this loop rather than by recursing, so long
+	// expressions don't take a stack frame for each operator
+	while (true) {
+		// Get the operator to pass to the codegenerator evaluation stack
+		SkipComments();
+		string op = token->ascii;
+
+		if (!CheckToken(T_BITWISE)) return found;
+		found = true;
+		constValue left = exprConst;
+		int leftValue = exprValue;
+		bool notOp = CheckToken(T_NOT); // 'NOT' is always optional and will be good for both integer-bitwise and boolean-boolean expressions.
 		if (ArithOp(arithOpType, arithOpSize)) {
+			if (notOp) {
+				constValue folded;
+				if (foldNot(exprConst, folded)) {
+					exprConst = folded;
+					foldedNodes++;
+					exprValue = builder->constant(exprConst);
+				}
+				else {
+					exprConst = constValue();
+					exprValue = builder->notOp(exprValue);
+				}
+			}
+			FoldBinary(op, left, leftValue);
 			if (catchTypeError) {
 				if (inputType == TYPE_INTEGER) {
 					if (arithOpType != TYPE_INTEGER) {
@@ -990,12 +1308,10 @@ bool Parser::ExpressionPrime(int& inputType, int& inputSize, bool catchTypeError
 			ReportError("Expected ArithOp after '&' or '|' operator.");
 			catchTypeError = false;
 			catchSizeError = false;
+			exprConst = constValue();
+			exprValue = -1;
 		}
-		ExpressionPrime(inputType, inputSize, catchTypeError, catchSizeError);
-
-		return true;
 	}
-	else return false;
 }
 
 /*	<arithOp> ::=
@@ -1017,44 +1333,52 @@ bool Parser::ArithOp(int& type, int& size) {
 bool Parser::ArithOpPrime(int& inputType, int& inputSize, bool catchTypeError, bool catchSizeError) {
 	// Size and type of next Relation in the ArithOp sequence
 	int relationType, relationSize;
+	bool found = false;
 
-	// Get operation to pass to the codegenerator
-	string op = token->ascii;
-
-	// If '+' or '-' can't be found then return false ('null'). Otherwise continue function.
-	if (CheckToken(T_ADD));
-	else if (CheckToken(T_SUBTRACT));
-	else return false;
-
-	// Get next Relation. Otherwise report Missing Relation error.
-	if (Relation(relationType, relationSize)) {
-		// Only allow number (integer / float) relations in arithmetic operations.
-		if (catchTypeError) {
-			if (!isNumber(relationType) || !isNumber(inputType)) {
-				ReportError("Only integer and float values are allowed for arithmetic operations.");
-				catchTypeError = false;
+	// Each further '+' or '-' <relation> is parsed by this loop rather than by recursing, so long
+	// expressions don't take a stack frame for each operator
+	while (true) {
+		// Get operation to pass to the codegenerator
+		SkipComments();
+		string op = token->ascii;
+
+		// If '+' or '-' can't be found then return false ('null'). Otherwise continue function.
+		if (CheckToken(T_ADD));
+		else if (CheckToken(T_SUBTRACT));
+		else return found;
+		found = true;
+		constValue left = exprConst;
+		int leftValue = exprValue;
+
+		// Get next Relation. Otherwise report Missing Relation error.
+		if (Relation(relationType, relationSize)) {
+			FoldBinary(op, left, leftValue);
+			// Only allow number (integer / float) relations in arithmetic operations.
+			if (catchTypeError) {
+				if (!isNumber(relationType) || !isNumber(inputType)) {
+					ReportError("Only integer and float values are allowed for arithmetic operations.");
+					catchTypeError = false;
+				}
 			}
-		}
-		// Ensure compatible sizes are used in ArithOp.
-		if (catchSizeError) {
-			// Error if sizes are not identical and both are non-zero
-			if ((inputSize != relationSize) && (inputSize != 0) && (relationSize != 0)) {
-				ReportError("Expected Relation of size " + to_string(inputSize) + ", but found one of size " + to_string(relationSize) + ".");
-				catchSizeError = false;
+			// Ensure compatible sizes are used in ArithOp.
+			if (catchSizeError) {
+				// Error if sizes are not identical and both are non-zero
+				if ((inputSize != relationSize) && (inputSize != 0) && (relationSize != 0)) {
+					ReportError("Expected Relation of size " + to_string(inputSize) + ", but found one of size " + to_string(relationSize) + ".");
+					catchSizeError = false;
+				}
+				// Assign inputSize as exprSize if inputSize is non-zero.
+				else if (relationSize != 0) inputSize = relationSize;
 			}
-			// Assign inputSize as exprSize if inputSize is non-zero.
-			else if (relationSize != 0) inputSize = relationSize;
+		}
+		else {
+			ReportError("Expected relation after arithmetic operator.");
+			catchTypeError = false;
+			catchSizeError = false;
+			exprConst = constValue();
+			exprValue = -1;
 		}
 	}
-	else {
-		ReportError("Expected relation after arithmetic operator.");
-		catchTypeError = false;
-		catchSizeError = false;
-	}
-	// Continue to look for other +/- <relation> in case there is a missing arithOp or doubled up arithmetic operators
-	ArithOpPrime(inputType, inputSize, catchTypeError, catchSizeError);
-
-	return true;
 }
 
 /*	<relation> ::=
@@ -1081,16 +1405,32 @@ bool Parser::Relation(int& type, int& size) {
 bool Parser::RelationPrime(int& inputType, int& inputSize, bool catchTypeError, bool catchSizeError) {
 	// Type and size of relation being compared to.
 	int termType, termSize;
+	bool found = false;
 
-	// Get relationsal op to pass to the codegenerator evaluation stack
-	string op = token->ascii;
-
-	if (CheckToken(T_COMPARE)) {
+	// Each further relational operator and term is parsed by this loop rather than by recursing, so long
+	// expressions don't take a stack frame for each operator
+	while (true) {
+		// Get relationsal op to pass to the codegenerator evaluation stack
+		SkipComments();
+		string op = token->ascii;
+
+		if (!CheckToken(T_COMPARE)) return found;
+		found = true;
+		constValue left = exprConst;
+		int leftValue = exprValue;
 		// Get next term, otherwise report missing term error.
 		if (Term(termType, termSize)) {
+			FoldBinary(op, left, leftValue);
 			if (catchTypeError) {
+				// Strings can only be tested for equality against other strings.
+				if ((inputType == TYPE_STRING) && (termType == TYPE_STRING)) {
+					if ((op != "==") && (op != "!=")) {
+						ReportError("Only '==' and '!=' are valid relational operators for strings.");
+						catchTypeError = false;
+					}
+				}
 				// Ensure both terms are of type integer or bool. The two types can be compared against each other.
-				if (((inputType != TYPE_BOOL) && (inputType != TYPE_INTEGER)) || ((termType != TYPE_BOOL) && (termType != TYPE_INTEGER))) {
+				else if (((inputType != TYPE_BOOL) && (inputType != TYPE_INTEGER)) || ((termType != TYPE_BOOL) && (termType != TYPE_INTEGER))) {
 					ReportError("Relational operators are only valid for terms of type bool or integers '0' and '1'.");
 					catchTypeError = false;
 				}
@@ -1109,13 +1449,10 @@ bool Parser::RelationPrime(int& inputType, int& inputSize, bool catchTypeError,
 			ReportError("Expected term after relational operator.");
 			catchTypeError = false;
 			catchSizeError = false;
+			exprConst = constValue();
+			exprValue = -1;
 		}
-		// Check for another relational operator and term.
-		RelationPrime(inputType, inputSize, catchTypeError, catchSizeError);
-
-		return true;
 	}
-	else return false;
 }
 
 /*	<term> ::=
@@ -1137,41 +1474,54 @@ bool Parser::Term(int& type, int& size) {
 bool Parser::TermPrime(int& inputType, int& inputSize, bool catchTypeError, bool catchSizeError) {
 	// Next factor type and size.
 	int factorType, factorSize;
+	bool found = false;
 
-	// TODO: Get term op to pass to the code generator
-	string op = token->ascii;
-
-	// Check for '*' or '/' token, otherwise return false ('null').
-	if (CheckToken(T_MULTIPLY));
-	else if (CheckToken(T_DIVIDE));
-	else return false;
-
-	// Get next factor, otherwise report missing factor error.
-	if (Factor(factorType, factorSize)) {
-		// Ensure both factors are numbers for arithmetic operators.
-		if (!isNumber(inputType) || !isNumber(factorType)) {
-			ReportError("Only integer and float factors are defined for arithmetic operations in term.");
-			catchTypeError = false;
+	// Each further '*' or '/' <factor> is parsed by this loop rather than by recursing, so long
+	// expressions don't take a stack frame for each operator
+	while (true) {
+		// Get term op to fold constants and pass to the code generator
+		SkipComments();
+		string op = token->ascii;
+
+		// Check for '*' or '/' token, otherwise return false ('null').
+		if (CheckToken(T_MULTIPLY));
+		else if (CheckToken(T_DIVIDE));
+		else return found;
+		found = true;
+		constValue left = exprConst;
+		int leftValue = exprValue;
+
+		// Get next factor, otherwise report missing factor error.
+		if (Factor(factorType, factorSize)) {
+			FoldBinary(op, left, leftValue);
+			// Ensure both factors are numbers for arithmetic operators.
+			if (catchTypeError) {
+				if (!isNumber(inputType) || !isNumber(factorType)) {
+					ReportError("Only integer and float factors are defined for arithmetic operations in term.");
+					catchTypeError = false;
+				}
+			}
+			if (catchSizeError) {
+				if ((inputSize != factorSize) && ((inputSize != 0) && (factorSize != 0))) {
+					ReportError("Expected factor of size " + to_string(inputSize) + ", but found one of size " + to_string(factorSize) + ".");
+					catchSizeError = false;
+				}
+				else if (factorSize != 0) inputSize = factorSize;
+			}
 		}
-		if ((inputSize != factorSize) && ((inputSize != 0) && (factorSize != 0))) {
-			ReportError("Expected factor of size " + to_string(inputSize) + ", but found one of size " + to_string(factorSize) + ".");
+		else {
+			ReportError("Expected factor after arithmetic operator in term.");
+			catchTypeError = false;
 			catchSizeError = false;
+			exprConst = constValue();
+			exprValue = -1;
 		}
-		else if (factorSize != 0) inputSize = factorSize;
-	}
-	else {
-		ReportError("Expected factor after arithmetic operator in term.");
-		catchTypeError = false;
-		catchSizeError = false;
 	}
-	TermPrime(inputType, inputSize, catchTypeError, catchSizeError);
-
-	return true;
 }
 
 /*	<factor> ::=
  *		 ( <expression> )
- *			TODO: Add <procedure_call>
+ *		|<procedure_call>
  *		|{-} <name>
  *		|{-} <number>
  *		|<string>
@@ -1199,6 +1549,7 @@ bool Parser::Factor(int& type, int& size) {
 	else if (CheckToken(T_PROCEDURE)) {
 		if (Identifier(id)) {
 			if (ProcedureCall(id)) {
+				exprConst = constValue();
 				return true;
 			}
 		}
@@ -1207,11 +1558,15 @@ bool Parser::Factor(int& type, int& size) {
 		if (Integer()) {
 			type = TYPE_INTEGER;
 			size = 0;
+			foldNegate(exprConst, exprConst);
+			exprValue = builder->constant(exprConst);
 			return true;
 		}
 		else if (Float()) {
 			type = TYPE_FLOAT;
 			size = 0;
+			foldNegate(exprConst, exprConst);
+			exprValue = builder->constant(exprConst);
 			return true;
 		}
 		else if (Name(tempType, tempSize)) {
@@ -1220,6 +1575,16 @@ bool Parser::Factor(int& type, int& size) {
 			if (!isNumber(type)) {
 				ReportError("Negation '-' before variable name is valid only for integers and floats.");
 			}
+			constValue folded;
+			if (foldNegate(exprConst, folded)) {
+				exprConst = folded;
+				foldedNodes++;
+				exprValue = builder->constant(exprConst);
+			}
+			else {
+				exprConst = constValue();
+				exprValue = builder->negate(exprValue);
+			}
 			return true;
 		}
 		else {
@@ -1256,16 +1621,28 @@ bool Parser::Factor(int& type, int& size) {
 	}
 }
 
-// <name> ::= <identifier> { [ <expression> ] }
+/* <name> ::= <identifier> { [ <expression> ] }
+ * A procedure identifier followed by '(' is parsed as a <procedure_call> and has the procedure's return type. */
 bool Parser::Name(int& type, int& size) {
 	string id;
 	scopeInfo nameValue;
 	bool isGlobal;
 	if (Identifier(id)) {
 		bool symbolExists = scopes->checkSymbol(id, nameValue, isGlobal);
+		SkipComments();
+		if (symbolExists && (nameValue.type == TYPE_PROCEDURE) && (token->type == T_LPAREN)) {
+			ProcedureCall(id);
+			type = nameValue.returnType;
+			size = 0;
+			exprConst = constValue();
+			return true;
+		}
+		int variable = symbolExists ? VariableOf(id, nameValue, isGlobal) : -1;
 		if (symbolExists) {
 			if (nameValue.type == TYPE_PROCEDURE) {
 				ReportError(id + " is a procedure in this scope, not a variable.");
+				size = 0;
+				type = T_UNKNOWN;
 			}
 			else {
 				size = nameValue.size;
@@ -1285,6 +1662,8 @@ bool Parser::Name(int& type, int& size) {
 				if ((size2 > 1) || ((type2 != TYPE_INTEGER) && (type2 != TYPE_FLOAT) && (type2 != TYPE_BOOL)))
 					ReportError("Array index must be a scalar numeric value.");
 				size = 0;
+				exprConst = constValue();
+				exprValue = builder->loadElement(variable, exprValue);
 				if (CheckToken(T_RBRACKET)) {
 					return true;
 				}
@@ -1293,6 +1672,17 @@ bool Parser::Name(int& type, int& size) {
 			else ReportFatalError("Expected expression between brackets.");
 		}
 		else {
+			// Use the variable's value if a constant was last assigned to it
+			exprConst = constValue();
+			if (symbolExists && (nameValue.type != TYPE_PROCEDURE) && (nameValue.size == 0)) {
+				map<string, constValue>::iterator it = constTable.back().find(ConstKey(id, isGlobal));
+				if (it != constTable.back().end()) {
+					exprConst = it->second;
+					propagatedUses++;
+				}
+			}
+			if (exprConst.known) exprValue = builder->constant(exprConst);
+			else exprValue = builder->readVariable(variable);
 			return true;
 		}
 	}
@@ -1308,8 +1698,11 @@ bool Parser::Number() {
 
 // <integer> ::= [0-9][0-9]* TODO: Make this include underscores.
 bool Parser::Integer() {
-	string val = token->ascii;
+	SkipComments();
+	int val = token->val.intValue;
 	if (CheckToken(TYPE_INTEGER)) {
+		exprConst = constInteger(val);
+		exprValue = builder->constant(exprConst);
 		return true;
 	}
 	else return false;
@@ -1317,8 +1710,11 @@ bool Parser::Integer() {
 
 // <float> ::= [0-9][0-9]*[.[0-9]+] TODO: Make this include underscores.
 bool Parser::Float() {
-	string val = token->ascii;
+	SkipComments();
+	double val = token->val.doubleValue;
 	if (CheckToken(TYPE_FLOAT)) {
+		exprConst = constFloat(val);
+		exprValue = builder->constant(exprConst);
 		return true;
 	}
 	else return false;
@@ -1326,19 +1722,26 @@ bool Parser::Float() {
 
 // <string> ::=  [^]*
 bool Parser::String() {
+	SkipComments();
 	string val = token->ascii;
 	if (CheckToken(TYPE_STRING)) {
+		// Strip the surrounding quotation marks
+		exprConst = constString(val.substr(1, val.size() - 2));
+		exprValue = builder->constant(exprConst);
 		return true;
 	}
 	else return false;
 }
 
 bool Parser::Bool() {
-	string val = token->ascii;
 	if (CheckToken(T_TRUE)) {
+		exprConst = constBool(true);
+		exprValue = builder->constant(exprConst);
 		return true;
 	}
 	else if (CheckToken(T_FALSE)) {
+		exprConst = constBool(false);
+		exprValue = builder->constant(exprConst);
 		return true;
 	}
 	else return false;
@@ -1346,15 +1749,100 @@ bool Parser::Bool() {
 
 // <identifier> ::= [a-zA-Z][a-zA-Z0-9_]*
 bool Parser::Identifier(string& id) {
+	SkipComments();
 	string tmp = token->ascii;
+	int line = token->line;
 	bool ret_val = CheckToken(TYPE_IDENTIFIER);
 	if (ret_val) {
 		id = tmp;
+		if (scopes->index) scopes->index->identifier(id, line);
 		return true;
 	}
 	else return false;
 }
 
+// Key used in constTable for a variable. Globals are kept apart from locals of the same name.
+string Parser::ConstKey(string id, bool global) {
+	if (global) return "G:" + id;
+	else return "L:" + id;
+}
+
+// Record the value assigned to a variable, or forget it if the value is unknown
+void Parser::SetConst(string key, constValue value) {
+	ALLOCATION_SITE("Parser::SetConst");
+	if (value.known) constTable.back()[key] = value;
+	else constTable.back().erase(key);
+	if (!assignedConsts.empty()) assignedConsts.back().insert(key);
+	return;
+}
+
+/* Forget the value of every variable a procedure call could change.
+ * Procedures can only see globals, but in the program body the globals are keyed as locals so everything is forgotten. */
+void Parser::KillGlobalConsts() {
+	map<string, constValue>& consts = constTable.back();
+	if (constTable.size() == 1) {
+		consts.clear();
+		return;
+	}
+	map<string, constValue>::iterator it = consts.begin();
+	while (it != consts.end()) {
+		if (it->first.compare(0, 2, "G:") == 0) it = consts.erase(it);
+		else ++it;
+	}
+	return;
+}
+
+// Keep only the constants that have the same value in the current table and in 'other'
+void Parser::MergeConsts(map<string, constValue>& other) {
+	map<string, constValue>& consts = constTable.back();
+	map<string, constValue>::iterator it = consts.begin();
+	while (it != consts.end()) {
+		map<string, constValue>::iterator match = other.find(it->first);
+		if ((match == other.end()) || (match->second != it->second)) it = consts.erase(it);
+		else ++it;
+	}
+	return;
+}
+
+/* Combine exprConst with the left operand's value using op. Counts the expression if it was folded.
+ * The IR for the operation is only emitted when it couldn't be folded. */
+void Parser::FoldBinary(string op, constValue left, int leftValue) {
+	constValue folded;
+	bool divideByZero;
+	if (foldBinary(op, left, exprConst, folded, divideByZero)) {
+		exprConst = folded;
+		foldedNodes++;
+		exprValue = builder->constant(exprConst);
+	}
+	else {
+		if (divideByZero) ReportWarning("Division by zero in constant expression.");
+		exprConst = constValue();
+		exprValue = builder->binary(op, leftValue, exprValue);
+	}
+	return;
+}
+
+// Find the IR variable of a symbol found in the scope tables
+int Parser::VariableOf(string id, scopeInfo& value, bool isGlobal) {
+	if (value.type == TYPE_PROCEDURE) return -1;
+	return builder->findVariable(id, isGlobal, value.type, value.size);
+}
+
+// Restore the constants known before a loop statement, forgetting anything the loop could have changed
+void Parser::EndLoopConsts(map<string, constValue>& beforeLoop, int callsBeforeLoop) {
+	set<string> assigned = assignedConsts.back();
+	assignedConsts.pop_back();
+	if (!assignedConsts.empty()) assignedConsts.back().insert(assigned.begin(), assigned.end());
+
+	constTable.back() = beforeLoop;
+	set<string>::iterator it;
+	for (it = assigned.begin(); it != assigned.end(); ++it) {
+		constTable.back().erase(*it);
+	}
+	if (callCount != callsBeforeLoop) KillGlobalConsts();
+	return;
+}
+
 // Check if token is an integer or float.
 bool Parser::isNumber(int& type_value) {
 	if ((type_value == TYPE_INTEGER) || (type_value == TYPE_FLOAT)) return true;
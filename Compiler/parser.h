@@ -7,10 +7,39 @@
 #include "scopeInfo.h"
 #include "scanner.h"
 #include "scopeMap.h"
+#include "constValue.h"
+#include "options.h"
+#include "ir.h"
+#include "irBuilder.h"
 #include <queue>
+#include <map>
+#include <set>
+#include <vector>
 
 using namespace std;
 
+// Most characters of a line's text shown before and after where an error was found
+#define ERROR_CONTEXT_CHARS 160
+
+/* Most declarations, statements and expressions that can be nested inside each other. This keeps the parser's
+ * recursion inside its stack, which the project links with 16 MB of (StackReserveSize) since a debug build needs
+ * about 2 KB for each level. */
+#define MAX_NESTING 1000
+
+/* Struct to hold an error or warning the parser reported, for tools that show them with the source (languageServer.cpp).
+ *    line - line number it was found on
+ *    kind - "Fatal Error", "Line Error", "Error" or "Warning"
+ *    message - what was wrong
+ */
+struct parserDiagnostic {
+	int line;
+	string kind;
+	string message;
+};
+
+// Thrown by a fatal error when the options don't allow exiting, and caught by the Parser's constructor
+struct parserStopped {};
+
 class Parser
 {
 private:
@@ -23,17 +52,22 @@ private:
 	void ReportLineError(string message, bool skipSemicolon);
 	void ReportError(string message);
 	void ReportWarning(string message);
+	string ErrorContext();
 
 	// Error status flags and text and line number to report errors with
 	bool hasError, hasWarning, hasLineError;
 	string textLine;
 	int currentLine;
 
+	// How deep declarations, statements and expressions are nested at the token being parsed
+	int nesting;
+
 	/* Pointers and method to handle the token stream passed from the Scanner.
 	 * CheckToken() determines if the current token type is the input type. The stream moves forward one token.
 	 * The two pointers point to the current token in the stream, and the previous token in the stream (useful for getting information)
 	 */
 	bool CheckToken(int type);
+	void SkipComments();
 	void DeclareRunTime();
 	void Program();
 	bool ProgramHeader();
@@ -56,12 +90,13 @@ private:
 	// Parameters / Arguments for procedure declarations / calls
 	bool ParameterList(scopeInfo& procEntry);
 	bool Parameter(scopeInfo& procEntry);
-	bool ArgumentList(vector<scopeInfo>& list, scopeInfo procValue, int& offset);
+	bool ArgumentList(vector<scopeInfo>& list, scopeInfo procValue, int& offset, vector<int>& values);
+	int PassArgument(scopeInfo& param, int value);
 
 	// Statements
 	bool Statement();
 	bool Assignment(string& id);
-	bool Destination(string& id, int& dType, int& dSize, scopeInfo& destinationValue, bool& found, bool& isGlobal, bool& indirect, int& indirect_type);
+	bool Destination(string& id, int& dType, int& dSize, scopeInfo& destinationValue, bool& found, bool& isGlobal, bool& indirect, int& indirect_type, int& indexValue);
 	bool IfStatement();
 	bool LoopStatement();
 	bool ReturnStatement();
@@ -94,15 +129,51 @@ private:
 	bool Identifier(string& id);
 	bool isNumber(int& type_value);
 
-	bool outArg;
+	/* Constant folding and propagation, done while expressions are type checked.
+	 * exprConst holds the compile time value (if any) of the expression, term, factor, etc. that was parsed last.
+	 * constTable holds the known values of scalar variables for each procedure being parsed, keyed by ConstKey().
+	 * assignedConsts holds the keys of variables assigned inside each enclosing loop statement.
+	 */
+	constValue exprConst;
+	vector< map<string, constValue> > constTable;
+	vector< set<string> > assignedConsts;
+	int callCount;
+	string ConstKey(string id, bool global);
+	void SetConst(string key, constValue value);
+	void KillGlobalConsts();
+	void MergeConsts(map<string, constValue>& other);
+	void FoldBinary(string op, constValue left, int leftValue);
+	void EndLoopConsts(map<string, constValue>& beforeLoop, int callsBeforeLoop);
+
+	/* IR generation, done alongside type checking.
+	 * exprValue holds the IR value of the expression, term, factor, etc. that was parsed last (-1 if there is none).
+	 * VariableOf() finds the IR variable for a symbol found with scopes->checkSymbol().
+	 */
+	irBuilder* builder;
+	int exprValue;
+	int VariableOf(string id, scopeInfo& value, bool isGlobal);
+
+	// Memo table size from a //#memo pragma comment, applied to the next procedure declared (-1 if there is none)
+	int memoPragma;
+	void ReadPragma(string comment);
+
+	// Command line options, and the statistics shown with the --stats flag
+	compilerOptions options;
+	int foldedNodes, propagatedUses, constantConditions;
+	void DisplayStats();
 public:
 	// Pointers to the other major components of the compiler which are called / checked by the parser
 	Token* token;
 	Scanner* scanner;
 	scopeMap* scopes;
 	// Constructor and destructor - begins parsing as soon as it is constructed
-	Parser(Token* tokenPtr, Scanner* scannerPtr, scopeMap* scopes);
+	Parser(Token* tokenPtr, Scanner* scannerPtr, scopeMap* scopes, compilerOptions options_input, irModule* module);
 	~Parser();
+	bool HasErrors();
+	vector<parserDiagnostic> diagnostics;
+	// Global symbols of the program scope, kept when an interface is exported
+	vector<pair<string, scopeInfo>> exported;
+	static const vector<pair<string, scopeInfo>>& RunTimeDeclarations();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "phaseReport.h"
+#include <string>
+#include <ostream>
+#include <iomanip>
+#include <new>
+#include <mutex>
+#include <cstdlib>
+// Size of a block from malloc, so the memory report can count the live bytes back down when it is freed
+#ifdef _WIN32
+#include <malloc.h>
+#define usableSize _msize
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define usableSize malloc_size
+#else
+#include <malloc.h>
+#define usableSize malloc_usable_size
+#endif
+
+using namespace std;
+
+phaseReport phases;
+thread_local const char* allocationSite::current = NULL;
+
+static const char* phaseNames[PHASE_COUNT] = {
+	"Scanner", "Program", "Declaration", "Statement", "Expression", "Scope table", "Optimizer", "Code generation"
+};
+static const char* phaseKeys[PHASE_COUNT] = {
+	"scan", "program", "declaration", "statement", "expression", "scope", "optimize", "codegen"
+};
+
+void printPhaseReport(ostream& out, bool json) {
+	if (json) {
+		out << "{\n  \"phases\": {\n";
+		for (int p = 0; p < PHASE_COUNT; p++) {
+			out << "    \"" << phaseKeys[p] << "\": { \"seconds\": " << fixed << setprecision(6) << phases.seconds[p];
+			out << ", \"calls\": " << phases.calls[p] << " }" << (p + 1 < PHASE_COUNT ? "," : "") << "\n";
+		}
+		out << "  },\n";
+		out << "  \"tokens\": " << phases.tokens << ",\n  \"bytes\": " << phases.bytes << ",\n";
+		out << "  \"scopes\": " << phases.scopes << ",\n  \"peakScopeDepth\": " << phases.peakScopeDepth << ",\n";
+		out << "  \"symbolsAdded\": " << phases.symbolsAdded << ",\n  \"symbolLookups\": " << phases.symbolLookups << ",\n";
+		out << "  \"diagnostics\": " << phases.diagnostics << "\n}" << endl;
+		return;
+	}
+
+	out << "Time report:\n" << endl;
+	out << "\t" << left << setw(18) << "Phase" << right << setw(12) << "Seconds" << setw(12) << "Calls" << endl;
+	for (int p = 0; p < PHASE_COUNT; p++) {
+		out << "\t" << left << setw(18) << phaseNames[p] << right << setw(12) << fixed << setprecision(6) << phases.seconds[p];
+		out << setw(12) << phases.calls[p] << endl;
+	}
+	out << endl;
+	printPhaseCounts(out);
+}
+
+void printPhaseCounts(ostream& out) {
+	out << "Front end statistics:\n" << endl;
+	out << "\tTokens scanned: " << phases.tokens << " (" << phases.bytes << " bytes)" << endl;
+	out << "\tScopes created: " << phases.scopes << " (at most " << phases.peakScopeDepth << " open)" << endl;
+	out << "\tSymbols added: " << phases.symbolsAdded << endl;
+	out << "\tSymbol lookups: " << phases.symbolLookups << endl;
+	out << "\tDiagnostics: " << phases.diagnostics << "\n" << endl;
+}
+
+/* Struct to hold what was allocated while a phase was running, or at a site.
+ *    allocations / bytes - number of allocations and the bytes asked for
+ *    peakLive - most bytes allocated and not yet freed (by any phase) while the phase was running
+ */
+struct memoryCounts {
+	long long allocations = 0;
+	long long bytes = 0;
+	long long peakLive = 0;
+};
+
+/* The memory report's counts, kept apart from phases since threads optimizing and compiling procedures allocate
+ * at the same time. Everything is under a lock, which is fine for a report that is asked for.
+ * Live bytes are what malloc actually gave out, so frees match their allocations even though the size isn't kept.
+ * Blocks allocated before counting started and freed after aren't matched, so live bytes can start a little low. */
+static mutex memoryLock;
+static memoryCounts phaseMemory[PHASE_COUNT + 1];
+static const char* siteNames[MEMORY_SITES];
+static memoryCounts siteMemory[MEMORY_SITES];
+static int siteCount = 0;
+static long long liveBytes = 0;
+static long long peakLiveBytes = 0;
+
+static void countAllocation(void* block, size_t size) {
+	lock_guard<mutex> lock(memoryLock);
+	liveBytes += usableSize(block);
+	if (liveBytes > peakLiveBytes) peakLiveBytes = liveBytes;
+	memoryCounts& phase = phaseMemory[phases.active];
+	phase.allocations++;
+	phase.bytes += size;
+	if (liveBytes > phase.peakLive) phase.peakLive = liveBytes;
+
+	const char* name = allocationSite::current;
+	if (!name) return;
+	int site = 0;
+	while ((site < siteCount) && (siteNames[site] != name)) site++;
+	if (site == MEMORY_SITES) return;
+	if (site == siteCount) siteNames[siteCount++] = name;
+	siteMemory[site].allocations++;
+	siteMemory[site].bytes += size;
+	if (liveBytes > siteMemory[site].peakLive) siteMemory[site].peakLive = liveBytes;
+}
+
+static void countFree(void* block) {
+	lock_guard<mutex> lock(memoryLock);
+	liveBytes -= usableSize(block);
+}
+
+void printMemoryReport(ostream& out) {
+	// Printing allocates, so the counts are copied out first
+	memoryCounts counts[PHASE_COUNT + 1];
+	memoryCounts siteCounts[MEMORY_SITES];
+	int order[MEMORY_SITES];
+	int sites;
+	long long peak;
+	{
+		lock_guard<mutex> lock(memoryLock);
+		for (int p = 0; p <= PHASE_COUNT; p++) counts[p] = phaseMemory[p];
+		sites = siteCount;
+		for (int s = 0; s < sites; s++) {
+			siteCounts[s] = siteMemory[s];
+			order[s] = s;
+		}
+		peak = peakLiveBytes;
+	}
+
+	// Sites with the most bytes first
+	for (int s = 1; s < sites; s++) {
+		for (int t = s; (t > 0) && (siteCounts[order[t]].bytes > siteCounts[order[t - 1]].bytes); t--) swap(order[t], order[t - 1]);
+	}
+
+	out << "Memory report:\n" << endl;
+	out << "\t" << left << setw(28) << "Phase" << right << setw(14) << "Allocations" << setw(14) << "Bytes" << setw(14) << "Peak live" << endl;
+	for (int p = 0; p <= PHASE_COUNT; p++) {
+		out << "\t" << left << setw(28) << ((p < PHASE_COUNT) ? phaseNames[p] : "Other") << right << setw(14) << counts[p].allocations;
+		out << setw(14) << counts[p].bytes << setw(14) << counts[p].peakLive << endl;
+	}
+	out << "\n\t" << left << setw(28) << "Site" << right << setw(14) << "Allocations" << setw(14) << "Bytes" << setw(14) << "Peak live" << endl;
+	for (int s = 0; s < sites; s++) {
+		memoryCounts& site = siteCounts[order[s]];
+		out << "\t" << left << setw(28) << siteNames[order[s]] << right << setw(14) << site.allocations;
+		out << setw(14) << site.bytes << setw(14) << site.peakLive << endl;
+	}
+	out << "\n\tPeak live bytes: " << peak << "\n" << endl;
+}
+
+#ifndef NO_PHASE_REPORT
+/* Every heap allocation the compiler makes goes through these, so the memory report sees std::string, std::map and
+ * the IR's vectors as well as explicit news. With --mem-report off they cost one branch over malloc and free. */
+static void* allocate(size_t size) {
+	void* block = malloc(size ? size : 1);
+	if (!block) throw bad_alloc();
+	if (phases.memory) countAllocation(block, size);
+	return block;
+}
+
+static void release(void* block) {
+	if (!block) return;
+	if (phases.memory) countFree(block);
+	free(block);
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept {
+	try { return allocate(size); }
+	catch (...) { return NULL; }
+}
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+	try { return allocate(size); }
+	catch (...) { return NULL; }
+}
+void operator delete(void* block) noexcept { release(block); }
+void operator delete[](void* block) noexcept { release(block); }
+void operator delete(void* block, size_t) noexcept { release(block); }
+void operator delete[](void* block, size_t) noexcept { release(block); }
+void operator delete(void* block, const nothrow_t&) noexcept { release(block); }
+void operator delete[](void* block, const nothrow_t&) noexcept { release(block); }
+#endif
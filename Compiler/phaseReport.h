@@ -0,0 +1,124 @@
+#ifndef PHASEREPORT_H
+#define PHASEREPORT_H
+
+#include <string>
+#include <chrono>
+#include <ostream>
+
+using namespace std;
+
+// Phases of a compilation timed by --time-report
+#define PHASE_SCAN 0
+#define PHASE_PROGRAM 1
+#define PHASE_DECLARATION 2
+#define PHASE_STATEMENT 3
+#define PHASE_EXPRESSION 4
+#define PHASE_SCOPE 5
+#define PHASE_OPTIMIZE 6
+#define PHASE_CODEGEN 7
+#define PHASE_COUNT 8
+
+// Most allocation sites the memory report keeps apart. Allocations at sites past these are counted with their phase.
+#define MEMORY_SITES 64
+
+/* Struct to hold the time spent in each phase and counts of the work done, collected with --time-report, --stats or
+ * --mem-report.
+ * A phase's time includes the phases it calls (expressions in a statement are in both), but a phase that calls
+ * itself (nested statements and expressions) is only timed at the outermost call, so no time is counted twice.
+ *    enabled - true if anything is being collected. Everything is checked against it first, so collecting costs a
+ *              predictable branch when it is off. Building with NO_PHASE_REPORT removes the collection entirely.
+ *    seconds / calls / depth - total time and number of calls of each phase, and how deep each one is nested now
+ *    tokens / bytes - tokens scanned and bytes of source they came from
+ *    scopes / peakScopeDepth - scopes created and most scopes open at once
+ *    symbolsAdded / symbolLookups - scopeMap::addSymbol and checkSymbol calls
+ *    diagnostics - errors and warnings reported
+ *    memory - true if each heap allocation is counted (--mem-report), checked by operator new like enabled is
+ *    active - phase that allocations are counted against, the innermost one running, PHASE_COUNT outside of any
+ */
+struct phaseReport {
+	bool enabled = false;
+	double seconds[PHASE_COUNT] = {};
+	long long calls[PHASE_COUNT] = {};
+	int depth[PHASE_COUNT] = {};
+	long long tokens = 0;
+	long long bytes = 0;
+	long long scopes = 0;
+	int scopeDepth = 0;
+	int peakScopeDepth = 0;
+	long long symbolsAdded = 0;
+	long long symbolLookups = 0;
+	long long diagnostics = 0;
+	bool memory = false;
+	int active = PHASE_COUNT;
+};
+
+extern phaseReport phases;
+
+/*
+ * Times one call of a phase from its construction to the end of the enclosing block.
+ */
+class phaseTimer
+{
+private:
+	int phase;
+	int previous = PHASE_COUNT;
+	bool timing;
+	chrono::steady_clock::time_point start;
+public:
+	phaseTimer(int phase_input) {
+		phase = phase_input;
+		timing = phases.enabled && (phases.depth[phase]++ == 0);
+		if (phases.enabled) {
+			phases.calls[phase]++;
+			previous = phases.active;
+			phases.active = phase;
+		}
+		if (timing) start = chrono::steady_clock::now();
+	}
+	~phaseTimer() {
+		if (!phases.enabled) return;
+		phases.depth[phase]--;
+		phases.active = previous;
+		if (timing) phases.seconds[phase] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+};
+
+/*
+ * Names the allocations made from its construction to the end of the enclosing block for the memory report.
+ * The name must be a string literal, since sites are told apart by its address. Sites are per thread.
+ */
+class allocationSite
+{
+private:
+	const char* previous;
+public:
+	static thread_local const char* current;
+	allocationSite(const char* name) {
+		previous = current;
+		current = name;
+	}
+	~allocationSite() {
+		current = previous;
+	}
+};
+
+#ifdef NO_PHASE_REPORT
+#define TIME_PHASE(phase)
+#define COUNT_PHASE(counter, amount)
+#define ALLOCATION_SITE(name)
+#else
+#define TIME_PHASE(phase) phaseTimer phaseTimerGuard(phase)
+#define COUNT_PHASE(counter, amount) if (phases.enabled) phases.counter += (amount)
+#define ALLOCATION_SITE(name) allocationSite allocationSiteGuard(name)
+#endif
+
+// Print the counts of the work the front end did (without the times, which change from run to run)
+void printPhaseCounts(ostream& out);
+
+// Print the time spent in each phase and the counts as a table, or as a JSON object
+void printPhaseReport(ostream& out, bool json);
+
+// Print the allocations, bytes and peak live memory of each phase, and the sites that allocated the most bytes
+void printMemoryReport(ostream& out);
+
+#endif
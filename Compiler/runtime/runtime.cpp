@@ -0,0 +1,615 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "runtime.h"
+#include <string>
+#include <thread>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <vector>
+#include <climits>
+#include <cerrno>
+#include <cmath>
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Constructor - queue starts empty
+inputQueue::inputQueue() {
+	head.store(0);
+	tail.store(0);
+	consumerWaiting.store(false);
+	producerWaiting.store(false);
+}
+
+// Add a value to the back of the queue. Returns false if the queue is full.
+bool inputQueue::tryPush(inputValue& value) {
+	size_t t = tail.load(memory_order_relaxed);
+	if (t - head.load(memory_order_acquire) == capacity) return false;
+	buffer[t & (capacity - 1)] = std::move(value);
+	tail.store(t + 1, memory_order_release);
+	return true;
+}
+
+// Remove the value at the front of the queue. Returns false if the queue is empty.
+bool inputQueue::tryPop(inputValue& value) {
+	size_t h = head.load(memory_order_relaxed);
+	if (h == tail.load(memory_order_acquire)) return false;
+	value = std::move(buffer[h & (capacity - 1)]);
+	head.store(h + 1, memory_order_release);
+	return true;
+}
+
+/* Add a value, sleeping while the queue is full. A side sets its waiting flag before checking the queue one last
+ * time, and the other side checks the flag after moving its index, with a fence between each store and load. So
+ * either the sleeper sees the new index or the other side sees the flag, and wakes it while holding the mutex, which
+ * the sleeper only releases by going to sleep. */
+void inputQueue::push(inputValue& value) {
+	while (!tryPush(value)) {
+		unique_lock<mutex> lock(parking);
+		producerWaiting.store(true);
+		atomic_thread_fence(memory_order_seq_cst);
+		notFull.wait(lock, [this]() { return tail.load(memory_order_relaxed) - head.load(memory_order_acquire) < capacity; });
+		producerWaiting.store(false);
+	}
+	atomic_thread_fence(memory_order_seq_cst);
+	if (consumerWaiting.load()) {
+		lock_guard<mutex> lock(parking);
+		notEmpty.notify_one();
+	}
+}
+
+// Remove the value at the front, sleeping while the queue is empty
+void inputQueue::pop(inputValue& value) {
+	while (!tryPop(value)) {
+		unique_lock<mutex> lock(parking);
+		consumerWaiting.store(true);
+		atomic_thread_fence(memory_order_seq_cst);
+		notEmpty.wait(lock, [this]() { return head.load(memory_order_relaxed) != tail.load(memory_order_acquire); });
+		consumerWaiting.store(false);
+	}
+	atomic_thread_fence(memory_order_seq_cst);
+	if (producerWaiting.load()) {
+		lock_guard<mutex> lock(parking);
+		notFull.notify_one();
+	}
+}
+
+// Input state shared by all of the GET* procedures
+static inputQueue readAhead;
+static once_flag inputStarted;
+static bool synchronousInput = true;
+static bool inputDone = false;
+
+// Read one line from stdin without the trailing newline. Returns false once the input is exhausted.
+static bool readLine(string& line) {
+	line.clear();
+	int ch = getc(stdin);
+	if (ch == EOF) return false;
+	while ((ch != EOF) && (ch != '\n')) {
+		line += (char)ch;
+		ch = getc(stdin);
+	}
+	return true;
+}
+
+// Strip surrounding whitespace from a line and parse it as every scalar type it could be requested as
+static void tokenizeLine(string& line, inputValue& value) {
+	size_t first = 0;
+	size_t last = line.size();
+	while ((first < last) && isspace((unsigned char)line[first])) first++;
+	while ((last > first) && isspace((unsigned char)line[last - 1])) last--;
+	value.text = line.substr(first, last - first);
+	value.eof = false;
+
+	const char* begin = value.text.c_str();
+	char* end;
+
+	// Numbers out of range aren't read as clamped or wrapped values, so they are reported as bad input
+	errno = 0;
+	long intValue = strtol(begin, &end, 10);
+	value.isInt = (!value.text.empty()) && (*end == '\0') && (errno != ERANGE) && (intValue >= INT_MIN) && (intValue <= INT_MAX);
+	value.intValue = value.isInt ? (int)intValue : 0;
+
+	errno = 0;
+	value.floatValue = strtod(begin, &end);
+	value.isFloat = (!value.text.empty()) && (*end == '\0') && !((errno == ERANGE) && (fabs(value.floatValue) == HUGE_VAL));
+
+	// Bools are read as true / false in any case, or as the integers they are compatible with
+	string upper = value.text;
+	for (size_t i = 0; i < upper.size(); i++) upper[i] = toupper((unsigned char)upper[i]);
+	if (upper == "TRUE") {
+		value.isBool = true;
+		value.boolValue = true;
+	}
+	else if (upper == "FALSE") {
+		value.isBool = true;
+		value.boolValue = false;
+	}
+	else {
+		value.isBool = value.isInt;
+		value.boolValue = value.isInt && (value.intValue != 0);
+	}
+}
+
+// Background reader - reads and tokenizes stdin until EOF, then pushes an end of input marker
+static void readInput() {
+	string line;
+	inputValue value;
+	bool more = true;
+	while (more) {
+		if (readLine(line)) {
+			tokenizeLine(line, value);
+		}
+		else {
+			value = inputValue();
+			value.eof = true;
+			more = false;
+		}
+		// Waits for the program to catch up if it has fallen a full queue behind
+		readAhead.push(value);
+	}
+}
+
+// Decide between read-ahead and synchronous input the first time a GET* procedure is called.
+// Interactive terminals stay synchronous so that prompts from PUT* procedures are seen before input is read.
+static void startInput() {
+	synchronousInput = isatty(fileno(stdin)) != 0;
+	if (getenv("RUNTIME_SYNC_INPUT") != nullptr) synchronousInput = true;
+	if (!synchronousInput) {
+		thread reader(readInput);
+		reader.detach();
+	}
+}
+
+// Get the next input value from the read-ahead queue or directly from stdin
+static void nextInput(inputValue& value) {
+	call_once(inputStarted, startInput);
+	if (inputDone) {
+		value = inputValue();
+		value.eof = true;
+		return;
+	}
+	if (synchronousInput) {
+		string line;
+		fflush(stdout);
+		if (readLine(line)) tokenizeLine(line, value);
+		else {
+			value = inputValue();
+			value.eof = true;
+		}
+	}
+	else {
+		readAhead.pop(value);
+	}
+	if (value.eof) inputDone = true;
+}
+
+// Report badly formed input and stop the program
+static void inputError(inputValue& value, const char* expected) {
+	if (value.eof) fprintf(stderr, "\nRuntime Error: expected %s but reached the end of input.\n", expected);
+	else fprintf(stderr, "\nRuntime Error: expected %s but found \"%s\".\n", expected, value.text.c_str());
+	exit(EXIT_FAILURE);
+}
+
+bool getBool() {
+	inputValue value;
+	nextInput(value);
+	if (value.eof || !value.isBool) inputError(value, "a bool");
+	return value.boolValue;
+}
+
+int getInteger() {
+	inputValue value;
+	nextInput(value);
+	if (value.eof || !value.isInt) inputError(value, "an integer");
+	return value.intValue;
+}
+
+double getFloat() {
+	inputValue value;
+	nextInput(value);
+	if (value.eof || !value.isFloat) inputError(value, "a float");
+	return value.floatValue;
+}
+
+// Allocations are aligned for the widest value, a vector of IR_VECTOR_BITS
+#define ALLOC_ALIGN 32
+
+static size_t alignBytes(size_t bytes) {
+	return (bytes + ALLOC_ALIGN - 1) / ALLOC_ALIGN * ALLOC_ALIGN;
+}
+
+#ifdef RT_COUNT_ALLOCATIONS
+static thread_local allocationCounters counters;
+#define COUNT_ALLOCATION(counter, amount) (counters.counter += (amount))
+#else
+#define COUNT_ALLOCATION(counter, amount)
+#endif
+
+// Constructor - region starts without any chunks
+region::region() {
+	current = NULL;
+	spare = NULL;
+}
+
+region::~region() {
+	chunk* lists[2] = { current, spare };
+	for (int l = 0; l < 2; l++) {
+		while (lists[l]) {
+			chunk* previous = lists[l]->previous;
+			free(lists[l]);
+			lists[l] = previous;
+		}
+	}
+}
+
+// Chunk with room for at least 'bytes', a released one if it is big enough
+region::chunk* region::newChunk(size_t bytes) {
+	chunk* c;
+	if (spare && (spare->size >= bytes)) {
+		c = spare;
+		spare = spare->previous;
+	}
+	else {
+		size_t size = (bytes > RT_REGION_CHUNK_BYTES) ? bytes : RT_REGION_CHUNK_BYTES;
+		c = (chunk*)malloc(alignBytes(sizeof(chunk)) + size);
+		if (!c) {
+			fprintf(stderr, "\nRuntime Error: out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		c->size = size;
+		COUNT_ALLOCATION(regionChunks, 1);
+	}
+	c->used = 0;
+	c->previous = current;
+	current = c;
+	return c;
+}
+
+void* region::allocate(size_t bytes) {
+	bytes = alignBytes(bytes ? bytes : 1);
+	COUNT_ALLOCATION(regionAllocations, 1);
+	COUNT_ALLOCATION(regionBytes, bytes);
+	if (!current || (current->size - current->used < bytes)) {
+		// Big allocations get their own chunk, so the rest of the current one isn't wasted
+		if (bytes > RT_REGION_CHUNK_BYTES / 4) newChunk(bytes);
+		else newChunk(RT_REGION_CHUNK_BYTES);
+	}
+	char* data = (char*)current + alignBytes(sizeof(chunk)) + current->used;
+	current->used += bytes;
+	return data;
+}
+
+regionMark region::mark() {
+	regionMark position;
+	position.chunk = current;
+	position.used = current ? current->used : 0;
+	return position;
+}
+
+// Free everything allocated since the mark was taken. Chunks that become empty are kept as spares.
+void region::release(regionMark position) {
+	while (current && (current != position.chunk)) {
+		chunk* previous = current->previous;
+		current->previous = spare;
+		spare = current;
+		current = previous;
+	}
+	if (current) current->used = position.used;
+}
+
+/* Free blocks of each pool size class, linked through their first word, and the slab new blocks are carved from.
+ * Blocks freed by another thread just join that thread's lists. nextOrphan links the pools of exited threads. */
+struct sizePools {
+	void* freeBlocks[RT_POOL_CLASSES] = {};
+	region slabs;
+	sizePools* nextOrphan = nullptr;
+};
+
+static thread_local region activations;
+
+/* Pools of threads that have exited. They are never destroyed, since blocks carved from their slabs can still be in
+ * use by (or on the free lists of) other threads, but the next thread to allocate adopts them. So there are only ever
+ * as many pools as there were threads allocating at once. */
+static mutex orphanLock;
+static sizePools* orphanPools = nullptr;
+
+// Owner of a thread's pools, which hands them over to orphanPools when the thread exits
+struct poolsOwner {
+	sizePools* pools = nullptr;
+	~poolsOwner() {
+		if (!pools) return;
+		lock_guard<mutex> lock(orphanLock);
+		pools->nextOrphan = orphanPools;
+		orphanPools = pools;
+	}
+};
+
+// The calling thread's pools, adopted from an exited thread if there are any
+static sizePools& threadPools() {
+	static thread_local poolsOwner owner;
+	if (!owner.pools) {
+		lock_guard<mutex> lock(orphanLock);
+		if (orphanPools) {
+			owner.pools = orphanPools;
+			orphanPools = orphanPools->nextOrphan;
+		}
+		else owner.pools = new sizePools();
+	}
+	return *owner.pools;
+}
+
+// Smallest size class that fits, or -1 if the block is too big for all of them
+static int sizeClass(size_t bytes) {
+	size_t size = RT_POOL_MIN_BYTES;
+	for (int c = 0; c < RT_POOL_CLASSES; c++, size *= 2) {
+		if (bytes <= size) return c;
+	}
+	return -1;
+}
+
+regionMark regionEnter() {
+	return activations.mark();
+}
+
+void* regionAlloc(int bytes) {
+	return activations.allocate((size_t)bytes);
+}
+
+void regionLeave(regionMark mark) {
+	activations.release(mark);
+}
+
+void* poolAlloc(int bytes) {
+	int c = sizeClass((size_t)bytes);
+	if (c < 0) {
+		COUNT_ALLOCATION(largeAllocations, 1);
+		void* block = malloc((size_t)bytes);
+		if (!block) {
+			fprintf(stderr, "\nRuntime Error: out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		return block;
+	}
+	COUNT_ALLOCATION(poolAllocations, 1);
+	sizePools& pools = threadPools();
+	void* block = pools.freeBlocks[c];
+	if (block) {
+		pools.freeBlocks[c] = *(void**)block;
+		COUNT_ALLOCATION(poolReuses, 1);
+		return block;
+	}
+	return pools.slabs.allocate((size_t)RT_POOL_MIN_BYTES << c);
+}
+
+void poolFree(void* block, int bytes) {
+	if (!block) return;
+	int c = sizeClass((size_t)bytes);
+	if (c < 0) {
+		free(block);
+		return;
+	}
+	COUNT_ALLOCATION(poolFrees, 1);
+	sizePools& pools = threadPools();
+	*(void**)block = pools.freeBlocks[c];
+	pools.freeBlocks[c] = block;
+}
+
+bool allocationCounts(allocationCounters& counts) {
+#ifdef RT_COUNT_ALLOCATIONS
+	counts = counters;
+	return true;
+#else
+	counts = allocationCounters();
+	return false;
+#endif
+}
+
+void allocationReport() {
+#ifdef RT_COUNT_ALLOCATIONS
+	fprintf(stderr, "Region allocations: %lld (%lld bytes, %lld chunks)\n", counters.regionAllocations, counters.regionBytes, counters.regionChunks);
+	fprintf(stderr, "Pool allocations: %lld (%lld reused, %lld freed)\n", counters.poolAllocations, counters.poolReuses, counters.poolFrees);
+	fprintf(stderr, "Large allocations: %lld\n", counters.largeAllocations);
+#endif
+}
+
+/* Interned long strings, an open addressing table of the one copy of each (see rtString). Only the program's thread
+ * creates strings, so the table isn't locked. It is kept at most half full. Copies are never freed, so they are
+ * bump allocated from a region that is never released instead of one malloc each. */
+struct internEntry {
+	const char* data;
+	size_t length;
+	size_t hash;
+};
+static vector<internEntry> internTable(64);
+static size_t internCount = 0;
+static region internStorage;
+
+static size_t stringHash(const char* text, size_t length) {
+	unsigned long long h = 0xCBF29CE484222325ULL;
+	for (size_t i = 0; i < length; i++) h = (h ^ (unsigned char)text[i]) * 0x100000001B3ULL;
+	return (size_t)h;
+}
+
+static void growInternTable() {
+	vector<internEntry> old(internTable.size() * 2);
+	old.swap(internTable);
+	for (size_t i = 0; i < old.size(); i++) {
+		if (!old[i].data) continue;
+		size_t slot = old[i].hash & (internTable.size() - 1);
+		while (internTable[slot].data) slot = (slot + 1) & (internTable.size() - 1);
+		internTable[slot] = old[i];
+	}
+}
+
+/* The interned copy of a long string. If there isn't one yet the bytes become it, after being copied to the heap
+ * unless they are a literal (which already lives for the whole run). */
+static const char* intern(const char* text, size_t length, bool literal) {
+	size_t h = stringHash(text, length);
+	size_t slot = h & (internTable.size() - 1);
+	while (internTable[slot].data) {
+		internEntry& entry = internTable[slot];
+		if ((entry.hash == h) && (entry.length == length) && (memcmp(entry.data, text, length) == 0)) return entry.data;
+		slot = (slot + 1) & (internTable.size() - 1);
+	}
+	if (!literal) {
+		char* copy = (char*)internStorage.allocate(length + 1);
+		memcpy(copy, text, length);
+		copy[length] = '\0';
+		text = copy;
+	}
+	internTable[slot].data = text;
+	internTable[slot].length = length;
+	internTable[slot].hash = h;
+	if (++internCount * 2 > internTable.size()) growInternTable();
+	return text;
+}
+
+static rtString shortString(const char* text, size_t length) {
+	rtString value;
+	memset(&value, 0, sizeof(value));
+	memcpy(value.bytes, text, length);
+	value.bytes[RT_STRING_INLINE] = (char)(RT_STRING_INLINE - length);
+	return value;
+}
+
+static rtString longString(const char* data, size_t length) {
+	rtString value;
+	memset(&value, 0, sizeof(value));
+	value.text.data = data;
+	value.text.length = (unsigned int)length;
+	value.bytes[RT_STRING_INLINE] = (char)RT_STRING_LONG;
+	return value;
+}
+
+rtString makeString(const char* text, size_t length) {
+	if (length <= RT_STRING_INLINE) return shortString(text, length);
+	return longString(intern(text, length, false), length);
+}
+
+const char* stringText(const rtString& value) {
+	if ((unsigned char)value.bytes[RT_STRING_INLINE] == RT_STRING_LONG) return value.text.data;
+	return value.bytes;
+}
+
+size_t stringLength(const rtString& value) {
+	if ((unsigned char)value.bytes[RT_STRING_INLINE] == RT_STRING_LONG) return value.text.length;
+	return RT_STRING_INLINE - (size_t)value.bytes[RT_STRING_INLINE];
+}
+
+void stringLiterals(const char* const* literals, const int* lengths, int count) {
+	for (int i = 0; i < count; i++) intern(literals[i], (size_t)lengths[i], true);
+}
+
+bool stringEqual(rtString left, rtString right) {
+	return memcmp(&left, &right, sizeof(rtString)) == 0;
+}
+
+// Strings are read a whole line at a time. A line equal to a literal (or an earlier line) shares its bytes.
+rtString getString() {
+	inputValue value;
+	nextInput(value);
+	if (value.eof) inputError(value, "a string");
+	return makeString(value.text.c_str(), value.text.size());
+}
+
+bool putBool(bool value) {
+	printf("%s\n", value ? "true" : "false");
+	return true;
+}
+
+bool putInteger(int value) {
+	printf("%d\n", value);
+	return true;
+}
+
+bool putFloat(double value) {
+	printf("%f\n", value);
+	return true;
+}
+
+bool putString(rtString value) {
+	fwrite(stringText(value), 1, stringLength(value), stdout);
+	putchar('\n');
+	return true;
+}
+
+void boundsError(int index, int size) {
+	fflush(stdout);
+	fprintf(stderr, "\nRuntime Error: array index %d is out of bounds for an array of size %d.\n", index, size);
+	exit(EXIT_FAILURE);
+}
+
+// Constructor - room for at least 'entries' results (rounded up to a whole number of buckets), all empty
+memoTable::memoTable(size_t keyWords_input, size_t entries) {
+	keyWords = keyWords_input;
+	bucketCount = 1;
+	while (bucketCount * ways < entries) bucketCount *= 2;
+	keys = new long long[bucketCount * ways * (keyWords ? keyWords : 1)];
+	values = new long long[bucketCount * ways];
+	used = new unsigned char[bucketCount]();
+	next = new unsigned char[bucketCount]();
+}
+
+memoTable::~memoTable() {
+	delete[] keys;
+	delete[] values;
+	delete[] used;
+	delete[] next;
+}
+
+// Mix the key words so that nearby arguments (as in most recursive calls) land in different buckets
+size_t memoTable::hash(const long long* key) {
+	unsigned long long h = 0;
+	for (size_t w = 0; w < keyWords; w++) {
+		h = (h ^ (unsigned long long)key[w]) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 29;
+	}
+	return (size_t)(h & (bucketCount - 1));
+}
+
+// Look up the result for a key. Returns false if it isn't in the table.
+bool memoTable::find(const long long* key, long long& value) {
+	size_t bucket = hash(key);
+	for (size_t s = 0; s < used[bucket]; s++) {
+		size_t slot = bucket * ways + s;
+		if (memcmp(keys + slot * keyWords, key, keyWords * sizeof(long long)) != 0) continue;
+		value = values[slot];
+		return true;
+	}
+	return false;
+}
+
+// Add the result for a key, replacing the oldest entry in its bucket if the bucket is full
+void memoTable::put(const long long* key, long long value) {
+	size_t bucket = hash(key);
+	size_t s;
+	if (used[bucket] < ways) s = used[bucket]++;
+	else {
+		s = next[bucket];
+		next[bucket] = (unsigned char)((s + 1) % ways);
+	}
+	size_t slot = bucket * ways + s;
+	memcpy(keys + slot * keyWords, key, keyWords * sizeof(long long));
+	values[slot] = value;
+}
+
+memoTable* memoCreate(int keyWords, int entries) {
+	return new memoTable((size_t)keyWords, (size_t)entries);
+}
+
+bool memoFind(memoTable* table, long long* key, long long* value) {
+	return table->find(key, *value);
+}
+
+void memoPut(memoTable* table, long long* key, long long value) {
+	table->put(key, value);
+}
@@ -0,0 +1,223 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+using namespace std;
+
+/* Struct to hold one pre-tokenized line of program input.
+ *    text - the input line with surrounding whitespace removed
+ *    intValue / floatValue / boolValue - values parsed from text by the reader
+ *    isInt / isFloat / isBool - true if text was a valid literal of that type
+ *    eof - marks the end of the input stream, no other members are valid
+ */
+struct inputValue {
+	string text;
+	int intValue;
+	double floatValue;
+	bool boolValue;
+	bool isInt;
+	bool isFloat;
+	bool isBool;
+	bool eof;
+};
+
+/*
+ * Single producer / single consumer lock-free ring buffer of parsed input values.
+ * The reader thread is the only producer and the GET* runtime procedures are the only consumer,
+ * so head and tail each have one writer and only need acquire / release ordering.
+ * A side that finds the queue empty (or full) sleeps on a condition variable instead of spinning. The mutex is only
+ * taken to go to sleep and to wake the other side, so pushes and pops that don't wait stay lock-free.
+ */
+class inputQueue
+{
+private:
+	static const size_t capacity = 1024; // must be a power of two
+	inputValue buffer[capacity];
+	atomic<size_t> head; // next slot to pop, written by the consumer
+	atomic<size_t> tail; // next slot to push, written by the producer
+	mutex parking;
+	condition_variable notEmpty;
+	condition_variable notFull;
+	atomic<bool> consumerWaiting;
+	atomic<bool> producerWaiting;
+	bool tryPush(inputValue& value);
+	bool tryPop(inputValue& value);
+public:
+	inputQueue();
+	void push(inputValue& value);
+	void pop(inputValue& value);
+};
+
+/* Strings of up to RT_STRING_INLINE bytes are stored inside the string value itself. RT_STRING_LONG marks the last
+ * byte of a value holding a longer string. */
+#define RT_STRING_BYTES 16
+#define RT_STRING_INLINE 15
+#define RT_STRING_LONG 0xFF
+
+/*
+ * A string value of a compiled program, 16 bytes so it fits in one vector register (or two integer registers).
+ * Short strings are kept inline, zero padded, with the last byte holding RT_STRING_INLINE minus the length, so a
+ * string of exactly RT_STRING_INLINE bytes is still zero terminated. Longer strings point to interned bytes: the
+ * program's string literals, which stay in read-only data and are registered by stringLiterals() at startup, and the
+ * strings read by getString(), which are only copied to the heap if no equal string was interned before.
+ * Equal long strings therefore always share one pointer, and two strings are equal exactly when their 16 bytes are.
+ *    bytes - characters of a short string
+ *    text.data / text.length - bytes (zero terminated) and length of a long string, the rest of the value is zero
+ *                              except for the RT_STRING_LONG marker in bytes[RT_STRING_INLINE]
+ * The marker is always written and read through bytes, since where text ends depends on the size of a pointer.
+ */
+struct rtString {
+	union {
+		char bytes[RT_STRING_BYTES];
+		struct {
+			const char* data;
+			unsigned int length;
+		} text;
+	};
+};
+static_assert(sizeof(rtString) == RT_STRING_BYTES, "rtString must fit in one 16 byte register");
+static_assert(offsetof(rtString, text.length) + sizeof(unsigned int) <= RT_STRING_INLINE, "rtString text overlaps its marker byte");
+
+/* Regions get memory from malloc RT_REGION_CHUNK_BYTES at a time, and allocations bigger than a quarter of that get
+ * a chunk of their own. Pools keep RT_POOL_CLASSES size classes, from RT_POOL_MIN_BYTES doubling up to
+ * RT_POOL_MAX_BYTES, and carve new blocks out of RT_REGION_CHUNK_BYTES slabs. Bigger blocks go straight to malloc.
+ * Building the runtime with RT_COUNT_ALLOCATIONS defined (as the Debug configurations do) keeps the allocationCounters. */
+#define RT_REGION_CHUNK_BYTES 65536
+#define RT_POOL_MIN_BYTES 16
+#define RT_POOL_MAX_BYTES 1024
+#define RT_POOL_CLASSES 7
+
+/* Struct to hold the allocation counts of one thread.
+ *    regionAllocations / regionBytes - allocations from regions and the bytes they asked for
+ *    regionChunks - chunks regions got from malloc (chunks released by a procedure return are reused)
+ *    poolAllocations / poolReuses / poolFrees - pool allocations, how many of them reused a freed block, and frees
+ *    largeAllocations - allocations too big for any pool size class
+ */
+struct allocationCounters {
+	long long regionAllocations = 0;
+	long long regionBytes = 0;
+	long long regionChunks = 0;
+	long long poolAllocations = 0;
+	long long poolReuses = 0;
+	long long poolFrees = 0;
+	long long largeAllocations = 0;
+};
+
+/* Position in a region to release it back to: the chunk being allocated from and the bytes used in it */
+struct regionMark {
+	void* chunk;
+	size_t used;
+};
+
+/*
+ * Bump allocator over a list of chunks, which is released back to an earlier mark all at once.
+ * Each thread of a compiled program has one meant for the data of its procedure activations: a procedure that
+ * allocates would take a mark on entry and release it on return, freeing everything it and its callees allocated.
+ * Released chunks are kept for the next allocations instead of being returned to malloc.
+ */
+class region
+{
+private:
+	struct chunk {
+		chunk* previous;
+		size_t size;
+		size_t used;
+	};
+	chunk* current;
+	chunk* spare; // released chunks, linked by previous
+	chunk* newChunk(size_t bytes);
+public:
+	region();
+	~region();
+	void* allocate(size_t bytes);
+	regionMark mark();
+	void release(regionMark position);
+};
+
+/*
+ * Bounded hash cache of the results of one memoized procedure (IR_MEMO_* instructions), keyed on its arguments.
+ * Every argument and the result are stored as one 64 bit word: integers and bools widened, floats by their bits.
+ * Entries are kept in buckets of 'ways' slots. A full bucket replaces its least recently added entry, so the table
+ * never grows past the number of entries it was created with.
+ */
+class memoTable
+{
+private:
+	static const size_t ways = 4;
+	size_t keyWords;
+	size_t bucketCount; // a power of two
+	long long* keys; // bucketCount * ways keys of keyWords words each
+	long long* values;
+	unsigned char* used; // slots in use in each bucket
+	unsigned char* next; // slot to replace next in each full bucket
+	size_t hash(const long long* key);
+public:
+	memoTable(size_t keyWords, size_t entries);
+	~memoTable();
+	bool find(const long long* key, long long& value);
+	void put(const long long* key, long long value);
+};
+
+/* Runtime procedures declared by Parser::DeclareRunTime().
+ * Generated code calls these by their callLabel, so they use C linkage.
+ * GET* procedures read one line of input each. When stdin is not a terminal the lines are read and
+ * parsed ahead of time by a background thread, otherwise they are read synchronously on each call.
+ */
+extern "C" {
+	bool getBool();
+	int getInteger();
+	double getFloat();
+	rtString getString();
+	bool putBool(bool value);
+	bool putInteger(int value);
+	bool putFloat(double value);
+	bool putString(rtString value);
+
+	/* Called once at startup with the program's long string literals (each distinct one once), before any string is
+	 * read, so literals are the interned copy of their contents and are never copied. */
+	void stringLiterals(const char* const* literals, const int* lengths, int count);
+
+	// Strings are compared by their 16 bytes, this is the out of line version generated code may call
+	bool stringEqual(rtString left, rtString right);
+
+	// Called by generated code when an array index fails its bounds check
+	void boundsError(int index, int size);
+
+	/* Memo tables of the procedures memoized with --memoize. Generated code creates each table the first time
+	 * the procedure is called, and passes the arguments as an array of keyWords words. */
+	memoTable* memoCreate(int keyWords, int entries);
+	bool memoFind(memoTable* table, long long* key, long long* value);
+	void memoPut(memoTable* table, long long* key, long long value);
+
+	/* Memory of the calling thread's procedure activations (see region), for generated code to call regionEnter on
+	 * entry to a procedure that allocates and regionLeave with its mark before returning. The code generator doesn't
+	 * emit these calls, or the pool ones, yet: no IR instruction allocates. */
+	regionMark regionEnter();
+	void* regionAlloc(int bytes);
+	void regionLeave(regionMark mark);
+
+	/* Memory for values that outlive the activation that made them, from the calling thread's size class pools.
+	 * Blocks are freed with the size they were allocated with, and may be freed by a different thread, even after
+	 * the thread that allocated them has exited. */
+	void* poolAlloc(int bytes);
+	void poolFree(void* block, int bytes);
+
+	// Print the calling thread's allocationCounters to stderr (nothing unless built with RT_COUNT_ALLOCATIONS)
+	void allocationReport();
+}
+
+/* Copy the calling thread's allocationCounters to 'counts'. Returns false, leaving them zero, if the runtime was built
+ * without RT_COUNT_ALLOCATIONS. */
+bool allocationCounts(allocationCounters& counts);
+
+// String value of 'length' bytes, interning it if it is too long to be stored inline
+rtString makeString(const char* text, size_t length);
+const char* stringText(const rtString& value);
+size_t stringLength(const rtString& value);
+
+#endif
@@ -0,0 +1,342 @@
+#define _CRT_SECURE_NO_DEPRECATE
+#include "runtime.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#else
+#include <sys/wait.h>
+#endif
+
+using namespace std;
+
+/*
+ * Tests of the runtime library: its allocators, the input queue and the GET* procedures.
+ * Run without arguments it runs all of them and exits with 1 if any failed.
+ * The input tests run this program again as a child, with a mode as its arguments (see childMain), and write the
+ * child's stdin through a pipe, so the GET* procedures read it just like a compiled program's input.
+ */
+
+// Values pushed through the queue by the queue test, and how often each side stalls so the other one parks
+#define QUEUE_TEST_VALUES 100000
+#define QUEUE_TEST_STALL 10000
+
+// Integer lines written to the child by the input test, before the lines of the other types
+#define INPUT_TEST_LINES 3000
+
+// Milliseconds a side of a test sleeps to leave the other one waiting on it
+#define TEST_STALL_MS 20
+
+// A test that hangs (a lost wakeup) fails after this long
+#define TEST_TIMEOUT_SECONDS 60
+
+static int failures = 0;
+
+static void check(bool condition, const string& test, const string& what) {
+	if (condition) return;
+	cout << "FAIL " << test << ": " << what << endl;
+	failures++;
+}
+
+static void stall() {
+	this_thread::sleep_for(chrono::milliseconds(TEST_STALL_MS));
+}
+
+// The integer on input line 'i' of the input test, negative for some lines
+static int inputTestInteger(int i) {
+	return i * 7919 - 1000000;
+}
+
+/* Push values through an inputQueue from a producer thread, many times its capacity so its indices wrap. Each side
+ * stalls now and then, so the producer fills the queue and parks, and the consumer empties it and parks. */
+static void testQueue() {
+	inputQueue* queue = new inputQueue();
+	thread producer([queue]() {
+		for (int i = 0; i < QUEUE_TEST_VALUES; i++) {
+			inputValue value = inputValue();
+			value.text = to_string(i);
+			value.intValue = i;
+			value.eof = false;
+			queue->push(value);
+			if (i % QUEUE_TEST_STALL == 0) stall();
+		}
+	});
+	int outOfOrder = 0;
+	for (int i = 0; i < QUEUE_TEST_VALUES; i++) {
+		if (i % QUEUE_TEST_STALL == QUEUE_TEST_STALL / 2) stall();
+		inputValue value;
+		queue->pop(value);
+		if ((value.intValue != i) || (value.text != to_string(i))) outOfOrder++;
+	}
+	producer.join();
+	delete queue;
+	check(outOfOrder == 0, "queue", to_string(outOfOrder) + " values popped out of order");
+}
+
+// Make children read their input synchronously (RUNTIME_SYNC_INPUT) or ahead, as they do from a pipe by default
+static void setSyncInput(bool sync) {
+#ifdef _WIN32
+	_putenv(sync ? "RUNTIME_SYNC_INPUT=1" : "RUNTIME_SYNC_INPUT=");
+#else
+	if (sync) setenv("RUNTIME_SYNC_INPUT", "1", 1);
+	else unsetenv("RUNTIME_SYNC_INPUT");
+#endif
+}
+
+/* Run this program as a child with 'mode', write 'lines' to its stdin and return its exit status, or -1 if it
+ * couldn't be run. Writing stops for a moment after 'pauseAt' lines, so a child reading ahead runs out of input. */
+static int runChild(const string& self, const string& mode, const vector<string>& lines, size_t pauseAt) {
+	string command = "\"" + self + "\" " + mode;
+	FILE* child = popen(command.c_str(), "w");
+	if (!child) return -1;
+	for (size_t i = 0; i < lines.size(); i++) {
+		if (i == pauseAt) {
+			fflush(child);
+			stall();
+		}
+		fprintf(child, "%s\n", lines[i].c_str());
+	}
+	int status = pclose(child);
+#ifdef _WIN32
+	return status;
+#else
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+/* Read one line of each type, and thousands of integers so a child reading ahead fills its queue, in either input
+ * mode. The child sleeps before reading, and the lines are written in two parts with a pause in between, so the
+ * reader thread parks on a full queue and then the child parks on an empty one. */
+static void testInput(const string& self, bool sync) {
+	vector<string> lines;
+	for (int i = 0; i < INPUT_TEST_LINES; i++) lines.push_back(to_string(inputTestInteger(i)));
+	lines.push_back("  2.5\t");
+	lines.push_back("True");
+	lines.push_back("0");
+	lines.push_back("a short string");
+	lines.push_back("a string longer than a short one");
+	lines.push_back("a string longer than a short one");
+
+	string test = sync ? "synchronous input" : "read-ahead input";
+	setSyncInput(sync);
+	int status = runChild(self, "input", lines, INPUT_TEST_LINES / 2);
+	setSyncInput(false);
+	check(status == 0, test, "child exited with status " + to_string(status));
+}
+
+/* Struct to hold one number range check.
+ *    mode - child mode that reads the number: "integer" or "float"
+ *    text - the input line
+ *    accepted - true if it is in range, and must be read as exactly the value it spells
+ */
+struct rangeCase {
+	const char* mode;
+	const char* text;
+	bool accepted;
+};
+
+static const rangeCase rangeCases[] = {
+	{ "integer", "2147483647", true },
+	{ "integer", "-2147483648", true },
+	{ "integer", "2147483648", false },
+	{ "integer", "-2147483649", false },
+	{ "integer", "99999999999999999999", false },
+	{ "float", "1e308", true },
+	{ "float", "-2.5e-300", true },
+	{ "float", "1e999", false },
+	{ "float", "-1e999", false },
+};
+
+// Numbers out of range must stop the program with a runtime error instead of being read as some other value
+static void testNumberRanges(const string& self) {
+	for (const rangeCase& c : rangeCases) {
+		vector<string> lines(1, c.text);
+		int status = runChild(self, string(c.mode) + " " + c.text, lines, 1);
+		string test = string(c.mode) + " " + c.text;
+		if (c.accepted) check(status == 0, test, "child exited with status " + to_string(status));
+		else check(status == EXIT_FAILURE, test, "child exited with status " + to_string(status) + " instead of a runtime error");
+	}
+}
+
+// Blocks a thread allocates from its pools, to be freed by another thread after it has exited
+#define POOL_TEST_BLOCKS 100
+
+// Nested marks release exactly what was allocated after them, and a big allocation gets a chunk that is reused
+static void testRegions() {
+	regionMark outer = regionEnter();
+	char* first = (char*)regionAlloc(24);
+	regionMark inner = regionEnter();
+	char* second = (char*)regionAlloc(24);
+	check(second >= first + 24, "region", "allocations overlap");
+	char* big = (char*)regionAlloc(RT_REGION_CHUNK_BYTES);
+	memset(big, 1, RT_REGION_CHUNK_BYTES);
+	regionLeave(inner);
+	check(regionAlloc(24) == second, "region", "leaving the inner mark didn't release its allocations");
+	regionLeave(outer);
+	check(regionAlloc(24) == first, "region", "leaving the outer mark didn't release its allocations");
+	regionLeave(outer);
+
+	allocationCounters before, after;
+	allocationCounts(before);
+	for (int i = 0; i < 10; i++) {
+		regionMark mark = regionEnter();
+		memset(regionAlloc(RT_REGION_CHUNK_BYTES), 2, RT_REGION_CHUNK_BYTES);
+		regionLeave(mark);
+	}
+	allocationCounts(after);
+	check(after.regionChunks == before.regionChunks, "region", "released chunks weren't reused");
+}
+
+// A freed block is reused by the next allocation of its size class, and only of its size class
+static void testPools() {
+	void* block = poolAlloc(24);
+	poolFree(block, 24);
+	check(poolAlloc(RT_POOL_MIN_BYTES * 2) == block, "pool", "a freed block wasn't reused by its size class");
+	void* other = poolAlloc(RT_POOL_MIN_BYTES * 2 + 1);
+	check(other != block, "pool", "a block was given out twice");
+	poolFree(other, RT_POOL_MIN_BYTES * 2 + 1);
+	void* small = poolAlloc(RT_POOL_MIN_BYTES);
+	check(small != other, "pool", "a block was reused by the wrong size class");
+	poolFree(small, RT_POOL_MIN_BYTES);
+	poolFree(block, RT_POOL_MIN_BYTES * 2);
+
+	void* large = poolAlloc(RT_POOL_MAX_BYTES + 1);
+	memset(large, 3, RT_POOL_MAX_BYTES + 1);
+	poolFree(large, RT_POOL_MAX_BYTES + 1);
+}
+
+/* Blocks allocated by a thread that has exited stay valid, and freeing them puts them on the freeing thread's lists.
+ * The next thread to allocate adopts the exited thread's pools. Run with a leak or address sanitizer to see that
+ * neither the blocks nor the pools are lost, and no block is used after being freed. */
+static void testPoolFreeAfterExit() {
+	vector<int*> blocks;
+	thread allocator([&blocks]() {
+		for (int i = 0; i < POOL_TEST_BLOCKS; i++) {
+			int* block = (int*)poolAlloc(sizeof(int) * 8);
+			block[0] = i;
+			blocks.push_back(block);
+		}
+	});
+	allocator.join();
+
+	int damaged = 0;
+	for (int i = 0; i < POOL_TEST_BLOCKS; i++) {
+		if (blocks[i][0] != i) damaged++;
+		poolFree(blocks[i], sizeof(int) * 8);
+	}
+	check(damaged == 0, "pool free after exit", to_string(damaged) + " blocks changed after their thread exited");
+	// The last block freed is the first one reused
+	check(poolAlloc(sizeof(int) * 8) == blocks.back(), "pool free after exit", "a freed block wasn't reused");
+	poolFree(blocks.back(), sizeof(int) * 8);
+
+	void* freed = NULL;
+	void* reused = NULL;
+	thread first([&freed]() {
+		freed = poolAlloc(RT_POOL_MAX_BYTES);
+		poolFree(freed, RT_POOL_MAX_BYTES);
+	});
+	first.join();
+	thread second([&reused]() { reused = poolAlloc(RT_POOL_MAX_BYTES); });
+	second.join();
+	check(reused == freed, "pool free after exit", "a new thread didn't adopt the pools of an exited one");
+	poolFree(reused, RT_POOL_MAX_BYTES);
+}
+
+/* Each thread counts its own allocations from zero. Pool slabs are regions, so carving a new pool block also counts
+ * as a region allocation. This runs before any other thread has allocated, so the thread gets new pools instead of
+ * adopting an exited thread's, and has to get a slab chunk for them. */
+static void testCounters() {
+	allocationCounters counts;
+	bool counting = true;
+	thread counted([&counts, &counting]() {
+		regionMark mark = regionEnter();
+		for (int i = 0; i < 3; i++) regionAlloc(10);
+		regionLeave(mark);
+		regionAlloc(10);
+		void* block = poolAlloc(RT_POOL_MIN_BYTES);
+		poolFree(block, RT_POOL_MIN_BYTES);
+		poolAlloc(RT_POOL_MIN_BYTES);
+		poolFree(poolAlloc(RT_POOL_MAX_BYTES + 1), RT_POOL_MAX_BYTES + 1);
+		counting = allocationCounts(counts);
+	});
+	counted.join();
+	if (!counting) {
+		cout << "Skipped allocation counters: the runtime was built without RT_COUNT_ALLOCATIONS" << endl;
+		return;
+	}
+	check(counts.regionAllocations == 5, "counters", "regionAllocations is " + to_string(counts.regionAllocations));
+	check(counts.regionChunks == 2, "counters", "regionChunks is " + to_string(counts.regionChunks));
+	check(counts.regionBytes >= 4 * 10 + RT_POOL_MIN_BYTES, "counters", "regionBytes is " + to_string(counts.regionBytes));
+	check(counts.poolAllocations == 2, "counters", "poolAllocations is " + to_string(counts.poolAllocations));
+	check(counts.poolReuses == 1, "counters", "poolReuses is " + to_string(counts.poolReuses));
+	check(counts.poolFrees == 1, "counters", "poolFrees is " + to_string(counts.poolFrees));
+	check(counts.largeAllocations == 1, "counters", "largeAllocations is " + to_string(counts.largeAllocations));
+}
+
+static bool sameString(const rtString& value, const char* expected) {
+	return (stringLength(value) == strlen(expected)) && (memcmp(stringText(value), expected, strlen(expected)) == 0);
+}
+
+/* The child side of the input tests.
+ *    input - read the lines written by testInput and check each value
+ *    integer / float <text> - read one value and check it is the number in text
+ * Returns 0 if every value was read as expected. Bad input doesn't return, the runtime exits with EXIT_FAILURE. */
+static int childMain(int argc, char* argv[]) {
+	string mode = argv[1];
+	if ((mode == "integer") && (argc == 3)) return (getInteger() == (int)strtol(argv[2], NULL, 10)) ? 0 : 2;
+	if ((mode == "float") && (argc == 3)) return (getFloat() == strtod(argv[2], NULL)) ? 0 : 2;
+	if (mode != "input") return 2;
+
+	stall();
+	int wrong = 0;
+	for (int i = 0; i < INPUT_TEST_LINES; i++) {
+		if (getInteger() != inputTestInteger(i)) wrong++;
+	}
+	if (getFloat() != 2.5) wrong++;
+	if (getBool() != true) wrong++;
+	if (getBool() != false) wrong++;
+	if (!sameString(getString(), "a short string")) wrong++;
+	rtString first = getString();
+	rtString second = getString();
+	if (!sameString(first, "a string longer than a short one")) wrong++;
+	// Equal long strings are interned, so they are the same 16 bytes
+	if (!stringEqual(first, second)) wrong++;
+	if (wrong) cout << wrong << " input values read wrong" << endl;
+	return wrong ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc > 1) return childMain(argc, argv);
+#ifndef _WIN32
+	// A child that fails stops reading, which must not kill the test with SIGPIPE
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	thread watchdog([]() {
+		this_thread::sleep_for(chrono::seconds(TEST_TIMEOUT_SECONDS));
+		cout << "FAIL: runtime tests timed out" << endl;
+		exit(1);
+	});
+	watchdog.detach();
+
+	string self = argv[0];
+	testCounters();
+	testRegions();
+	testPools();
+	testPoolFreeAfterExit();
+	testQueue();
+	testInput(self, false);
+	testInput(self, true);
+	testNumberRanges(self);
+
+	if (failures) cout << failures << " runtime tests failed" << endl;
+	else cout << "All runtime tests passed" << endl;
+	return failures ? 1 : 0;
+}
@@ -2,13 +2,14 @@
 #include "scanner.h"
 #include "tokentypes.h"
 #include "token.h"
+#include "phaseReport.h"
 #include <iostream>
 #include <stdio.h>
 
 using namespace std;
 
 // Constructor
-Scanner::Scanner() {
+Scanner::Scanner() : reserved_table(keywords()) {
 	debug = false;
 	line_number = 1;
 	token = {};
@@ -19,6 +20,54 @@ Scanner::~Scanner() {
 	if (fPtr != nullptr) fclose(fPtr);
 }
 
+/* The reserved keyword table, shared by every scanner. It is filled the first time it is used, so a process
+ * compiling many programs (compilerServer.cpp) only builds it once. */
+const map<string, int>& Scanner::keywords() {
+	static const map<string, int> reserved = []() {
+		map<string, int> table;
+		table[";"] = T_SEMICOLON;
+		table[":"] = T_COLON;
+		table["("] = T_LPAREN;
+		table[")"] = T_RPAREN;
+		table[":="] = T_ASSIGNMENT;
+		table[">="] = T_COMPARE;
+		table[">"] = T_COMPARE;
+		table["<="] = T_COMPARE;
+		table["<"] = T_COMPARE;
+		table["/"] = T_DIVIDE;
+		table["*"] = T_MULTIPLY;
+		table["+"] = T_ADD;
+		table["-"] = T_SUBTRACT;
+		table[","] = T_COMMA;
+		table["["] = T_LBRACKET;
+		table["]"] = T_RBRACKET;
+		table["PROGRAM"] = T_PROGRAM;
+		table["IS"] = T_IS;
+		table["BEGIN"] = T_BEGIN;
+		table["END"] = T_END;
+		table["GLOBAL"] = T_GLOBAL;
+		table["PROCEDURE"] = T_PROCEDURE;
+		table["IN"] = T_IN;
+		table["OUT"] = T_OUT;
+		table["INOUT"] = T_INOUT;
+		table["INTEGER"] = T_INTEGER;
+		table["FLOAT"] = T_FLOAT;
+		table["BOOL"] = T_BOOL;
+		table["STRING"] = T_STRING;
+		table["NOT"] = T_NOT;
+		table["IF"] = T_IF;
+		table["THEN"] = T_THEN;
+		table["ELSE"] = T_ELSE;
+		table["FOR"] = T_FOR;
+		table["RETURN"] = T_RETURN;
+		table["TRUE"] = T_TRUE;
+		table["FALSE"] = T_FALSE;
+		table["VARIABLE"] = T_VARIABLE;
+		return table;
+	}();
+	return reserved;
+}
+
 bool Scanner::startScanner(string filename, bool debug_input) {
 	debug = debug_input;
 	line_number = 1;
@@ -29,48 +78,64 @@ bool Scanner::startScanner(string filename, bool debug_input) {
 		return false;
 	}
 
-	// Populate the reserved keyword table
-	reserved_table[";"] = T_SEMICOLON;
-	reserved_table[":"] = T_COLON;
-	reserved_table["("] = T_LPAREN;
-	reserved_table[")"] = T_RPAREN;
-	reserved_table[":="] = T_ASSIGNMENT;
-	reserved_table[">="] = T_COMPARE;
-	reserved_table[">"] = T_COMPARE;
-	reserved_table["<="] = T_COMPARE;
-	reserved_table["<"] = T_COMPARE;
-	reserved_table["/"] = T_DIVIDE;
-	reserved_table["*"] = T_MULTIPLY;
-	reserved_table["+"] = T_ADD;
-	reserved_table["-"] = T_SUBTRACT;
-	reserved_table[","] = T_COMMA;
-	reserved_table["["] = T_LBRACKET;
-	reserved_table["]"] = T_RBRACKET;
-	reserved_table["PROGRAM"] = T_PROGRAM;
-	reserved_table["IS"] = T_IS;
-	reserved_table["BEGIN"] = T_BEGIN;
-	reserved_table["END"] = T_END;
-	reserved_table["GLOBAL"] = T_GLOBAL;
-	reserved_table["PROCEDURE"] = T_PROCEDURE;
-	reserved_table["IN"] = T_IN; // TODO: Remove this?
-	reserved_table["OUT"] = T_OUT; // TODO: Remove this?
-	reserved_table["INOUT"] = T_INOUT; // TODO: Remove this?
-	reserved_table["INTEGER"] = T_INTEGER;
-	reserved_table["FLOAT"] = T_FLOAT;
-	reserved_table["BOOL"] = T_BOOL;
-	reserved_table["STRING"] = T_STRING;
-	reserved_table["NOT"] = T_NOT;
-	reserved_table["IF"] = T_IF;
-	reserved_table["THEN"] = T_THEN;
-	reserved_table["ELSE"] = T_ELSE;
-	reserved_table["FOR"] = T_FOR;
-	reserved_table["RETURN"] = T_RETURN;
-	reserved_table["TRUE"] = T_TRUE;
-	reserved_table["FALSE"] = T_FALSE;
-	reserved_table["VARIABLE"] = T_VARIABLE;
 	return true;
 }
 
+// Scan an open file, like a tmpfile() holding text that isn't saved (languageServer.cpp). The scanner closes it.
+bool Scanner::startScanner(FILE* file, bool debug_input) {
+	debug = debug_input;
+	line_number = 1;
+
+	fPtr = file;
+	return fPtr != nullptr;
+}
+
+/* Scan text in memory, starting from a state saved with state() (tokenStream.cpp). The text isn't copied, so it
+ * has to outlive the scanning. */
+void Scanner::startText(scanText text_input, scanRestart start) {
+	debug = false;
+	memory = true;
+	text = text_input;
+	position = start.offset;
+	line_number = start.line;
+	comment_depth = start.depth;
+}
+
+/* Read the tokens back from a syntax file made from the same source instead of scanning it. The file has to stay
+ * mapped until the last token is read. */
+void Scanner::startTokens(syntaxFile* file) {
+	replay = file;
+	replayed = 0;
+}
+
+/* Read the tokens back from a list made by scanning 'bytes' of source, ending with its T_EOF token (the tokens of a
+ * tokenStream). The list isn't copied, so it has to outlive the scanning. */
+void Scanner::startTokens(const vector<Token>* tokens, size_t bytes) {
+	replayTokens = tokens;
+	replayBytes = bytes;
+	replayed = 0;
+}
+
+// Where scanning is in the text, and its line and how many comments are open there
+scanRestart Scanner::state() {
+	scanRestart current = { position, line_number, comment_depth };
+	return current;
+}
+
+// The next character, like getc() on the file
+int Scanner::readChar() {
+	if (!memory) return getc(fPtr);
+	if (position < text.firstLength) return (unsigned char)text.first[position++];
+	if (position >= text.firstLength + text.secondLength) return EOF;
+	return (unsigned char)text.second[position++ - text.firstLength];
+}
+
+// Put back the last character read, like ungetc(). A character that reads as EOF can't be put back.
+void Scanner::unreadChar(char character) {
+	if (!memory) ungetc(character, fPtr);
+	else if (character != EOF) position--;
+}
+
 bool Scanner::isNum(char character) {
 	int ascii = (int)character;
 	if ((ascii >= 48) && (ascii <= 57))
@@ -137,20 +202,43 @@ bool Scanner::isSpace(char character) {
 }
 
 Token Scanner::getToken() {
-	return_token.type = scanToken(fPtr, &return_token);
+	TIME_PHASE(PHASE_SCAN);
+	if (replay) {
+		replay->token(replayed++, return_token);
+		COUNT_PHASE(tokens, return_token.type != T_EOF);
+		if (phases.enabled && (return_token.type == T_EOF)) phases.bytes = (long long)replay->sourceBytes();
+		return return_token;
+	}
+	if (replayTokens) {
+		// Past the end the T_EOF token is read again, like a scanner at the end of its input
+		size_t index = (replayed < replayTokens->size()) ? replayed++ : replayTokens->size() - 1;
+		return_token = (*replayTokens)[index];
+		COUNT_PHASE(tokens, return_token.type != T_EOF);
+		if (phases.enabled && (return_token.type == T_EOF)) phases.bytes = (long long)replayBytes;
+		return return_token;
+	}
+	return_token.type = scanToken(&return_token);
+	COUNT_PHASE(tokens, return_token.type != T_EOF);
+	if (phases.enabled && (return_token.type == T_EOF)) phases.bytes = memory ? (long long)position : ftell(fPtr);
 	return_token.line = line_number;
+	if (tree) tree->add(return_token);
 	if (debug && return_token.type != T_EOF) {
 		std::cout << return_token.ascii << " ";
 	}
 	return return_token;
 }
 
-int Scanner::scanToken(FILE* fPtr, Token* token) {
+int Scanner::scanToken(Token* token) {
+	ALLOCATION_SITE("Scanner::scanToken");
 	char ch;
 	char nextch = ' ';
 	string str = "";
+
+	// Text that was stopped inside a multiline comment goes on with the comment
+	if (comment_depth > 0) return scanComment(token, comment_depth);
+
 	do {
-		ch = getc(fPtr);
+		ch = readChar();
 		if (debug && (ch == '\n'))
 			std::cout << endl;
 	} while (isSpace(ch));
@@ -158,41 +246,21 @@ int Scanner::scanToken(FILE* fPtr, Token* token) {
 	// Handle comments or divisor token
 	if (ch == '/') {
 		str += ch;
-		nextch = getc(fPtr);
+		nextch = readChar();
 		if (nextch == '/') { // A comment is detected
-			while (nextch != '\n') { // Builds the single-line comment's string up until the line ends
+			while ((nextch != '\n') && (nextch != EOF)) { // Builds the single-line comment's string up until the line ends
 				str += nextch;
-				nextch = getc(fPtr);
+				nextch = readChar();
 			}
 			token->ascii = str;
 			line_number++;
 			return T_COMMENT;
 		}
 		else if (nextch == '*') { // Handling multiline comments
-			str += nextch;
-			int i = 1;
-			while (i > 0) {
-				nextch = getc(fPtr);
-				str += nextch;
-				if (nextch == '*') {
-					nextch = getc(fPtr);
-					str += nextch;
-					if (nextch == '/')
-						i -= 1; // A multiline comment has been closed
-				}
-				else if (nextch == '/') {
-					nextch = getc(fPtr);
-					str += nextch;
-					if (nextch == '*')
-						i += 1; // A nested multiline comment was detected
-				}
-				else if (nextch == '\n') line_number++;
-			}
-			token->ascii = str;
-			return T_COMMENT;
+			return scanComment(token, 1);
 		}
 		else {
-			ungetc(nextch, fPtr);
+			unreadChar(nextch);
 			token->ascii = str;
 			return T_DIVIDE;
 		}
@@ -200,63 +268,59 @@ int Scanner::scanToken(FILE* fPtr, Token* token) {
 	// Handle integer and float tokens
 	else if (isNum(ch)) {
 		str += ch;
-		nextch = getc(fPtr);
+		nextch = readChar();
 		while (isNum(nextch)) {
 			str += nextch;
-			nextch = getc(fPtr);
+			nextch = readChar();
 		}
 		if (nextch == '.') {
 			str += nextch;
-			nextch = getc(fPtr);
+			nextch = readChar();
 			while (isNum(nextch)) { // TODO: Do I need to allow underscores here as well? Check grammar's regex
 				str += nextch;
-				nextch = getc(fPtr);
+				nextch = readChar();
 			}
 			token->val.doubleValue = stod(str);
 			token->ascii = str;
-			ungetc(nextch, fPtr);
+			unreadChar(nextch);
 			return TYPE_FLOAT;
 		}
 		else {
 			token->val.intValue = stoi(str);
 			token->ascii = str;
-			ungetc(nextch, fPtr);
+			unreadChar(nextch);
 			return TYPE_INTEGER;
 		}
 	}
 	// Handle string tokens
 	else if (isString(ch)) {
 		str += ch; // Appends initial double quotation
-		nextch = getc(fPtr);
-		int i = 0;
-		while (!isString(nextch)) { // Appends string within quotes
-			token->val.stringValue[i++] = nextch;
+		nextch = readChar();
+		while (!isString(nextch) && (nextch != EOF)) { // Appends string within quotes
 			str += nextch;
-			nextch = getc(fPtr);
+			nextch = readChar();
 		}
-		str += nextch; // Appends string's closing double quotation
 		token->ascii = str;
+		if (nextch == EOF) return T_UNKNOWN; // String was never closed
+		token->ascii += nextch; // Appends string's closing double quotation
 		return TYPE_STRING;
 	}
 	// Handle identifier tokens
 	else if (isLetter(ch)) {
-		int i = 0;
-		token->val.stringValue[i++] = toupper(nextch);
 		str += toupper(ch); // Appends identifier's initial character
-		nextch = getc(fPtr);
+		nextch = readChar();
 		while (isLetter(nextch) || isNum(nextch) || nextch == '_') // Appends full identifier name
 		{
-			token->val.stringValue[i++] = toupper(nextch);
 			str += toupper(nextch);
-			nextch = getc(fPtr);
+			nextch = readChar();
 		}
-		ungetc(nextch, fPtr);
+		unreadChar(nextch);
 		token->ascii = str;
 
-		map<string, int>::iterator it;
+		map<string, int>::const_iterator it;
 		it = reserved_table.find(str);
 		if (it != reserved_table.end())
-			return reserved_table.find(str)->second; // returns the reserved keyword found in the table
+			return it->second; // returns the reserved keyword found in the table
 		else return TYPE_IDENTIFIER; // returns a generic identifier
 	}
 	else if (isSingleToken(ch)) {
@@ -275,40 +339,40 @@ int Scanner::scanToken(FILE* fPtr, Token* token) {
 		case '[': return T_LBRACKET;
 		case ']': return T_RBRACKET;
 		case ':':
-			ch = getc(fPtr);
+			ch = readChar();
 			if (ch == '=') {
 				str += ch;
 				token->ascii = str;
 				return T_ASSIGNMENT;
 			}
 			else {
-				ungetc(ch, fPtr);
+				unreadChar(ch);
 				token->ascii = str;
 				return T_COLON;
 			}
 		case '>': case '<': case '=':
-			ch = getc(fPtr);
+			ch = readChar();
 			if (ch == '=') {
 				str += ch;
 				token->ascii = str;
 				return T_LOGICAL;
 			}
 			else {
-				ungetc(ch, fPtr);
+				unreadChar(ch);
 				if (str == "=")
 					return T_UNKNOWN;
 				else
 					return T_LOGICAL;
 			}
 		case '!':
-			ch = getc(fPtr);
+			ch = readChar();
 			if (ch == '=') {
 				str += ch;
 				token->ascii = str;
 				return T_LOGICAL;
 			}
 			else {
-				ungetc(ch, fPtr);
+				unreadChar(ch);
 				return T_UNKNOWN;
 			}
 		case '&': case '|':
@@ -324,4 +388,47 @@ int Scanner::scanToken(FILE* fPtr, Token* token) {
 		token->ascii = str;
 		return T_UNKNOWN; // catches any unknown token
 	}
-}
\ No newline at end of file
+}
+
+/* Scan the rest of a multiline comment, 'depth' comments deep. Only the parser's pragmas are read from comments, and
+ * those are single-line. So a multiline comment's text is only kept when debugging prints it, and a long one isn't
+ * built into a string as it is scanned. Scanning text in memory, each line inside the comment is passed to
+ * restartPoint, and if that returns false scanning stops at the start of the line with the comment still open. */
+int Scanner::scanComment(Token* token, int depth) {
+	string str = "/*";
+	char ch;
+	char nextch = readChar();
+	comment_depth = 0;
+	while ((depth > 0) && (nextch != EOF)) {
+		ch = nextch;
+		nextch = readChar();
+		if (debug) str += ch;
+		if ((ch == '*') && (nextch == '/')) {
+			depth -= 1; // A multiline comment has been closed
+			if (debug) str += nextch;
+			nextch = readChar();
+		}
+		else if ((ch == '/') && (nextch == '*')) {
+			depth += 1; // A nested multiline comment was detected
+			if (debug) str += nextch;
+			nextch = readChar();
+		}
+		else if (ch == '\n') {
+			line_number++;
+			if (!memory || !restartPoint || (nextch == EOF)) continue;
+			scanRestart point = { position - 1, line_number, depth };
+			if (restartPoint(point)) continue;
+			position = point.offset;
+			comment_depth = depth;
+			token->ascii = "/* */";
+			return T_COMMENT;
+		}
+	}
+	unreadChar(nextch);
+	if (depth > 0) { // Comment was never closed
+		token->ascii = "/*";
+		return T_UNKNOWN;
+	}
+	token->ascii = debug ? str : "/* */";
+	return T_COMMENT;
+}
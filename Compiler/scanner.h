@@ -2,22 +2,58 @@
 #define SCANNER_H
 
 #include <string>
+#include <vector>
 #include <map>
+#include <functional>
 #include <cstdio>
 #include <stdlib.h>
 #include "tokentypes.h"
 #include "token.h"
+#include "syntaxTree.h"
 
 using namespace std;
+
+/* Struct to hold a point the scanner can start from in text in memory (tokenStream.cpp).
+ *    offset - position in the text
+ *    line - line number there
+ *    depth - multiline comments open there, 0 between tokens
+ */
+struct scanRestart {
+	size_t offset = 0;
+	int line = 1;
+	int depth = 0;
+};
+
+/* Struct to hold text in memory to scan, in two pieces that follow each other (the two sides of the gap in a gap
+ * buffer, tokenStream.cpp). Text in one piece has an empty second one.
+ */
+struct scanText {
+	const char* first = nullptr;
+	size_t firstLength = 0;
+	const char* second = nullptr;
+	size_t secondLength = 0;
+};
+
 class Scanner
 {
 private:
 	int line_number;
 	Token return_token;
 	FILE* fPtr = nullptr;
+	bool memory = false;
+	scanText text;
+	size_t position = 0;
+	int comment_depth = 0;
+	syntaxFile* replay = nullptr;
+	const vector<Token>* replayTokens = nullptr;
+	size_t replayBytes = 0;
+	size_t replayed = 0;
 	bool debug = false;
-	map<string, int> reserved_table;
-	int scanToken(FILE* fPtr, Token* token);
+	const map<string, int>& reserved_table;
+	int readChar();
+	void unreadChar(char character);
+	int scanToken(Token* token);
+	int scanComment(Token* token, int depth);
 	bool isNum(char character);
 	bool isLetter(char character);
 	bool isString(char character);
@@ -28,6 +64,15 @@ public:
 	Scanner();
 	~Scanner();
 	bool startScanner(string filename, bool debug_input);
+	bool startScanner(FILE* file, bool debug_input);
+	void startText(scanText text_input, scanRestart start);
+	scanRestart state();
+	void startTokens(syntaxFile* file);
+	void startTokens(const vector<Token>* tokens, size_t bytes);
+	// If a tree is given, every token scanned is added to it
+	syntaxTree* tree = nullptr;
+	function<bool(const scanRestart&)> restartPoint;
+	static const map<string, int>& keywords();
 	Token getToken();
 	void printToken(); // TODO: Delete this?
 	Token* token;
@@ -1,5 +1,6 @@
 #include "scope.h"
 #include "scopeInfo.h"
+#include "phaseReport.h"
 #include <string>
 #include <map>
 #include <vector>
@@ -32,8 +33,17 @@ void scope::setName(string id) {
 	return;
 }
 
+string scope::getName() {
+	return name;
+}
+
+map<string, scopeInfo> scope::getGlobals() {
+	return globalTable;
+}
+
 // Add procedure or variable symbol to this scope's local and/or global table along with scopeValue attributes.
 bool scope::addSymbol(string identifier, bool global, scopeInfo value) {
+	ALLOCATION_SITE("scope::addSymbol");
 	map<string, scopeInfo>::iterator it;
 	it = localTable.find(identifier);
 	if (it != localTable.end()) return false;
@@ -50,6 +60,7 @@ bool scope::addSymbol(string identifier, bool global, scopeInfo value) {
 
 		if (global) globalTable[identifier] = value;
 		localTable[identifier] = value;
+		return true;
 	}
 }
 
@@ -78,6 +89,7 @@ bool scope::checkSymbol(string identifier, bool global) {
 
 // Get symbol identifier's scopeValue from this scope's local table if one exists.
 scopeInfo scope::getSymbol(string identifier) {
+	ALLOCATION_SITE("scope::getSymbol");
 	map<string, scopeInfo>::iterator it;
 	it = localTable.find(identifier);
 	if (it != localTable.end()) {
@@ -166,9 +178,17 @@ void scope::printScope() {
 				if (Vec[vec_it].size > 0) {
 					cout << "[" << Vec[vec_it].size << "]";
 				}
-				switch (Vec[vec_it].parameterType) { // TODO: Delete this? Used to be in, out, inout
+				switch (Vec[vec_it].parameterType) {
+				case TYPE_PARAM_IN:
+					cout << " in";
+					break;
+				case TYPE_PARAM_OUT:
+					cout << " out";
+					break;
+				case TYPE_PARAM_INOUT:
+					cout << " inout";
+					break;
 				default:
-					cout << " ?";
 					break;
 				}
 			}
@@ -34,6 +34,10 @@ public:
 
 	//used as a label for the scope table. Will be useful for code generation.
 	void setName(string id);
+	string getName();
+
+	//global symbols of the scope, used to export the program scope's (moduleInterface.h)
+	map<string, scopeInfo> getGlobals();
 
 	//symbol table management
 	bool addSymbol(string identifier, bool global, scopeInfo value);
@@ -10,23 +10,25 @@ using namespace std;
  *    type - symbol type (procedure, string, integer, etc.)
  *    size - size of arrays (0 for non-arrays)
  *    arguments - vector of input arguments for functions.
- *    paramType - parameter type IN | OUT | INOUT | NULL
+ *    parameterType - parameter mode IN | OUT | INOUT, or NULL for parameters passed by value and other symbols
  *    FPoffset - number of bytes offset from Frame Pointer on the stack
  *    callLabel - string of a procedure call label
+ *    declaration - number of the symbol's declaration in the symbolIndex kept while parsing, -1 if none is kept
  */
 struct scopeInfo {
-	int type;
-	int size;
-	int returnType;
+	int type = 0;
+	int size = 0;
+	int returnType = 0;
 
 	// Used solely for function calls
 	vector<scopeInfo> arguments;
 	string callLabel;
 
 	// Used solely for variables
-	int parameterType; // TODO: Do we even need this?
-	int FPoffset;
+	int parameterType = 0;
+	int FPoffset = 0;
 
+	int declaration = -1;
 };
 
 #endif
\ No newline at end of file
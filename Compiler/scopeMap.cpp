@@ -2,6 +2,7 @@
 #include "scopeInfo.h"
 #include "scopeMap.h"
 #include "tokentypes.h"
+#include "phaseReport.h"
 #include <iostream>
 
 scopeMap::scopeMap(bool debug_input) {
@@ -9,13 +10,23 @@ scopeMap::scopeMap(bool debug_input) {
 	tmpPtr = nullptr;
 	curPtr = nullptr;
 	outermost = nullptr;
+	index = nullptr;
 }
 
+// Scopes are normally all exited by the end of the program, but not if parsing stopped early
 scopeMap::~scopeMap() {
-
+	while (curPtr != nullptr) {
+		tmpPtr = curPtr;
+		curPtr = curPtr->prevScope;
+		delete tmpPtr;
+	}
 }
 
 void scopeMap::newScope() {
+	TIME_PHASE(PHASE_SCOPE);
+	COUNT_PHASE(scopes, 1);
+	ALLOCATION_SITE("scopeMap::newScope");
+	if (phases.enabled && (++phases.scopeDepth > phases.peakScopeDepth)) phases.peakScopeDepth = phases.scopeDepth;
 	if (curPtr != nullptr) {
 		//Add procedure scope
 		tmpPtr = curPtr;
@@ -31,7 +42,9 @@ void scopeMap::newScope() {
 }
 
 void scopeMap::exitScope() {
+	TIME_PHASE(PHASE_SCOPE);
 	if (curPtr != nullptr) {
+		COUNT_PHASE(scopeDepth, -1);
 		if (debug) curPtr->printScope();
 		tmpPtr = curPtr;
 		curPtr = curPtr->prevScope;
@@ -41,9 +54,16 @@ void scopeMap::exitScope() {
 	return;
 }
 
-bool scopeMap::addSymbol(string identifier, scopeInfo value, bool global) {
+bool scopeMap::addSymbol(string identifier, scopeInfo& value, bool global) {
+	TIME_PHASE(PHASE_SCOPE);
+	COUNT_PHASE(symbolsAdded, 1);
 	if (curPtr != nullptr) {
 		if (!curPtr->checkSymbol(identifier, false)) {
+			if (index) {
+				// A procedure is added to its own scope first, but is declared in its parent's
+				scope* container = ((value.type == TYPE_PROCEDURE) && (curPtr->prevScope != nullptr)) ? curPtr->prevScope : curPtr;
+				value.declaration = index->declare(identifier, value, container->getName(), global);
+			}
 			curPtr->addSymbol(identifier, global, value);
 			return true;
 		}
@@ -52,10 +72,13 @@ bool scopeMap::addSymbol(string identifier, scopeInfo value, bool global) {
 	else return false;
 }
 
-bool scopeMap::prevAddSymbol(string identifier, scopeInfo value, bool global) {
+bool scopeMap::prevAddSymbol(string identifier, scopeInfo& value, bool global) {
+	TIME_PHASE(PHASE_SCOPE);
+	COUNT_PHASE(symbolsAdded, 1);
 	scope* prevPtr = curPtr->prevScope;
 	if (prevPtr != nullptr) {
 		if (!prevPtr->checkSymbol(identifier, false)) {
+			if (index) value.declaration = index->declare(identifier, value, prevPtr->getName(), global);
 			prevPtr->addSymbol(identifier, global, value);
 			return true;
 		}
@@ -66,6 +89,8 @@ bool scopeMap::prevAddSymbol(string identifier, scopeInfo value, bool global) {
 
 //returns true if symbol exists and puts its table entry into &value
 bool scopeMap::checkSymbol(string identifier, scopeInfo& value, bool& global) {
+	TIME_PHASE(PHASE_SCOPE);
+	COUNT_PHASE(symbolLookups, 1);
 	// Ensure there is actuall a scope to check
 	if (curPtr == nullptr) return false;
 
@@ -74,6 +99,7 @@ bool scopeMap::checkSymbol(string identifier, scopeInfo& value, bool& global) {
 	if (found) {
 		global = false;
 		value = curPtr->getSymbol(identifier);
+		if (index) index->use(identifier, value.declaration);
 		return true;
 	}
 	else {
@@ -81,9 +107,16 @@ bool scopeMap::checkSymbol(string identifier, scopeInfo& value, bool& global) {
 		if (found) {
 			global = true;
 			value = outermost->getSymbol(identifier);
+			if (index) index->use(identifier, value.declaration);
 			return true;
 		}
-		else return false;
+		for (size_t i = 0; i < imports.size(); i++) {
+			if (imports[i]->lookup(identifier, value)) {
+				global = true;
+				return true;
+			}
+		}
+		return false;
 	}
 	return false;
 }
@@ -93,6 +126,12 @@ int scopeMap::getFrameSize() {
 	return curPtr->totalBytes;
 }
 
+// Global symbols of the program scope, empty once it is exited
+map<string, scopeInfo> scopeMap::getGlobals() {
+	if (outermost == nullptr) return map<string, scopeInfo>();
+	return outermost->getGlobals();
+}
+
 // Set scope name - useful for debugging
 void scopeMap::ChangeScopeName(string name) {
 	curPtr->setName(name);
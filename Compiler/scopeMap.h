@@ -4,10 +4,16 @@
 #include "scope.h"
 #include "scopeInfo.h"
 #include "tokentypes.h"
+#include "symbolIndex.h"
+#include "moduleInterface.h"
+#include <vector>
+#include <map>
 
 /*
  * Interface for managing nested scope tables. Uses the 'scope' class to implement all functionality.
  * Will add and check symbols to the nested scope tables.
+ * If an index is given, every symbol added is declared in it and every symbol found is recorded as a use.
+ * Symbols that aren't in any scope are looked up in the imported module interfaces, in order, as globals.
  */
 class scopeMap
 {
@@ -17,16 +23,19 @@ private:
 	scope* outermost;
 	bool debug;
 public:
+	symbolIndex* index;
+	vector<moduleInterface*> imports;
 	scopeMap(bool debug_input);
 	~scopeMap();
 	void newScope();
 	void exitScope();
-	bool addSymbol(string identifier, scopeInfo value, bool global);
+	bool addSymbol(string identifier, scopeInfo& value, bool global);
 	//identical to addSymbol, but for one scope level up. Used to add procedure declaration to its parent scope and own scope
-	bool prevAddSymbol(string identifier, scopeInfo value, bool global);
+	bool prevAddSymbol(string identifier, scopeInfo& value, bool global);
 	bool checkSymbol(string identifier, scopeInfo& value, bool& global);
 	void ChangeScopeName(string name);
 	int getFrameSize();
+	map<string, scopeInfo> getGlobals();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "sha256.h"
+#include <string>
+#include <cstring>
+
+using namespace std;
+
+static const unsigned int roundConstants[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static unsigned int rotateRight(unsigned int value, int bits) {
+	return (value >> bits) | (value << (32 - bits));
+}
+
+// Constructor - initial hash value of SHA-256
+sha256::sha256() {
+	static const unsigned int initial[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	memcpy(state, initial, sizeof(state));
+	blockUsed = 0;
+	totalBytes = 0;
+}
+
+// Mix one 64 byte block into the state
+void sha256::transform(const unsigned char* data) {
+	unsigned int w[64];
+	int i;
+	for (i = 0; i < 16; i++) {
+		w[i] = ((unsigned int)data[i * 4] << 24) | ((unsigned int)data[i * 4 + 1] << 16) |
+			((unsigned int)data[i * 4 + 2] << 8) | (unsigned int)data[i * 4 + 3];
+	}
+	for (i = 16; i < 64; i++) {
+		unsigned int s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		unsigned int s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+	unsigned int e = state[4], f = state[5], g = state[6], h = state[7];
+	for (i = 0; i < 64; i++) {
+		unsigned int s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+		unsigned int choose = (e & f) ^ (~e & g);
+		unsigned int t1 = h + s1 + choose + roundConstants[i] + w[i];
+		unsigned int s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+		unsigned int majority = (a & b) ^ (a & c) ^ (b & c);
+		unsigned int t2 = s0 + majority;
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256::update(const string& data) {
+	update(data.data(), data.size());
+}
+
+void sha256::update(const char* data, size_t length) {
+	totalBytes += length;
+	while (length > 0) {
+		size_t take = 64 - blockUsed;
+		if (take > length) take = length;
+		memcpy(block + blockUsed, data, take);
+		blockUsed += take;
+		data += take;
+		length -= take;
+		if (blockUsed == 64) {
+			transform(block);
+			blockUsed = 0;
+		}
+	}
+}
+
+// Pad the message with a 1 bit, zeros and its length in bits, then write out the state
+string sha256::hexDigest() {
+	unsigned long long bits = totalBytes * 8;
+	unsigned char padding[72] = { 0x80 };
+	size_t padBytes = (blockUsed < 56) ? (56 - blockUsed) : (120 - blockUsed);
+	for (int i = 0; i < 8; i++) padding[padBytes + i] = (unsigned char)(bits >> (56 - 8 * i));
+	update((const char*)padding, padBytes + 8);
+
+	static const char digits[] = "0123456789abcdef";
+	string hex;
+	for (int i = 0; i < 8; i++) {
+		for (int shift = 28; shift >= 0; shift -= 4) hex += digits[(state[i] >> shift) & 0xF];
+	}
+	return hex;
+}
@@ -0,0 +1,27 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <string>
+
+using namespace std;
+
+/*
+ * SHA-256 (FIPS 180-4) of a byte string, used to name compile cache entries by their contents.
+ * Data can be added in pieces with update(); hexDigest() finishes the hash and returns it as 64 hex digits.
+ */
+class sha256
+{
+private:
+	unsigned int state[8];
+	unsigned char block[64];
+	size_t blockUsed;
+	unsigned long long totalBytes;
+	void transform(const unsigned char* data);
+public:
+	sha256();
+	void update(const string& data);
+	void update(const char* data, size_t length);
+	string hexDigest();
+};
+
+#endif
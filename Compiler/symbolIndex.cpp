@@ -0,0 +1,76 @@
+#include "symbolIndex.h"
+#include "scopeInfo.h"
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+/* Identifiers read but not yet declared or looked up that are remembered. Only the latest few can still be waiting
+ * (a procedure's name waits for its parameters), so older ones, like the program's name, are dropped. */
+#define INDEX_PENDING_LIMIT 64
+
+symbolIndex::symbolIndex() {
+	line = -1;
+}
+
+// The parser read an identifier on a line
+void symbolIndex::identifier(string name, int line_input) {
+	if (line_input != line) {
+		line = line_input;
+		onLine.clear();
+	}
+	symbolPosition position;
+	position.name = name;
+	position.line = line_input;
+	position.occurrence = onLine[name]++;
+	pending.push_back(position);
+	if (pending.size() > INDEX_PENDING_LIMIT) pending.erase(pending.begin());
+}
+
+// Take the latest identifier read with the name. Returns false if there isn't one waiting.
+bool symbolIndex::take(string name, symbolPosition& position) {
+	for (size_t i = pending.size(); i > 0; i--) {
+		if (pending[i - 1].name != name) continue;
+		position = pending[i - 1];
+		pending.erase(pending.begin() + (i - 1));
+		return true;
+	}
+	return false;
+}
+
+/* A symbol was added to a scope. A procedure is added to its own scope and then to its parent's, and the second one
+ * already has its declaration number from the first. Returns the number to keep in the symbol's scopeInfo. */
+int symbolIndex::declare(string name, scopeInfo& symbol, string container, bool global) {
+	if (symbol.declaration >= 0) return symbol.declaration;
+	symbolDeclaration declaration;
+	if (!take(name, declaration.position)) declaration.position.name = name;
+	declaration.position.declaration = (int)declarations.size();
+	declaration.symbol = symbol;
+	declaration.container = container;
+	declaration.global = global;
+	declarations.push_back(declaration);
+	return declaration.position.declaration;
+}
+
+// A symbol was looked up and found. Lookups the parser makes without reading the name (like after declaring it) aren't uses.
+void symbolIndex::use(string name, int declaration) {
+	symbolPosition position;
+	if ((declaration < 0) || !take(name, position)) return;
+	position.declaration = declaration;
+	references.push_back(position);
+}
+
+// The declaration that the appearance of a name is or refers to, -1 if it isn't in the index
+int symbolIndex::find(string name, int line_input, int occurrence) {
+	size_t i;
+	for (i = 0; i < declarations.size(); i++) {
+		symbolPosition& position = declarations[i].position;
+		if ((position.line == line_input) && (position.occurrence == occurrence) && (position.name == name)) return (int)i;
+	}
+	for (i = 0; i < references.size(); i++) {
+		symbolPosition& position = references[i];
+		if ((position.line == line_input) && (position.occurrence == occurrence) && (position.name == name)) return position.declaration;
+	}
+	return -1;
+}
@@ -0,0 +1,63 @@
+#ifndef SYMBOLINDEX_H
+#define SYMBOLINDEX_H
+
+#include "scopeInfo.h"
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+/* Struct to hold where an identifier appears in the source. Tokens don't have a column, so an appearance is the line
+ * and which appearance of the same name on that line it is (0 for the first). Tools find the column from the text.
+ *    name - the identifier, in upper case like the scanner makes it
+ *    line - line number, 0 for the runtime procedures, which aren't declared in the source
+ *    occurrence - appearances of the name earlier on the same line
+ *    declaration - index in symbolIndex::declarations of the symbol it refers to
+ */
+struct symbolPosition {
+	string name;
+	int line = 0;
+	int occurrence = 0;
+	int declaration = -1;
+};
+
+/* Struct to hold a declaration in the index.
+ *    position - where it is declared
+ *    symbol - its type, size, and return type and parameters for procedures
+ *    container - name of the scope it is declared in
+ *    global - declared with 'global', or one of the runtime procedures
+ */
+struct symbolDeclaration {
+	symbolPosition position;
+	scopeInfo symbol;
+	string container;
+	bool global = false;
+};
+
+/*
+ * Index of every declaration and every use of a declared symbol in a compilation unit, in all of its scopes, for
+ * go-to-definition and find-references in the language server (languageServer.cpp). It is filled while parsing:
+ * the parser passes each identifier it reads to identifier(), and scopeMap passes each symbol it adds to declare()
+ * and each symbol it finds to use(). Those go with the latest identifier read with the same name, which is the one
+ * being declared or looked up.
+ */
+class symbolIndex
+{
+private:
+	vector<symbolPosition> pending;
+	map<string, int> onLine;
+	int line;
+	bool take(string name, symbolPosition& position);
+public:
+	vector<symbolDeclaration> declarations;
+	vector<symbolPosition> references;
+
+	symbolIndex();
+	void identifier(string name, int line_input);
+	int declare(string name, scopeInfo& symbol, string container, bool global);
+	void use(string name, int declaration);
+	int find(string name, int line_input, int occurrence);
+};
+
+#endif
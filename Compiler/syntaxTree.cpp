@@ -0,0 +1,214 @@
+#include "syntaxTree.h"
+#include "tokentypes.h"
+#include "token.h"
+#include "fileMap.h"
+#include "sha256.h"
+#include <cstdio>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+// The string table starts with "", which nodes without a name refer to
+syntaxTree::syntaxTree() {
+	strings = string(1, '\0');
+	interned[""] = 0;
+}
+
+uint32_t syntaxTree::intern(const string& text) {
+	map<string, uint32_t>::iterator it = interned.find(text);
+	if (it != interned.end()) return it->second;
+	uint32_t offset = (uint32_t)strings.size();
+	strings += text;
+	strings += '\0';
+	interned[text] = offset;
+	return offset;
+}
+
+/* A token was scanned. Only literals keep their value, since the scanner leaves the last one in other tokens. The
+ * parser can ask for tokens again after the end, which are all the same T_EOF token. */
+void syntaxTree::add(const Token& token) {
+	if (!tokens.empty() && (tokens.back().type == T_EOF) && (token.type == T_EOF)) return;
+	syntaxToken record;
+	bool literal = !token.ascii.empty() && isdigit((unsigned char)token.ascii[0]);
+	record.type = token.type;
+	record.line = token.line;
+	record.text = intern(token.ascii);
+	record.integer = (literal && (token.type == TYPE_INTEGER)) ? token.val.intValue : 0;
+	record.real = (literal && (token.type == TYPE_FLOAT)) ? token.val.doubleValue : 0.0;
+	tokens.push_back(record);
+}
+
+/* Open a node starting at the token being parsed, or at the identifier read last when the parser only knows it is
+ * parsing a call after reading the name. Returns the node's index to end it with. */
+size_t syntaxTree::begin(bool fromIdentifier) {
+	uint32_t first = tokens.empty() ? 0 : (uint32_t)(tokens.size() - 1);
+	if (fromIdentifier) {
+		for (size_t i = first; i > 0; i--) {
+			if (tokens[i - 1].type != T_IDENTIFIER) continue;
+			first = (uint32_t)(i - 1);
+			break;
+		}
+	}
+	syntaxNode node;
+	node.kind = 0;
+	node.parent = open.empty() ? -1 : (int32_t)open.back();
+	node.end = 0;
+	node.firstToken = first;
+	node.tokenEnd = first;
+	node.name = 0;
+	node.type = 0;
+	node.size = 0;
+	open.push_back(nodes.size());
+	nodes.push_back(node);
+	return nodes.size() - 1;
+}
+
+/* Close a node before the token being parsed. A node closed without a kind wasn't the construct it was opened for,
+ * and is dropped along with anything opened inside it. */
+void syntaxTree::end(size_t node, int kind, int type, int size) {
+	while (!open.empty() && (open.back() >= node)) open.pop_back();
+	if (kind == 0) {
+		nodes.resize(node);
+		return;
+	}
+	syntaxNode& record = nodes[node];
+	uint32_t tokenEnd = tokens.empty() ? 0 : (uint32_t)(tokens.size() - 1);
+	if (tokenEnd < record.firstToken) tokenEnd = record.firstToken;
+	while ((record.firstToken < tokenEnd) && (tokens[record.firstToken].type == T_COMMENT)) record.firstToken++;
+	while ((tokenEnd > record.firstToken) && (tokens[tokenEnd - 1].type == T_COMMENT)) tokenEnd--;
+	record.kind = kind;
+	record.end = (uint32_t)nodes.size();
+	record.tokenEnd = tokenEnd;
+	record.type = type;
+	record.size = size;
+
+	// Declarations, assignments and calls are named by their first identifier
+	if ((kind != NODE_IF) && (kind != NODE_LOOP) && (kind != NODE_RETURN)) {
+		for (uint32_t i = record.firstToken; i < tokenEnd; i++) {
+			if (tokens[i].type != T_IDENTIFIER) continue;
+			record.name = tokens[i].text;
+			break;
+		}
+	}
+}
+
+/* Write the syntax file. It is written to a temporary file first and then renamed, so a compiler or tool reading it
+ * at the same time never maps a partial one. */
+bool syntaxTree::write(string filename, string sourceHash, uint64_t sourceBytes) {
+	syntaxHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SYNTAX_MAGIC, sizeof(header.magic));
+	header.version = SYNTAX_VERSION;
+	header.tokenCount = (uint32_t)tokens.size();
+	header.nodeCount = (uint32_t)nodes.size();
+	header.stringBytes = (uint32_t)strings.size();
+	header.sourceBytes = sourceBytes;
+	memcpy(header.sourceHash, sourceHash.data(), min(sourceHash.size(), sizeof(header.sourceHash)));
+
+	string temporary = filename + ".tmp";
+	{
+		ofstream out(temporary.c_str(), ios::out | ios::binary | ios::trunc);
+		if (!out) return false;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if (!tokens.empty()) out.write(reinterpret_cast<const char*>(&tokens[0]), tokens.size() * sizeof(syntaxToken));
+		if (!nodes.empty()) out.write(reinterpret_cast<const char*>(&nodes[0]), nodes.size() * sizeof(syntaxNode));
+		out.write(strings.data(), strings.size());
+		if (!out) {
+			out.close();
+			remove(temporary.c_str());
+			return false;
+		}
+	}
+#ifdef _WIN32
+	remove(filename.c_str());
+#endif
+	if (rename(temporary.c_str(), filename.c_str()) != 0) {
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Map the syntax file and check its header and that the arrays it describes fit in it
+syntaxFile::syntaxFile(string filename) : file(filename.c_str()) {
+	header = nullptr;
+	tokens = nullptr;
+	nodes = nullptr;
+	strings = nullptr;
+	if (!file || (file.size() < sizeof(syntaxHeader))) return;
+
+	const syntaxHeader* candidate = reinterpret_cast<const syntaxHeader*>(file.begin());
+	if ((memcmp(candidate->magic, SYNTAX_MAGIC, sizeof(candidate->magic)) != 0) || (candidate->version != SYNTAX_VERSION)) return;
+	size_t bytes = sizeof(syntaxHeader) + (size_t)candidate->tokenCount * sizeof(syntaxToken);
+	bytes += (size_t)candidate->nodeCount * sizeof(syntaxNode) + candidate->stringBytes;
+	if ((bytes != file.size()) || (candidate->tokenCount == 0) || (candidate->stringBytes == 0)) return;
+	if (file.begin()[file.size() - 1] != '\0') return;
+
+	header = candidate;
+	tokens = reinterpret_cast<const syntaxToken*>(file.begin() + sizeof(syntaxHeader));
+	nodes = reinterpret_cast<const syntaxNode*>(tokens + header->tokenCount);
+	strings = reinterpret_cast<const char*>(nodes + header->nodeCount);
+}
+
+// Whether the file was mapped and is a syntax file written by this version
+bool syntaxFile::valid() {
+	return header != nullptr;
+}
+
+// Whether the file was made from a source with this hash
+bool syntaxFile::matches(string sourceHash) {
+	return header && (sourceHash.size() == sizeof(header->sourceHash)) && (memcmp(header->sourceHash, sourceHash.data(), sourceHash.size()) == 0);
+}
+
+size_t syntaxFile::tokenCount() {
+	return header ? header->tokenCount : 0;
+}
+
+size_t syntaxFile::nodeCount() {
+	return header ? header->nodeCount : 0;
+}
+
+uint64_t syntaxFile::sourceBytes() {
+	return header ? header->sourceBytes : 0;
+}
+
+// A string in the table. The table ends with a NUL, so only an offset past its end (a damaged file) needs checking.
+const char* syntaxFile::text(uint32_t offset) {
+	if (offset >= header->stringBytes) return "";
+	return strings + offset;
+}
+
+/* Put a token into &result as the scanner made it. Like the scanner's, only literals set the value, and the other
+ * tokens keep the one before them, which the parser reads after taking an array size. Reading past the last token
+ * gives the last one (T_EOF) again, as scanning does. */
+void syntaxFile::token(size_t index, Token& result) {
+	if (index >= header->tokenCount) index = header->tokenCount - 1;
+	const syntaxToken& record = tokens[index];
+	result.type = record.type;
+	result.line = record.line;
+	result.ascii = text(record.text);
+	if (!isdigit((unsigned char)result.ascii[0])) return;
+	if (record.type == TYPE_FLOAT) result.val.doubleValue = record.real;
+	else if (record.type == TYPE_INTEGER) result.val.intValue = record.integer;
+}
+
+// The SHA-256 and size of a source, for telling whether a syntax file was made from it
+bool syntaxFile::hashSource(string filename, string& hash, uint64_t& bytes) {
+	fileMap source(filename.c_str());
+	sha256 digest;
+	if (source) digest.update(source.begin(), source.size());
+	else {
+		// An empty file maps to nothing, so tell it apart from one that can't be read
+		ifstream file(filename.c_str(), ios::in | ios::binary);
+		if (!file) return false;
+	}
+	hash = digest.hexDigest();
+	bytes = source ? source.size() : 0;
+	return true;
+}
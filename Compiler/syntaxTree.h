@@ -0,0 +1,131 @@
+#ifndef SYNTAXTREE_H
+#define SYNTAXTREE_H
+
+#include "token.h"
+#include "fileMap.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+// First bytes of every syntax file
+#define SYNTAX_MAGIC "EECESYNT"
+
+// Changes whenever the layout of the records or the meaning of their fields changes
+#define SYNTAX_VERSION 1
+
+// Kinds of the nodes of a syntax tree
+#define NODE_PROGRAM 1
+#define NODE_PROCEDURE 2
+#define NODE_PARAMETER 3
+#define NODE_VARIABLE 4
+#define NODE_TYPE 5
+#define NODE_ASSIGNMENT 6
+#define NODE_IF 7
+#define NODE_LOOP 8
+#define NODE_RETURN 9
+#define NODE_CALL 10
+
+/* Struct at the start of a syntax file. The tokens, the nodes and the string table follow it in that order.
+ *    magic - SYNTAX_MAGIC, without its terminating NUL
+ *    version - SYNTAX_VERSION of the compiler that wrote it
+ *    tokenCount / nodeCount - records in the token and node arrays
+ *    stringBytes - size of the string table, which holds each distinct token text once, NUL terminated
+ *    sourceBytes / sourceHash - size and SHA-256 (64 hex digits) of the source the file was made from
+ */
+struct syntaxHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t tokenCount;
+	uint32_t nodeCount;
+	uint32_t stringBytes;
+	uint64_t sourceBytes;
+	char sourceHash[64];
+};
+
+/* Struct to hold a token, in the order they were scanned (comments included), ending with the T_EOF token.
+ *    type / line - as in Token
+ *    text - offset of the token's ascii in the string table
+ *    integer / real - value of integer and float literals, 0 for other tokens
+ */
+struct syntaxToken {
+	int32_t type;
+	int32_t line;
+	uint32_t text;
+	int32_t integer;
+	double real;
+};
+
+/* Struct to hold a node of the parse tree. Nodes are in preorder: a node's descendants are the nodes after it up to
+ * 'end', and its first child (if any) is the node right after it.
+ *    kind - NODE_* constant
+ *    parent - index of the parent node, -1 for a program
+ *    end - index just past the node's last descendant
+ *    firstToken / tokenEnd - the tokens the node was parsed from, without comments before or after it
+ *    name - offset in the string table of the name declared, assigned or called, 0 ("") for other nodes
+ *    type / size - declared type and array size of variables and parameters, and return type of procedures
+ */
+struct syntaxNode {
+	int32_t kind;
+	int32_t parent;
+	uint32_t end;
+	uint32_t firstToken;
+	uint32_t tokenEnd;
+	uint32_t name;
+	int32_t type;
+	int32_t size;
+};
+
+/*
+ * Syntax file of a source being compiled: the tokens scanned (Scanner adds them), and the tree of declarations,
+ * statements and calls the parser found in them. The parser builds IR as it parses instead of a tree, so expressions
+ * are only kept as the tokens of the nodes around them. Nodes are opened when the parser starts on a construct and
+ * closed when it is done, so a node that turned out not to be one can be dropped.
+ */
+class syntaxTree
+{
+private:
+	vector<syntaxToken> tokens;
+	vector<syntaxNode> nodes;
+	vector<size_t> open;
+	string strings;
+	map<string, uint32_t> interned;
+	uint32_t intern(const string& text);
+public:
+	syntaxTree();
+	void add(const Token& token);
+	size_t begin(bool fromIdentifier = false);
+	void end(size_t node, int kind, int type = 0, int size = 0);
+	bool write(string filename, string sourceHash, uint64_t sourceBytes);
+};
+
+/*
+ * A syntax file mapped read only into memory. The file is made of arrays of fixed size records that refer to each
+ * other by index and to their text by offset, so it is used where it is mapped, with no pointers to fix up and
+ * nothing allocated per node. The compiler reads the tokens back from it instead of scanning a source that hasn't
+ * changed, and other tools (linters, formatters, metrics) can read it without the compiler's code, using only the
+ * structs above. Every field is in the byte order of the machine that wrote it.
+ */
+class syntaxFile
+{
+private:
+	fileMap file;
+	const syntaxHeader* header;
+public:
+	const syntaxToken* tokens;
+	const syntaxNode* nodes;
+	const char* strings;
+	syntaxFile(string filename);
+	bool valid();
+	bool matches(string sourceHash);
+	size_t tokenCount();
+	size_t nodeCount();
+	uint64_t sourceBytes();
+	const char* text(uint32_t offset);
+	void token(size_t index, Token& result);
+	static bool hashSource(string filename, string& hash, uint64_t& bytes);
+};
+
+#endif
@@ -9,7 +9,7 @@ using namespace std;
    ascii - the actual token string
    type - token type (identifier, begin, end, etc.)
    line - the line of the inputfile the token is found in
-   val - stored value of char, integer, double, string symbols
+   val - stored value of integer and double symbols. Strings and identifiers are only kept in ascii.
 */
 class Token {
 	public:
@@ -17,7 +17,6 @@ class Token {
 		int type;
 		int line;
 		union {
-			char stringValue[256];
 			int intValue;
 			double doubleValue;
 		} val;
@@ -0,0 +1,442 @@
+#include "tokenStream.h"
+#include "scanner.h"
+#include "tokentypes.h"
+#include "token.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+using namespace std;
+
+// Index of the first token in a chunk ending at or after an offset in the text, the chunk's size if none does
+static size_t firstEnding(tokenChunk& chunk, size_t offset) {
+	size_t low = 0, high = chunk.ends.size();
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		if ((size_t)(chunk.offset + (long long)chunk.ends[middle]) < offset) low = middle + 1;
+		else high = middle;
+	}
+	return low;
+}
+
+// Index of the first restart point in a chunk at or after an offset in the text
+static size_t firstRestart(tokenChunk& chunk, size_t offset) {
+	size_t low = 0, high = chunk.restarts.size();
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		if ((size_t)(chunk.offset + (long long)chunk.restarts[middle].offset) < offset) low = middle + 1;
+		else high = middle;
+	}
+	return low;
+}
+
+tokenStream::tokenStream(string text_input) {
+	buffer = text_input;
+	gapStart = gapEnd = buffer.size();
+	vector<Token> scanned;
+	vector<size_t> scannedEnds;
+	vector<scanRestart> scannedRestarts;
+	Scanner scanner;
+	scanner.startText(pieces(), scanRestart());
+	scanner.restartPoint = [&](const scanRestart& point) {
+		scannedRestarts.push_back(point);
+		return true;
+	};
+	do {
+		scanned.push_back(scanner.getToken());
+		scannedEnds.push_back(scanner.state().offset);
+	} while (scanned.back().type != T_EOF);
+	count = 0;
+	rebuild(0, 0, scanned, scannedEnds, scannedRestarts);
+}
+
+// Move the gap in the text to an offset, making it at least 'room' bytes
+void tokenStream::moveGap(size_t offset, size_t room) {
+	if (gapEnd - gapStart < room) {
+		// Grow it by a part of the text as well, so that growing it again is rare
+		size_t grow = room - (gapEnd - gapStart) + max((size_t)TEXT_GAP, length() / 8);
+		buffer.insert(gapEnd, grow, '\0');
+		gapEnd += grow;
+	}
+	if (offset < gapStart) {
+		size_t moved = gapStart - offset;
+		memmove(&buffer[gapEnd - moved], &buffer[offset], moved);
+		gapStart -= moved;
+		gapEnd -= moved;
+	}
+	else if (offset > gapStart) {
+		size_t moved = offset - gapStart;
+		memmove(&buffer[gapStart], &buffer[gapEnd], moved);
+		gapStart += moved;
+		gapEnd += moved;
+	}
+}
+
+// The text before and after the gap, for the scanner
+scanText tokenStream::pieces() {
+	scanText text;
+	text.first = buffer.data();
+	text.firstLength = gapStart;
+	text.second = buffer.data() + gapEnd;
+	text.secondLength = buffer.size() - gapEnd;
+	return text;
+}
+
+size_t tokenStream::length() {
+	return buffer.size() - (gapEnd - gapStart);
+}
+
+string tokenStream::text() {
+	return buffer.substr(0, gapStart) + buffer.substr(gapEnd);
+}
+
+// The first chunk from 'from' on with a token ending at or after 'offset', chunks.size() if there isn't one
+size_t tokenStream::chunkEnding(size_t offset, size_t from) {
+	size_t low = from, high = chunks.size();
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		tokenChunk& chunk = chunks[middle];
+		if ((size_t)(chunk.offset + (long long)chunk.ends.back()) < offset) low = middle + 1;
+		else high = middle;
+	}
+	return low;
+}
+
+// Replace chunks [from, to) with chunks holding these tokens, ends and restart points, which aren't relative to a base
+void tokenStream::rebuild(size_t from, size_t to, vector<Token>& tokens, vector<size_t>& ends, vector<scanRestart>& restarts) {
+	for (size_t c = from; c < to; c++) count -= chunks[c].tokens.size();
+	count += tokens.size();
+	size_t pieces = max((size_t)1, (tokens.size() + TOKEN_CHUNK - 1) / TOKEN_CHUNK);
+	vector<tokenChunk> built(pieces);
+	size_t restart = 0;
+	for (size_t p = 0; p < pieces; p++) {
+		size_t low = tokens.size() * p / pieces, high = tokens.size() * (p + 1) / pieces;
+		tokenChunk& chunk = built[p];
+		chunk.tokens.assign(make_move_iterator(tokens.begin() + low), make_move_iterator(tokens.begin() + high));
+		chunk.ends.assign(ends.begin() + low, ends.begin() + high);
+		while ((restart < restarts.size()) && ((high == tokens.size()) || (restarts[restart].offset < ends[high - 1]))) {
+			chunk.restarts.push_back(restarts[restart++]);
+		}
+	}
+	// The chunks after them are only moved if the number of chunks changes
+	size_t same = min(to - from, pieces);
+	for (size_t p = 0; p < same; p++) chunks[from + p] = move(built[p]);
+	if (to - from > same) chunks.erase(chunks.begin() + from + same, chunks.begin() + to);
+	else chunks.insert(chunks.begin() + from + same, make_move_iterator(built.begin() + same), make_move_iterator(built.end()));
+}
+
+relexResult tokenStream::edit(textEdit change) {
+	size_t start = min(change.offset, length());
+	size_t end = start + min(change.length, length() - start);
+	long long delta = (long long)change.text.size() - (long long)(end - start);
+	size_t editEnd = start + change.text.size();
+	size_t c, i;
+
+	// The tokens before the first one ending at or after the edit didn't read the byte after them, which is in it
+	size_t firstChunk = min(chunkEnding(start, 0), chunks.size() - 1);
+	tokenChunk& chunk = chunks[firstChunk];
+	size_t first = min(firstEnding(chunk, start), chunk.tokens.size() - 1);
+	scanRestart from;
+	if (first > 0) {
+		from.offset = (size_t)(chunk.offset + (long long)chunk.ends[first - 1]);
+		from.line = chunk.line + chunk.tokens[first - 1].line;
+	}
+	else if (firstChunk > 0) {
+		tokenChunk& previous = chunks[firstChunk - 1];
+		from.offset = (size_t)(previous.offset + (long long)previous.ends.back());
+		from.line = previous.line + previous.tokens.back().line;
+	}
+	/* Inside a multiline comment, start from its last line before the edit. Whether a line is a restart point depends
+	 * on its first byte, so that has to be before the edit too. */
+	size_t kept = firstRestart(chunk, start);
+	if ((kept > 0) && ((size_t)(chunk.offset + (long long)chunk.restarts[kept - 1].offset) > from.offset)) {
+		from = chunk.restarts[kept - 1];
+		from.offset = (size_t)(chunk.offset + (long long)from.offset);
+		from.line += chunk.line;
+	}
+
+	moveGap(start, 0);
+	gapEnd += end - start;
+	moveGap(start, change.text.size());
+	if (!change.text.empty()) memcpy(&buffer[gapStart], change.text.data(), change.text.size());
+	gapStart += change.text.size();
+
+	/* Scan until the state after a new token (or at a line in a comment) past the edit is the state after an old one,
+	 * shifted by the edit. Everything from there on is the same text scanned from the same state, so it is kept:
+	 * from token 'resume' and restart point 'resumeRestart' of chunk 'resumeChunk' on (none if it is chunks.size()). */
+	vector<Token> fresh;
+	vector<size_t> freshEnds;
+	vector<scanRestart> freshRestarts;
+	size_t resumeChunk = chunks.size(), resume = 0, resumeRestart = 0;
+	int lineShift = 0;
+	bool inComment = false;
+	Scanner scanner;
+	scanner.startText(pieces(), from);
+	scanner.restartPoint = [&](const scanRestart& point) {
+		if (point.offset >= editEnd) {
+			size_t old = (size_t)((long long)point.offset - delta);
+			size_t holder = chunkEnding(old + 1, firstChunk);
+			if (holder < chunks.size()) {
+				tokenChunk& oldChunk = chunks[holder];
+				size_t r = firstRestart(oldChunk, old);
+				if ((r < oldChunk.restarts.size()) && ((size_t)(oldChunk.offset + (long long)oldChunk.restarts[r].offset) == old) && (oldChunk.restarts[r].depth == point.depth)) {
+					// The old token the comment is in finishes it
+					resumeChunk = holder;
+					resumeRestart = r;
+					resume = firstEnding(oldChunk, old + 1);
+					lineShift = point.line - (oldChunk.line + oldChunk.restarts[r].line);
+					inComment = true;
+					return false;
+				}
+			}
+		}
+		freshRestarts.push_back(point);
+		return true;
+	};
+	while (true) {
+		Token token = scanner.getToken();
+		if (inComment) break;
+		size_t offset = scanner.state().offset;
+		fresh.push_back(token);
+		freshEnds.push_back(offset);
+		if (token.type == T_EOF) break;
+		if (offset < editEnd) continue;
+		size_t old = (size_t)((long long)offset - delta);
+		size_t holder = chunkEnding(old, firstChunk);
+		if (holder == chunks.size()) continue;
+		tokenChunk& oldChunk = chunks[holder];
+		size_t match = firstEnding(oldChunk, old);
+		// The end of the text after the old T_EOF token isn't a state to go on from, since nothing follows it
+		if (((size_t)(oldChunk.offset + (long long)oldChunk.ends[match]) != old) || (oldChunk.tokens[match].type == T_EOF)) continue;
+		lineShift = token.line - (oldChunk.line + oldChunk.tokens[match].line);
+		resumeChunk = holder;
+		resume = match + 1;
+		if (resume == oldChunk.tokens.size()) {
+			resumeChunk++;
+			resume = 0;
+		}
+		resumeRestart = firstRestart(chunks[resumeChunk], old);
+		break;
+	}
+
+	relexResult result;
+	for (c = 0; c < firstChunk; c++) result.first += chunks[c].tokens.size();
+	size_t resumeIndex = count;
+	if (resumeChunk < chunks.size()) {
+		resumeIndex = result.first + resume;
+		for (c = firstChunk; c < resumeChunk; c++) resumeIndex += chunks[c].tokens.size();
+	}
+	result.first += first;
+	result.removed = resumeIndex - result.first;
+	result.inserted = fresh.size();
+	result.lineShift = lineShift;
+	result.scanned = scanner.state().offset - from.offset;
+
+	// The chunks after the ones rebuilt only have their bases shifted
+	size_t rebuilt = (resumeChunk < chunks.size()) ? resumeChunk + 1 : chunks.size();
+	for (c = rebuilt; (c < chunks.size()) && ((delta != 0) || (lineShift != 0)); c++) {
+		chunks[c].offset += delta;
+		chunks[c].line += lineShift;
+	}
+
+	// The tokens of the rebuilt chunks before the edit, the new ones, and the old ones after it shifted
+	vector<Token> tokens;
+	vector<size_t> ends;
+	vector<scanRestart> restarts;
+	for (i = 0; i < first; i++) {
+		tokens.push_back(chunk.tokens[i]);
+		tokens.back().line += chunk.line;
+		ends.push_back((size_t)(chunk.offset + (long long)chunk.ends[i]));
+	}
+	for (i = 0; i < kept; i++) {
+		restarts.push_back(chunk.restarts[i]);
+		restarts.back().offset = (size_t)(chunk.offset + (long long)restarts.back().offset);
+		restarts.back().line += chunk.line;
+	}
+	tokens.insert(tokens.end(), make_move_iterator(fresh.begin()), make_move_iterator(fresh.end()));
+	ends.insert(ends.end(), freshEnds.begin(), freshEnds.end());
+	restarts.insert(restarts.end(), freshRestarts.begin(), freshRestarts.end());
+	if (resumeChunk < chunks.size()) {
+		tokenChunk& last = chunks[resumeChunk];
+		for (i = resume; i < last.tokens.size(); i++) {
+			tokens.push_back(last.tokens[i]);
+			tokens.back().line += last.line + lineShift;
+			ends.push_back((size_t)(last.offset + (long long)last.ends[i] + delta));
+		}
+		for (i = resumeRestart; i < last.restarts.size(); i++) {
+			restarts.push_back(last.restarts[i]);
+			restarts.back().offset = (size_t)(last.offset + (long long)restarts.back().offset + delta);
+			restarts.back().line += last.line + lineShift;
+		}
+	}
+	rebuild(firstChunk, rebuilt, tokens, ends, restarts);
+	return result;
+}
+
+size_t tokenStream::size() {
+	return count;
+}
+
+// A token, with its line number. Finding it walks the chunks.
+Token tokenStream::token(size_t index) {
+	size_t c = 0;
+	while (index >= chunks[c].tokens.size()) index -= chunks[c++].tokens.size();
+	Token found = chunks[c].tokens[index];
+	found.line += chunks[c].line;
+	return found;
+}
+
+// Offset in the text just past a token
+size_t tokenStream::end(size_t index) {
+	size_t c = 0;
+	while (index >= chunks[c].tokens.size()) index -= chunks[c++].tokens.size();
+	return (size_t)(chunks[c].offset + (long long)chunks[c].ends[index]);
+}
+
+vector<Token> tokenStream::tokens() {
+	vector<Token> all;
+	all.reserve(count);
+	for (size_t c = 0; c < chunks.size(); c++) {
+		for (size_t i = 0; i < chunks[c].tokens.size(); i++) {
+			all.push_back(chunks[c].tokens[i]);
+			all.back().line += chunks[c].line;
+		}
+	}
+	return all;
+}
+
+vector<size_t> tokenStream::ends() {
+	vector<size_t> all;
+	all.reserve(count);
+	for (size_t c = 0; c < chunks.size(); c++) {
+		for (size_t i = 0; i < chunks[c].ends.size(); i++) all.push_back((size_t)(chunks[c].offset + (long long)chunks[c].ends[i]));
+	}
+	return all;
+}
+
+// The points inside multiline comments the scanner can restart from, with the comments open at each
+vector<scanRestart> tokenStream::restarts() {
+	vector<scanRestart> all;
+	for (size_t c = 0; c < chunks.size(); c++) {
+		for (size_t r = 0; r < chunks[c].restarts.size(); r++) {
+			all.push_back(chunks[c].restarts[r]);
+			all.back().offset = (size_t)(chunks[c].offset + (long long)all.back().offset);
+			all.back().line += chunks[c].line;
+		}
+	}
+	return all;
+}
+
+// Pieces of text the check inserts. Most of them open or close something that changes how the text after it scans.
+static const char* relexPieces[] = { "/*", "*/", "//", "\n", "\"", " ", "x", "12", "3.5", ":=", "<", "=", "begin", ";",
+	"end program.", "/* comment */", "\"text\"" };
+
+/* Whether two tokens are the same. Only literals have a value, the other tokens keep the scanner's last one. The
+ * T_EOF token keeps the text of the token the scanner made before it too, which an edit can change without
+ * scanning the end of the text again. */
+static bool sameToken(Token& a, Token& b) {
+	if ((a.type != b.type) || (a.line != b.line)) return false;
+	if (a.type == T_EOF) return true;
+	if (a.ascii != b.ascii) return false;
+	if (a.ascii.empty() || !isdigit((unsigned char)a.ascii[0])) return true;
+	if (a.type == TYPE_INTEGER) return a.val.intValue == b.val.intValue;
+	if (a.type == TYPE_FLOAT) return a.val.doubleValue == b.val.doubleValue;
+	return true;
+}
+
+// What differs between the tokens of a stream after edits and those of scanning its text again, "" if nothing does
+static string relexDifference(tokenStream& edited, tokenStream& scanned) {
+	vector<Token> tokens = edited.tokens(), expected = scanned.tokens();
+	vector<size_t> ends = edited.ends(), expectedEnds = scanned.ends();
+	vector<scanRestart> restarts = edited.restarts(), expectedRestarts = scanned.restarts();
+	ostringstream difference;
+	size_t i;
+	for (i = 0; (i < tokens.size()) && (i < expected.size()); i++) {
+		if (sameToken(tokens[i], expected[i]) && (ends[i] == expectedEnds[i])) continue;
+		difference << "token " << i << " is '" << tokens[i].ascii << "' (type " << tokens[i].type << ", line " << tokens[i].line;
+		difference << ", ending at " << ends[i] << ") instead of '" << expected[i].ascii << "' (type " << expected[i].type;
+		difference << ", line " << expected[i].line << ", ending at " << expectedEnds[i] << ")";
+		return difference.str();
+	}
+	if (tokens.size() != expected.size()) {
+		difference << tokens.size() << " tokens instead of " << expected.size();
+		return difference.str();
+	}
+	if ((edited.size() != scanned.size()) || (edited.text() != scanned.text())) return "the text or token count differs";
+	for (i = 0; (i < restarts.size()) && (i < expectedRestarts.size()); i++) {
+		scanRestart& a = restarts[i];
+		scanRestart& b = expectedRestarts[i];
+		if ((a.offset == b.offset) && (a.line == b.line) && (a.depth == b.depth)) continue;
+		difference << "restart point " << i << " is at " << a.offset << " (line " << a.line << ", depth " << a.depth;
+		difference << ") instead of " << b.offset << " (line " << b.line << ", depth " << b.depth << ")";
+		return difference.str();
+	}
+	if (restarts.size() != expectedRestarts.size()) {
+		difference << restarts.size() << " restart points instead of " << expectedRestarts.size();
+		return difference.str();
+	}
+	return "";
+}
+
+int runRelexCheck(string filename, int edits) {
+	ifstream file(filename.c_str(), ios::in | ios::binary);
+	if (!file) {
+		cout << "ERROR: Could not open " << filename << endl;
+		return 1;
+	}
+	ostringstream contents;
+	contents << file.rdbuf();
+	string text = contents.str();
+	tokenStream stream(text);
+
+	// A fixed generator, so running the check again makes the same edits
+	unsigned long long seed = 5183;
+	auto next = [&seed](size_t range) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		return (range == 0) ? 0 : (size_t)((seed >> 33) % range);
+	};
+	size_t pieces = sizeof(relexPieces) / sizeof(relexPieces[0]);
+	unsigned long long relexBytes = 0, fullBytes = 0;
+	chrono::steady_clock::duration relexTime(0), fullTime(0);
+	for (int e = 0; e < edits; e++) {
+		textEdit change;
+		change.offset = next(text.size() + 1);
+		size_t kind = next(4);
+		// Deleting as often as inserting keeps the text about the same size
+		if ((kind == 0) || (kind == 1)) change.length = next(min((size_t)16, text.size() - change.offset) + 1);
+		if ((kind == 1) || (kind == 2)) change.text = relexPieces[next(pieces)];
+		else if (kind == 3) {
+			size_t from = next(text.size() + 1);
+			change.text = text.substr(from, next(32));
+		}
+		text.replace(change.offset, change.length, change.text);
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		relexResult result = stream.edit(change);
+		chrono::steady_clock::time_point middle = chrono::steady_clock::now();
+		tokenStream scanned(text);
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		relexTime += middle - start;
+		fullTime += end - middle;
+		relexBytes += result.scanned;
+		fullBytes += text.size();
+
+		string difference = relexDifference(stream, scanned);
+		if (difference == "") continue;
+		cout << "Relexing " << filename << " differs from scanning it again after edit " << (e + 1) << " (" << change.length;
+		cout << " bytes at " << change.offset << " replaced with " << change.text.size() << "): " << difference << endl;
+		return 1;
+	}
+	double relexMs = chrono::duration<double, milli>(relexTime).count();
+	double fullMs = chrono::duration<double, milli>(fullTime).count();
+	cout << "Relexed " << edits << " edits of " << filename << " the same as scanning it again." << endl;
+	cout << "\tBytes scanned: " << relexBytes << " relexing, " << fullBytes << " scanning everything" << endl;
+	cout << "\tTime: " << relexMs << " ms relexing, " << fullMs << " ms scanning everything" << endl;
+	return 0;
+}
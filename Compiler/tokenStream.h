@@ -0,0 +1,99 @@
+#ifndef TOKENSTREAM_H
+#define TOKENSTREAM_H
+
+#include "scanner.h"
+#include "token.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Tokens kept in each chunk of a tokenStream when it is built. An edit only rebuilds the chunks it touches.
+#define TOKEN_CHUNK 256
+
+// Least free space a tokenStream's gap buffer grows by when an edit doesn't fit in it
+#define TEXT_GAP 4096
+
+/* Struct to hold an edit of the text: 'length' bytes at 'offset' replaced with 'text' */
+struct textEdit {
+	size_t offset = 0;
+	size_t length = 0;
+	string text;
+};
+
+/* Struct to hold what relexing an edit changed, for callers that keep something per token.
+ *    first - index of the first token replaced
+ *    removed - tokens replaced, starting at first
+ *    inserted - tokens put in their place
+ *    lineShift - lines the edit added (negative if it removed lines), which were added to the tokens after them
+ *    scanned - bytes scanned again
+ */
+struct relexResult {
+	size_t first = 0;
+	size_t removed = 0;
+	size_t inserted = 0;
+	int lineShift = 0;
+	size_t scanned = 0;
+};
+
+/* Struct to hold a run of consecutive tokens of a tokenStream. Shifting the tokens after an edit only changes the
+ * bases of the chunks after it, which are added to what the chunk holds.
+ *    offset / line - added to the ends, and to the lines of the tokens and restart points
+ *    tokens - the tokens
+ *    ends - offset in the text just past each token
+ *    restarts - points inside the chunk's multiline comments the scanner can restart from, in text order
+ */
+struct tokenChunk {
+	long long offset = 0;
+	int line = 0;
+	vector<Token> tokens;
+	vector<size_t> ends;
+	vector<scanRestart> restarts;
+};
+
+/*
+ * Tokens of a text kept in memory, for an editor or daemon that edits it. The text is scanned once, and after that
+ * edit() scans again only from the last point before the edit the scanner can restart from, until the tokens it
+ * makes line up with the old ones after the edit. That point is the end of a token (scanning a token reads at most
+ * one byte past it), or a line inside a multiline comment with the number of comments open there, so an edit in a
+ * long comment isn't scanned from where the comment starts. The old tokens after the edit are kept, and their
+ * offsets and line numbers are shifted instead of scanned again. The work an edit takes depends on how far it
+ * reaches, not on the size of the text.
+ * The text is kept in a gap buffer, with its free space where the last edit was, so an edit only moves the text
+ * between it and the last one. The tokens are as Scanner::getToken makes them, ending with the T_EOF token.
+ */
+class tokenStream
+{
+private:
+	string buffer;
+	size_t gapStart;
+	size_t gapEnd;
+	vector<tokenChunk> chunks;
+	size_t count;
+	void moveGap(size_t offset, size_t room);
+	scanText pieces();
+	size_t chunkEnding(size_t offset, size_t from);
+	void rebuild(size_t from, size_t to, vector<Token>& tokens, vector<size_t>& ends, vector<scanRestart>& restarts);
+public:
+	tokenStream(string text_input);
+	relexResult edit(textEdit change);
+	size_t length();
+	string text();
+	size_t size();
+	Token token(size_t index);
+	size_t end(size_t index);
+	vector<Token> tokens();
+	vector<size_t> ends();
+	vector<scanRestart> restarts();
+};
+
+/*
+ * Check of tokenStream::edit (--relex-check=N): makes N pseudo-random edits to the text of a file, mostly the ones
+ * that change how the text after them scans (comment and string delimiters, newlines, pieces of tokens, copies of
+ * the text), and after each one compares the tokens, their ends and the restart points with those of scanning the
+ * whole edited text. Prints the first difference and returns 1 if there is one. Otherwise prints how many bytes and
+ * how much time relexing took against scanning everything again, and returns 0.
+ */
+int runRelexCheck(string filename, int edits);
+
+#endif
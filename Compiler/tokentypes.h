@@ -28,9 +28,9 @@
 #define T_END 260
 #define T_GLOBAL 261
 #define T_PROCEDURE 262
-#define T_IN 263 // TODO: Delete this?
-#define T_OUT 264 // TODO: Delete this?
-#define T_INOUT 265 // TODO: Delete this?
+#define T_IN 263
+#define T_OUT 264
+#define T_INOUT 265
 #define T_INTEGER 266
 #define T_FLOAT 267
 #define T_BOOL 268
@@ -57,9 +57,10 @@
 // Used for type checking and scope
 #define TYPE_PROGRAM 285
 #define TYPE_PROCEDURE 286
-#define TYPE_PARAM_IN 287 // TODO: Delete this?
-#define TYPE_PARAM_OUT 288 // TODO: Delete this?
-#define TYPE_PARAM_INOUT 289 // TODO: Delete this?
+// Parameter modes. Arrays with a mode are passed by reference (read only for in), everything else by value.
+#define TYPE_PARAM_IN 287
+#define TYPE_PARAM_OUT 288
+#define TYPE_PARAM_INOUT 289
 #define TYPE_PARAM_NULL 290
 
 // Other